@@ -10,6 +10,8 @@ DeviceConfig::DeviceConfig() : deviceId("") {
 	ppm.store(0);
 	offset.store(0);
     agcMode.store(true);
+    nativeStreamFormat.store(false);
+    dcRemoval.store(false);
     sampleRate.store(0);
 }
 
@@ -57,6 +59,22 @@ bool DeviceConfig::getAGCMode() {
     return agcMode.load();
 }
 
+void DeviceConfig::setNativeStreamFormat(bool nativeFormat) {
+    nativeStreamFormat.store(nativeFormat);
+}
+
+bool DeviceConfig::getNativeStreamFormat() {
+    return nativeStreamFormat.load();
+}
+
+void DeviceConfig::setDCRemoval(bool dcRemoval) {
+    this->dcRemoval.store(dcRemoval);
+}
+
+bool DeviceConfig::getDCRemoval() {
+    return dcRemoval.load();
+}
+
 
 void DeviceConfig::setDeviceId(std::string deviceId) {
     std::lock_guard < std::mutex > lock(busy_lock);
@@ -100,6 +118,8 @@ void DeviceConfig::save(DataNode *node) {
     *node->newChild("offset") = offset.load();
     *node->newChild("sample_rate") = sampleRate.load();
     *node->newChild("agc_mode") = agcMode.load()?1:0;
+    *node->newChild("native_stream_format") = nativeStreamFormat.load()?1:0;
+    *node->newChild("dc_removal") = dcRemoval.load()?1:0;
 
     if (!antennaName.empty()) {
         *node->newChild("antenna") = antennaName;
@@ -159,6 +179,18 @@ void DeviceConfig::load(DataNode *node) {
         agc_node->element()->get(agcModeValue);
         setAGCMode(agcModeValue?true:false);
     }
+    if (node->hasAnother("native_stream_format")) {
+        DataNode *native_format_node = node->getNext("native_stream_format");
+        int nativeFormatValue = 0;
+        native_format_node->element()->get(nativeFormatValue);
+        setNativeStreamFormat(nativeFormatValue?true:false);
+    }
+    if (node->hasAnother("dc_removal")) {
+        DataNode *dc_removal_node = node->getNext("dc_removal");
+        int dcRemovalValue = 0;
+        dc_removal_node->element()->get(dcRemovalValue);
+        setDCRemoval(dcRemovalValue?true:false);
+    }
     if (node->hasAnother("sample_rate")) {
         DataNode *sample_rate_node = node->getNext("sample_rate");
         long sampleRateValue = 0;
@@ -307,12 +339,18 @@ AppConfig::AppConfig() : configName("") {
     winMax.store(false);
     showTips.store(true);
     perfMode.store(PERF_NORMAL);
+    sharedDemodulators.store(false);
+    parallelDSP.store(false);
     themeId.store(0);
     fontScale.store(0);
     snap.store(1);
     centerFreq.store(100000000);
     waterfallLinesPerSec.store(DEFAULT_WATERFALL_LPS);
     spectrumAvgSpeed.store(0.65f);
+    spectrumWindow.store(0);
+    spectrumOverlap.store(50);
+    waterfallHistoryHours.store(0);
+    waterfallRate.store(WATERFALL_RATE_SAMPLED);
     dbOffset.store(0);
     modemPropsCollapsed.store(false);
     mainSplit = -1;
@@ -393,6 +431,22 @@ bool AppConfig::getShowTips() {
     return showTips.load();
 }
 
+void AppConfig::setSharedDemodulators(bool shared) {
+    sharedDemodulators.store(shared);
+}
+
+bool AppConfig::getSharedDemodulators() {
+    return sharedDemodulators.load();
+}
+
+void AppConfig::setParallelDSP(bool parallel) {
+    parallelDSP.store(parallel);
+}
+
+bool AppConfig::getParallelDSP() {
+    return parallelDSP.load();
+}
+
 void AppConfig::setPerfMode(PerfModeEnum show) {
     perfMode.store(show);
 }
@@ -459,6 +513,38 @@ float AppConfig::getSpectrumAvgSpeed() {
     return spectrumAvgSpeed.load();
 }
 
+void AppConfig::setSpectrumWindow(int window) {
+    spectrumWindow.store(window);
+}
+
+int AppConfig::getSpectrumWindow() {
+    return spectrumWindow.load();
+}
+
+void AppConfig::setSpectrumOverlap(int overlapPercent) {
+    spectrumOverlap.store(overlapPercent);
+}
+
+int AppConfig::getSpectrumOverlap() {
+    return spectrumOverlap.load();
+}
+
+void AppConfig::setWaterfallRate(int rate) {
+    waterfallRate.store(rate);
+}
+
+int AppConfig::getWaterfallRate() {
+    return waterfallRate.load();
+}
+
+void AppConfig::setWaterfallHistoryHours(int hours) {
+    waterfallHistoryHours.store(hours);
+}
+
+int AppConfig::getWaterfallHistoryHours() {
+    return waterfallHistoryHours.load();
+}
+
 void AppConfig::setDBOffset(int offset) {
     this->dbOffset.store(offset);
 }
@@ -591,12 +677,18 @@ bool AppConfig::save() {
         *window_node->newChild("max") = winMax.load();
         *window_node->newChild("tips") = showTips.load();
         *window_node->newChild("perf_mode") = (int)perfMode.load();
+        *window_node->newChild("shared_demodulators") = sharedDemodulators.load();
+        *window_node->newChild("parallel_dsp") = parallelDSP.load();
         *window_node->newChild("theme") = themeId.load();
         *window_node->newChild("font_scale") = fontScale.load();
         *window_node->newChild("snap") = snap.load();
         *window_node->newChild("center_freq") = centerFreq.load();
         *window_node->newChild("waterfall_lps") = waterfallLinesPerSec.load();
         *window_node->newChild("spectrum_avg") = spectrumAvgSpeed.load();
+        *window_node->newChild("spectrum_window") = spectrumWindow.load();
+        *window_node->newChild("spectrum_overlap") = spectrumOverlap.load();
+        *window_node->newChild("waterfall_history_hours") = waterfallHistoryHours.load();
+        *window_node->newChild("waterfall_rate") = waterfallRate.load();
         *window_node->newChild("modemprops_collapsed") = modemPropsCollapsed.load();;
         *window_node->newChild("db_offset") = dbOffset.load();
 
@@ -716,6 +808,18 @@ bool AppConfig::load() {
             showTips.store(tips?true:false);
         }
 
+        if (win_node->hasAnother("shared_demodulators")) {
+            int shared;
+            win_node->getNext("shared_demodulators")->element()->get(shared);
+            sharedDemodulators.store(shared?true:false);
+        }
+
+        if (win_node->hasAnother("parallel_dsp")) {
+            int parallel;
+            win_node->getNext("parallel_dsp")->element()->get(parallel);
+            parallelDSP.store(parallel?true:false);
+        }
+
         // default:
         perfMode.store(PERF_NORMAL);
 
@@ -765,6 +869,30 @@ bool AppConfig::load() {
             spectrumAvgSpeed.store(avgVal);
         }
 
+        if (win_node->hasAnother("spectrum_window")) {
+            int windowVal;
+            win_node->getNext("spectrum_window")->element()->get(windowVal);
+            spectrumWindow.store(windowVal);
+        }
+
+        if (win_node->hasAnother("spectrum_overlap")) {
+            int overlapVal;
+            win_node->getNext("spectrum_overlap")->element()->get(overlapVal);
+            spectrumOverlap.store(overlapVal);
+        }
+
+        if (win_node->hasAnother("waterfall_history_hours")) {
+            int hoursVal;
+            win_node->getNext("waterfall_history_hours")->element()->get(hoursVal);
+            waterfallHistoryHours.store(hoursVal);
+        }
+
+        if (win_node->hasAnother("waterfall_rate")) {
+            int rateVal;
+            win_node->getNext("waterfall_rate")->element()->get(rateVal);
+            waterfallRate.store(rateVal);
+        }
+
         if (win_node->hasAnother("modemprops_collapsed")) {
             win_node->getNext("modemprops_collapsed")->element()->get(mpc);
             modemPropsCollapsed.store(mpc?true:false);
@@ -36,6 +36,16 @@ public:
 
     void setAGCMode(bool agcMode);
     bool getAGCMode();
+
+    //when set, stream the device native format (CS16, CS8) and convert it
+    //to float in the SDR thread, instead of letting the driver produce CF32.
+    void setNativeStreamFormat(bool nativeFormat);
+    bool getNativeStreamFormat();
+
+    //when set, and the device has no hardware DC offset correction, remove the DC offset
+    //in the SDR thread sample conversion, instead of by the DC blocker of the post-processing.
+    void setDCRemoval(bool dcRemoval);
+    bool getDCRemoval();
     
     void setDeviceId(std::string deviceId);
     std::string getDeviceId();
@@ -73,6 +83,8 @@ private:
     std::atomic_int ppm;
     std::atomic_llong offset;
     std::atomic_bool agcMode;
+    std::atomic_bool nativeStreamFormat;
+    std::atomic_bool dcRemoval;
     std::atomic_long sampleRate;
     std::string antennaName;
     ConfigSettings streamOpts;
@@ -90,6 +102,14 @@ public:
         PERF_HIGH = 2
     };
 
+    enum WaterfallRate {
+        //a line sampled from the input per waterfall line.
+        WATERFALL_RATE_SAMPLED = 0,
+        //all of the input FFT-ed and folded into the waterfall lines, by max or mean.
+        WATERFALL_RATE_FULL_MAX = 1,
+        WATERFALL_RATE_FULL_MEAN = 2
+    };
+
 
     AppConfig();
     std::string getConfigDir();
@@ -109,6 +129,15 @@ public:
 
     void setPerfMode(PerfModeEnum mode);
     PerfModeEnum getPerfMode();
+
+    //Run the demodulators started from now on as tasks of a shared pool of one thread per core,
+    //instead of threads of their own.
+    void setSharedDemodulators(bool shared);
+    bool getSharedDemodulators();
+
+    //Spread the channelizer and the Welch spectrum estimator over worker threads, off by default.
+    void setParallelDSP(bool parallel);
+    bool getParallelDSP();
     
     void setTheme(int themeId);
     int getTheme();
@@ -127,6 +156,21 @@ public:
     
     void setSpectrumAvgSpeed(float avgSpeed);
     float getSpectrumAvgSpeed();
+
+    //Welch spectrum estimator window, as SpectrumEstimator::WindowType, 0 (rectangular) for a single FFT.
+    void setSpectrumWindow(int window);
+    int getSpectrumWindow();
+
+    void setSpectrumOverlap(int overlapPercent);
+    int getSpectrumOverlap();
+
+    //as WaterfallRate.
+    void setWaterfallRate(int rate);
+    int getWaterfallRate();
+
+    //Hours of waterfall history kept on disk, 0 to keep none.
+    void setWaterfallHistoryHours(int hours);
+    int getWaterfallHistoryHours();
     
     void setDBOffset(int offset);
     int getDBOffset();
@@ -193,7 +237,7 @@ private:
     std::string configName;
     std::map<std::string, DeviceConfig *> deviceConfig;
     std::atomic_int winX,winY,winW,winH;
-    std::atomic_bool winMax, showTips, modemPropsCollapsed;
+    std::atomic_bool winMax, showTips, modemPropsCollapsed, sharedDemodulators, parallelDSP;
     std::atomic_int themeId;
     std::atomic_int fontScale;
     std::atomic_llong snap;
@@ -201,6 +245,8 @@ private:
     std::atomic_int waterfallLinesPerSec;
     std::atomic<float> spectrumAvgSpeed, mainSplit, visSplit, bookmarkSplit;
     std::atomic_int dbOffset;
+    std::atomic_int spectrumWindow, spectrumOverlap;
+    std::atomic_int waterfallHistoryHours, waterfallRate;
     std::vector<SDRManualDef> manualDevices;
     std::atomic_bool bookmarksVisible;
 
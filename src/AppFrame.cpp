@@ -72,6 +72,10 @@ public:
 #define APPFRAME_MODEMPROPS_MINSIZE 20
 #define APPFRAME_MODEMPROPS_MAXSIZE 240
 
+//Waterfall history menu choices, in hours, the first one for none.
+#define WATERFALL_HISTORY_NUM_HOURS 5
+static const int waterfallHistoryHours[WATERFALL_HISTORY_NUM_HOURS] = { 0, 1, 4, 12, 24 };
+
 AppFrame::AppFrame() :
         wxFrame(NULL, wxID_ANY, CUBICSDR_TITLE), activeDemodulator(nullptr) {
 
@@ -267,6 +271,12 @@ AppFrame::AppFrame() :
     waterfallDataThread->setOutputQueue("FFTDataOutput", waterfallCanvas->getVisualDataQueue());
     waterfallDataThread->getProcessor()->setHideDC(true);
 
+    // The spectrum averages the FFT frames of the waterfall, rather than running the same FFTs:
+    SpectrumFrameQueuePtr spectrumFrames = std::make_shared<SpectrumFrameQueue>();
+    spectrumFrames->set_max_num_items(1);
+    waterfallDataThread->getProcessor()->attachFrameOutput(spectrumFrames);
+    wxGetApp().getSpectrumProcessor()->setFrameInput(spectrumFrames);
+
     t_FFTData = new std::thread(&FFTVisualDataThread::threadMain, waterfallDataThread);
 
 
@@ -408,12 +418,19 @@ void AppFrame::initConfigurationSettings() {
     spectrumAvgMeter->setLevel(spectrumAvg);
     wxGetApp().getSpectrumProcessor()->setFFTAverageRate(spectrumAvg);
 
+    // Init spectrum estimator
+    updateSpectrumEstimator();
+
     // Init waterfall speed
     int wflps =wxGetApp().getConfig()->getWaterfallLinesPerSec();
     waterfallSpeedMeter->setLevel(sqrtf(wflps));
     waterfallDataThread->setLinesPerSecond(wflps);
     waterfallCanvas->setLinesPerSecond(wflps);
 
+    // Init waterfall rate and history
+    updateWaterfallRate();
+    updateWaterfallHistory();
+
     // Init modem property collapsed state
     int mpc =wxGetApp().getConfig()->getModemPropsCollapsed();
     if (mpc) {
@@ -612,12 +629,91 @@ wxMenu *AppFrame::makeDisplayMenu() {
 
     dispMenu->AppendSubMenu(themeMenu, wxT("&Color Scheme"));
 
+    wxMenu *estimatorMenu = new wxMenu;
+
+    int spectrumWindow = wxGetApp().getConfig()->getSpectrumWindow();
+    int spectrumOverlap = wxGetApp().getConfig()->getSpectrumOverlap();
+
+    estimatorMenu->AppendRadioItem(wxID_SPECTRUM_ESTIMATOR_BASE, "Single FFT")->Check(spectrumWindow == SpectrumEstimator::WINDOW_RECTANGULAR);
+    estimatorMenu->AppendRadioItem(wxID_SPECTRUM_ESTIMATOR_BASE + SpectrumEstimator::WINDOW_HANN, "Welch, Hann")->Check(spectrumWindow == SpectrumEstimator::WINDOW_HANN);
+    estimatorMenu->AppendRadioItem(wxID_SPECTRUM_ESTIMATOR_BASE + SpectrumEstimator::WINDOW_BLACKMAN_HARRIS, "Welch, Blackman-Harris")->Check(spectrumWindow == SpectrumEstimator::WINDOW_BLACKMAN_HARRIS);
+    estimatorMenu->AppendRadioItem(wxID_SPECTRUM_ESTIMATOR_BASE + SpectrumEstimator::WINDOW_FLAT_TOP, "Welch, Flat-top")->Check(spectrumWindow == SpectrumEstimator::WINDOW_FLAT_TOP);
+    estimatorMenu->AppendSeparator();
+    estimatorMenu->AppendRadioItem(wxID_SPECTRUM_OVERLAP_50, "Overlap 50%")->Check(spectrumOverlap != 75);
+    estimatorMenu->AppendRadioItem(wxID_SPECTRUM_OVERLAP_75, "Overlap 75%")->Check(spectrumOverlap == 75);
+
+    dispMenu->AppendSubMenu(estimatorMenu, wxT("&Spectrum Estimator"));
+
+    wxMenu *rateMenu = new wxMenu;
+
+    int waterfallRate = wxGetApp().getConfig()->getWaterfallRate();
+
+    rateMenu->AppendRadioItem(wxID_WATERFALL_RATE_BASE + AppConfig::WATERFALL_RATE_SAMPLED, "Sampled Lines")->Check(waterfallRate == AppConfig::WATERFALL_RATE_SAMPLED);
+    rateMenu->AppendRadioItem(wxID_WATERFALL_RATE_BASE + AppConfig::WATERFALL_RATE_FULL_MAX, "Full Rate, Peak")->Check(waterfallRate == AppConfig::WATERFALL_RATE_FULL_MAX);
+    rateMenu->AppendRadioItem(wxID_WATERFALL_RATE_BASE + AppConfig::WATERFALL_RATE_FULL_MEAN, "Full Rate, Average")->Check(waterfallRate == AppConfig::WATERFALL_RATE_FULL_MEAN);
+
+    dispMenu->AppendSubMenu(rateMenu, wxT("Waterfall &Rate"));
+
+    wxMenu *historyMenu = new wxMenu;
+
+    int historyHours = wxGetApp().getConfig()->getWaterfallHistoryHours();
+
+    historyMenu->AppendRadioItem(wxID_WATERFALL_HISTORY_BASE, "Off")->Check(historyHours <= 0);
+    for (int i = 1; i < WATERFALL_HISTORY_NUM_HOURS; i++) {
+        historyMenu->AppendRadioItem(wxID_WATERFALL_HISTORY_BASE + i, std::to_string(waterfallHistoryHours[i]) + " h")->Check(historyHours == waterfallHistoryHours[i]);
+    }
+    historyMenu->AppendSeparator();
+    historyMenu->Append(wxID_WATERFALL_HISTORY_EXPORT, "Export...");
+
+    dispMenu->AppendSubMenu(historyMenu, wxT("Waterfall &History"));
+
     hideBookmarksItem = dispMenu->AppendCheckItem(wxID_DISPLAY_BOOKMARKS, wxT("Hide Bookmarks"));
     hideBookmarksItem->Check(!wxGetApp().getConfig()->getBookmarksVisible());
 
     return dispMenu;
 }
 
+void AppFrame::updateSpectrumEstimator() {
+    int spectrumWindow = wxGetApp().getConfig()->getSpectrumWindow();
+    int spectrumOverlap = wxGetApp().getConfig()->getSpectrumOverlap();
+    bool enabled = (spectrumWindow != SpectrumEstimator::WINDOW_RECTANGULAR);
+    bool parallel = wxGetApp().getConfig()->getParallelDSP();
+
+    wxGetApp().getSpectrumProcessor()->setWelchEstimator(enabled, (SpectrumEstimator::WindowType)spectrumWindow, spectrumOverlap, parallel);
+
+    if (wxGetApp().getDemodSpectrumProcessor()) {
+        wxGetApp().getDemodSpectrumProcessor()->setWelchEstimator(enabled, (SpectrumEstimator::WindowType)spectrumWindow, spectrumOverlap, parallel);
+    }
+}
+
+void AppFrame::updateWaterfallRate() {
+    int waterfallRate = wxGetApp().getConfig()->getWaterfallRate();
+    bool fullRate = (waterfallRate == AppConfig::WATERFALL_RATE_FULL_MAX || waterfallRate == AppConfig::WATERFALL_RATE_FULL_MEAN);
+    SpectrumEstimator::FoldType fold = (waterfallRate == AppConfig::WATERFALL_RATE_FULL_MEAN) ? SpectrumEstimator::FOLD_MEAN : SpectrumEstimator::FOLD_MAX;
+
+    //the spectrum stops following the waterfall frames meanwhile, see handleScopeSpectrumProcessors().
+    waterfallDataThread->setFullRate(fullRate, fold);
+}
+
+void AppFrame::updateWaterfallHistory() {
+    int hours = wxGetApp().getConfig()->getWaterfallHistoryHours();
+
+    waterfallHistoryLPS = waterfallHistoryPendingLPS = waterfallDataThread->getLinesPerSecond();
+
+    if (hours <= 0) {
+        waterfallCanvas->disableHistory();
+        return;
+    }
+
+    //sized for the current line rate, up to WATERFALL_HISTORY_MAX_FILE_SIZE, the latest rows being moved
+    //to a new file when it changes.
+    int lps = std::max(waterfallDataThread->getLinesPerSecond(), 1);
+    size_t capacity = (size_t)hours * 3600 * (size_t)lps;
+    std::string historyPath = wxFileName(wxGetApp().getConfig()->getConfigDir(), "waterfall_history.bin").GetFullPath().ToStdString();
+
+    waterfallCanvas->enableHistory(historyPath, capacity);
+}
+
 wxMenu *AppFrame::makeAudioSampleRateMenu() {
     // Audio Sample Rates
     wxMenu *pMenu = new wxMenu;
@@ -843,6 +939,7 @@ wxMenu *AppFrame::makeFileMenu() {
 #endif
 #endif
     menu->Append(wxID_SDR_DEVICES, "SDR Devices");
+    menu->Append(wxID_PIPELINE_STATS, "Pipeline Statistics");
     menu->AppendSeparator();
     menu->Append(wxID_SDR_START_STOP, "Stop / Start Device");
     menu->AppendSeparator();
@@ -1000,6 +1097,7 @@ void AppFrame::handleUpdateDeviceParams() {
     } else {
         wxGetApp().setChannelizerType(SDRPostThreadChannelizerType::SDRPostPFBCH);
     }
+    wxGetApp().setParallelChannelizer(wxGetApp().getConfig()->getParallelDSP());
 
     performanceMenuItems[wxID_PERF_BASE + (int)perfMode]->Check(true);
 
@@ -1007,6 +1105,12 @@ void AppFrame::handleUpdateDeviceParams() {
 
     performanceMenuItems[wxID_PERF_CURRENT] = newSettingsMenu->AppendSubMenu(subMenu, "CPU usage");
     performanceMenuItems[wxID_PERF_CURRENT]->SetItemLabel(getSettingsLabel("CPU usage", selectedPerfModeItem->GetItemLabel().ToStdString()));
+
+    //applies to the demodulators started afterwards.
+    newSettingsMenu->AppendCheckItem(wxID_SET_SHARED_DEMODULATORS, "Shared Demodulator Threads")->Check(wxGetApp().getConfig()->getSharedDemodulators());
+
+    //channelizer and spectrum estimator spread over the cores.
+    newSettingsMenu->AppendCheckItem(wxID_SET_PARALLEL_DSP, "Multi-threaded DSP")->Check(wxGetApp().getConfig()->getParallelDSP());
    
     newSettingsMenu->AppendSeparator();
 
@@ -1290,9 +1394,12 @@ void AppFrame::dismissRigControlPortDialog() {
 
 void AppFrame::OnMenu(wxCommandEvent &event) {
     actionOnMenuAbout(event)
+    || actionOnMenuPipelineStats(event)
     || actionOnMenuSDRStartStop(event)
     || actionOnMenuPerformance(event)
     || actionOnMenuTips(event)
+    || actionOnMenuSharedDemodulators(event)
+    || actionOnMenuParallelDSP(event)
     || actionOnMenuIQSwap(event)
     || actionOnMenuFreqOffset(event)
     || actionOnMenuDBOffset(event)
@@ -1348,6 +1455,38 @@ bool AppFrame::actionOnMenuDisplay(wxCommandEvent& event) {
     else if (event.GetId() == wxID_DISPLAY_BASE + 2) {
         GLFont::setScale(GLFont::GLFONT_SCALE_LARGE);
     }
+    //Display : spectrum estimator
+    else if (event.GetId() >= wxID_SPECTRUM_ESTIMATOR_BASE && event.GetId() <= wxID_SPECTRUM_ESTIMATOR_BASE + SpectrumEstimator::WINDOW_FLAT_TOP) {
+        wxGetApp().getConfig()->setSpectrumWindow(event.GetId() - wxID_SPECTRUM_ESTIMATOR_BASE);
+        updateSpectrumEstimator();
+    }
+    else if (event.GetId() == wxID_SPECTRUM_OVERLAP_50 || event.GetId() == wxID_SPECTRUM_OVERLAP_75) {
+        wxGetApp().getConfig()->setSpectrumOverlap((event.GetId() == wxID_SPECTRUM_OVERLAP_75) ? 75 : 50);
+        updateSpectrumEstimator();
+    }
+    //Display : waterfall rate
+    else if (event.GetId() >= wxID_WATERFALL_RATE_BASE && event.GetId() <= wxID_WATERFALL_RATE_BASE + AppConfig::WATERFALL_RATE_FULL_MEAN) {
+        wxGetApp().getConfig()->setWaterfallRate(event.GetId() - wxID_WATERFALL_RATE_BASE);
+        updateWaterfallRate();
+    }
+    //Display : waterfall history
+    else if (event.GetId() >= wxID_WATERFALL_HISTORY_BASE && event.GetId() < wxID_WATERFALL_HISTORY_BASE + WATERFALL_HISTORY_NUM_HOURS) {
+        wxGetApp().getConfig()->setWaterfallHistoryHours(waterfallHistoryHours[event.GetId() - wxID_WATERFALL_HISTORY_BASE]);
+        updateWaterfallHistory();
+    }
+    else if (event.GetId() == wxID_WATERFALL_HISTORY_EXPORT) {
+        if (!waterfallCanvas->isHistoryEnabled()) {
+            wxMessageDialog noHistoryDialog(this, "Enable the waterfall history first, in Display > Waterfall History.", "Waterfall History", wxOK | wxICON_INFORMATION);
+            noHistoryDialog.ShowModal();
+        } else {
+            wxFileDialog saveFileDialog(this, _("Export Waterfall History"), "", "", "PGM files (*.pgm)|*.pgm", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+            if (saveFileDialog.ShowModal() != wxID_CANCEL) {
+                if (!waterfallCanvas->exportHistory(saveFileDialog.GetPath().ToStdString())) {
+                    std::cout << "Warning, unable to export the waterfall history." << std::endl;
+                }
+            }
+        }
+    }
     else if (event.GetId() == wxID_DISPLAY_BOOKMARKS) {
         if (hideBookmarksItem->IsChecked()) {
             bookmarkSplitter->Unsplit(bookmarkView);
@@ -1439,6 +1578,26 @@ bool AppFrame::actionOnMenuAbout(wxCommandEvent& event) {
     return false;
 }
 
+bool AppFrame::actionOnMenuPipelineStats(wxCommandEvent& event) {
+
+    if (event.GetId() == wxID_PIPELINE_STATS) {
+        if (pipelineStatsDlg != nullptr) {
+            pipelineStatsDlg->Raise();
+            pipelineStatsDlg->SetFocus();
+        }
+        else {
+            pipelineStatsDlg = new PipelineStatsDialog(NULL);
+            pipelineStatsDlg->Connect(wxEVT_CLOSE_WINDOW, wxCommandEventHandler(AppFrame::OnPipelineStatsDialogClose), NULL, this);
+
+            pipelineStatsDlg->Show();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
 bool AppFrame::actionOnMenuSettings(wxCommandEvent& event) {
 
     int antennaIdMax = wxID_ANTENNAS_BASE + antennaNames.size();
@@ -2058,6 +2217,26 @@ bool AppFrame::actionOnMenuTips(wxCommandEvent &event) {
     return false;
 }
 
+bool AppFrame::actionOnMenuSharedDemodulators(wxCommandEvent &event) {
+    if (event.GetId() == wxID_SET_SHARED_DEMODULATORS) {
+        wxGetApp().getConfig()->setSharedDemodulators(!wxGetApp().getConfig()->getSharedDemodulators());
+        return true;
+    }
+    return false;
+}
+
+bool AppFrame::actionOnMenuParallelDSP(wxCommandEvent &event) {
+    if (event.GetId() == wxID_SET_PARALLEL_DSP) {
+        bool parallel = !wxGetApp().getConfig()->getParallelDSP();
+
+        wxGetApp().getConfig()->setParallelDSP(parallel);
+        wxGetApp().setParallelChannelizer(parallel);
+        updateSpectrumEstimator();
+        return true;
+    }
+    return false;
+}
+
 bool AppFrame::actionOnMenuPerformance(wxCommandEvent &event) {
     if (event.GetId() >= wxID_PERF_BASE && event.GetId() <= wxID_PERF_BASE + (int) AppConfig::PERF_HIGH) {
 
@@ -2186,6 +2365,7 @@ void AppFrame::OnIdle(wxIdleEvent &event) {
     handleScopeSpectrumProcessors();
     handleModemProperties();
     handlePeakHold();
+    handleWaterfallHistoryRate();
 
 #if USE_HAMLIB
     handleRigMenu();
@@ -2210,6 +2390,22 @@ void AppFrame::OnIdle(wxIdleEvent &event) {
     event.RequestMore();
 }
 
+void AppFrame::handleWaterfallHistoryRate() {
+    int lps = waterfallDataThread->getLinesPerSecond();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    //wait for the speed meter to be released before resizing the history file.
+    if (lps != waterfallHistoryPendingLPS) {
+        waterfallHistoryPendingLPS = lps;
+        waterfallHistoryRateChange = now;
+        return;
+    }
+
+    if (lps != waterfallHistoryLPS && now - waterfallHistoryRateChange >= std::chrono::seconds(1)) {
+        updateWaterfallHistory();
+    }
+}
+
 void AppFrame::handleTXAntennaChange() {//Refresh the current TX antenna on, if any:
     if ((antennaMenuItems.find(wxID_ANTENNA_CURRENT_TX) != antennaMenuItems.end()) && devInfo) {
         string actualTxAntenna = devInfo->getAntennaName(SOAPY_SDR_TX, 0);
@@ -2328,6 +2524,7 @@ void AppFrame::handleScopeSpectrumProcessors() {
                    waterfallCanvas->getBandwidth());
 
     proc->setView(wproc->isView(), wproc->getCenterFrequency(), wproc->getBandwidth());
+    proc->setFollowFrames(waterfallDataThread->getLinesPerSecond() >= SPECTRUM_FOLLOW_WATERFALL_MIN_LPS && !waterfallDataThread->isFullRate());
 }
 
 void AppFrame::handleScopeProcessor() {
@@ -2632,6 +2829,11 @@ void AppFrame::OnAboutDialogClose(wxCommandEvent& /* event */) {
     aboutDlg = nullptr;
 }
 
+void AppFrame::OnPipelineStatsDialogClose(wxCommandEvent& /* event */) {
+    pipelineStatsDlg->Destroy();
+    pipelineStatsDlg = nullptr;
+}
+
 void AppFrame::saveSession(std::string fileName) {
     wxGetApp().getSessionMgr().saveSession(fileName);
 
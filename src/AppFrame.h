@@ -26,9 +26,11 @@
 #include "FrequencyDialog.h"
 #include "BookmarkView.h"
 #include "AboutDialog.h"
+#include "PipelineStatsDialog.h"
 #include "DemodulatorInstance.h"
 #include "DemodulatorThread.h"
 #include <map>
+#include <chrono>
 
 
 #ifdef USE_HAMLIB
@@ -145,6 +147,11 @@ private:
 	FFTVisualDataThread *waterfallDataThread;
 	std::thread *t_FFTData;
 
+	//line rate the waterfall history is sized for, and the latest rate with the time it was set,
+	//so that the history is resized once the rate settles.
+	int waterfallHistoryLPS = 0, waterfallHistoryPendingLPS = 0;
+	std::chrono::steady_clock::time_point waterfallHistoryRateChange;
+
 
 	/***
 	 * Active Settings
@@ -170,6 +177,7 @@ private:
     std::string currentTXantennaName;
 
     AboutDialog *aboutDlg = nullptr;
+    PipelineStatsDialog *pipelineStatsDlg = nullptr;
     std::string lastToolTip;
 
 #ifdef ENABLE_DIGITAL_LAB
@@ -186,6 +194,7 @@ private:
     void OnDoubleClickSash(wxSplitterEvent& event);
     void OnUnSplit(wxSplitterEvent& event);
     void OnAboutDialogClose(wxCommandEvent& event);
+    void OnPipelineStatsDialogClose(wxCommandEvent& event);
 	void OnNewWindow(wxCommandEvent& event);
 
     /**
@@ -231,6 +240,10 @@ private:
     wxMenu *makeFileMenu();
     wxMenu *makeAudioSampleRateMenu();
     wxMenu *makeDisplayMenu();
+    //apply the configured spectrum estimator to the spectrum processors.
+    void updateSpectrumEstimator();
+    void updateWaterfallHistory();
+    void updateWaterfallRate();
     wxMenu *makeRecordingMenu();
     void updateRecordingMenu();
 
@@ -245,6 +258,7 @@ private:
 	//actionXXXX manage menu actions, return true if the event has been
 	//treated.
 	bool actionOnMenuAbout(wxCommandEvent& event);
+	bool actionOnMenuPipelineStats(wxCommandEvent& event);
 	bool actionOnMenuReset(wxCommandEvent& event);
 	bool actionOnMenuSettings(wxCommandEvent& event);
 	bool actionOnMenuAGC(wxCommandEvent& event);
@@ -257,6 +271,8 @@ private:
 	bool actionOnMenuSDRStartStop(wxCommandEvent &event);
 	bool actionOnMenuPerformance(wxCommandEvent &event);
 	bool actionOnMenuTips(wxCommandEvent &event);
+	bool actionOnMenuSharedDemodulators(wxCommandEvent &event);
+	bool actionOnMenuParallelDSP(wxCommandEvent &event);
 	bool actionOnMenuIQSwap(wxCommandEvent &event);
 	bool actionOnMenuFreqOffset(wxCommandEvent &event);
 	bool actionOnMenuDBOffset(wxCommandEvent &event);
@@ -280,6 +296,7 @@ private:
     void handleScopeSpectrumProcessors();
     void handleModemProperties();
     void handlePeakHold();
+    void handleWaterfallHistoryRate();
 
 
     /**
@@ -328,6 +345,9 @@ private:
 #define wxID_SDR_START_STOP 2010
 #define wxID_SET_DB_OFFSET 2012
 #define wxID_ABOUT_CUBICSDR 2013
+#define wxID_PIPELINE_STATS 2014
+#define wxID_SET_SHARED_DEMODULATORS 2015
+#define wxID_SET_PARALLEL_DSP 2016
 
 #define wxID_OPEN_BOOKMARKS 2020
 #define wxID_SAVE_BOOKMARKS 2021
@@ -354,6 +374,18 @@ private:
 
 #define wxID_DISPLAY_BASE 2250
 
+//+ SpectrumEstimator::WindowType, the base itself for a single FFT.
+#define wxID_SPECTRUM_ESTIMATOR_BASE 2260
+#define wxID_SPECTRUM_OVERLAP_50 2270
+#define wxID_SPECTRUM_OVERLAP_75 2271
+
+//+ index in the waterfall history hours, the base itself for none.
+#define wxID_WATERFALL_HISTORY_BASE 2275
+#define wxID_WATERFALL_HISTORY_EXPORT 2285
+
+//+ AppConfig::WaterfallRate.
+#define wxID_WATERFALL_RATE_BASE 2290
+
 #define wxID_SETTINGS_BASE 2300
 
 #define wxID_ANTENNA_CURRENT 2350
@@ -31,6 +31,8 @@ IMPLEMENT_APP(CubicSDR)
 #include <clocale>
 
 #include "ActionDialog.h"
+#include "ThreadSPSCQueue.h"
+#include "PipelineMetrics.h"
 
 #include <memory>
 
@@ -326,17 +328,19 @@ bool CubicSDR::OnInit() {
     // Visual Data
     spectrumVisualThread = new SpectrumVisualDataThread();
     
-    pipeIQVisualData = std::make_shared<DemodulatorThreadInputQueue>();
+    // IQ pipes having a single producer thread and a single consumer thread
+    // use the lock-free ThreadSPSCQueue, the others the regular ThreadBlockingQueue.
+    pipeIQVisualData = std::make_shared<ThreadSPSCQueue<DemodulatorThreadIQDataPtr>>();
     pipeIQVisualData->set_max_num_items(1);
     
-    pipeWaterfallIQVisualData = std::make_shared<DemodulatorThreadInputQueue>();
+    pipeWaterfallIQVisualData = std::make_shared<ThreadSPSCQueue<DemodulatorThreadIQDataPtr>>();
     pipeWaterfallIQVisualData->set_max_num_items(128);
     
     getSpectrumProcessor()->setInput(pipeIQVisualData);
     getSpectrumProcessor()->setHideDC(true);
     
     // I/Q Data
-    pipeSDRIQData = std::make_shared<SDRThreadIQDataQueue>();
+    pipeSDRIQData = std::make_shared<ThreadSPSCQueue<SDRThreadIQDataPtr>>();
     pipeSDRIQData->set_max_num_items(100);
     
     sdrThread = new SDRThread();
@@ -347,6 +351,10 @@ bool CubicSDR::OnInit() {
 
     sdrPostThread->setOutputQueue("IQVisualDataOutput", pipeIQVisualData);
     sdrPostThread->setOutputQueue("IQDataOutput", pipeWaterfallIQVisualData);
+
+    PipelineMetrics::registerQueue("SDR IQ data", pipeSDRIQData);
+    PipelineMetrics::registerQueue("Spectrum IQ data", pipeIQVisualData);
+    PipelineMetrics::registerQueue("Waterfall IQ data", pipeWaterfallIQVisualData);
      
 #if CUBICSDR_ENABLE_VIEW_SCOPE
     pipeAudioVisualData = std::make_shared<DemodulatorThreadOutputQueue>();
@@ -359,13 +367,14 @@ bool CubicSDR::OnInit() {
     
 #if CUBICSDR_ENABLE_VIEW_DEMOD
     demodVisualThread = new SpectrumVisualDataThread();
-    pipeDemodIQVisualData = std::make_shared<DemodulatorThreadInputQueue>();
+    pipeDemodIQVisualData = std::make_shared<ThreadSPSCQueue<DemodulatorThreadIQDataPtr>>();
     pipeDemodIQVisualData->set_max_num_items(1);
     
     if (getDemodSpectrumProcessor()) {
         getDemodSpectrumProcessor()->setInput(pipeDemodIQVisualData);
     }
     sdrPostThread->setOutputQueue("IQActiveDemodVisualDataOutput", pipeDemodIQVisualData);
+    PipelineMetrics::registerQueue("Demod spectrum IQ data", pipeDemodIQVisualData);
 #else
     demodVisualThread = nullptr;
     pipeDemodIQVisualData = nullptr;
@@ -702,6 +711,21 @@ SDRPostThreadChannelizerType CubicSDR::getChannelizerType() {
     return SDRPostThreadChannelizerType::SDRPostPFBCH;
 }
 
+void CubicSDR::setParallelChannelizer(bool parallel) {
+    if (sdrPostThread && !sdrPostThread->isTerminated()) {
+        sdrPostThread->setParallelChannelizer(parallel);
+    }
+}
+
+bool CubicSDR::getParallelChannelizer() {
+
+    if (sdrPostThread && !sdrPostThread->isTerminated()) {
+        return sdrPostThread->getParallelChannelizer();
+    }
+
+    return false;
+}
+
 long long CubicSDR::getFrequency() {
     return frequency;
 }
@@ -736,6 +760,12 @@ void CubicSDR::setSampleRate(long long rate_in) {
 
     setFrequency(frequency);
 
+    spectrumVisualThread->getProcessor()->setDeviceSampleRate(sampleRate);
+    appframe->getWaterfallDataThread()->getProcessor()->setDeviceSampleRate(sampleRate);
+    if (demodVisualThread) {
+        demodVisualThread->getProcessor()->setDeviceSampleRate(sampleRate);
+    }
+
     if (rate_in <= CHANNELIZER_RATE_MAX / 8) {
         appframe->setMainWaterfallFFTSize(DEFAULT_FFT_SIZE / 4);
         appframe->getWaterfallDataThread()->getProcessor()->setHideDC(false);
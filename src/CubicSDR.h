@@ -99,6 +99,9 @@ public:
 
     void setChannelizerType(SDRPostThreadChannelizerType chType);
     SDRPostThreadChannelizerType getChannelizerType();
+
+    void setParallelChannelizer(bool parallel);
+    bool getParallelChannelizer();
    
 
     void setSampleRate(long long rate_in);
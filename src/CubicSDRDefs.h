@@ -55,6 +55,10 @@ const char filePathSeparator =
 
 #define DEFAULT_WATERFALL_LPS 30
 
+//The main spectrum takes the FFT frames of the waterfall when it runs
+//at least at this many lines per second, else it runs its own FFTs.
+#define SPECTRUM_FOLLOW_WATERFALL_MIN_LPS 20
+
 //Dmod waterfall lines per second is adjusted 
 //so that the whole demod waterfall show DEMOD_WATERFALL_DURATION_IN_SECONDS
 //seconds.
@@ -13,6 +13,11 @@
 #include <thread>
 #include <memory>
 #include <climits>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
 #include "ThreadBlockingQueue.h"
 #include "Timer.h"
 #include "SpinMutex.h"
@@ -157,6 +162,223 @@ private:
 };
 
 
+#define BUFFER_POOL_DEFAULT_CAPACITY 256
+//Bytes reserved per slot for the std::shared_ptr control block of the buffer.
+#define BUFFER_POOL_CONTROL_BLOCK_SIZE 64
+
+//A fixed-capacity pool of BufferType, as a O(1) alternative to ReBuffer:
+//free buffers are kept in a lock-free free-list (a tagged Treiber stack of slot indices)
+//and a buffer returned by getBuffer() goes back to the free-list by itself, when the last reference
+//on its std::shared_ptr is released, from whatever thread.
+//BufferType instances are allocated lazily on the first use of each slot, and reused as-is afterwards,
+//so that their internal storage (typically a std::vector) keeps its capacity. The std::shared_ptr control
+//blocks are not heap-allocated either, but placed in a slab holding one block per slot.
+//If the pool is exhausted getBuffer() does not block but falls back to a non-pooled heap allocation.
+template<typename BufferType>
+class BufferPool {
+
+    typedef typename std::shared_ptr<BufferType> BufferPoolPtr;
+
+    //The pool storage, referenced by the pool and by each buffer currently in use,
+    //so that it is only destroyed when the last of them is released.
+    class Storage {
+    public:
+        static const uint32_t NIL_INDEX = 0xFFFFFFFF;
+
+        typedef typename std::aligned_storage<BUFFER_POOL_CONTROL_BLOCK_SIZE, alignof(std::max_align_t)>::type ControlBlock;
+
+        Storage(size_t capacity) : slots(capacity, nullptr), controlBlocks(capacity), nextFree(capacity) {
+            
+            //chain all slots in the free-list:
+            for (size_t i = 0; i < capacity; i++) {
+                nextFree[i].store((i + 1 < capacity) ? (uint32_t)(i + 1) : NIL_INDEX);
+            }
+            freeHead.store((capacity > 0) ? 0 : NIL_INDEX);
+            //the reference of the pool itself.
+            references.store(1);
+            highWaterMark.store(0);
+            overflowCount.store(0);
+        }
+
+        ~Storage() {
+            for (BufferType *slot : slots) {
+                delete slot;
+            }
+        }
+
+        //pop a free slot index, or NIL_INDEX if none is available.
+        uint32_t acquire() {
+            uint64_t head = freeHead.load(std::memory_order_acquire);
+
+            while ((uint32_t)head != NIL_INDEX) {
+                uint32_t index = (uint32_t)head;
+                //the tag in the upper 32 bits is bumped at each change to defeat ABA.
+                uint64_t newHead = (((head >> 32) + 1) << 32) | nextFree[index].load(std::memory_order_relaxed);
+
+                if (freeHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    
+                    //the previous count includes the reference of the pool, so it is the new number of slots in use.
+                    //A release may have pushed its slot back without having dropped its reference yet, hence the bound.
+                    size_t inUse = std::min(references.fetch_add(1), slots.size());
+                    size_t highest = highWaterMark.load();
+
+                    while (inUse > highest && !highWaterMark.compare_exchange_weak(highest, inUse)) {
+                        //retry
+                    }
+                    return index;
+                }
+            }
+            return NIL_INDEX;
+        }
+
+        //push back index into the free-list, and drop the reference of its buffer.
+        //Storage may be deleted by this call.
+        void release(uint32_t index) {
+            uint64_t head = freeHead.load(std::memory_order_relaxed);
+            uint64_t newHead;
+
+            do {
+                nextFree[index].store((uint32_t)head, std::memory_order_relaxed);
+                newHead = (((head >> 32) + 1) << 32) | index;
+            } while (!freeHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+
+            unref();
+        }
+
+        //drop one reference, deleting the storage with the last one.
+        void unref() {
+            if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete this;
+            }
+        }
+
+        //slots and controlBlocks entries are only accessed by the current owner of the slot index.
+        std::vector<BufferType *> slots;
+        std::vector<ControlBlock> controlBlocks;
+        std::vector< std::atomic<uint32_t> > nextFree;
+        std::atomic<uint64_t> freeHead;
+
+        //1 for the pool, plus 1 per slot in use.
+        std::atomic<size_t> references;
+        std::atomic<size_t> highWaterMark;
+        std::atomic<size_t> overflowCount;
+    };
+
+    //Deleter of the std::shared_ptr given out by getBuffer(): the buffer stays in its slot.
+    class KeepInPool {
+    public:
+        void operator()(BufferType * /* buffer */) {
+        }
+    };
+
+    //Allocator of the std::shared_ptr given out by getBuffer(): its control block lives in the
+    //slab entry of the slot, and the slot is recycled when the control block is deallocated,
+    //that is once the buffer and the control block are no longer referenced at all.
+    template<typename T>
+    class SlabAllocator {
+    public:
+        typedef T value_type;
+
+        template<typename U>
+        struct rebind {
+            typedef SlabAllocator<U> other;
+        };
+
+        SlabAllocator(Storage *storage, uint32_t index) : storage(storage), index(index) {
+        }
+
+        template<typename U>
+        SlabAllocator(const SlabAllocator<U>& other) : storage(other.storage), index(other.index) {
+        }
+
+        T *allocate(size_t /* n */) {
+            static_assert(sizeof(T) <= sizeof(typename Storage::ControlBlock), "BUFFER_POOL_CONTROL_BLOCK_SIZE is too small");
+            static_assert(alignof(T) <= alignof(typename Storage::ControlBlock), "Control block is over-aligned");
+
+            return reinterpret_cast<T *>(&storage->controlBlocks[index]);
+        }
+
+        void deallocate(T * /* p */, size_t /* n */) {
+            storage->release(index);
+        }
+
+        template<typename U>
+        bool operator==(const SlabAllocator<U>& other) const {
+            return storage == other.storage && index == other.index;
+        }
+
+        template<typename U>
+        bool operator!=(const SlabAllocator<U>& other) const {
+            return !(*this == other);
+        }
+
+        Storage *storage;
+        uint32_t index;
+    };
+
+public:
+
+    BufferPool(std::string poolId, size_t capacity = BUFFER_POOL_DEFAULT_CAPACITY) : poolId(poolId) {
+        storage = new Storage(capacity);
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    virtual ~BufferPool() {
+        //the storage dies with the last buffer in use.
+        storage->unref();
+    }
+
+    /// Return a buffer usable by the application, recycled in the pool once no longer referenced.
+    BufferPoolPtr getBuffer() {
+
+        uint32_t index = storage->acquire();
+
+        if (index == Storage::NIL_INDEX) {
+            //pool exhausted: do not block, allocate a temporary buffer instead.
+            if (storage->overflowCount.fetch_add(1) == 0) {
+                std::cout << "Warning: BufferPool '" << poolId << "' capacity of '" << storage->slots.size() << "' exhausted, falling back to heap allocations." << std::endl << std::flush;
+            }
+            return std::make_shared<BufferType>();
+        }
+
+        if (storage->slots[index] == nullptr) {
+            storage->slots[index] = new BufferType();
+        }
+
+        return BufferPoolPtr(storage->slots[index], KeepInPool(), SlabAllocator<BufferType>(storage, index));
+    }
+
+    /// Total number of pooled buffers.
+    size_t getCapacity() const {
+        return storage->slots.size();
+    }
+
+    /// Number of pooled buffers currently in use.
+    size_t getOccupancy() const {
+        return std::min(storage->references.load() - 1, storage->slots.size());
+    }
+
+    /// Maximum number of pooled buffers ever in use at the same time.
+    size_t getHighWaterMark() const {
+        return storage->highWaterMark.load();
+    }
+
+    /// Number of getBuffer() calls that could not be served from the pool.
+    size_t getOverflowCount() const {
+        return storage->overflowCount.load();
+    }
+
+private:
+    //name of the pool, for traces.
+    std::string poolId;
+
+    //owned with the buffers in use, see Storage::references.
+    Storage *storage;
+};
+
+
 class IOThread {
 public:
     IOThread();
@@ -8,6 +8,7 @@
 #include "CubicSDR.h"
 #include "DemodulatorThread.h"
 #include "DemodulatorInstance.h"
+#include "PipelineMetrics.h"
 #include <memory.h>
 #include <mutex>
 
@@ -91,6 +92,11 @@ void AudioThread::deviceCleanup() {
 static int audioCallback(void *outputBuffer, void * /* inputBuffer */, unsigned int nBufferFrames, double /* streamTime */, RtAudioStreamStatus status,
     void *userData) {
 
+    static PipelineMetrics::ThreadStats *busyStats = PipelineMetrics::getThreadStats("AudioThread");
+    static PipelineMetrics::LatencyStats *latencyStats = PipelineMetrics::getLatencyStats("Audio output");
+
+    PipelineMetrics::BusyScope busy(busyStats);
+
     float *out = (float*)outputBuffer;
 
     //Zero output buffer in all cases: this allow to mute audio if no AudioThread data is 
@@ -126,6 +132,8 @@ static int audioCallback(void *outputBuffer, void * /* inputBuffer */, unsigned
             continue;
         }
 
+        AudioThreadInput *previousInput = srcmix->currentInput.get();
+
         if (!srcmix->currentInput) {
             srcmix->audioQueuePtr = 0;
 
@@ -230,6 +238,11 @@ static int audioCallback(void *outputBuffer, void * /* inputBuffer */, unsigned
             }
         }
 
+        //a new block started playing:
+        if (srcmix->currentInput && srcmix->currentInput.get() != previousInput) {
+            latencyStats->record(srcmix->currentInput->captureTime);
+        }
+
         peak += mixPeak;
     }
 
@@ -22,11 +22,13 @@ public:
     float peak;
     int type;
     bool is_squelch_active;
+    //capture time of the IQ samples it was demodulated from, see DemodulatorThreadIQData.
+    int64_t captureTime;
 
     std::vector<float> data;
 
     AudioThreadInput() :
-        frequency(0), inputRate(0), sampleRate(0), channels(0), peak(0), type(0), is_squelch_active(false) {
+        frequency(0), inputRate(0), sampleRate(0), channels(0), peak(0), type(0), is_squelch_active(false), captureTime(0) {
 
     }
 
@@ -43,6 +45,7 @@ public:
         peak = copyFrom->peak;
         type = copyFrom->type;
         is_squelch_active = copyFrom->is_squelch_active;
+        captureTime = copyFrom->captureTime;
         data.assign(copyFrom->data.begin(), copyFrom->data.end());
     }
 
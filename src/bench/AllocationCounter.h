@@ -0,0 +1,15 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstdint>
+
+//Counts the heap allocations made through the global operator new of the program it is linked into,
+//which it replaces. The malloc() calls of the C libraries (liquid-dsp...) are not seen.
+class AllocationCounter {
+public:
+    //allocations and bytes allocated since the start of the program, over all threads.
+    static uint64_t getCount();
+    static uint64_t getBytes();
+};
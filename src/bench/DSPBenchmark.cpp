@@ -0,0 +1,684 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "DSPBenchmark.h"
+#include "AllocationCounter.h"
+#include "PipelineMetrics.h"
+#include "PFBChannelizer.h"
+#include "FFTChannelizer.h"
+#include "SpectrumVisualProcessor.h"
+#include "ZoomDecimator.h"
+#include "TranslatingDecimator.h"
+#include "FilterDesignCache.h"
+#include "WorkerPool.h"
+#include "DemodDefs.h"
+#include "CubicSDRDefs.h"
+#include "IOThread.h"
+#include "ThreadSPSCQueue.h"
+
+#include "Modem.h"
+#include "ModemAnalog.h"
+#include "ModemDigital.h"
+#include "ModemAM.h"
+#include "ModemDSB.h"
+#include "ModemFM.h"
+#include "ModemFMStereo.h"
+#include "ModemIQ.h"
+#include "ModemLSB.h"
+#include "ModemNBFM.h"
+#include "ModemUSB.h"
+
+#if ENABLE_DIGITAL_LAB
+#include "ModemAPSK.h"
+#include "ModemASK.h"
+#include "ModemBPSK.h"
+#include "ModemDPSK.h"
+#include "ModemFSK.h"
+#include "ModemGMSK.h"
+#include "ModemOOK.h"
+#include "ModemPSK.h"
+#include "ModemQAM.h"
+#include "ModemQPSK.h"
+#include "ModemSQAM.h"
+#include "ModemST.h"
+#endif
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+//blocks run before each test starts measuring, for the buffers to reach their steady size.
+#define DSP_BENCHMARK_WARMUP_BLOCKS 8
+
+//synthetic input generated, then looped, at most:
+#define DSP_BENCHMARK_SYNTHETIC_MAX_SAMPLES (1 << 22)
+//and read from a recording:
+#define DSP_BENCHMARK_INPUT_MAX_SAMPLES (1 << 26)
+
+//synthetic carriers: amplitude, 1 kHz tone FM deviation, and noise level.
+#define DSP_BENCHMARK_CARRIER_LEVEL 0.1f
+#define DSP_BENCHMARK_CARRIER_DEVIATION 5000.0
+#define DSP_BENCHMARK_NOISE_LEVEL 0.01f
+
+//as SDRThread and SDRPostThread:
+#define DSP_BENCHMARK_BLOCKS_PER_SECOND 60
+#define CHANNELIZER_MAX_WORKER_THREADS 8
+#define DEMOD_BUFFER_POOL_CAPACITY 1024
+
+DSPBenchmark::Options::Options() : sampleRate(DEFAULT_SAMPLE_RATE), blocksPerSecond(DSP_BENCHMARK_BLOCKS_PER_SECOND),
+    seconds(10.0), realTime(false), numDemods(4), demodBandwidth(DEFAULT_DEMOD_BW), audioSampleRate(48000), parallel(false) {
+}
+
+DSPBenchmark::Timing::Timing(const Options& options, long long sampleRate, size_t blockSize, size_t numBlocks) :
+    sampleRate(sampleRate), blockSize(blockSize), numBlocks(numBlocks), realTime(options.realTime),
+    startTime(0), blockDue(0), blockStart(0), busyNanos(0), measuring(false), startAllocs(0), startBytes(0), endAllocs(0), endBytes(0) {
+
+    //reserved here, not to count the allocations of the measure itself.
+    latencies.reserve(numBlocks);
+}
+
+size_t DSPBenchmark::Timing::getTotalBlocks() {
+    return DSP_BENCHMARK_WARMUP_BLOCKS + numBlocks;
+}
+
+void DSPBenchmark::Timing::beginBlock(size_t block) {
+    if (block == 0) {
+        startTime = PipelineMetrics::now();
+    }
+
+    measuring = (block >= DSP_BENCHMARK_WARMUP_BLOCKS);
+
+    if (block == DSP_BENCHMARK_WARMUP_BLOCKS) {
+        startAllocs = AllocationCounter::getCount();
+        startBytes = AllocationCounter::getBytes();
+    }
+
+    //the block is complete once its last sample would have been read from the device.
+    blockDue = startTime + (int64_t)((double)((block + 1) * blockSize) * 1e9 / (double)sampleRate);
+
+    if (realTime) {
+        int64_t wait = blockDue - PipelineMetrics::now();
+
+        if (wait > 0) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+        }
+    }
+
+    blockStart = PipelineMetrics::now();
+}
+
+void DSPBenchmark::Timing::endBlock() {
+    int64_t blockEnd = PipelineMetrics::now();
+
+    if (!measuring) {
+        return;
+    }
+
+    endAllocs = AllocationCounter::getCount();
+    endBytes = AllocationCounter::getBytes();
+
+    //when paced, a block processed late also waited for the previous ones.
+    latencies.push_back(blockEnd - (realTime ? blockDue : blockStart));
+    busyNanos += blockEnd - blockStart;
+}
+
+void DSPBenchmark::Timing::getResult(Result& result) {
+    result.blocks = latencies.size();
+    result.sampleRate = sampleRate;
+
+    if (latencies.empty()) {
+        result.samplesPerSecond = 0;
+        result.p50 = result.p90 = result.p99 = result.max = 0;
+        result.allocsPerBlock = result.bytesPerBlock = 0;
+        return;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    size_t n = latencies.size();
+
+    result.p50 = latencies[std::min(n - 1, n * 50 / 100)];
+    result.p90 = latencies[std::min(n - 1, n * 90 / 100)];
+    result.p99 = latencies[std::min(n - 1, n * 99 / 100)];
+    result.max = latencies[n - 1];
+
+    result.samplesPerSecond = (double)(n * blockSize) / std::max((double)busyNanos * 1e-9, 1e-9);
+    result.allocsPerBlock = (double)(endAllocs - startAllocs) / (double)n;
+    result.bytesPerBlock = (double)(endBytes - startBytes) / (double)n;
+}
+
+DSPBenchmark::DSPBenchmark(const Options& options) : options(options) {
+}
+
+DSPBenchmark::~DSPBenchmark() {
+}
+
+void DSPBenchmark::registerModems() {
+    //as CubicSDR::OnInit()
+    Modem::addModemFactory(ModemFM::factory, "FM", 200000);
+    Modem::addModemFactory(ModemNBFM::factory, "NBFM", 12500);
+    Modem::addModemFactory(ModemFMStereo::factory, "FMS", 200000);
+    Modem::addModemFactory(ModemAM::factory, "AM", 6000);
+    Modem::addModemFactory(ModemLSB::factory, "LSB", 5400);
+    Modem::addModemFactory(ModemUSB::factory, "USB", 5400);
+    Modem::addModemFactory(ModemDSB::factory, "DSB", 5400);
+    Modem::addModemFactory(ModemIQ::factory, "I/Q", 48000);
+
+#if ENABLE_DIGITAL_LAB
+    Modem::addModemFactory(ModemAPSK::factory, "APSK", 200000);
+    Modem::addModemFactory(ModemASK::factory, "ASK", 200000);
+    Modem::addModemFactory(ModemBPSK::factory, "BPSK", 200000);
+    Modem::addModemFactory(ModemDPSK::factory, "DPSK", 200000);
+    Modem::addModemFactory(ModemFSK::factory, "FSK", 19200);
+    Modem::addModemFactory(ModemGMSK::factory, "GMSK", 19200);
+    Modem::addModemFactory(ModemOOK::factory, "OOK", 200000);
+    Modem::addModemFactory(ModemPSK::factory, "PSK", 200000);
+    Modem::addModemFactory(ModemQAM::factory, "QAM", 200000);
+    Modem::addModemFactory(ModemQPSK::factory, "QPSK", 200000);
+    Modem::addModemFactory(ModemSQAM::factory, "SQAM", 200000);
+    Modem::addModemFactory(ModemST::factory, "ST", 200000);
+#endif
+}
+
+std::vector<std::string> DSPBenchmark::getModemNames() {
+    std::vector<std::string> names;
+
+    for (auto& factory : Modem::getFactories()) {
+        names.push_back(factory.first);
+    }
+    return names;
+}
+
+std::string DSPBenchmark::getChannelizerName(ChannelizerMode mode, bool parallel) {
+    std::string name;
+
+    switch (mode) {
+        case CHANNELIZER_PFBCH:
+            name = "pfbch";
+            break;
+        case CHANNELIZER_PFBCH2:
+            name = "pfbch2";
+            break;
+        case CHANNELIZER_FFT:
+            name = "fft";
+            break;
+    }
+
+    return parallel ? (name + "-mt") : name;
+}
+
+//as SDRThread::getOptimalChannelCount()
+int DSPBenchmark::getNumChannels() {
+    if (options.sampleRate <= CHANNELIZER_RATE_MAX) {
+        return 1;
+    }
+
+    int count = int(ceil(double(options.sampleRate) / double(CHANNELIZER_RATE_MAX)));
+
+    if (count % 2 == 1) {
+        count--;
+    }
+
+    return std::max(count, 2);
+}
+
+//as SDRThread::getOptimalElementCount()
+size_t DSPBenchmark::getBlockSize() {
+    int numChannels = getNumChannels();
+    int elemCount = (int)floor((double)options.sampleRate / (double)options.blocksPerSecond);
+
+    return (size_t)(int(ceil((double)elemCount / (double)numChannels)) * numChannels);
+}
+
+long long DSPBenchmark::getDemodOffset(int i) {
+    return options.sampleRate * (i + 1) / (options.numDemods + 1) - options.sampleRate / 2;
+}
+
+bool DSPBenchmark::init() {
+    if (options.inputFile.empty()) {
+        makeSyntheticInput();
+        return true;
+    }
+    return readInput();
+}
+
+void DSPBenchmark::makeSyntheticInput() {
+    size_t blockSize = getBlockSize();
+    size_t numBlocks = std::max((size_t)1, std::min((size_t)options.blocksPerSecond, DSP_BENCHMARK_SYNTHETIC_MAX_SAMPLES / blockSize));
+    size_t numSamples = numBlocks * blockSize;
+
+    std::mt19937 generator(1);
+    std::normal_distribution<float> noise(0.0f, DSP_BENCHMARK_NOISE_LEVEL);
+
+    input.resize(numSamples);
+
+    for (size_t i = 0; i < numSamples; i++) {
+        input[i].real = noise(generator);
+        input[i].imag = noise(generator);
+    }
+
+    // One 1 kHz tone FM carrier at each demodulator frequency.
+    double fs = (double)options.sampleRate;
+
+    for (int d = 0; d < options.numDemods; d++) {
+        double carrierStep = 2.0 * M_PI * (double)getDemodOffset(d) / fs;
+        double toneStep = 2.0 * M_PI * 1000.0 / fs;
+        double phase = 0;
+
+        for (size_t i = 0; i < numSamples; i++) {
+            phase += carrierStep + 2.0 * M_PI * DSP_BENCHMARK_CARRIER_DEVIATION / fs * sin(toneStep * (double)i);
+
+            input[i].real += DSP_BENCHMARK_CARRIER_LEVEL * (float)cos(phase);
+            input[i].imag += DSP_BENCHMARK_CARRIER_LEVEL * (float)sin(phase);
+        }
+    }
+}
+
+bool DSPBenchmark::readInput() {
+    std::ifstream file(options.inputFile.c_str(), std::ios::binary);
+
+    if (!file) {
+        std::cout << "DSPBenchmark: cannot read '" << options.inputFile << "'" << std::endl;
+        return false;
+    }
+
+    size_t blockSize = getBlockSize();
+    size_t maxSamples = std::min((size_t)DSP_BENCHMARK_INPUT_MAX_SAMPLES, (size_t)((double)options.sampleRate * options.seconds));
+
+    std::vector<float> raw(std::max(maxSamples, blockSize) * 2);
+    file.read((char *)&raw[0], raw.size() * sizeof(float));
+
+    size_t numSamples = (size_t)file.gcount() / (2 * sizeof(float));
+
+    if (numSamples == 0) {
+        std::cout << "DSPBenchmark: no I/Q samples in '" << options.inputFile << "'" << std::endl;
+        return false;
+    }
+
+    //whole blocks only, zero-padded to at least one.
+    numSamples = std::max(blockSize, numSamples - numSamples % blockSize);
+    raw.resize(numSamples * 2, 0.0f);
+
+    input.resize(numSamples);
+
+    for (size_t i = 0; i < numSamples; i++) {
+        input[i].real = raw[2 * i];
+        input[i].imag = raw[2 * i + 1];
+    }
+
+    return true;
+}
+
+void DSPBenchmark::findDemodChannels(PFBChannelizer& channelizer, std::vector<int>& channels) {
+    channels.resize(options.numDemods);
+
+    for (int d = 0; d < options.numDemods; d++) {
+        channels[d] = channelizer.getChannelAt(getDemodOffset(d));
+    }
+}
+
+bool DSPBenchmark::runChannelizer(ChannelizerMode mode, bool parallel, Result& result) {
+    int numChannels = getNumChannels();
+
+    //SDRPostThread does not channelize a single channel.
+    if (numChannels < 2 || options.numDemods < 1) {
+        return false;
+    }
+
+    size_t blockSize = getBlockSize();
+    size_t inputBlocks = input.size() / blockSize;
+    size_t numBlocks = std::max((size_t)1, (size_t)ceil(options.seconds * (double)options.blocksPerSecond));
+
+    BufferPool<DemodulatorThreadIQData> buffers("DSPBenchmarkBuffers", DEMOD_BUFFER_POOL_CAPACITY);
+    std::vector<DemodulatorThreadIQDataPtr> channelData;
+
+    std::unique_ptr<WorkerPool> workerPool;
+    if (parallel) {
+        workerPool.reset(new WorkerPool("DSPBenchmarkWorkers", WorkerPool::getDefaultNumThreads(CHANNELIZER_MAX_WORKER_THREADS)));
+    }
+
+    // Polyphase channelizers state
+    PFBChannelizer pfbChannelizer;
+    std::vector<int> runChannels;
+    std::vector<liquid_float_complex *> runOutputs;
+
+    // FFT channelizer state
+    FFTChannelizer fftChannelizer;
+    std::vector<long long> fftOffsets;
+    std::vector<int> fftBandwidths, fftChannelIndex;
+
+    if (mode == CHANNELIZER_FFT) {
+        fftChannelizer.setSampleRate(options.sampleRate);
+
+        for (int d = 0; d < options.numDemods; d++) {
+            fftOffsets.push_back(getDemodOffset(d));
+            fftBandwidths.push_back(options.demodBandwidth);
+        }
+        fftChannelizer.setChannels(fftOffsets, fftBandwidths, fftChannelIndex);
+    } else {
+        // as SDRPostThread::runPFBCH(), around a 0 center frequency.
+        pfbChannelizer.init((mode == CHANNELIZER_PFBCH2) ? PFBChannelizer::PFBCH2 : PFBChannelizer::PFBCH,
+                            numChannels, options.sampleRate, workerPool.get());
+        pfbChannelizer.setCenterFrequency(0);
+
+        // the channels to extract, in increasing order as SDRPostThread::runDemodChannels().
+        findDemodChannels(pfbChannelizer, runChannels);
+        std::sort(runChannels.begin(), runChannels.end());
+        runChannels.erase(std::unique(runChannels.begin(), runChannels.end()), runChannels.end());
+
+        runOutputs.reserve(runChannels.size());
+    }
+
+    Timing timing(options, options.sampleRate, blockSize, numBlocks);
+
+    for (size_t b = 0; b < timing.getTotalBlocks(); b++) {
+        liquid_float_complex *in = &input[(b % inputBlocks) * blockSize];
+
+        timing.beginBlock(b);
+
+        if (mode == CHANNELIZER_FFT) {
+            fftChannelizer.execute(in, blockSize, workerPool.get());
+
+            for (int c = 0, cMax = (int)fftChannelizer.getNumChannels(); c < cMax; c++) {
+                const std::vector<liquid_float_complex>& chanOut = fftChannelizer.getOutput(c);
+
+                if (chanOut.empty()) {
+                    continue;
+                }
+
+                DemodulatorThreadIQDataPtr demodDataOut = buffers.getBuffer();
+                demodDataOut->frequency = fftChannelizer.getOffset(c);
+                demodDataOut->sampleRate = fftChannelizer.getOutputSampleRate(c);
+                demodDataOut->data.assign(chanOut.begin(), chanOut.end());
+
+                channelData.push_back(demodDataOut);
+            }
+        } else {
+            pfbChannelizer.execute(in, blockSize);
+
+            size_t chanDataSize = pfbChannelizer.getChannelSize();
+            runOutputs.clear();
+
+            for (size_t k = 0; k < runChannels.size(); k++) {
+                DemodulatorThreadIQDataPtr demodDataOut = buffers.getBuffer();
+                demodDataOut->frequency = pfbChannelizer.getChannelCenter(runChannels[k]);
+                demodDataOut->sampleRate = pfbChannelizer.getChannelSampleRate();
+
+                if (demodDataOut->data.size() != chanDataSize) {
+                    demodDataOut->data.resize(chanDataSize);
+                }
+
+                runOutputs.push_back(&demodDataOut->data[0]);
+                channelData.push_back(demodDataOut);
+            }
+
+            pfbChannelizer.extract(&runChannels[0], &runOutputs[0], runChannels.size(), false);
+        }
+
+        timing.endBlock();
+
+        //released by the demodulators in the application.
+        channelData.clear();
+    }
+
+    timing.getResult(result);
+    result.name = "channelizer " + getChannelizerName(mode, parallel);
+
+    return true;
+}
+
+void DSPBenchmark::makeChannelInput(std::vector<liquid_float_complex>& out, long long& centerOffset, long long& channelRate) {
+    int numChannels = getNumChannels();
+
+    if (numChannels < 2 || options.numDemods < 1) {
+        out = input;
+        centerOffset = 0;
+        channelRate = options.sampleRate;
+        return;
+    }
+
+    PFBChannelizer pfbChannelizer;
+    pfbChannelizer.init(PFBChannelizer::PFBCH, numChannels, options.sampleRate, nullptr);
+    pfbChannelizer.setCenterFrequency(0);
+
+    std::vector<int> demodChannels;
+    findDemodChannels(pfbChannelizer, demodChannels);
+
+    int channel = demodChannels[0];
+
+    centerOffset = pfbChannelizer.getChannelCenter(channel);
+    channelRate = pfbChannelizer.getChannelSampleRate();
+
+    size_t blockSize = getBlockSize();
+    size_t chanBlockSize = blockSize / numChannels;
+
+    out.resize(input.size() / numChannels);
+
+    for (size_t b = 0; b < input.size() / blockSize; b++) {
+        liquid_float_complex *chanOut = &out[b * chanBlockSize];
+
+        pfbChannelizer.execute(&input[b * blockSize], blockSize);
+        pfbChannelizer.extract(&channel, &chanOut, 1, false);
+    }
+}
+
+bool DSPBenchmark::runModem(const std::string& modemName, Result& result) {
+    Modem *modem = Modem::makeModem(modemName);
+
+    if (modem == nullptr) {
+        return false;
+    }
+
+    // The channel of the first demodulator, as SDRPostThread delivers it in the polyphase modes.
+    std::vector<liquid_float_complex> chanInput;
+    long long centerOffset, chanRate;
+    makeChannelInput(chanInput, centerOffset, chanRate);
+
+    size_t blockSize = getBlockSize() / std::max(1, getNumChannels());
+    size_t inputBlocks = chanInput.size() / blockSize;
+    size_t numBlocks = std::max((size_t)1, (size_t)ceil(options.seconds * (double)options.blocksPerSecond));
+
+    // As DemodulatorWorkerThread builds them:
+    int bandwidth = modem->checkSampleRate(Modem::getModemDefaultSampleRate(modemName), options.audioSampleRate);
+    ModemKit *kit = modem->buildKit(bandwidth, options.audioSampleRate);
+
+    double resampleRatio = (double)bandwidth / (double)chanRate;
+    msresamp_crcf resampler = nullptr;
+    TranslatingDecimator *decimator = nullptr;
+
+    int interpolation, decimation;
+    if (TranslatingDecimator::getRatio(chanRate, bandwidth, 60.0f, interpolation, decimation)) {
+        decimator = new TranslatingDecimator(interpolation, decimation, 60.0f);
+    } else {
+        resampler = FilterDesignCache::createResamplerCRCF(resampleRatio, 60.0f);
+    }
+
+    long long shiftFrequency = getDemodOffset(0) - centerOffset;
+    nco_crcf freqShifter = nco_crcf_create(LIQUID_VCO);
+    nco_crcf_set_frequency(freqShifter, (2.0 * M_PI) * (((double) std::abs(shiftFrequency)) / ((double) chanRate)));
+    if (decimator) {
+        decimator->setShift((double)shiftFrequency / (double)chanRate);
+    }
+
+    BufferPool<AudioThreadInput> outputBuffers("DSPBenchmarkAudioBuffers");
+    std::vector<liquid_float_complex> inBuf(blockSize), outBuf(blockSize);
+    std::vector<liquid_float_complex> resampledData((size_t)ceil((double)blockSize * resampleRatio) + 512);
+    ModemIQData modemData;
+
+    Timing timing(options, chanRate, blockSize, numBlocks);
+
+    for (size_t b = 0; b < timing.getTotalBlocks(); b++) {
+        liquid_float_complex *in = &chanInput[(b % inputBlocks) * blockSize];
+
+        timing.beginBlock(b);
+
+        // DemodulatorPreThread:
+        modemData.sampleRate = bandwidth;
+
+        if (decimator) {
+            modemData.data.resize(decimator->getMaxOutput(blockSize));
+            modemData.data.resize(decimator->execute(in, blockSize, &modemData.data[0]));
+        } else {
+            inBuf.assign(in, in + blockSize);
+
+            liquid_float_complex *shifted = &inBuf[0];
+
+            if (shiftFrequency != 0) {
+                if (shiftFrequency < 0) {
+                    nco_crcf_mix_block_up(freqShifter, &inBuf[0], &outBuf[0], blockSize);
+                } else {
+                    nco_crcf_mix_block_down(freqShifter, &inBuf[0], &outBuf[0], blockSize);
+                }
+                shifted = &outBuf[0];
+            }
+
+            unsigned int numWritten;
+            msresamp_crcf_execute(resampler, shifted, blockSize, &resampledData[0], &numWritten);
+
+            // DemodulatorThread:
+            modemData.data.assign(resampledData.begin(), resampledData.begin() + numWritten);
+        }
+
+        AudioThreadInputPtr ati = outputBuffers.getBuffer();
+
+        if (modem->getType() == "digital") {
+            ati->sampleRate = kit->sampleRate;
+            ati->data.resize(0);
+        } else {
+            ati->sampleRate = kit->audioSampleRate;
+        }
+        ati->inputRate = bandwidth;
+
+        modem->demodulate(kit, &modemData, ati.get());
+
+        timing.endBlock();
+    }
+
+    modem->disposeKit(kit);
+    delete modem;
+
+    if (resampler) {
+        FilterDesignCache::releaseResampler(resampler);
+    }
+    delete decimator;
+    nco_crcf_destroy(freqShifter);
+
+    timing.getResult(result);
+    result.name = "modem " + modemName;
+
+    return true;
+}
+
+bool DSPBenchmark::runSpectrum(size_t fftSize, Result& result) {
+    size_t blockSize = getBlockSize();
+
+    if (fftSize < 2 || blockSize < fftSize) {
+        return false;
+    }
+
+    size_t inputBlocks = input.size() / blockSize;
+    size_t numBlocks = std::max((size_t)1, (size_t)ceil(options.seconds * (double)options.blocksPerSecond));
+
+    //as the main spectrum of SpectrumVisualDataThread with peak hold, out of view mode.
+    SpectrumVisualProcessor sproc;
+    sproc.setup((unsigned int)(fftSize / 2));
+    sproc.setPeakHold(true);
+    sproc.setDeviceSampleRate(options.sampleRate);
+
+    //as CubicSDR::OnInit()
+    DemodulatorThreadInputQueuePtr iqQueue = std::make_shared<ThreadSPSCQueue<DemodulatorThreadIQDataPtr>>();
+    SpectrumVisualDataQueuePtr visualQueue = std::make_shared<SpectrumVisualDataQueue>();
+    iqQueue->set_max_num_items(1);
+    visualQueue->set_max_num_items(1);
+
+    sproc.setInput(iqQueue);
+    sproc.attachOutput(visualQueue);
+
+    BufferPool<DemodulatorThreadIQData> buffers("DSPBenchmarkSpectrumBuffers");
+    SpectrumVisualDataPtr visualData;
+
+    Timing timing(options, options.sampleRate, blockSize, numBlocks);
+
+    for (size_t b = 0; b < timing.getTotalBlocks(); b++) {
+        liquid_float_complex *in = &input[(b % inputBlocks) * blockSize];
+
+        //one update per block, as SDRPostThread pushes them, filled out of the timing as SDRThread does.
+        DemodulatorThreadIQDataPtr iqData = buffers.getBuffer();
+        iqData->frequency = 0;
+        iqData->sampleRate = options.sampleRate;
+        iqData->data.assign(in, in + blockSize);
+
+        timing.beginBlock(b);
+
+        iqQueue->push(iqData);
+        sproc.run();
+
+        //released by the spectrum canvas in the application.
+        visualQueue->try_pop(visualData);
+        visualData = nullptr;
+
+        timing.endBlock();
+    }
+
+    timing.getResult(result);
+    result.name = "spectrum " + std::to_string(fftSize) + " " + CPUFeatures::getSIMDLevelName(CPUFeatures::getSIMDLevel());
+
+    return true;
+}
+
+bool DSPBenchmark::runZoom(int numStages, Result& result) {
+    if (numStages < 0) {
+        return false;
+    }
+
+    size_t blockSize = getBlockSize();
+    size_t inputBlocks = input.size() / blockSize;
+    size_t numBlocks = std::max((size_t)1, (size_t)ceil(options.seconds * (double)options.blocksPerSecond));
+
+    ZoomDecimator zoomDecimator;
+    zoomDecimator.setDecimation(numStages);
+    zoomDecimator.setShift((double)getDemodOffset(0) / (double)options.sampleRate);
+
+    std::vector<liquid_float_complex> out(zoomDecimator.getMaxOutput(blockSize));
+
+    Timing timing(options, options.sampleRate, blockSize, numBlocks);
+
+    for (size_t b = 0; b < timing.getTotalBlocks(); b++) {
+        timing.beginBlock(b);
+
+        zoomDecimator.execute(&input[(b % inputBlocks) * blockSize], blockSize, &out[0]);
+
+        timing.endBlock();
+    }
+
+    timing.getResult(result);
+    result.name = "zoom 1/" + std::to_string(1 << numStages);
+
+    return true;
+}
+
+void DSPBenchmark::printHeader(std::ostream& out) {
+    out << std::left << std::setw(24) << "Test" << std::right
+        << std::setw(10) << "Msps" << std::setw(10) << "realtime"
+        << std::setw(10) << "p50 us" << std::setw(10) << "p90 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us"
+        << std::setw(12) << "allocs/blk" << std::setw(12) << "KiB/blk" << std::endl;
+}
+
+void DSPBenchmark::printResult(std::ostream& out, const Result& result) {
+    out << std::fixed << std::setprecision(2);
+    out << std::left << std::setw(24) << result.name << std::right
+        << std::setw(10) << (result.samplesPerSecond * 1e-6)
+        << std::setw(9) << (result.samplesPerSecond / (double)std::max(result.sampleRate, 1LL)) << "x"
+        << std::setprecision(1)
+        << std::setw(10) << ((double)result.p50 * 1e-3)
+        << std::setw(10) << ((double)result.p90 * 1e-3)
+        << std::setw(10) << ((double)result.p99 * 1e-3)
+        << std::setw(10) << ((double)result.max * 1e-3)
+        << std::setw(12) << result.allocsPerBlock
+        << std::setw(12) << (result.bytesPerBlock / 1024.0) << std::endl;
+}
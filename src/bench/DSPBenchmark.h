@@ -0,0 +1,125 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include "liquid/liquid.h"
+#include "PFBChannelizer.h"
+
+//Headless benchmark of the DSP pipeline, without wx, GL or SDR device:
+//- the channelizers of SDRPostThread, extracting the channels of a few demodulators spread over the band,
+//- each modem, fed from one channelizer output through the shift and resampling of DemodulatorPreThread,
+//- SpectrumVisualProcessor at a given FFT size, one update per block,
+//- the view mode shift and decimation of the spectrum, on the whole input.
+//The input is either synthetic (FM carriers over noise) or a raw recording, looped as long as needed,
+//processed as fast as possible or paced at its sample rate.
+class DSPBenchmark {
+public:
+    enum ChannelizerMode {
+        CHANNELIZER_PFBCH, CHANNELIZER_PFBCH2, CHANNELIZER_FFT
+    };
+
+    struct Options {
+        //input sample rate, and blocks per second as read by SDRThread.
+        long long sampleRate;
+        int blocksPerSecond;
+        //interleaved float32 I/Q recording, synthetic input if empty.
+        std::string inputFile;
+        //seconds of input processed by each test.
+        double seconds;
+        //pace the input at sampleRate instead of processing it as fast as possible.
+        bool realTime;
+        //number and bandwidth of the demodulators the channelizers extract.
+        int numDemods;
+        int demodBandwidth;
+        int audioSampleRate;
+        //run the channelizers on a worker pool too.
+        bool parallel;
+
+        Options();
+    };
+
+    struct Result {
+        std::string name;
+        size_t blocks;
+        //input samples per second of the tested stage, and its nominal rate.
+        double samplesPerSecond;
+        long long sampleRate;
+        //per block latency percentiles, in nanoseconds.
+        int64_t p50, p90, p99, max;
+        //operator new calls and bytes per block.
+        double allocsPerBlock, bytesPerBlock;
+    };
+
+    DSPBenchmark(const Options& options);
+    ~DSPBenchmark();
+
+    //prepare the input, false if the recording cannot be read.
+    bool init();
+
+    static void registerModems();
+    static std::vector<std::string> getModemNames();
+
+    static std::string getChannelizerName(ChannelizerMode mode, bool parallel);
+
+    //false when the mode does not apply at this sample rate (single channel, as SDRPostThread).
+    bool runChannelizer(ChannelizerMode mode, bool parallel, Result& result);
+    bool runModem(const std::string& modemName, Result& result);
+    //fftSize being the internal FFT size, i.e. twice the number of display points.
+    bool runSpectrum(size_t fftSize, Result& result);
+    //decimation by 2^numStages.
+    bool runZoom(int numStages, Result& result);
+
+    static void printHeader(std::ostream& out);
+    static void printResult(std::ostream& out, const Result& result);
+
+private:
+    //timing of one test, block after block.
+    class Timing {
+    public:
+        Timing(const Options& options, long long sampleRate, size_t blockSize, size_t numBlocks);
+
+        //blocks to run: the warm-up ones, then the numBlocks measured.
+        size_t getTotalBlocks();
+
+        //wait for the block time when paced, and start timing it.
+        void beginBlock(size_t block);
+        void endBlock();
+
+        void getResult(Result& result);
+
+    private:
+        long long sampleRate;
+        size_t blockSize, numBlocks;
+        bool realTime;
+
+        std::vector<int64_t> latencies;
+        int64_t startTime, blockDue, blockStart, busyNanos;
+        bool measuring;
+        uint64_t startAllocs, startBytes, endAllocs, endBytes;
+    };
+
+    int getNumChannels();
+    size_t getBlockSize();
+    void makeSyntheticInput();
+    bool readInput();
+
+    //demodulator i offset from the center frequency.
+    long long getDemodOffset(int i);
+
+    //the channelizer channel nearest each demodulator, as SDRPostThread::runDemodChannels().
+    void findDemodChannels(PFBChannelizer& channelizer, std::vector<int>& channels);
+
+    //channel of the first demodulator over the whole input, as SDRPostThread delivers it from firpfbch,
+    //returns its center offset and rate.
+    void makeChannelInput(std::vector<liquid_float_complex>& out, long long& centerOffset, long long& channelRate);
+
+    Options options;
+
+    //input, an integer number of blocks, looped.
+    std::vector<liquid_float_complex> input;
+};
@@ -0,0 +1,204 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "DSPBenchmark.h"
+#include "CPUFeatures.h"
+#include <iostream>
+#include <stdexcept>
+
+static void printUsage(const char *program) {
+    DSPBenchmark::Options defaults;
+
+    std::cout << "Usage: " << program << " [options]" << std::endl << std::endl
+        << "Headless benchmark of the CubicSDR channelizers and modems." << std::endl << std::endl
+        << "  --rate <Hz>            input sample rate (" << defaults.sampleRate << ")" << std::endl
+        << "  --fps <n>              input blocks per second (" << defaults.blocksPerSecond << ")" << std::endl
+        << "  --input <file>         raw interleaved float32 I/Q recording at --rate, looped;" << std::endl
+        << "                         FM carriers over noise at the demodulator frequencies if none" << std::endl
+        << "  --seconds <s>          seconds of input per test (" << defaults.seconds << ")" << std::endl
+        << "  --realtime             pace the input at --rate instead of as fast as possible" << std::endl
+        << "  --demods <n>           demodulators spread over the band (" << defaults.numDemods << ")" << std::endl
+        << "  --bandwidth <Hz>       demodulators bandwidth (" << defaults.demodBandwidth << ")" << std::endl
+        << "  --audio-rate <Hz>      audio sample rate of the modems (" << defaults.audioSampleRate << ")" << std::endl
+        << "  --parallel             also run the channelizers on worker threads" << std::endl
+        << "  --channelizer <name>   only this channelizer mode: pfbch, pfbch2, fft or none (repeatable)" << std::endl
+        << "  --modem <name>         only this modem, or none (repeatable)" << std::endl
+        << "  --spectrum <size>      only this internal spectrum FFT size, or none (repeatable);" << std::endl
+        << "                         2048, 8192 and 65536 by default" << std::endl
+        << "  --zoom <stages>        only this spectrum zoom, decimating by 2^stages, or none (repeatable);" << std::endl
+        << "                         2, 5 and 10 by default" << std::endl
+        << "  --help                 this text" << std::endl;
+}
+
+static bool contains(const std::vector<std::string>& list, const std::string& value) {
+    for (const std::string& item : list) {
+        if (item == value) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    DSPBenchmark::Options options;
+    std::vector<std::string> channelizers, modems, spectrums, zooms;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+
+            if (arg == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            } else if (arg == "--realtime") {
+                options.realTime = true;
+                continue;
+            } else if (arg == "--parallel") {
+                options.parallel = true;
+                continue;
+            }
+
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(arg);
+            }
+            std::string value = argv[++i];
+
+            if (arg == "--rate") {
+                options.sampleRate = std::stoll(value);
+            } else if (arg == "--fps") {
+                options.blocksPerSecond = std::stoi(value);
+            } else if (arg == "--input") {
+                options.inputFile = value;
+            } else if (arg == "--seconds") {
+                options.seconds = std::stod(value);
+            } else if (arg == "--demods") {
+                options.numDemods = std::stoi(value);
+            } else if (arg == "--bandwidth") {
+                options.demodBandwidth = std::stoi(value);
+            } else if (arg == "--audio-rate") {
+                options.audioSampleRate = std::stoi(value);
+            } else if (arg == "--channelizer") {
+                channelizers.push_back(value);
+            } else if (arg == "--modem") {
+                modems.push_back(value);
+            } else if (arg == "--spectrum") {
+                spectrums.push_back(value);
+            } else if (arg == "--zoom") {
+                zooms.push_back(value);
+            } else {
+                throw std::invalid_argument(arg);
+            }
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.sampleRate <= 0 || options.blocksPerSecond <= 0 || options.seconds <= 0 ||
+        options.numDemods < 0 || options.demodBandwidth <= 0 || options.audioSampleRate <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    DSPBenchmark::registerModems();
+
+    if (channelizers.empty()) {
+        channelizers = { "pfbch", "pfbch2", "fft" };
+    }
+    if (modems.empty()) {
+        modems = DSPBenchmark::getModemNames();
+    }
+    if (spectrums.empty()) {
+        spectrums = { "2048", "8192", "65536" };
+    }
+    if (zooms.empty()) {
+        zooms = { "2", "5", "10" };
+    }
+
+    DSPBenchmark benchmark(options);
+
+    if (!benchmark.init()) {
+        return 1;
+    }
+
+    std::cout << "Input: " << (options.inputFile.empty() ? std::string("synthetic") : options.inputFile)
+        << " at " << options.sampleRate << " Hz, " << options.blocksPerSecond << " blocks/s"
+        << (options.realTime ? ", paced" : ", as fast as possible") << std::endl;
+    std::cout << "SIMD: " << CPUFeatures::getSIMDLevelName(CPUFeatures::getSIMDLevel()) << std::endl << std::endl;
+
+    DSPBenchmark::printHeader(std::cout);
+
+    const DSPBenchmark::ChannelizerMode modes[] = {
+        DSPBenchmark::CHANNELIZER_PFBCH, DSPBenchmark::CHANNELIZER_PFBCH2, DSPBenchmark::CHANNELIZER_FFT
+    };
+
+    for (DSPBenchmark::ChannelizerMode mode : modes) {
+        if (!contains(channelizers, DSPBenchmark::getChannelizerName(mode, false))) {
+            continue;
+        }
+
+        for (int parallel = 0; parallel < (options.parallel ? 2 : 1); parallel++) {
+            DSPBenchmark::Result result;
+
+            if (benchmark.runChannelizer(mode, parallel != 0, result)) {
+                DSPBenchmark::printResult(std::cout, result);
+            }
+        }
+    }
+
+    for (const std::string& modemName : modems) {
+        if (modemName == "none") {
+            continue;
+        }
+
+        DSPBenchmark::Result result;
+
+        if (benchmark.runModem(modemName, result)) {
+            DSPBenchmark::printResult(std::cout, result);
+        } else {
+            std::cout << "Unknown modem '" << modemName << "'" << std::endl;
+        }
+    }
+
+    for (const std::string& spectrumSize : spectrums) {
+        if (spectrumSize == "none") {
+            continue;
+        }
+
+        DSPBenchmark::Result result;
+        size_t fftSize = 0;
+
+        try {
+            fftSize = std::stoul(spectrumSize);
+        } catch (const std::exception&) {
+        }
+
+        if (benchmark.runSpectrum(fftSize, result)) {
+            DSPBenchmark::printResult(std::cout, result);
+        } else {
+            std::cout << "Invalid spectrum size '" << spectrumSize << "'" << std::endl;
+        }
+    }
+
+    for (const std::string& zoom : zooms) {
+        if (zoom == "none") {
+            continue;
+        }
+
+        DSPBenchmark::Result result;
+        int numStages = -1;
+
+        try {
+            numStages = std::stoi(zoom);
+        } catch (const std::exception&) {
+        }
+
+        if (numStages <= 20 && benchmark.runZoom(numStages, result)) {
+            DSPBenchmark::printResult(std::cout, result);
+        } else {
+            std::cout << "Invalid zoom '" << zoom << "'" << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -34,23 +34,49 @@ public:
     long long frequency;
     long long sampleRate;
     std::vector<liquid_float_complex> data;
-   
+    //PipelineMetrics::now() time the samples were read from the device, 0 if unknown.
+    int64_t captureTime;
 
     DemodulatorThreadIQData() :
-            frequency(0), sampleRate(0) {
+            frequency(0), sampleRate(0), captureTime(0), viewOffset(0), viewSize(0) {
 
     }
 
     DemodulatorThreadIQData & operator=(const DemodulatorThreadIQData &other) {
         frequency = other.frequency;
         sampleRate = other.sampleRate;
+        captureTime = other.captureTime;
         data.assign(other.data.begin(), other.data.end());
+        viewSegment = other.viewSegment;
+        viewOffset = other.viewOffset;
+        viewSize = other.viewSize;
         return *this;
     }
 
+    //Make the samples size samples at offset of a segment shared with other IQ data,
+    //instead of data, so that they are not copied.
+    void setView(const std::shared_ptr<const std::vector<liquid_float_complex>>& segment, size_t offset, size_t size) {
+        viewSegment = segment;
+        viewOffset = offset;
+        viewSize = size;
+    }
+
+    //The samples, either data or the view set by setView().
+    const liquid_float_complex *getSamples() const {
+        return viewSegment ? (viewSegment->data() + viewOffset) : data.data();
+    }
+
+    size_t getNumSamples() const {
+        return viewSegment ? viewSize : data.size();
+    }
+
     virtual ~DemodulatorThreadIQData() {
 
     }
+
+private:
+    std::shared_ptr<const std::vector<liquid_float_complex>> viewSegment;
+    size_t viewOffset, viewSize;
 };
 
 class Modem;
@@ -65,9 +91,10 @@ public:
     std::string modemType;
     Modem *modem;
     ModemKit *modemKit;
+    int64_t captureTime;
 
     DemodulatorThreadPostIQData() :
-            sampleRate(0), modem(nullptr), modemKit(nullptr) {
+            sampleRate(0), modem(nullptr), modemKit(nullptr), captureTime(0) {
 
     }
 
@@ -102,7 +129,7 @@ public:
 typedef std::shared_ptr<DemodulatorThreadIQData> DemodulatorThreadIQDataPtr;
 typedef std::shared_ptr<DemodulatorThreadPostIQData> DemodulatorThreadPostIQDataPtr;
 
-typedef ThreadBlockingQueue<DemodulatorThreadIQDataPtr> DemodulatorThreadInputQueue;
+typedef ThreadQueue<DemodulatorThreadIQDataPtr> DemodulatorThreadInputQueue;
 typedef ThreadBlockingQueue<DemodulatorThreadPostIQDataPtr> DemodulatorThreadPostInputQueue;
 typedef ThreadBlockingQueue<DemodulatorThreadControlCommand> DemodulatorThreadControlCommandQueue;
 
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <iomanip>
+#include <algorithm>
 
 #include "DemodulatorInstance.h"
 #include "CubicSDR.h"
@@ -11,11 +12,21 @@
 #include "DemodulatorPreThread.h"
 #include "AudioSinkFileThread.h"
 #include "AudioFileWAV.h"
+#include "ThreadSPSCQueue.h"
+#include "PipelineMetrics.h"
+#include "WorkerPool.h"
 
 #if USE_HAMLIB
 #include "RigThread.h"
 #endif
 
+//Pool running the pre-processing and demodulation of the demodulators in shared execution,
+//one thread per core for all of them instead of two threads each.
+static WorkerPool& getDemodulatorScheduler() {
+    static WorkerPool scheduler("DemodulatorScheduler", std::max(1u, std::thread::hardware_concurrency()));
+    return scheduler;
+}
+
 DemodVisualCue::DemodVisualCue() {
     squelchBreak.store(false);
 }
@@ -57,11 +68,15 @@ DemodulatorInstance::DemodulatorInstance() {
     currentAudioGain.store(1.0);
     follow.store(false);
     tracking.store(false);
+    sharedExecution.store(false);
+    processScheduled.store(false);
+    processStopping.store(false);
 
     label.store(new std::string("Unnamed"));
     user_label.store(new std::wstring());
 
-    pipeIQInputData = std::make_shared<DemodulatorThreadInputQueue>();
+    //only fed by SDRPostThread and consumed by DemodulatorPreThread, or by one scheduler task at a time:
+    pipeIQInputData = std::make_shared<ThreadSPSCQueue<DemodulatorThreadIQDataPtr>>();
     pipeIQInputData->set_max_num_items(100);
     pipeIQDemodData = std::make_shared< DemodulatorThreadPostInputQueue>();
     pipeIQDemodData->set_max_num_items(100);
@@ -84,6 +99,10 @@ DemodulatorInstance::DemodulatorInstance() {
     demodulatorThread->setOutputQueue("AudioDataOutput", pipeAudioData);
 
     audioThread->setInputQueue("AudioDataInput", pipeAudioData);
+
+    PipelineMetrics::registerQueue("Demodulator IQ input", pipeIQInputData);
+    PipelineMetrics::registerQueue("Demodulator IQ output", pipeIQDemodData);
+    PipelineMetrics::registerQueue("Demodulator audio output", pipeAudioData);
 }
 
 DemodulatorInstance::~DemodulatorInstance() {
@@ -134,6 +153,15 @@ void DemodulatorInstance::run() {
     }
 
     t_Audio = new std::thread(&AudioThread::threadMain, audioThread);
+
+    if (wxGetApp().getConfig()->getSharedDemodulators()) {
+        demodulatorPreThread->setup();
+        demodulatorThread->setup();
+
+        sharedExecution.store(true);
+        active = true;
+        return;
+    }
     
 #ifdef __APPLE__    // Already using pthreads, might as well do some custom init..
     pthread_attr_t attr;
@@ -177,6 +205,9 @@ void DemodulatorInstance::terminate() {
     }
 #endif
 
+    //no more scheduler tasks from now on, the running one stopping at its next block.
+    processStopping.store(true);
+
 //    std::cout << "Terminating demodulator audio thread.." << std::endl;
     audioThread->terminate();
 
@@ -213,6 +244,12 @@ bool DemodulatorInstance::isTerminated() {
     bool audioTerminated = audioThread->isTerminated();
     bool demodTerminated = demodulatorThread->isTerminated();
     bool preDemodTerminated = demodulatorPreThread->isTerminated();
+
+    if (sharedExecution.load()) {
+        //no threads to end, only the scheduler task to wait for.
+        demodTerminated = preDemodTerminated = processStopping.load() && !processScheduled.load();
+    }
+
     bool audioSinkTerminated = (audioSinkThread == nullptr) || audioSinkThread->isTerminated();
 
     //Cleanup the worker threads, if the threads are indeed terminated.
@@ -570,6 +607,51 @@ DemodulatorThreadInputQueuePtr DemodulatorInstance::getIQInputDataPipe() {
     return pipeIQInputData;
 }
 
+void DemodulatorInstance::pushIQData(const DemodulatorThreadIQDataPtr& data) {
+    if (!pipeIQInputData->try_push(data) || !sharedExecution.load() || processStopping.load()) {
+        return;
+    }
+
+    //already scheduled or running: the task will take this block too.
+    bool idle = false;
+    if (!processScheduled.compare_exchange_strong(idle, true)) {
+        return;
+    }
+
+    //the task keeps the demodulator alive until it is done with it.
+    DemodulatorInstancePtr self = shared_from_this();
+
+    getDemodulatorScheduler().submit([self]() {
+        self->processQueuedData();
+    });
+}
+
+void DemodulatorInstance::processQueuedData() {
+    DemodulatorThreadIQDataPtr inp;
+
+    while (!processStopping.load()) {
+        if (pipeIQInputData->try_pop(inp)) {
+            DemodulatorThreadPostIQDataPtr resamp = demodulatorPreThread->process(inp);
+
+            if (resamp) {
+                demodulatorThread->process(resamp);
+            }
+            continue;
+        }
+
+        processScheduled.store(false);
+
+        //a block pushed since the last try_pop() found the task still scheduled:
+        //take it, unless pushIQData() has scheduled a new task meanwhile.
+        bool idle = false;
+        if (pipeIQInputData->empty() || !processScheduled.compare_exchange_strong(idle, true)) {
+            return;
+        }
+    }
+
+    processScheduled.store(false);
+}
+
 ModemArgInfoList DemodulatorInstance::getModemArgs() {
     Modem *m = demodulatorPreThread->getModem();
     
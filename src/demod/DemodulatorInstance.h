@@ -33,7 +33,7 @@ private:
 class DemodulatorThread;
 class DemodulatorPreThread;
 
-class DemodulatorInstance {
+class DemodulatorInstance : public std::enable_shared_from_this<DemodulatorInstance> {
 public:
 
 #ifdef __APPLE__
@@ -117,6 +117,9 @@ public:
     DemodVisualCue *getVisualCue();
     
     DemodulatorThreadInputQueuePtr getIQInputDataPipe();
+    //Push an IQ block to the demodulator without ever blocking, dropped if its input is full,
+    //and schedule its processing when run by the demodulator scheduler.
+    void pushIQData(const DemodulatorThreadIQDataPtr& data);
 
     ModemArgInfoList getModemArgs();
     std::string readModemSetting(std::string setting);
@@ -139,6 +142,9 @@ protected:
     void startRecording();
     void stopRecording();
 
+    //Shared execution: pre-process and demodulate the queued IQ blocks, as a task of the demodulator scheduler.
+    void processQueuedData();
+
 private:
     DemodulatorThreadInputQueuePtr pipeIQInputData;
     DemodulatorThreadPostInputQueuePtr pipeIQDemodData;
@@ -154,6 +160,10 @@ private:
     //protects child thread creation and termination 
     std::recursive_mutex m_thread_control_mutex;
 
+    //run by the demodulator scheduler instead of threads of its own,
+    //with at most one task scheduled at a time, until terminate().
+    std::atomic_bool sharedExecution, processScheduled, processStopping;
+
     std::atomic<std::string *> label; //
     // User editable buffer, 16 bit string.
     std::atomic<std::wstring *> user_label; 
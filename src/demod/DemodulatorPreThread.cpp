@@ -11,11 +11,14 @@
 #include "DemodulatorPreThread.h"
 #include "CubicSDR.h"
 #include "DemodulatorInstance.h"
+#include "PipelineMetrics.h"
+#include "FilterDesignCache.h"
 
 //50 ms
 #define HEARTBEAT_CHECK_PERIOD_MICROS (50 * 1000) 
 
-DemodulatorPreThread::DemodulatorPreThread(DemodulatorInstance* parent) : IOThread(), iqResampler(NULL), iqResampleRatio(1), cModem(nullptr), cModemKit(nullptr)
+DemodulatorPreThread::DemodulatorPreThread(DemodulatorInstance* parent) : IOThread(), buffers("DemodulatorPreThreadBuffers"), iqResampler(NULL), iqDecimator(nullptr), iqResampleRatio(1), cModem(nullptr), cModemKit(nullptr),
+    t_Worker(nullptr), busyStats(nullptr), latencyStats(nullptr)
  {
 	initialized.store(false);
     this->parent = parent;
@@ -32,6 +35,9 @@ DemodulatorPreThread::DemodulatorPreThread(DemodulatorInstance* parent) : IOThre
     workerThread = new DemodulatorWorkerThread();
     workerThread->setInputQueue("WorkerCommandQueue",workerQueue);
     workerThread->setOutputQueue("WorkerResultQueue",workerResults);
+    //for processPendingCommands(), which does not go through run().
+    workerThread->setCommandQueue(workerQueue);
+    workerThread->setResultQueue(workerResults);
      
     newSampleRate = currentSampleRate = 0;
     newBandwidth = currentBandwidth = 0;
@@ -51,6 +57,21 @@ bool DemodulatorPreThread::isInitialized() {
 }
 
 DemodulatorPreThread::~DemodulatorPreThread() {
+    //left by terminate() in shared execution, where a scheduled task may still be using it.
+    delete workerThread;
+
+    if (iqResampler) {
+        FilterDesignCache::releaseResampler(iqResampler);
+    }
+    delete iqDecimator;
+}
+
+void DemodulatorPreThread::setup() {
+    iqInputQueue = std::static_pointer_cast<DemodulatorThreadInputQueue>(getInputQueue("IQDataInput"));
+    iqOutputQueue = std::static_pointer_cast<DemodulatorThreadPostInputQueue>(getOutputQueue("IQDataOutput"));
+
+    busyStats = PipelineMetrics::getThreadStats("DemodulatorPreThread");
+    latencyStats = PipelineMetrics::getLatencyStats("DemodulatorPreThread input");
 }
 
 void DemodulatorPreThread::run() {
@@ -63,114 +84,135 @@ void DemodulatorPreThread::run() {
 
 //    std::cout << "Demodulator preprocessor thread started.." << std::endl;
 
-    ReBuffer<DemodulatorThreadPostIQData> buffers("DemodulatorPreThreadBuffers");
-
-    iqInputQueue = std::static_pointer_cast<DemodulatorThreadInputQueue>(getInputQueue("IQDataInput"));
-    iqOutputQueue = std::static_pointer_cast<DemodulatorThreadPostInputQueue>(getOutputQueue("IQDataOutput"));
-    
-    std::vector<liquid_float_complex> in_buf_data;
-    std::vector<liquid_float_complex> out_buf_data;
+    setup();
 
     t_Worker = new std::thread(&DemodulatorWorkerThread::threadMain, workerThread);
-    
+
     while (!stopping) {
         DemodulatorThreadIQDataPtr inp;
 
         if (!iqInputQueue->pop(inp, HEARTBEAT_CHECK_PERIOD_MICROS)) {
             continue;
         }
-        
-        if (frequencyChanged.load()) {
-            currentFrequency.store(newFrequency);
-            frequencyChanged.store(false);
+
+        DemodulatorThreadPostIQDataPtr resamp = process(inp);
+
+        if (resamp) {
+            //VSO: blocking push
+            iqOutputQueue->push(resamp);
         }
-        
-        if (inp->sampleRate != currentSampleRate) {
-            newSampleRate = inp->sampleRate;
-            if (newSampleRate) {
-                sampleRateChanged.store(true);
-            }
+    } //end while stopping
+
+   
+    iqOutputQueue->flush();
+    iqInputQueue->flush();
+}
+
+DemodulatorThreadPostIQDataPtr DemodulatorPreThread::process(const DemodulatorThreadIQDataPtr& inp) {
+    PipelineMetrics::BusyScope busy(busyStats);
+    latencyStats->record(inp->captureTime);
+    
+    if (frequencyChanged.load()) {
+        currentFrequency.store(newFrequency);
+        frequencyChanged.store(false);
+    }
+    
+    if (inp->sampleRate != currentSampleRate) {
+        newSampleRate = inp->sampleRate;
+        if (newSampleRate) {
+            sampleRateChanged.store(true);
+        }
+    }
+    
+    if (!newAudioSampleRate) {
+        newAudioSampleRate = parent->getAudioSampleRate();
+        if (newAudioSampleRate) {
+            audioSampleRateChanged.store(true);
         }
-        
-        if (!newAudioSampleRate) {
+    } else if (parent->getAudioSampleRate() != newAudioSampleRate) {
+        int newRate;
+        if ((newRate = parent->getAudioSampleRate())) {
             newAudioSampleRate = parent->getAudioSampleRate();
-            if (newAudioSampleRate) {
-                audioSampleRateChanged.store(true);
-            }
-        } else if (parent->getAudioSampleRate() != newAudioSampleRate) {
-            int newRate;
-            if ((newRate = parent->getAudioSampleRate())) {
-                newAudioSampleRate = parent->getAudioSampleRate();
-                audioSampleRateChanged.store(true);
-            }
+            audioSampleRateChanged.store(true);
         }
-        
-        if (demodTypeChanged.load() && (newSampleRate && newAudioSampleRate && newBandwidth)) {
-            DemodulatorWorkerThreadCommand command(DemodulatorWorkerThreadCommand::DEMOD_WORKER_THREAD_CMD_MAKE_DEMOD);
-            command.frequency = newFrequency;
-            command.sampleRate = newSampleRate;
-            command.demodType = newDemodType;
-            command.bandwidth = newBandwidth;
-            command.audioSampleRate = newAudioSampleRate;
-            demodType = newDemodType;
-            sampleRateChanged.store(false);
-            audioSampleRateChanged.store(false);
-            ModemSettings lastSettings = parent->getLastModemSettings(newDemodType);
-            if (lastSettings.size() != 0) {
-                command.settings = lastSettings;
-                if (modemSettingsBuffered.size()) {
-                    for (ModemSettings::const_iterator msi = modemSettingsBuffered.begin(); msi != modemSettingsBuffered.end(); msi++) {
-                        command.settings[msi->first] = msi->second;
-                    }
+    }
+    
+    if (demodTypeChanged.load() && (newSampleRate && newAudioSampleRate && newBandwidth)) {
+        DemodulatorWorkerThreadCommand command(DemodulatorWorkerThreadCommand::DEMOD_WORKER_THREAD_CMD_MAKE_DEMOD);
+        command.frequency = newFrequency;
+        command.sampleRate = newSampleRate;
+        command.demodType = newDemodType;
+        command.bandwidth = newBandwidth;
+        command.audioSampleRate = newAudioSampleRate;
+        demodType = newDemodType;
+        sampleRateChanged.store(false);
+        audioSampleRateChanged.store(false);
+        ModemSettings lastSettings = parent->getLastModemSettings(newDemodType);
+        if (lastSettings.size() != 0) {
+            command.settings = lastSettings;
+            if (modemSettingsBuffered.size()) {
+                for (ModemSettings::const_iterator msi = modemSettingsBuffered.begin(); msi != modemSettingsBuffered.end(); msi++) {
+                    command.settings[msi->first] = msi->second;
                 }
-            } else {
-                command.settings = modemSettingsBuffered;
             }
-            modemSettingsBuffered.clear();
-            modemSettingsChanged.store(false);
-            //VSO: blocking push
-            workerQueue->push(command);
-            cModem = nullptr;
-            cModemKit = nullptr;
-            demodTypeChanged.store(false);
-            initialized.store(false);
-        }
-        else if (
-            cModemKit && cModem &&
-            (bandwidthChanged.load() || sampleRateChanged.load() || audioSampleRateChanged.load() || cModem->shouldRebuildKit()) &&
-            (newSampleRate && newAudioSampleRate && newBandwidth)
-        ) {
-            DemodulatorWorkerThreadCommand command(DemodulatorWorkerThreadCommand::DEMOD_WORKER_THREAD_CMD_BUILD_FILTERS);
-            command.frequency = newFrequency;
-            command.sampleRate = newSampleRate;
-            command.bandwidth = newBandwidth;
-            command.audioSampleRate = newAudioSampleRate;
-            bandwidthChanged.store(false);
-            sampleRateChanged.store(false);
-            audioSampleRateChanged.store(false);
-            modemSettingsBuffered.clear();
-            //VSO: blocking
-            workerQueue->push(command);
+        } else {
+            command.settings = modemSettingsBuffered;
         }
-        
-        // Requested frequency is not center, shift it into the center!
-        if ((currentFrequency - inp->frequency) != shiftFrequency) {
-            shiftFrequency = currentFrequency - inp->frequency;
-            if (abs(shiftFrequency) <= (int) ((double) (inp->sampleRate / 2) * 1.5)) {
-                nco_crcf_set_frequency(freqShifter, (2.0 * M_PI) * (((double) abs(shiftFrequency)) / ((double) inp->sampleRate)));
+        modemSettingsBuffered.clear();
+        modemSettingsChanged.store(false);
+        sendWorkerCommand(command);
+        cModem = nullptr;
+        cModemKit = nullptr;
+        demodTypeChanged.store(false);
+        initialized.store(false);
+    }
+    else if (
+        cModemKit && cModem &&
+        (bandwidthChanged.load() || sampleRateChanged.load() || audioSampleRateChanged.load() || cModem->shouldRebuildKit()) &&
+        (newSampleRate && newAudioSampleRate && newBandwidth)
+    ) {
+        DemodulatorWorkerThreadCommand command(DemodulatorWorkerThreadCommand::DEMOD_WORKER_THREAD_CMD_BUILD_FILTERS);
+        command.frequency = newFrequency;
+        command.sampleRate = newSampleRate;
+        command.bandwidth = newBandwidth;
+        command.audioSampleRate = newAudioSampleRate;
+        bandwidthChanged.store(false);
+        sampleRateChanged.store(false);
+        audioSampleRateChanged.store(false);
+        modemSettingsBuffered.clear();
+        sendWorkerCommand(command);
+    }
+    
+    // Requested frequency is not center, shift it into the center!
+    if ((currentFrequency - inp->frequency) != shiftFrequency) {
+        shiftFrequency = currentFrequency - inp->frequency;
+        if (abs(shiftFrequency) <= (int) ((double) (inp->sampleRate / 2) * 1.5)) {
+            nco_crcf_set_frequency(freqShifter, (2.0 * M_PI) * (((double) abs(shiftFrequency)) / ((double) inp->sampleRate)));
+            if (iqDecimator) {
+                iqDecimator->setShift((double) shiftFrequency / (double) inp->sampleRate);
             }
         }
+    }
 
-        if (cModem && cModemKit && abs(shiftFrequency) > (int) ((double) (inp->sampleRate / 2) * 1.5)) {
-          
-            continue;
-        }
+    if (cModem && cModemKit && abs(shiftFrequency) > (int) ((double) (inp->sampleRate / 2) * 1.5)) {
+      
+        return nullptr;
+    }
+
+//    std::lock_guard < std::mutex > lock(inp->m_mutex);
+    DemodulatorThreadPostIQDataPtr resamp = nullptr;
 
-//        std::lock_guard < std::mutex > lock(inp->m_mutex);
-        std::vector<liquid_float_complex> *data = &inp->data;
-        if (data->size() && (inp->sampleRate == currentSampleRate) && cModem && cModemKit) {
-            size_t bufSize = data->size();
+    std::vector<liquid_float_complex> *data = &inp->data;
+    if (data->size() && (inp->sampleRate == currentSampleRate) && cModem && cModemKit) {
+        size_t bufSize = data->size();
 
+        resamp = buffers.getBuffer();
+
+        if (iqDecimator) {
+            //shift and decimate straight from the input block.
+            resamp->data.resize(iqDecimator->getMaxOutput(bufSize));
+            resamp->data.resize(iqDecimator->execute(&inp->data[0], bufSize, &resamp->data[0]));
+        } else {
             if (in_buf_data.size() != bufSize) {
                 if (in_buf_data.capacity() < bufSize) {
                     in_buf_data.reserve(bufSize);
@@ -197,8 +239,6 @@ void DemodulatorPreThread::run() {
                 out_buf = temp_buf;
             }
 
-            DemodulatorThreadPostIQDataPtr resamp = buffers.getBuffer();
-
             size_t out_size = ceil((double) (bufSize) * iqResampleRatio) + 512;
 
             if (resampledData.size() != out_size) {
@@ -212,77 +252,85 @@ void DemodulatorPreThread::run() {
             msresamp_crcf_execute(iqResampler, in_buf, bufSize, &resampledData[0], &numWritten);
 
             resamp->data.assign(resampledData.begin(), resampledData.begin() + numWritten);
-
-            resamp->modemType = cModem->getType();
-            resamp->modemName = cModem->getName();
-            resamp->modem = cModem;
-            resamp->modemKit = cModemKit;
-            resamp->sampleRate = currentBandwidth;
-
-            //VSO: blocking push
-            iqOutputQueue->push(resamp);   
         }
 
-        DemodulatorWorkerThreadResult result;
-        //process all worker results until 
-        while (!stopping && workerResults->try_pop(result)) {
-              
-            switch (result.cmd) {
-                case DemodulatorWorkerThreadResult::DEMOD_WORKER_THREAD_RESULT_FILTERS:
-                    if (result.iqResampler) {
-                        if (iqResampler) {
-                            msresamp_crcf_destroy(iqResampler);
-                        }
-                        iqResampler = result.iqResampler;
-                        iqResampleRatio = result.iqResampleRatio;
+        resamp->modemType = cModem->getType();
+        resamp->modemName = cModem->getName();
+        resamp->modem = cModem;
+        resamp->modemKit = cModemKit;
+        resamp->sampleRate = currentBandwidth;
+        resamp->captureTime = inp->captureTime;
+    }
+
+    DemodulatorWorkerThreadResult result;
+    //process all worker results until 
+    while (!stopping && workerResults->try_pop(result)) {
+          
+        switch (result.cmd) {
+            case DemodulatorWorkerThreadResult::DEMOD_WORKER_THREAD_RESULT_FILTERS:
+                if (result.iqResampler || result.iqDecimator) {
+                    if (iqResampler) {
+                        FilterDesignCache::releaseResampler(iqResampler);
                     }
+                    delete iqDecimator;
+                    iqResampler = result.iqResampler;
+                    iqDecimator = result.iqDecimator;
+                    iqResampleRatio = result.iqResampleRatio;
+                }
 
-                    if (result.modem != nullptr) {
-                        cModem = result.modem;
+                if (result.modem != nullptr) {
+                    cModem = result.modem;
 #if ENABLE_DIGITAL_LAB
-                        if (cModem->getType() == "digital") {
-                            ModemDigital *mDigi = (ModemDigital *)cModem;
-                            mDigi->setOutput(parent->getOutput());
-                        }
-#endif
+                    if (cModem->getType() == "digital") {
+                        ModemDigital *mDigi = (ModemDigital *)cModem;
+                        mDigi->setOutput(parent->getOutput());
                     }
+#endif
+                }
+                
+                if (result.modemKit != nullptr) {
+                    cModemKit = result.modemKit;
+                    currentAudioSampleRate = cModemKit->audioSampleRate;
+                }
                     
-                    if (result.modemKit != nullptr) {
-                        cModemKit = result.modemKit;
-                        currentAudioSampleRate = cModemKit->audioSampleRate;
-                    }
-                        
-                    if (result.bandwidth) {
-                        currentBandwidth = result.bandwidth;
-                    }
+                if (result.bandwidth) {
+                    currentBandwidth = result.bandwidth;
+                }
 
-                    if (result.sampleRate) {
-                        currentSampleRate = result.sampleRate;
-                    }
-                        
-                    if (result.modemName != "") {
-                        demodType = result.modemName;
-                        demodTypeChanged.store(false);
-                    }
-                        
-                    shiftFrequency = inp->frequency-1;
-                    initialized.store(cModem != nullptr);
-                    break;
-                default:
-                    break;
-            }
-        } //end while
-        
-        if ((cModem != nullptr) && modemSettingsChanged.load()) {
-            cModem->writeSettings(modemSettingsBuffered);
-            modemSettingsBuffered.clear();
-            modemSettingsChanged.store(false);
+                if (result.sampleRate) {
+                    currentSampleRate = result.sampleRate;
+                }
+                    
+                if (result.modemName != "") {
+                    demodType = result.modemName;
+                    demodTypeChanged.store(false);
+                }
+                    
+                shiftFrequency = inp->frequency-1;
+                initialized.store(cModem != nullptr);
+                break;
+            default:
+                break;
         }
-    } //end while stopping
+    } //end while
+    
+    if ((cModem != nullptr) && modemSettingsChanged.load()) {
+        cModem->writeSettings(modemSettingsBuffered);
+        modemSettingsBuffered.clear();
+        modemSettingsChanged.store(false);
+    }
 
-   
-    iqOutputQueue->flush();
-    iqInputQueue->flush();
+    return resamp;
+}
+
+void DemodulatorPreThread::sendWorkerCommand(const DemodulatorWorkerThreadCommand& command) {
+    //VSO: blocking push
+    workerQueue->push(command);
+
+    //no worker thread in shared execution: build right away, the result is applied with the others at the end of process().
+    if (t_Worker == nullptr) {
+        workerThread->processPendingCommands();
+    }
 }
 
 void DemodulatorPreThread::setDemodType(std::string demodType) {
@@ -356,6 +404,10 @@ void DemodulatorPreThread::terminate() {
     iqOutputQueue->flush();
     iqInputQueue->flush();
 
+    if (t_Worker == nullptr) {
+        return;
+    }
+
     //wait blocking for termination here, it could be long with lots of modems and we MUST terminate properly,
     //else better kill the whole application...
     workerThread->isTerminated(5000);
@@ -11,6 +11,7 @@
 #include "CubicSDRDefs.h"
 #include "DemodDefs.h"
 #include "DemodulatorWorkerThread.h"
+#include "PipelineMetrics.h"
 
 class DemodulatorInstance;
 
@@ -20,7 +21,13 @@ public:
     DemodulatorPreThread(DemodulatorInstance* parent);
     virtual ~DemodulatorPreThread();
 
+    //bind the queues, done by run(), or before process() when run by the demodulator scheduler.
+    virtual void setup();
     virtual void run();
+
+    //Shift and resample one input block for the demodulator, nullptr if there is nothing to demodulate yet.
+    //Without the thread of run(), filters are built right away instead of by a worker thread.
+    DemodulatorThreadPostIQDataPtr process(const DemodulatorThreadIQDataPtr& inp);
     
     void setDemodType(std::string demodType);
     std::string getDemodType();
@@ -50,10 +57,17 @@ public:
     void writeModemSettings(ModemSettings settings);
 
 protected:
+    void sendWorkerCommand(const DemodulatorWorkerThreadCommand& command);
   
     DemodulatorInstance* parent;
 
+    ReBuffer<DemodulatorThreadPostIQData> buffers;
+    std::vector<liquid_float_complex> in_buf_data;
+    std::vector<liquid_float_complex> out_buf_data;
+
     msresamp_crcf iqResampler;
+    //shift and resampling in one pass, used instead of freqShifter and iqResampler when set.
+    TranslatingDecimator *iqDecimator;
     double iqResampleRatio;
     std::vector<liquid_float_complex> resampledData;
 
@@ -86,4 +100,7 @@ protected:
 
     DemodulatorThreadInputQueuePtr iqInputQueue;
     DemodulatorThreadPostInputQueuePtr iqOutputQueue;
+
+    PipelineMetrics::ThreadStats *busyStats;
+    PipelineMetrics::LatencyStats *latencyStats;
 };
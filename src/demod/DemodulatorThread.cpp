@@ -5,6 +5,7 @@
 #include "DemodulatorThread.h"
 #include "DemodulatorInstance.h"
 #include "CubicSDR.h"
+#include "PipelineMetrics.h"
 #include <vector>
 
 #include <cmath>
@@ -24,7 +25,7 @@ std::mutex DemodulatorThread::squelchLockMutex;
 
 DemodulatorThread::DemodulatorThread(DemodulatorInstance* parent)
     : IOThread(), outputBuffers("DemodulatorThreadBuffers"), squelchLevel(-100), 
-      signalLevel(-100), signalFloor(-30), signalCeil(30), squelchEnabled(false) {
+      signalLevel(-100), signalFloor(-30), signalCeil(30), squelchEnabled(false), busyStats(nullptr), latencyStats(nullptr) {
     
     demodInstance = parent;
     muted.store(false);
@@ -71,6 +72,15 @@ double DemodulatorThread::linearToDb(double linear) {
     return 20.0 * log10(linear);
 }
 
+void DemodulatorThread::setup() {
+    iqInputQueue = std::static_pointer_cast<DemodulatorThreadPostInputQueue>(getInputQueue("IQDataInput"));
+    audioOutputQueue = std::static_pointer_cast<AudioThreadInputQueue>(getOutputQueue("AudioDataOutput"));
+    threadQueueControl = std::static_pointer_cast<DemodulatorThreadControlCommandQueue>(getInputQueue("ControlQueue"));
+
+    busyStats = PipelineMetrics::getThreadStats("DemodulatorThread");
+    latencyStats = PipelineMetrics::getLatencyStats("DemodulatorThread input");
+}
+
 void DemodulatorThread::run() {
 #ifdef __APPLE__
     pthread_t tID = pthread_self();  // ID of this thread
@@ -81,11 +91,7 @@ void DemodulatorThread::run() {
     
 //    std::cout << "Demodulator thread started.." << std::endl;
     
-    iqInputQueue = std::static_pointer_cast<DemodulatorThreadPostInputQueue>(getInputQueue("IQDataInput"));
-    audioOutputQueue = std::static_pointer_cast<AudioThreadInputQueue>(getOutputQueue("AudioDataOutput"));
-    threadQueueControl = std::static_pointer_cast<DemodulatorThreadControlCommandQueue>(getInputQueue("ControlQueue"));
-     
-    ModemIQData modemData;
+    setup();
     
     while (!stopping) {
         DemodulatorThreadPostIQDataPtr inp;
@@ -93,137 +99,156 @@ void DemodulatorThread::run() {
         if (!iqInputQueue->pop(inp, HEARTBEAT_CHECK_PERIOD_MICROS)) {
             continue;
         }
-         
-        size_t bufSize = inp->data.size();
-        
-        if (!bufSize) {
-           
-            continue;
-        }
-        
-        if (inp->modemKit && inp->modemKit != cModemKit) {
-            if (cModemKit != nullptr) {
-                cModem->disposeKit(cModemKit);
-            }
-            cModemKit = inp->modemKit;
-        }
-        
-        if (inp->modem && inp->modem != cModem) {
-            delete cModem;
-            cModem = inp->modem;
-        }
-        
-        if (!cModem || !cModemKit) {
-           
-            continue;
+
+        process(inp);
+    }
+    // end while !stopping
+    
+    // Purge any unused inputs, with a non-blocking pop
+    iqInputQueue->flush();
+    audioOutputQueue->flush();
+    
+//    std::cout << "Demodulator thread done." << std::endl;
+}
+
+void DemodulatorThread::process(const DemodulatorThreadPostIQDataPtr& inp) {
+    PipelineMetrics::BusyScope busy(busyStats);
+    latencyStats->record(inp->captureTime);
+     
+    size_t bufSize = inp->data.size();
+    
+    if (!bufSize) {
+       
+        return;
+    }
+    
+    if (inp->modemKit && inp->modemKit != cModemKit) {
+        if (cModemKit != nullptr) {
+            cModem->disposeKit(cModemKit);
         }
+        cModemKit = inp->modemKit;
+    }
+    
+    if (inp->modem && inp->modem != cModem) {
+        delete cModem;
+        cModem = inp->modem;
+    }
+    
+    if (!cModem || !cModemKit) {
+       
+        return;
+    }
+    
+    std::vector<liquid_float_complex> *inputData;
+    
+    inputData = &inp->data;
+    
+    modemData.sampleRate = inp->sampleRate;
+    modemData.data.assign(inputData->begin(), inputData->end());
+    
+    AudioThreadInputPtr ati = nullptr;
+    
+    ModemAnalog *modemAnalog = (cModem->getType() == "analog")?((ModemAnalog *)cModem):nullptr;
+    ModemDigital *modemDigital = (cModem->getType() == "digital")?((ModemDigital *)cModem):nullptr;
+    
+    if (modemAnalog != nullptr) {
+        ati = outputBuffers.getBuffer();
         
-        std::vector<liquid_float_complex> *inputData;
-        
-        inputData = &inp->data;
-        
-        modemData.sampleRate = inp->sampleRate;
-        modemData.data.assign(inputData->begin(), inputData->end());
-        
-        AudioThreadInputPtr ati = nullptr;
-        
-        ModemAnalog *modemAnalog = (cModem->getType() == "analog")?((ModemAnalog *)cModem):nullptr;
-        ModemDigital *modemDigital = (cModem->getType() == "digital")?((ModemDigital *)cModem):nullptr;
+        ati->sampleRate = cModemKit->audioSampleRate;
+        ati->inputRate = inp->sampleRate;
+    } else if (modemDigital != nullptr) {
+        ati = outputBuffers.getBuffer();
         
-        if (modemAnalog != nullptr) {
-            ati = outputBuffers.getBuffer();
-            
-            ati->sampleRate = cModemKit->audioSampleRate;
-            ati->inputRate = inp->sampleRate;
-        } else if (modemDigital != nullptr) {
-            ati = outputBuffers.getBuffer();
-            
-            ati->sampleRate = cModemKit->sampleRate;
-            ati->inputRate = inp->sampleRate;
-            ati->data.resize(0);
-        }
+        ati->sampleRate = cModemKit->sampleRate;
+        ati->inputRate = inp->sampleRate;
+        ati->data.resize(0);
+    }
 
-        cModem->demodulate(cModemKit, &modemData, ati.get());
+    if (ati) {
+        ati->captureTime = inp->captureTime;
+    }
 
-        double currentSignalLevel = 0;
-        double sampleTime = double(inp->data.size()) / double(inp->sampleRate);
+    cModem->demodulate(cModemKit, &modemData, ati.get());
 
-        if (audioOutputQueue != nullptr && ati && ati->data.size()) {
-            double accum = 0;
+    double currentSignalLevel = 0;
+    double sampleTime = double(inp->data.size()) / double(inp->sampleRate);
 
-             if (cModem->useSignalOutput()) {
+    if (audioOutputQueue != nullptr && ati && ati->data.size()) {
+        double accum = 0;
 
-                for (auto i : ati->data) {
-                    accum += abMagnitude(i, 0.0);
-                }
+         if (cModem->useSignalOutput()) {
 
-                currentSignalLevel = linearToDb(accum / double(ati->data.size()));
+            for (auto i : ati->data) {
+                accum += abMagnitude(i, 0.0);
+            }
 
-            } else {
-   
-                for (auto i : inp->data) {
-                    accum += abMagnitude(i.real, i.imag);
-                }
+            currentSignalLevel = linearToDb(accum / double(ati->data.size()));
 
-                currentSignalLevel = linearToDb(accum / double(inp->data.size()));
-            }
-            
-            float sf = signalFloor.load(), sc = signalCeil.load(), sl = squelchLevel.load();
-            
-         
-            if (currentSignalLevel > sc) {
-                sc = currentSignalLevel;
-            }
-            
-            if (currentSignalLevel < sf) {
-                sf = currentSignalLevel;
+        } else {
+   
+            for (auto i : inp->data) {
+                accum += abMagnitude(i.real, i.imag);
             }
-            
 
-            if (sl+1.0f > sc) {
-                sc = sl+1.0f;
-            }
-            
-            if ((sf+2.0f) > sc) {
-                sc = sf+2.0f;
-            }
-            
-            sc -= (sc - (currentSignalLevel + 2.0f)) * sampleTime * 0.05f;
-            sf += ((currentSignalLevel - 5.0f) - sf) * sampleTime * 0.15f;
-            
-            signalFloor.store(sf);
-            signalCeil.store(sc);
+            currentSignalLevel = linearToDb(accum / double(inp->data.size()));
         }
         
-        if (currentSignalLevel > signalLevel) {
-            signalLevel = signalLevel + (currentSignalLevel - signalLevel) * 0.5;
-        } else {
-            signalLevel = signalLevel + (currentSignalLevel - signalLevel) * 0.05 * sampleTime * 30.0;
+        float sf = signalFloor.load(), sc = signalCeil.load(), sl = squelchLevel.load();
+        
+     
+        if (currentSignalLevel > sc) {
+            sc = currentSignalLevel;
+        }
+        
+        if (currentSignalLevel < sf) {
+            sf = currentSignalLevel;
         }
         
-        bool squelched = squelchEnabled && (signalLevel < squelchLevel);
+
+        if (sl+1.0f > sc) {
+            sc = sl+1.0f;
+        }
+        
+        if ((sf+2.0f) > sc) {
+            sc = sf+2.0f;
+        }
+        
+        sc -= (sc - (currentSignalLevel + 2.0f)) * sampleTime * 0.05f;
+        sf += ((currentSignalLevel - 5.0f) - sf) * sampleTime * 0.15f;
         
-        if (squelchEnabled) {
-            if (!squelched && !squelchBreak) {
-                    if (wxGetApp().getSoloMode() && !wxGetApp().getAppFrame()->isUserDemodBusy()) {
-                        std::lock_guard < std::mutex > lock(squelchLockMutex);
-                        if (squelchLock == nullptr) {
-                            squelchLock = demodInstance;
-                            wxGetApp().getDemodMgr().setActiveDemodulator(nullptr);
-                            wxGetApp().getDemodMgr().setActiveDemodulatorByRawPointer(demodInstance, false);
-                            squelchBreak = true;
-                            demodInstance->getVisualCue()->triggerSquelchBreak(120);
-                        }
-                    } else {
+        signalFloor.store(sf);
+        signalCeil.store(sc);
+    }
+    
+    if (currentSignalLevel > signalLevel) {
+        signalLevel = signalLevel + (currentSignalLevel - signalLevel) * 0.5;
+    } else {
+        signalLevel = signalLevel + (currentSignalLevel - signalLevel) * 0.05 * sampleTime * 30.0;
+    }
+    
+    bool squelched = squelchEnabled && (signalLevel < squelchLevel);
+    
+    if (squelchEnabled) {
+        if (!squelched && !squelchBreak) {
+                if (wxGetApp().getSoloMode() && !wxGetApp().getAppFrame()->isUserDemodBusy()) {
+                    std::lock_guard < std::mutex > lock(squelchLockMutex);
+                    if (squelchLock == nullptr) {
+                        squelchLock = demodInstance;
+                        wxGetApp().getDemodMgr().setActiveDemodulator(nullptr);
+                        wxGetApp().getDemodMgr().setActiveDemodulatorByRawPointer(demodInstance, false);
                         squelchBreak = true;
                         demodInstance->getVisualCue()->triggerSquelchBreak(120);
                     }
-                
-            } else if (squelched && squelchBreak) {
-                releaseSquelchLock(demodInstance);
-                squelchBreak = false;
-            }
+                } else {
+                    squelchBreak = true;
+                    demodInstance->getVisualCue()->triggerSquelchBreak(120);
+                }
+            
+        } else if (squelched && squelchBreak) {
+            releaseSquelchLock(demodInstance);
+            squelchBreak = false;
         }
+    }
 
 		//compute audio peak:
 		if (audioOutputQueue != nullptr && ati) {
@@ -243,137 +268,129 @@ void DemodulatorThread::run() {
 			ati->is_squelch_active = squelched;
 		}
 
-        //At that point, capture the current state of audioVisOutputQueue in a local 
-        //variable, and works with it with now on until the next while-turn.
-        DemodulatorThreadOutputQueuePtr localAudioVisOutputQueue = nullptr;
-        {
-            std::lock_guard < SpinMutex > lock(m_mutexAudioVisOutputQueue);
-            localAudioVisOutputQueue = audioVisOutputQueue;
-        }
+    //At that point, capture the current state of audioVisOutputQueue in a local 
+    //variable, and works with it with now on until the next while-turn.
+    DemodulatorThreadOutputQueuePtr localAudioVisOutputQueue = nullptr;
+    {
+        std::lock_guard < SpinMutex > lock(m_mutexAudioVisOutputQueue);
+        localAudioVisOutputQueue = audioVisOutputQueue;
+    }
 
-        if (!squelched && (ati || modemDigital) && localAudioVisOutputQueue != nullptr && localAudioVisOutputQueue->empty()) {
+    if (!squelched && (ati || modemDigital) && localAudioVisOutputQueue != nullptr && localAudioVisOutputQueue->empty()) {
 
-            AudioThreadInputPtr ati_vis = std::make_shared<AudioThreadInput>();
+        AudioThreadInputPtr ati_vis = std::make_shared<AudioThreadInput>();
 
-            ati_vis->sampleRate = inp->sampleRate;
-            ati_vis->inputRate = inp->sampleRate;
+        ati_vis->sampleRate = inp->sampleRate;
+        ati_vis->inputRate = inp->sampleRate;
+        
+        size_t num_vis = DEMOD_VIS_SIZE;
+        if (modemDigital) {
+            if (ati) {  // TODO: handle digital modems with audio output
+               
+                ati = nullptr;
+            }
+            ati_vis->data.resize(inputData->size());
+            ati_vis->channels = 2;
+            for (int i = 0, iMax = inputData->size() / 2; i < iMax; i++) {
+                ati_vis->data[i * 2] = (*inputData)[i].real;
+                ati_vis->data[i * 2 + 1] = (*inputData)[i].imag;
+            }
+            ati_vis->type = 2;
+        } else if (ati->channels==2) {
+            ati_vis->channels = 2;
+            int stereoSize = ati->data.size();
+            if (stereoSize > DEMOD_VIS_SIZE * 2) {
+                stereoSize = DEMOD_VIS_SIZE * 2;
+            }
             
-            size_t num_vis = DEMOD_VIS_SIZE;
-            if (modemDigital) {
-                if (ati) {  // TODO: handle digital modems with audio output
-                   
-                    ati = nullptr;
-                }
-                ati_vis->data.resize(inputData->size());
-                ati_vis->channels = 2;
-                for (int i = 0, iMax = inputData->size() / 2; i < iMax; i++) {
-                    ati_vis->data[i * 2] = (*inputData)[i].real;
-                    ati_vis->data[i * 2 + 1] = (*inputData)[i].imag;
-                }
-                ati_vis->type = 2;
-            } else if (ati->channels==2) {
-                ati_vis->channels = 2;
-                int stereoSize = ati->data.size();
-                if (stereoSize > DEMOD_VIS_SIZE * 2) {
-                    stereoSize = DEMOD_VIS_SIZE * 2;
-                }
-                
-                ati_vis->data.resize(stereoSize);
-                
-                if (inp->modemName == "I/Q") {
-                    for (int i = 0; i < stereoSize / 2; i++) {
-                        ati_vis->data[i] = (*inputData)[i].real * 0.75;
-                        ati_vis->data[i + stereoSize / 2] = (*inputData)[i].imag * 0.75;
-                    }
-                } else {
-                    for (int i = 0; i < stereoSize / 2; i++) {
-                        ati_vis->inputRate = cModemKit->audioSampleRate;
-                        ati_vis->sampleRate = 36000;
-                        ati_vis->data[i] = ati->data[i * 2];
-                        ati_vis->data[i + stereoSize / 2] = ati->data[i * 2 + 1];
-                    }
+            ati_vis->data.resize(stereoSize);
+            
+            if (inp->modemName == "I/Q") {
+                for (int i = 0; i < stereoSize / 2; i++) {
+                    ati_vis->data[i] = (*inputData)[i].real * 0.75;
+                    ati_vis->data[i + stereoSize / 2] = (*inputData)[i].imag * 0.75;
                 }
-                ati_vis->type = 1;
             } else {
-                size_t numAudioWritten = ati->data.size();
-                ati_vis->channels = 1;
-                std::vector<float> *demodOutData = (modemAnalog != nullptr)?modemAnalog->getDemodOutputData():nullptr;
-                if ((numAudioWritten > bufSize) || (demodOutData == nullptr)) {
+                for (int i = 0; i < stereoSize / 2; i++) {
                     ati_vis->inputRate = cModemKit->audioSampleRate;
-                    if (num_vis > numAudioWritten) {
-                        num_vis = numAudioWritten;
-                    }
-                    ati_vis->data.assign(ati->data.begin(), ati->data.begin() + num_vis);
-                } else {
-                    if (num_vis > demodOutData->size()) {
-                        num_vis = demodOutData->size();
-                    }
-                    ati_vis->data.assign(demodOutData->begin(), demodOutData->begin() + num_vis);
+                    ati_vis->sampleRate = 36000;
+                    ati_vis->data[i] = ati->data[i * 2];
+                    ati_vis->data[i + stereoSize / 2] = ati->data[i * 2 + 1];
                 }
-                ati_vis->type = 0;
             }
-            
-            if (!localAudioVisOutputQueue->try_push(ati_vis)) {
-                //non-blocking push needed for audio vis out
-            
-                std::cout << "DemodulatorThread::run() cannot push ati_vis into localAudioVisOutputQueue, is full !" << std::endl;
-                std::this_thread::yield();
-            }
-        }
-
-        if (!squelched && ati != nullptr) {
-            if (!muted.load() && (!wxGetApp().getSoloMode() || (demodInstance ==
-                    wxGetApp().getDemodMgr().getCurrentModem().get()))) {
-                //non-blocking push needed for audio out
-                if (!audioOutputQueue->try_push(ati)) {
-                  
-                    std::cout << "DemodulatorThread::run() cannot push ati into audioOutputQueue, is full !" << std::endl;
-                    std::this_thread::yield();
+            ati_vis->type = 1;
+        } else {
+            size_t numAudioWritten = ati->data.size();
+            ati_vis->channels = 1;
+            std::vector<float> *demodOutData = (modemAnalog != nullptr)?modemAnalog->getDemodOutputData():nullptr;
+            if ((numAudioWritten > bufSize) || (demodOutData == nullptr)) {
+                ati_vis->inputRate = cModemKit->audioSampleRate;
+                if (num_vis > numAudioWritten) {
+                    num_vis = numAudioWritten;
+                }
+                ati_vis->data.assign(ati->data.begin(), ati->data.begin() + num_vis);
+            } else {
+                if (num_vis > demodOutData->size()) {
+                    num_vis = demodOutData->size();
                 }
+                ati_vis->data.assign(demodOutData->begin(), demodOutData->begin() + num_vis);
             }
+            ati_vis->type = 0;
         }
         
+        if (!localAudioVisOutputQueue->try_push(ati_vis)) {
+            //non-blocking push needed for audio vis out
         
-        // Capture audioSinkOutputQueue state in a local variable
-        DemodulatorThreadOutputQueuePtr localAudioSinkOutputQueue = nullptr;
-        {
-            std::lock_guard < SpinMutex > lock(m_mutexAudioVisOutputQueue);
-            localAudioSinkOutputQueue = audioSinkOutputQueue;
+            std::cout << "DemodulatorThread::process() cannot push ati_vis into localAudioVisOutputQueue, is full !" << std::endl;
+            std::this_thread::yield();
         }
+    }
 
-        //Push to audio sink, if any:
-        if (ati && localAudioSinkOutputQueue != nullptr) {
-            
-            if (!localAudioSinkOutputQueue->try_push(ati)) {
-                std::cout << "DemodulatorThread::run() cannot push ati into audioSinkOutputQueue, is full !" << std::endl;
+    if (!squelched && ati != nullptr) {
+        if (!muted.load() && (!wxGetApp().getSoloMode() || (demodInstance ==
+                wxGetApp().getDemodMgr().getCurrentModem().get()))) {
+            //non-blocking push needed for audio out
+            if (!audioOutputQueue->try_push(ati)) {
+              
+                std::cout << "DemodulatorThread::process() cannot push ati into audioOutputQueue, is full !" << std::endl;
                 std::this_thread::yield();
             }
         }
+    }
+    
+    
+    // Capture audioSinkOutputQueue state in a local variable
+    DemodulatorThreadOutputQueuePtr localAudioSinkOutputQueue = nullptr;
+    {
+        std::lock_guard < SpinMutex > lock(m_mutexAudioVisOutputQueue);
+        localAudioSinkOutputQueue = audioSinkOutputQueue;
+    }
 
-        DemodulatorThreadControlCommand command;
+    //Push to audio sink, if any:
+    if (ati && localAudioSinkOutputQueue != nullptr) {
         
-        //empty command queue, execute commands
-        while (threadQueueControl->try_pop(command)) {
-                       
-            switch (command.cmd) {
-                case DemodulatorThreadControlCommand::DEMOD_THREAD_CMD_CTL_SQUELCH_ON:
-                    squelchEnabled = true;
-                    break;
-                case DemodulatorThreadControlCommand::DEMOD_THREAD_CMD_CTL_SQUELCH_OFF:
-                    squelchEnabled = false;
-                    break;
-                default:
-                    break;
-            }
+        if (!localAudioSinkOutputQueue->try_push(ati)) {
+            std::cout << "DemodulatorThread::process() cannot push ati into audioSinkOutputQueue, is full !" << std::endl;
+            std::this_thread::yield();
         }
     }
-    // end while !stopping
-    
-    // Purge any unused inputs, with a non-blocking pop
-    iqInputQueue->flush();
-    audioOutputQueue->flush();
+
+    DemodulatorThreadControlCommand command;
     
-//    std::cout << "Demodulator thread done." << std::endl;
+    //empty command queue, execute commands
+    while (threadQueueControl->try_pop(command)) {
+                   
+        switch (command.cmd) {
+            case DemodulatorThreadControlCommand::DEMOD_THREAD_CMD_CTL_SQUELCH_ON:
+                squelchEnabled = true;
+                break;
+            case DemodulatorThreadControlCommand::DEMOD_THREAD_CMD_CTL_SQUELCH_OFF:
+                squelchEnabled = false;
+                break;
+            default:
+                break;
+        }
+    }
 }
 
 void DemodulatorThread::terminate() {
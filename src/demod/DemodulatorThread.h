@@ -11,6 +11,7 @@
 #include "AudioThread.h"
 #include "Modem.h"
 #include "SpinMutex.h"
+#include "PipelineMetrics.h"
 
 #define DEMOD_VIS_SIZE 2048
 #define DEMOD_SIGNAL_MIN -30
@@ -26,8 +27,13 @@ public:
 
     void onBindOutput(std::string name, ThreadQueueBasePtr threadQueue);
     
+    //bind the queues, done by run(), or before process() when run by the demodulator scheduler.
+    virtual void setup();
     virtual void run();
     virtual void terminate();
+
+    //Demodulate one block to the audio, visual and sink outputs, then apply the pending control commands.
+    void process(const DemodulatorThreadPostIQDataPtr& inp);
     
     void setMuted(bool state);
     bool isMuted();
@@ -62,6 +68,7 @@ protected:
     
     Modem *cModem = nullptr;
     ModemKit *cModemKit = nullptr;
+    ModemIQData modemData;
     
     DemodulatorThreadPostInputQueuePtr iqInputQueue;
     AudioThreadInputQueuePtr audioOutputQueue;
@@ -72,4 +79,7 @@ protected:
 
     //protects the audioVisOutputQueue dynamic binding change at runtime (in DemodulatorMgr)
     SpinMutex m_mutexAudioVisOutputQueue;
+
+    PipelineMetrics::ThreadStats *busyStats;
+    PipelineMetrics::LatencyStats *latencyStats;
 };
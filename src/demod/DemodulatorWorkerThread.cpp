@@ -4,6 +4,7 @@
 #include "DemodulatorWorkerThread.h"
 #include "CubicSDRDefs.h"
 #include "CubicSDR.h"
+#include "FilterDesignCache.h"
 #include <vector>
 
 //50 ms
@@ -24,94 +25,116 @@ void DemodulatorWorkerThread::run() {
     resultQueue = std::static_pointer_cast<DemodulatorThreadWorkerResultQueue>(getOutputQueue("WorkerResultQueue"));
     
     while (!stopping) {
-        bool filterChanged = false;
-        bool makeDemod = false;
-        DemodulatorWorkerThreadCommand filterCommand, demodCommand;
         DemodulatorWorkerThreadCommand command;
 
-        bool done = false;
         //Beware of the subtility here,
         //we are waiting for the first command to show up (blocking!)
         //then consuming the commands until done. 
-        while (!done && !stopping) {
+        if (!commandQueue->pop(command, HEARTBEAT_CHECK_PERIOD_MICROS)) {
+            continue;
+        }
 
-            if (!commandQueue->pop(command, HEARTBEAT_CHECK_PERIOD_MICROS)) {
-                continue;
-            }
+        processCommands(command);
+    }
+//    std::cout << "Demodulator worker thread done." << std::endl;
+}
 
-            switch (command.cmd) {
-                case DemodulatorWorkerThreadCommand::DEMOD_WORKER_THREAD_CMD_BUILD_FILTERS:
-                    filterChanged = true;
-                    filterCommand = command;
-                    break;
-                case DemodulatorWorkerThreadCommand::DEMOD_WORKER_THREAD_CMD_MAKE_DEMOD:
-                    makeDemod = true;
-                    demodCommand = command;
-                    break;
-                default:
-                    break;
-            }
-            done = commandQueue->empty();
-        } //end while done.
-
-        if ((makeDemod || filterChanged) && !stopping) {
-            DemodulatorWorkerThreadResult result(DemodulatorWorkerThreadResult::DEMOD_WORKER_THREAD_RESULT_FILTERS);
-            
-            
-            if (filterCommand.sampleRate) {
-                result.sampleRate = filterCommand.sampleRate;
-            }
-            
-            if (makeDemod) {
-                cModem = Modem::makeModem(demodCommand.demodType);
-                cModemName = cModem->getName();
-                cModemType = cModem->getType();
-                if (demodCommand.settings.size()) {
-                    cModem->writeSettings(demodCommand.settings);
-                }
-                result.sampleRate = demodCommand.sampleRate;
-                wxGetApp().getAppFrame()->notifyUpdateModemProperties();
+void DemodulatorWorkerThread::processPendingCommands() {
+    DemodulatorWorkerThreadCommand command;
+
+    if (commandQueue->try_pop(command)) {
+        processCommands(command);
+    }
+}
+
+void DemodulatorWorkerThread::processCommands(const DemodulatorWorkerThreadCommand& first) {
+    bool filterChanged = false;
+    bool makeDemod = false;
+    DemodulatorWorkerThreadCommand filterCommand, demodCommand;
+    DemodulatorWorkerThreadCommand command = first;
+
+    bool done = false;
+    //only the latest command of each kind matters.
+    while (!done && !stopping) {
+
+        switch (command.cmd) {
+            case DemodulatorWorkerThreadCommand::DEMOD_WORKER_THREAD_CMD_BUILD_FILTERS:
+                filterChanged = true;
+                filterCommand = command;
+                break;
+            case DemodulatorWorkerThreadCommand::DEMOD_WORKER_THREAD_CMD_MAKE_DEMOD:
+                makeDemod = true;
+                demodCommand = command;
+                break;
+            default:
+                break;
+        }
+        done = !commandQueue->try_pop(command);
+    } //end while done.
+
+    if ((makeDemod || filterChanged) && !stopping) {
+        DemodulatorWorkerThreadResult result(DemodulatorWorkerThreadResult::DEMOD_WORKER_THREAD_RESULT_FILTERS);
+        
+        
+        if (filterCommand.sampleRate) {
+            result.sampleRate = filterCommand.sampleRate;
+        }
+        
+        if (makeDemod) {
+            cModem = Modem::makeModem(demodCommand.demodType);
+            cModemName = cModem->getName();
+            cModemType = cModem->getType();
+            if (demodCommand.settings.size()) {
+                cModem->writeSettings(demodCommand.settings);
             }
-            result.modem = cModem;
-
-            if (makeDemod && demodCommand.bandwidth && demodCommand.audioSampleRate) {
-                if (cModem != nullptr) {
-                    result.bandwidth = cModem->checkSampleRate(demodCommand.bandwidth, demodCommand.audioSampleRate);
-                    cModemKit = cModem->buildKit(result.bandwidth, demodCommand.audioSampleRate);
-                } else {
-                    cModemKit = nullptr;
-                }
-            } else if (filterChanged && filterCommand.bandwidth && filterCommand.audioSampleRate) {
-                if (cModem != nullptr) {
-                    result.bandwidth = cModem->checkSampleRate(filterCommand.bandwidth, filterCommand.audioSampleRate);
-                    cModemKit = cModem->buildKit(result.bandwidth, filterCommand.audioSampleRate);
-                } else {
-                    cModemKit = nullptr;
-                }
-            } else if (makeDemod) {
+            result.sampleRate = demodCommand.sampleRate;
+            wxGetApp().getAppFrame()->notifyUpdateModemProperties();
+        }
+        result.modem = cModem;
+
+        if (makeDemod && demodCommand.bandwidth && demodCommand.audioSampleRate) {
+            if (cModem != nullptr) {
+                result.bandwidth = cModem->checkSampleRate(demodCommand.bandwidth, demodCommand.audioSampleRate);
+                cModemKit = cModem->buildKit(result.bandwidth, demodCommand.audioSampleRate);
+            } else {
                 cModemKit = nullptr;
             }
+        } else if (filterChanged && filterCommand.bandwidth && filterCommand.audioSampleRate) {
             if (cModem != nullptr) {
-                cModem->clearRebuildKit();
-            }
-            
-            float As = 60.0f;         // stop-band attenuation [dB]
-            
-            if (cModem && result.sampleRate && result.bandwidth) {
-                result.bandwidth = cModem->checkSampleRate(result.bandwidth, makeDemod?demodCommand.audioSampleRate:filterCommand.audioSampleRate);
-                result.iqResampleRatio = (double) (result.bandwidth) / (double) result.sampleRate;
-                result.iqResampler = msresamp_crcf_create(result.iqResampleRatio, As);
+                result.bandwidth = cModem->checkSampleRate(filterCommand.bandwidth, filterCommand.audioSampleRate);
+                cModemKit = cModem->buildKit(result.bandwidth, filterCommand.audioSampleRate);
+            } else {
+                cModemKit = nullptr;
             }
+        } else if (makeDemod) {
+            cModemKit = nullptr;
+        }
+        if (cModem != nullptr) {
+            cModem->clearRebuildKit();
+        }
+        
+        float As = 60.0f;         // stop-band attenuation [dB]
+        
+        if (cModem && result.sampleRate && result.bandwidth) {
+            result.bandwidth = cModem->checkSampleRate(result.bandwidth, makeDemod?demodCommand.audioSampleRate:filterCommand.audioSampleRate);
+            result.iqResampleRatio = (double) (result.bandwidth) / (double) result.sampleRate;
 
-            result.modemKit = cModemKit;
-            result.modemType = cModemType;
-            result.modemName = cModemName;
-            
-            //VSO: blocking push
-            resultQueue->push(result);
+            //shift and decimate in one pass when the ratio allows it, else mix then msresamp.
+            int interpolation, decimation;
+            if (TranslatingDecimator::getRatio(result.sampleRate, result.bandwidth, As, interpolation, decimation)) {
+                result.iqDecimator = new TranslatingDecimator(interpolation, decimation, As);
+            } else {
+                result.iqResampler = FilterDesignCache::createResamplerCRCF(result.iqResampleRatio, As);
+            }
         }
+
+        result.modemKit = cModemKit;
+        result.modemType = cModemType;
+        result.modemName = cModemName;
+        
+        //VSO: blocking push
+        resultQueue->push(result);
     }
-//    std::cout << "Demodulator worker thread done." << std::endl;
 }
 
 void DemodulatorWorkerThread::terminate() {
@@ -11,6 +11,7 @@
 #include "ThreadBlockingQueue.h"
 #include "CubicSDRDefs.h"
 #include "Modem.h"
+#include "TranslatingDecimator.h"
 
 class DemodulatorWorkerThreadResult {
 public:
@@ -19,7 +20,7 @@ public:
     };
 
     DemodulatorWorkerThreadResult() :
-            cmd(DEMOD_WORKER_THREAD_RESULT_NULL), iqResampler(nullptr), iqResampleRatio(0), sampleRate(0), bandwidth(0), modemKit(nullptr), modemType("") {
+            cmd(DEMOD_WORKER_THREAD_RESULT_NULL), iqResampler(nullptr), iqDecimator(nullptr), iqResampleRatio(0), sampleRate(0), bandwidth(0), modemKit(nullptr), modemType("") {
 
     }
 
@@ -31,6 +32,8 @@ public:
     DemodulatorThreadResultEnum cmd;
 
     msresamp_crcf iqResampler;
+    //replaces both iqResampler and the frequency shifter when set.
+    TranslatingDecimator *iqDecimator;
     double iqResampleRatio;
 
     long long sampleRate;
@@ -81,6 +84,9 @@ public:
 
     virtual void run();
 
+    //Process the commands queued so far, for a worker run without a thread of its own.
+    void processPendingCommands();
+
     void setCommandQueue(DemodulatorThreadWorkerCommandQueuePtr tQueue) {
         commandQueue = tQueue;
     }
@@ -92,6 +98,8 @@ public:
     virtual void terminate();
 
 protected:
+    //Build the filters and modem asked by first and the commands queued after it, and push the result.
+    void processCommands(const DemodulatorWorkerThreadCommand& first);
 
     DemodulatorThreadWorkerCommandQueuePtr commandQueue;
     DemodulatorThreadWorkerResultQueuePtr resultQueue;
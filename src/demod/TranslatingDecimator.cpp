@@ -0,0 +1,326 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "TranslatingDecimator.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+//passband edge and stopband start, as fractions of the output rate.
+#define TRANSLATING_DECIMATOR_PASSBAND 0.4
+#define TRANSLATING_DECIMATOR_STOPBAND 0.6
+
+//outputs between renormalizations of the output phasor.
+#define TRANSLATING_DECIMATOR_RENORMALIZE 1024
+
+// y = sum_k (a[2k] + j b[2k]) * x[k], on complex samples as interleaved floats,
+// a and b holding each tap part twice.
+// Plain C++ version, also used for the tails of the vectorized ones.
+static void dotGeneric(const float *x, const float *a, const float *b, size_t numTaps, float *y) {
+    float re = 0, im = 0;
+
+    for (size_t k = 0; k < numTaps; k++) {
+        float xr = x[2 * k], xi = x[2 * k + 1];
+
+        re += a[2 * k] * xr - b[2 * k] * xi;
+        im += a[2 * k] * xi + b[2 * k] * xr;
+    }
+
+    y[0] = re;
+    y[1] = im;
+}
+
+#if CUBICSDR_SIMD_X86
+//2 taps at a time: acc1 sums (re * xr, re * xi) and acc2 (im * xr, im * xi) pairs, combined at the end.
+CUBICSDR_TARGET_SSE2 static void dotSSE2(const float *x, const float *a, const float *b, size_t numTaps, float *y) {
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    size_t k = 0;
+
+    for (; k + 2 <= numTaps; k += 2) {
+        __m128 v = _mm_loadu_ps(x + 2 * k);
+
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + 2 * k), v));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(b + 2 * k), v));
+    }
+
+    acc1 = _mm_add_ps(acc1, _mm_movehl_ps(acc1, acc1));
+    acc2 = _mm_add_ps(acc2, _mm_movehl_ps(acc2, acc2));
+
+    float s1[4], s2[4], tail[2];
+    _mm_storeu_ps(s1, acc1);
+    _mm_storeu_ps(s2, acc2);
+
+    dotGeneric(x + 2 * k, a + 2 * k, b + 2 * k, numTaps - k, tail);
+
+    y[0] = s1[0] - s2[1] + tail[0];
+    y[1] = s1[1] + s2[0] + tail[1];
+}
+
+//4 taps at a time.
+CUBICSDR_TARGET_AVX2 static void dotAVX2(const float *x, const float *a, const float *b, size_t numTaps, float *y) {
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    size_t k = 0;
+
+    for (; k + 4 <= numTaps; k += 4) {
+        __m256 v = _mm256_loadu_ps(x + 2 * k);
+
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + 2 * k), v, acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(b + 2 * k), v, acc2);
+    }
+
+    __m128 sum1 = _mm_add_ps(_mm256_castps256_ps128(acc1), _mm256_extractf128_ps(acc1, 1));
+    __m128 sum2 = _mm_add_ps(_mm256_castps256_ps128(acc2), _mm256_extractf128_ps(acc2, 1));
+
+    sum1 = _mm_add_ps(sum1, _mm_movehl_ps(sum1, sum1));
+    sum2 = _mm_add_ps(sum2, _mm_movehl_ps(sum2, sum2));
+
+    float s1[4], s2[4], tail[2];
+    _mm_storeu_ps(s1, sum1);
+    _mm_storeu_ps(s2, sum2);
+
+    dotGeneric(x + 2 * k, a + 2 * k, b + 2 * k, numTaps - k, tail);
+
+    y[0] = s1[0] - s2[1] + tail[0];
+    y[1] = s1[1] + s2[0] + tail[1];
+}
+#endif
+
+#if CUBICSDR_SIMD_NEON
+//2 taps at a time.
+static void dotNEON(const float *x, const float *a, const float *b, size_t numTaps, float *y) {
+    float32x4_t acc1 = vdupq_n_f32(0);
+    float32x4_t acc2 = vdupq_n_f32(0);
+    size_t k = 0;
+
+    for (; k + 2 <= numTaps; k += 2) {
+        float32x4_t v = vld1q_f32(x + 2 * k);
+
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + 2 * k), v);
+        acc2 = vmlaq_f32(acc2, vld1q_f32(b + 2 * k), v);
+    }
+
+    float32x2_t sum1 = vadd_f32(vget_low_f32(acc1), vget_high_f32(acc1));
+    float32x2_t sum2 = vadd_f32(vget_low_f32(acc2), vget_high_f32(acc2));
+
+    float tail[2];
+    dotGeneric(x + 2 * k, a + 2 * k, b + 2 * k, numTaps - k, tail);
+
+    y[0] = vget_lane_f32(sum1, 0) - vget_lane_f32(sum2, 1) + tail[0];
+    y[1] = vget_lane_f32(sum1, 1) + vget_lane_f32(sum2, 0) + tail[1];
+}
+#endif
+
+static long long gcd(long long a, long long b) {
+    while (b != 0) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+//prototype length for a decimation by M, at the upsampled rate.
+static unsigned int getPrototypeLength(int decimation, float attenuation) {
+    float transition = (float)((TRANSLATING_DECIMATOR_STOPBAND - TRANSLATING_DECIMATOR_PASSBAND) / decimation);
+
+    return estimate_req_filter_len(transition, attenuation);
+}
+
+bool TranslatingDecimator::getRatio(long long inputRate, long long outputRate, float attenuation, int& interpolation_out, int& decimation_out) {
+    if (inputRate <= 0 || outputRate <= 0 || outputRate >= inputRate) {
+        return false;
+    }
+
+    long long g = gcd(inputRate, outputRate);
+    long long L = outputRate / g;
+    long long M = inputRate / g;
+
+    if (L > TRANSLATING_DECIMATOR_MAX_INTERPOLATION) {
+        return false;
+    }
+
+    //the prototype grows with M, about 18 M taps at 60 dB.
+    if (M > TRANSLATING_DECIMATOR_MAX_TAPS || getPrototypeLength((int)M, attenuation) > TRANSLATING_DECIMATOR_MAX_TAPS) {
+        return false;
+    }
+
+    interpolation_out = (int)L;
+    decimation_out = (int)M;
+
+    return true;
+}
+
+TranslatingDecimator::TranslatingDecimator(int interpolation_in, int decimation_in, float attenuation) :
+    interpolation(interpolation_in), decimation(decimation_in), shift(0), outputCount(0) {
+
+    unsigned int length = getPrototypeLength(decimation, attenuation);
+
+    //a whole number of taps per branch.
+    branchLength = (length + interpolation - 1) / interpolation;
+    length = (unsigned int)(branchLength * interpolation);
+
+    //cutoff halfway through the transition band, relative to the upsampled rate.
+    float cutoff = (float)((TRANSLATING_DECIMATOR_PASSBAND + TRANSLATING_DECIMATOR_STOPBAND) / (2.0 * decimation));
+    prototype = FilterDesignCache::getKaiserLowpass(length, cutoff, attenuation, 0.0f);
+
+    //unity gain at DC for each branch, i.e. a gain of L for the whole prototype.
+    double sum = 0;
+    for (float h : *prototype) {
+        sum += h;
+    }
+    prototypeGain = interpolation / sum;
+
+    phasor.real = 1.0f;
+    phasor.imag = 0.0f;
+    rotation = phasor;
+
+    simdLevel = CPUFeatures::getSIMDLevel();
+
+    switch (simdLevel) {
+#if CUBICSDR_SIMD_X86
+        case CPUFeatures::SIMD_AVX2:
+            dotKernel = &dotAVX2;
+            break;
+        case CPUFeatures::SIMD_SSE2:
+            dotKernel = &dotSSE2;
+            break;
+#endif
+#if CUBICSDR_SIMD_NEON
+        case CPUFeatures::SIMD_NEON:
+            dotKernel = &dotNEON;
+            break;
+#endif
+        default:
+            simdLevel = CPUFeatures::SIMD_NONE;
+            dotKernel = &dotGeneric;
+            break;
+    }
+
+    updateTaps();
+    reset();
+}
+
+TranslatingDecimator::~TranslatingDecimator() {
+}
+
+int TranslatingDecimator::getInterpolation() {
+    return interpolation;
+}
+
+int TranslatingDecimator::getDecimation() {
+    return decimation;
+}
+
+size_t TranslatingDecimator::getBranchLength() {
+    return branchLength;
+}
+
+CPUFeatures::SIMDLevel TranslatingDecimator::getSIMDLevel() {
+    return simdLevel;
+}
+
+// Shifting the input by exp(-j w i) before the filter is the same as filtering with the taps
+// h[k] exp(j w k / L), then applying exp(-j w t / L) at the output, t being its time at the upsampled rate.
+void TranslatingDecimator::updateTaps() {
+    size_t numTaps = branchLength * interpolation;
+
+    tapsRe.resize(2 * numTaps);
+    tapsIm.resize(2 * numTaps);
+
+    for (int p = 0; p < interpolation; p++) {
+        for (size_t j = 0; j < branchLength; j++) {
+            //branch p applies h[p + k L] to the k-th newest sample of the window.
+            size_t k = p + (branchLength - 1 - j) * interpolation;
+            double angle = 2.0 * M_PI * shift * (double)k / (double)interpolation;
+            size_t dst = 2 * (p * branchLength + j);
+
+            double h = (*prototype)[k] * prototypeGain;
+
+            tapsRe[dst] = tapsRe[dst + 1] = (float)(h * cos(angle));
+            tapsIm[dst] = tapsIm[dst + 1] = (float)(h * sin(angle));
+        }
+    }
+
+    rotation.real = (float)cos(-2.0 * M_PI * shift * decimation / interpolation);
+    rotation.imag = (float)sin(-2.0 * M_PI * shift * decimation / interpolation);
+}
+
+void TranslatingDecimator::setShift(double shift_in) {
+    if (shift_in == shift) {
+        return;
+    }
+    shift = shift_in;
+
+    updateTaps();
+}
+
+void TranslatingDecimator::reset() {
+    history.assign(2 * (branchLength - 1) + 1, liquid_float_complex());
+
+    nextInput = 0;
+    nextBranch = 0;
+}
+
+size_t TranslatingDecimator::getMaxOutput(size_t numSamples) {
+    return (numSamples * interpolation) / decimation + 2;
+}
+
+size_t TranslatingDecimator::execute(const liquid_float_complex *in, size_t numSamples, liquid_float_complex *out) {
+    size_t numHistory = branchLength - 1;
+    size_t numOut = 0;
+
+    //the start of the input after the history, for the windows spanning both.
+    size_t head = std::min(numSamples, numHistory);
+    memcpy(&history[numHistory], in, head * sizeof(liquid_float_complex));
+
+    float pr = phasor.real, pi = phasor.imag;
+    float rr = rotation.real, ri = rotation.imag;
+
+    while (nextInput < numSamples) {
+        //window of the branchLength samples up to nextInput, the history being numHistory samples before the input.
+        const liquid_float_complex *window = (nextInput < numHistory) ? &history[nextInput] : &in[nextInput - numHistory];
+        float y[2];
+
+        dotKernel((const float *)window, &tapsRe[2 * nextBranch * branchLength], &tapsIm[2 * nextBranch * branchLength], branchLength, y);
+
+        out[numOut].real = y[0] * pr - y[1] * pi;
+        out[numOut].imag = y[0] * pi + y[1] * pr;
+        numOut++;
+
+        float t = pr * rr - pi * ri;
+        pi = pr * ri + pi * rr;
+        pr = t;
+
+        //keep the phasor on the unit circle despite the rounding of the recurrence.
+        if ((++outputCount % TRANSLATING_DECIMATOR_RENORMALIZE) == 0) {
+            float mag = sqrtf(pr * pr + pi * pi);
+            pr /= mag;
+            pi /= mag;
+        }
+
+        //next output, M samples later at the upsampled rate.
+        nextBranch += decimation;
+        nextInput += nextBranch / interpolation;
+        nextBranch %= interpolation;
+    }
+
+    phasor.real = pr;
+    phasor.imag = pi;
+
+    nextInput -= numSamples;
+
+    // Keep the last numHistory samples, from the input or from the history followed by it.
+    if (numSamples >= numHistory) {
+        memcpy(&history[0], &in[numSamples - numHistory], numHistory * sizeof(liquid_float_complex));
+    } else {
+        memmove(&history[0], &history[numSamples], numHistory * sizeof(liquid_float_complex));
+    }
+
+    return numOut;
+}
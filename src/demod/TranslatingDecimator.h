@@ -0,0 +1,87 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "liquid/liquid.h"
+#include "CPUFeatures.h"
+#include "FilterDesignCache.h"
+
+//Largest interpolation L of the L/M ratios the decimator is built for,
+//i.e. number of polyphase branches.
+#define TRANSLATING_DECIMATOR_MAX_INTERPOLATION 64
+//Largest prototype filter, in taps of the upsampled rate.
+#define TRANSLATING_DECIMATOR_MAX_TAPS 32768
+
+//Frequency shift and rational decimation by L/M in a single pass, for the demodulator input:
+//a polyphase FIR whose prototype taps are rotated by the shift frequency, so that the mix is
+//folded into the taps and only a phasor is applied, at the output rate.
+//The input is read in place and the output written where asked, without intermediate buffers.
+//Lowpass up to 40% of the output rate, stopband from 60% of it, so that only the transition band
+//gets aliased, as the filter chain of msresamp_crcf it replaces when the ratio allows.
+class TranslatingDecimator {
+public:
+    //outputRate / inputRate reduced to interpolation / decimation, false when it is not a decimation
+    //or does not reduce to a filter small enough for this decimator.
+    static bool getRatio(long long inputRate, long long outputRate, float attenuation, int& interpolation, int& decimation);
+
+    //attenuation: stopband attenuation, in dB.
+    TranslatingDecimator(int interpolation, int decimation, float attenuation);
+    ~TranslatingDecimator();
+
+    int getInterpolation();
+    int getDecimation();
+    //taps of each polyphase branch, i.e. input samples of history.
+    size_t getBranchLength();
+
+    //Shift the input by -shift, in cycles per input sample: the taps are rotated again,
+    //the output phase stays continuous.
+    void setShift(double shift);
+
+    //Clear the filter history, e.g. after an input discontinuity.
+    void reset();
+
+    //Output samples execute() writes at most for numSamples input samples.
+    size_t getMaxOutput(size_t numSamples);
+
+    //Shift and decimate numSamples input samples, returns the number of samples written to out.
+    size_t execute(const liquid_float_complex *in, size_t numSamples, liquid_float_complex *out);
+
+    CPUFeatures::SIMDLevel getSIMDLevel();
+
+    //Complex dot product of numTaps interleaved samples x with the taps (re, re) pairs a and (im, im) pairs b,
+    //written to y as one complex sample.
+    typedef void (*DotKernel)(const float *x, const float *a, const float *b, size_t numTaps, float *y);
+
+private:
+    void updateTaps();
+
+    int interpolation, decimation;
+    size_t branchLength;
+
+    //real prototype lowpass, interpolation * branchLength taps, shared with the decimators of the same ratio.
+    FilterDesignCache::Taps prototype;
+    //scale of the prototype taps for a unity gain.
+    double prototypeGain;
+
+    //rotated taps of each branch, oldest sample first, as the duplicated real and imaginary parts for the kernel.
+    std::vector<float> tapsRe, tapsIm;
+
+    double shift;
+    liquid_float_complex phasor, rotation;
+    size_t outputCount;
+
+    //the last branchLength - 1 input samples, then room for as many new ones,
+    //from which the outputs whose window starts before the new input are computed.
+    std::vector<liquid_float_complex> history;
+
+    //newest input sample of the next output window, from the start of the next input,
+    //and its branch.
+    size_t nextInput;
+    int nextBranch;
+
+    CPUFeatures::SIMDLevel simdLevel;
+    DotKernel dotKernel;
+};
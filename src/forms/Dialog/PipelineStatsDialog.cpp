@@ -0,0 +1,77 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "PipelineStatsDialog.h"
+#include <wx/sizer.h>
+#include <wx/filedlg.h>
+#include <wx/msgdlg.h>
+#include <sstream>
+
+#define PIPELINE_STATS_REFRESH_MS 1000
+
+PipelineStatsDialog::PipelineStatsDialog(wxWindow* parent, wxWindowID id, const wxString& title, const wxPoint& pos, const wxSize& size, long style)
+    : wxDialog(parent, id, title, pos, size, style), m_timer(this) {
+
+    wxBoxSizer *mainSizer = new wxBoxSizer(wxVERTICAL);
+
+    m_report = new wxTextCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxTE_MULTILINE | wxTE_READONLY | wxTE_DONTWRAP);
+    m_report->SetFont(wxFont(wxNORMAL_FONT->GetPointSize(), wxFONTFAMILY_TELETYPE, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL));
+    mainSizer->Add(m_report, 1, wxALL | wxEXPAND, 5);
+
+    wxBoxSizer *buttonSizer = new wxBoxSizer(wxHORIZONTAL);
+    m_resetButton = new wxButton(this, wxID_ANY, wxT("Reset"));
+    m_saveButton = new wxButton(this, wxID_ANY, wxT("Save..."));
+    buttonSizer->Add(m_resetButton, 0, wxALL, 5);
+    buttonSizer->AddStretchSpacer();
+    buttonSizer->Add(m_saveButton, 0, wxALL, 5);
+    mainSizer->Add(buttonSizer, 0, wxEXPAND, 5);
+
+    SetSizer(mainSizer);
+    Layout();
+
+    m_resetButton->Bind(wxEVT_BUTTON, &PipelineStatsDialog::onReset, this);
+    m_saveButton->Bind(wxEVT_BUTTON, &PipelineStatsDialog::onSave, this);
+    Bind(wxEVT_TIMER, &PipelineStatsDialog::onTimer, this);
+
+    lastSnapshot = PipelineMetrics::getSnapshot();
+    refresh();
+
+    m_timer.Start(PIPELINE_STATS_REFRESH_MS);
+}
+
+PipelineStatsDialog::~PipelineStatsDialog() {
+    m_timer.Stop();
+}
+
+void PipelineStatsDialog::refresh() {
+    PipelineMetrics::Snapshot snapshot = PipelineMetrics::getSnapshot();
+
+    std::ostringstream report;
+    PipelineMetrics::report(report, snapshot, &lastSnapshot);
+
+    lastSnapshot = snapshot;
+
+    m_report->ChangeValue(report.str());
+}
+
+void PipelineStatsDialog::onTimer(wxTimerEvent& /* event */) {
+    refresh();
+}
+
+void PipelineStatsDialog::onReset(wxCommandEvent& /* event */) {
+    PipelineMetrics::reset();
+    lastSnapshot = PipelineMetrics::getSnapshot();
+}
+
+void PipelineStatsDialog::onSave(wxCommandEvent& /* event */) {
+    wxFileDialog saveFileDialog(this, wxT("Save pipeline statistics"), wxEmptyString, wxT("pipeline-stats.txt"),
+                                wxT("Text files (*.txt)|*.txt"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+
+    if (saveFileDialog.ShowModal() == wxID_CANCEL) {
+        return;
+    }
+
+    if (!PipelineMetrics::dumpToFile(saveFileDialog.GetPath().ToStdString())) {
+        wxMessageBox(wxT("Cannot write ") + saveFileDialog.GetPath(), wxT("Pipeline Statistics"), wxOK | wxICON_ERROR, this);
+    }
+}
@@ -0,0 +1,33 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <wx/dialog.h>
+#include <wx/textctrl.h>
+#include <wx/button.h>
+#include <wx/timer.h>
+#include "PipelineMetrics.h"
+
+//Live view of the PipelineMetrics, refreshed every second, which can be reset or saved to a file.
+class PipelineStatsDialog : public wxDialog {
+public:
+    PipelineStatsDialog(wxWindow* parent, wxWindowID id = wxID_ANY, const wxString& title = wxT("Pipeline Statistics"),
+                        const wxPoint& pos = wxDefaultPosition, const wxSize& size = wxSize(720, 560),
+                        long style = wxDEFAULT_DIALOG_STYLE | wxRESIZE_BORDER);
+    ~PipelineStatsDialog();
+
+private:
+    void refresh();
+
+    void onTimer(wxTimerEvent& event);
+    void onReset(wxCommandEvent& event);
+    void onSave(wxCommandEvent& event);
+
+    wxTextCtrl *m_report;
+    wxButton *m_resetButton;
+    wxButton *m_saveButton;
+    wxTimer m_timer;
+
+    PipelineMetrics::Snapshot lastSnapshot;
+};
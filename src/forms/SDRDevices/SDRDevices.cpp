@@ -202,6 +202,14 @@ void SDRDevicesDialog::refreshDeviceProperties() {
         devSettings["sample_rate"] = addArgInfoProperty(m_propertyGrid, sampleRateArg);
         deviceArgs["sample_rate"] = sampleRateArg;
 
+        //A-5) Native stream format (CS16 / CS8) converted by CubicSDR, instead of CF32 converted by the driver.
+        //Applied on the next device start.
+        devSettings["native_stream_format"] = m_propertyGrid->Append( new wxBoolProperty("Native Stream Format", wxPG_LABEL, devConfig->getNativeStreamFormat()) );
+
+        //A-6) DC offset removal in the sample conversion, for devices without hardware DC correction.
+        //Applied on the next device start.
+        devSettings["dc_removal"] = m_propertyGrid->Append( new wxBoolProperty("DC Removal", wxPG_LABEL, devConfig->getDCRemoval()) );
+
         
 
         //B) Runtime Settings:
@@ -554,6 +562,14 @@ void SDRDevicesDialog::OnPropGridChanged( wxPropertyGridEvent& event ) {
         } catch (std::invalid_argument e) {
             // nop
         }
+    } else if (dev && event.GetProperty() == devSettings["native_stream_format"]) {
+        DeviceConfig *devConfig = wxGetApp().getConfig()->getDevice(dev->getDeviceId());
+
+        devConfig->setNativeStreamFormat(event.GetPropertyValue().GetBool());
+    } else if (dev && event.GetProperty() == devSettings["dc_removal"]) {
+        DeviceConfig *devConfig = wxGetApp().getConfig()->getDevice(dev->getDeviceId());
+
+        devConfig->setDCRemoval(event.GetPropertyValue().GetBool());
     } else if (dev && event.GetProperty() == devSettings["antenna"]) {
         DeviceConfig *devConfig = wxGetApp().getConfig()->getDevice(dev->getDeviceId());
 
@@ -0,0 +1,357 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "FMStereoDecoder.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+//nominal pilot frequency, and how far the loop may pull away from it, in Hz.
+#define FM_STEREO_PILOT_FREQUENCY 19000.0
+#define FM_STEREO_PILOT_RANGE 50.0
+
+//natural frequency, in Hz, and damping of the pilot loop.
+#define FM_STEREO_PILOT_LOOP_BANDWIDTH 10.0
+#define FM_STEREO_PILOT_LOOP_DAMPING 0.707
+//bandwidth of the smoothing of the block sums the loop error is taken from, in Hz.
+#define FM_STEREO_PILOT_SMOOTHING_BANDWIDTH 100.0
+
+//audio passband edge and stopband start, in Hz, at most 40% and 50% of the audio rate.
+#define FM_STEREO_AUDIO_PASSBAND 15000.0
+#define FM_STEREO_AUDIO_STOPBAND 19000.0
+
+//gain of the left / right matrix.
+#define FM_STEREO_MATRIX_GAIN 0.568f
+
+//cosine table of the pilot and subcarrier, 2^FM_STEREO_TABLE_BITS entries over a turn.
+#define FM_STEREO_TABLE_BITS 12
+#define FM_STEREO_TABLE_SIZE (1 << FM_STEREO_TABLE_BITS)
+#define FM_STEREO_TABLE_SHIFT (32 - FM_STEREO_TABLE_BITS)
+
+//a full turn of the phase accumulator.
+#define FM_STEREO_TURN 4294967296.0
+
+static const float *getCosineTable() {
+    static const std::vector<float> table = []() {
+        std::vector<float> t(FM_STEREO_TABLE_SIZE);
+
+        for (int i = 0; i < FM_STEREO_TABLE_SIZE; i++) {
+            t[i] = (float)cos(2.0 * M_PI * (double)i / (double)FM_STEREO_TABLE_SIZE);
+        }
+        return t;
+    }();
+
+    return &table[0];
+}
+
+//table entry nearest to a phase, wrapping around.
+static inline uint32_t tableIndex(uint32_t phase) {
+    return (uint32_t)(phase + (1u << (FM_STEREO_TABLE_SHIFT - 1))) >> FM_STEREO_TABLE_SHIFT;
+}
+
+// y = (sum a[2k] * l[k], sum a[2k + 1] * r[k], sum b[2k] * l[k], sum b[2k + 1] * r[k]),
+// on (l, r) frames as interleaved floats.
+// Plain C++ version, also used for the tails of the vectorized ones.
+static void dotGeneric(const float *x, const float *a, const float *b, size_t numTaps, float *y) {
+    float la = 0, ra = 0, lb = 0, rb = 0;
+
+    for (size_t k = 0; k < numTaps; k++) {
+        float l = x[2 * k], r = x[2 * k + 1];
+
+        la += a[2 * k] * l;
+        ra += a[2 * k + 1] * r;
+        lb += b[2 * k] * l;
+        rb += b[2 * k + 1] * r;
+    }
+
+    y[0] = la;
+    y[1] = ra;
+    y[2] = lb;
+    y[3] = rb;
+}
+
+#if CUBICSDR_SIMD_X86
+//2 frames at a time, the (l, r) sums of both halves added at the end.
+CUBICSDR_TARGET_SSE2 static void dotSSE2(const float *x, const float *a, const float *b, size_t numTaps, float *y) {
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    size_t k = 0;
+
+    for (; k + 2 <= numTaps; k += 2) {
+        __m128 v = _mm_loadu_ps(x + 2 * k);
+
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + 2 * k), v));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(b + 2 * k), v));
+    }
+
+    acc1 = _mm_add_ps(acc1, _mm_movehl_ps(acc1, acc1));
+    acc2 = _mm_add_ps(acc2, _mm_movehl_ps(acc2, acc2));
+
+    float s1[4], s2[4], tail[4];
+    _mm_storeu_ps(s1, acc1);
+    _mm_storeu_ps(s2, acc2);
+
+    dotGeneric(x + 2 * k, a + 2 * k, b + 2 * k, numTaps - k, tail);
+
+    y[0] = s1[0] + tail[0];
+    y[1] = s1[1] + tail[1];
+    y[2] = s2[0] + tail[2];
+    y[3] = s2[1] + tail[3];
+}
+
+//4 frames at a time.
+CUBICSDR_TARGET_AVX2 static void dotAVX2(const float *x, const float *a, const float *b, size_t numTaps, float *y) {
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    size_t k = 0;
+
+    for (; k + 4 <= numTaps; k += 4) {
+        __m256 v = _mm256_loadu_ps(x + 2 * k);
+
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + 2 * k), v, acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(b + 2 * k), v, acc2);
+    }
+
+    __m128 sum1 = _mm_add_ps(_mm256_castps256_ps128(acc1), _mm256_extractf128_ps(acc1, 1));
+    __m128 sum2 = _mm_add_ps(_mm256_castps256_ps128(acc2), _mm256_extractf128_ps(acc2, 1));
+
+    sum1 = _mm_add_ps(sum1, _mm_movehl_ps(sum1, sum1));
+    sum2 = _mm_add_ps(sum2, _mm_movehl_ps(sum2, sum2));
+
+    float s1[4], s2[4], tail[4];
+    _mm_storeu_ps(s1, sum1);
+    _mm_storeu_ps(s2, sum2);
+
+    dotGeneric(x + 2 * k, a + 2 * k, b + 2 * k, numTaps - k, tail);
+
+    y[0] = s1[0] + tail[0];
+    y[1] = s1[1] + tail[1];
+    y[2] = s2[0] + tail[2];
+    y[3] = s2[1] + tail[3];
+}
+#endif
+
+#if CUBICSDR_SIMD_NEON
+//2 frames at a time.
+static void dotNEON(const float *x, const float *a, const float *b, size_t numTaps, float *y) {
+    float32x4_t acc1 = vdupq_n_f32(0);
+    float32x4_t acc2 = vdupq_n_f32(0);
+    size_t k = 0;
+
+    for (; k + 2 <= numTaps; k += 2) {
+        float32x4_t v = vld1q_f32(x + 2 * k);
+
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + 2 * k), v);
+        acc2 = vmlaq_f32(acc2, vld1q_f32(b + 2 * k), v);
+    }
+
+    float32x2_t sum1 = vadd_f32(vget_low_f32(acc1), vget_high_f32(acc1));
+    float32x2_t sum2 = vadd_f32(vget_low_f32(acc2), vget_high_f32(acc2));
+
+    float tail[4];
+    dotGeneric(x + 2 * k, a + 2 * k, b + 2 * k, numTaps - k, tail);
+
+    y[0] = vget_lane_f32(sum1, 0) + tail[0];
+    y[1] = vget_lane_f32(sum1, 1) + tail[1];
+    y[2] = vget_lane_f32(sum2, 0) + tail[2];
+    y[3] = vget_lane_f32(sum2, 1) + tail[3];
+}
+#endif
+
+FMStereoDecoder::FMStereoDecoder(long long sampleRate_in, int audioSampleRate_in, float attenuation) :
+    sampleRate(sampleRate_in), audioSampleRate(audioSampleRate_in) {
+
+    double rate = (double)sampleRate;
+
+    //loop gains per update, the natural frequency being that many radians per block.
+    double naturalFrequency = 2.0 * M_PI * FM_STEREO_PILOT_LOOP_BANDWIDTH * FM_STEREO_DECODER_PILOT_BLOCK / rate;
+
+    loopPhaseGain = 2.0 * FM_STEREO_PILOT_LOOP_DAMPING * naturalFrequency;
+    loopFrequencyGain = naturalFrequency * naturalFrequency;
+    pilotSmoothing = (float)(1.0 - exp(-2.0 * M_PI * FM_STEREO_PILOT_SMOOTHING_BANDWIDTH * FM_STEREO_DECODER_PILOT_BLOCK / rate));
+
+    // Audio lowpass, with the taps of FM_STEREO_DECODER_BRANCHES branches of the prototype at the upsampled rate
+    // and their ends at zero, so that the branch after the last one is the first one a sample later.
+    double passband = std::min(FM_STEREO_AUDIO_PASSBAND, 0.4 * audioSampleRate);
+    double stopband = std::min(FM_STEREO_AUDIO_STOPBAND, 0.5 * audioSampleRate);
+
+    branchLength = estimate_req_filter_len((float)((stopband - passband) / rate), attenuation) + 1;
+
+    size_t numBranches = FM_STEREO_DECODER_BRANCHES;
+    size_t length = numBranches * branchLength;
+    float cutoff = (float)((passband + stopband) / (2.0 * rate * numBranches));
+
+    prototype = FilterDesignCache::getKaiserLowpass((unsigned int)(length - 1), cutoff, attenuation, 0.0f);
+
+    //unity gain at DC for each branch.
+    double sum = 0;
+    for (float h : *prototype) {
+        sum += h;
+    }
+    double gain = numBranches / sum;
+
+    taps.resize(2 * (numBranches + 1) * branchLength);
+
+    for (size_t p = 0; p <= numBranches; p++) {
+        for (size_t j = 0; j < branchLength; j++) {
+            //branch p applies h[p + k P] to the k-th newest sample of the window, h[0] and h[P * length] being 0.
+            size_t k = p + (branchLength - 1 - j) * numBranches;
+            float h = (k > 0 && k < length) ? (float)((*prototype)[k - 1] * gain) : 0.0f;
+            size_t dst = 2 * (p * branchLength + j);
+
+            taps[dst] = taps[dst + 1] = h;
+        }
+    }
+
+    step = rate / (double)audioSampleRate;
+
+    simdLevel = CPUFeatures::getSIMDLevel();
+
+    switch (simdLevel) {
+#if CUBICSDR_SIMD_X86
+        case CPUFeatures::SIMD_AVX2:
+            dotKernel = &dotAVX2;
+            break;
+        case CPUFeatures::SIMD_SSE2:
+            dotKernel = &dotSSE2;
+            break;
+#endif
+#if CUBICSDR_SIMD_NEON
+        case CPUFeatures::SIMD_NEON:
+            dotKernel = &dotNEON;
+            break;
+#endif
+        default:
+            simdLevel = CPUFeatures::SIMD_NONE;
+            dotKernel = &dotGeneric;
+            break;
+    }
+
+    reset();
+}
+
+void FMStereoDecoder::reset() {
+    pilotPhase = 0;
+    pilotFrequency = FM_STEREO_PILOT_FREQUENCY * FM_STEREO_TURN / (double)sampleRate;
+    pilotSumRe = pilotSumIm = 0;
+    pilotRe = pilotIm = 0;
+    pilotBlockFill = 0;
+
+    frames.assign(2 * (branchLength - 1), 0);
+    nextTime = 0;
+}
+
+size_t FMStereoDecoder::getMaxOutput(size_t numSamples) {
+    return (size_t)ceil((double)numSamples / step) + 1;
+}
+
+double FMStereoDecoder::getPilotFrequency() {
+    return pilotFrequency * (double)sampleRate / FM_STEREO_TURN;
+}
+
+CPUFeatures::SIMDLevel FMStereoDecoder::getSIMDLevel() {
+    return simdLevel;
+}
+
+// The block sum of the multiplex mixed by exp(-j phase) is the pilot at its phase error, the rest of
+// the multiplex at 4 kHz and more from DC; smoothed over the blocks, its angle is the loop error.
+void FMStereoDecoder::updatePilotLoop() {
+    pilotRe += pilotSmoothing * (pilotSumRe - pilotRe);
+    pilotIm += pilotSmoothing * (pilotSumIm - pilotIm);
+
+    pilotSumRe = pilotSumIm = 0;
+    pilotBlockFill = 0;
+
+    if (pilotRe == 0 && pilotIm == 0) {
+        return;
+    }
+
+    double error = atan2(pilotIm, pilotRe) * FM_STEREO_TURN / (2.0 * M_PI);
+    double nominal = FM_STEREO_PILOT_FREQUENCY * FM_STEREO_TURN / (double)sampleRate;
+    double range = FM_STEREO_PILOT_RANGE * FM_STEREO_TURN / (double)sampleRate;
+
+    pilotPhase += (uint32_t)(int64_t)llround(loopPhaseGain * error);
+    pilotFrequency += loopFrequencyGain * error / FM_STEREO_DECODER_PILOT_BLOCK;
+    pilotFrequency = std::min(std::max(pilotFrequency, nominal - range), nominal + range);
+}
+
+size_t FMStereoDecoder::decode(const float *in, size_t numSamples, float *out) {
+    size_t numHistory = branchLength - 1;
+    const float *table = getCosineTable();
+
+    frames.resize(2 * (numHistory + numSamples));
+    float *matrixed = &frames[2 * numHistory];
+
+    // Pilot loop and stereo demodulation, one loop block at a time: the pilot phase runs in the accumulator.
+    // The pilot is sin(w t) and the subcarrier sin(2 w t): with the pilot locked as cos(phase), the subcarrier
+    // is -sin(2 phase), i.e. cos(2 phase) a quarter turn later, and the difference signal 2 x sin(2 w t) once lowpassed.
+    size_t i = 0;
+
+    while (i < numSamples) {
+        size_t len = std::min((size_t)FM_STEREO_DECODER_PILOT_BLOCK - pilotBlockFill, numSamples - i);
+        uint32_t phase = pilotPhase;
+        uint32_t increment = (uint32_t)llround(pilotFrequency);
+        float sumRe = pilotSumRe, sumIm = pilotSumIm;
+
+        for (size_t k = i; k < i + len; k++) {
+            float x = in[k];
+            uint32_t index = tableIndex(phase);
+
+            //sin is the cosine a quarter turn earlier.
+            sumRe += x * table[index];
+            sumIm -= x * table[(index - FM_STEREO_TABLE_SIZE / 4) & (FM_STEREO_TABLE_SIZE - 1)];
+
+            float difference = 2.0f * x * table[(tableIndex(phase * 2) + FM_STEREO_TABLE_SIZE / 4) & (FM_STEREO_TABLE_SIZE - 1)];
+
+            //left is (L + R) + (L - R), right (L + R) - (L - R).
+            matrixed[2 * k] = FM_STEREO_MATRIX_GAIN * (x + difference);
+            matrixed[2 * k + 1] = FM_STEREO_MATRIX_GAIN * (x - difference);
+
+            phase += increment;
+        }
+
+        pilotPhase = phase;
+        pilotSumRe = sumRe;
+        pilotSumIm = sumIm;
+        pilotBlockFill += len;
+        i += len;
+
+        if (pilotBlockFill == FM_STEREO_DECODER_PILOT_BLOCK) {
+            updatePilotLoop();
+        }
+    }
+
+    // Both channels through the same polyphase lowpass, at fractional positions: the taps are
+    // interpolated between the two branches around each output.
+    size_t numOut = 0;
+    size_t tapsPerBranch = 2 * branchLength;
+
+    while (nextTime < (double)numSamples) {
+        size_t n = (size_t)nextTime;
+        double position = (nextTime - (double)n) * FM_STEREO_DECODER_BRANCHES;
+        size_t branch = std::min((size_t)position, (size_t)FM_STEREO_DECODER_BRANCHES - 1);
+        float frac = (float)(position - (double)branch);
+        float y[4];
+
+        //window of the branchLength frames up to n, the history being numHistory frames before the input.
+        dotKernel(&frames[2 * n], &taps[branch * tapsPerBranch], &taps[(branch + 1) * tapsPerBranch], branchLength, y);
+
+        out[2 * numOut] = y[0] + frac * (y[2] - y[0]);
+        out[2 * numOut + 1] = y[1] + frac * (y[3] - y[1]);
+        numOut++;
+
+        nextTime += step;
+    }
+
+    nextTime -= (double)numSamples;
+
+    //keep the last numHistory frames.
+    memmove(&frames[0], &frames[2 * numSamples], 2 * numHistory * sizeof(float));
+    frames.resize(2 * numHistory);
+
+    return numOut;
+}
@@ -0,0 +1,85 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "liquid/liquid.h"
+#include "CPUFeatures.h"
+#include "FilterDesignCache.h"
+
+//Multiplex samples between two updates of the pilot loop.
+#define FM_STEREO_DECODER_PILOT_BLOCK 32
+//Polyphase branches of the audio resampler, the taps in between being linearly interpolated.
+#define FM_STEREO_DECODER_BRANCHES 32
+
+//Stereo decoder of the FM broadcast multiplex, on whole buffers of the demodulated FM:
+//- the 19 kHz pilot is tracked by a PLL updated once per FM_STEREO_DECODER_PILOT_BLOCK samples,
+//  from the pilot mixed to DC and summed over the block,
+//- the 38 kHz subcarrier, sin(2 w t) of a sin(w t) pilot, is regenerated from a cosine table at twice
+//  the pilot phase, and the difference signal demodulated by a plain product,
+//- left and right are matrixed at the multiplex rate and resampled to the audio rate together,
+//  by one polyphase lowpass whose stopband starts at the pilot, so that the pilot, the subcarrier
+//  images and the RDS are all removed by it.
+class FMStereoDecoder {
+public:
+    //attenuation: stopband attenuation of the resampler, in dB.
+    FMStereoDecoder(long long sampleRate, int audioSampleRate, float attenuation);
+
+    //Clear the filter history and restart the pilot acquisition.
+    void reset();
+
+    //Audio frames decode() writes at most for numSamples multiplex samples.
+    size_t getMaxOutput(size_t numSamples);
+
+    //Decode numSamples samples of the FM multiplex, writing interleaved left / right frames at the
+    //audio rate to out. Returns the number of frames written.
+    size_t decode(const float *in, size_t numSamples, float *out);
+
+    //Tracked pilot frequency, in Hz.
+    double getPilotFrequency();
+
+    CPUFeatures::SIMDLevel getSIMDLevel();
+
+    //Dot products of numTaps interleaved (left, right) frames x with the taps a and b, each tap held twice:
+    //y[0], y[1] the left and right sums with a, y[2], y[3] with b.
+    typedef void (*DotKernel)(const float *x, const float *a, const float *b, size_t numTaps, float *y);
+
+private:
+    void updatePilotLoop();
+
+    long long sampleRate;
+    int audioSampleRate;
+
+    //pilot phase, a full turn being 2^32, and frequency in the same unit per sample.
+    uint32_t pilotPhase;
+    double pilotFrequency;
+    //pilot mixed to DC, summed over the current block, and smoothed over the blocks.
+    float pilotSumRe, pilotSumIm;
+    float pilotRe, pilotIm;
+    size_t pilotBlockFill;
+
+    //loop gains, per update, and pole of the smoothing.
+    double loopPhaseGain, loopFrequencyGain;
+    float pilotSmoothing;
+
+    //taps per branch, i.e. multiplex samples of history.
+    size_t branchLength;
+    //real prototype lowpass, shared with the decoders of the same rates.
+    FilterDesignCache::Taps prototype;
+    //taps of the FM_STEREO_DECODER_BRANCHES + 1 branches, oldest sample first, each tap duplicated for the kernel.
+    std::vector<float> taps;
+
+    //multiplex samples per audio frame.
+    double step;
+    //multiplex time of the next output, from the start of the next input.
+    double nextTime;
+
+    //the last branchLength - 1 matrixed frames, followed by the frames of the current input.
+    std::vector<float> frames;
+
+    CPUFeatures::SIMDLevel simdLevel;
+    DotKernel dotKernel;
+};
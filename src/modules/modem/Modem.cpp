@@ -2,8 +2,6 @@
 // SPDX-License-Identifier: GPL-2.0+
 
 #include "Modem.h"
-#include "CubicSDR.h"
-
 
 ModemFactoryList Modem::modemFactories;
 DefaultRatesList Modem::modemDefaultRates;
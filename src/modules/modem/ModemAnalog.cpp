@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: GPL-2.0+
 
 #include "ModemAnalog.h"
+#include "FilterDesignCache.h"
 
 ModemAnalog::ModemAnalog() : Modem(), aOutputCeil(1), aOutputCeilMA(1), aOutputCeilMAA(1) {
     
@@ -27,7 +28,7 @@ ModemKit *ModemAnalog::buildKit(long long sampleRate, int audioSampleRate) {
     akit->sampleRate = sampleRate;
     akit->audioSampleRate = audioSampleRate;
     akit->audioResampleRatio = double(audioSampleRate) / double(sampleRate);
-    akit->audioResampler = msresamp_rrrf_create((float)akit->audioResampleRatio, As);
+    akit->audioResampler = FilterDesignCache::createResamplerRRRF((float)akit->audioResampleRatio, As);
     
     return akit;
 }
@@ -35,7 +36,7 @@ ModemKit *ModemAnalog::buildKit(long long sampleRate, int audioSampleRate) {
 void ModemAnalog::disposeKit(ModemKit *kit) {
     ModemKitAnalog *akit = (ModemKitAnalog *)kit;
     
-    msresamp_rrrf_destroy(akit->audioResampler);
+    FilterDesignCache::releaseResampler(akit->audioResampler);
     delete akit;
 }
 
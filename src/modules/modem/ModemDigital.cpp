@@ -67,6 +67,33 @@ void ModemDigital::digitalStart(ModemKitDigital * /* kit */, modem /* mod */, Mo
     }
 }
 
+void ModemDigital::demodulateSymbols(modem mod, ModemIQData *input) {
+    size_t bufSize = input->data.size();
+
+    if (!bufSize) {
+        return;
+    }
+
+    auto slicer = slicers.find(mod);
+
+    if (slicer == slicers.end()) {
+        std::unique_ptr<SymbolSlicer> made(SymbolSlicer::isSupported(mod) ? new SymbolSlicer(mod) : nullptr);
+        slicer = slicers.insert(std::make_pair(mod, std::move(made))).first;
+    }
+
+    if (!slicer->second) {
+        for (size_t i = 0; i < bufSize; i++) {
+            modem_demodulate(mod, input->data[i], &demodOutputDataDigital[i]);
+        }
+        return;
+    }
+
+    slicer->second->slice(&input->data[0], bufSize, &demodOutputDataDigital[0]);
+
+    //the last sample through mod as well, for its error vector used by updateDemodulatorLock().
+    modem_demodulate(mod, input->data[bufSize - 1], &demodOutputDataDigital[bufSize - 1]);
+}
+
 void ModemDigital::digitalFinish(ModemKitDigital * /* kit */, modem /* mod */) {
 #if ENABLE_DIGITAL_LAB
     if (digitalOut && outStream.str().length()) {
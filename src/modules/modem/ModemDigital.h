@@ -3,7 +3,9 @@
 
 #pragma once
 #include "Modem.h"
+#include "SymbolSlicer.h"
 #include <map>
+#include <memory>
 #include <vector>
 #include <sstream>
 #include <ostream>
@@ -45,6 +47,10 @@ public:
     virtual void digitalStart(ModemKitDigital *kit, modem mod, ModemIQData *input);
     virtual void digitalFinish(ModemKitDigital *kit, modem mod);
 
+    //Hard decisions of mod for the whole input, into demodOutputDataDigital:
+    //by a SymbolSlicer when it decides as mod does, else one sample at a time.
+    void demodulateSymbols(modem mod, ModemIQData *input);
+
     virtual void setDemodulatorLock(bool demod_lock_in);
     virtual int getDemodulatorLock();
     
@@ -56,6 +62,8 @@ public:
     
 protected:
     std::vector<unsigned int> demodOutputDataDigital;
+    //slicer of each constellation used so far.
+    std::map<modem, std::unique_ptr<SymbolSlicer>> slicers;
     std::atomic_bool currentDemodLock;
 #if ENABLE_DIGITAL_LAB
     ModemDigitalOutput *digitalOut;
@@ -0,0 +1,392 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "ModemKernels.h"
+#include <cmath>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+//pole of the AM DC blocker, y[n] = x[n] - x[n - 1] + pole * y[n - 1].
+#define AM_DC_BLOCKER_POLE 0.995f
+
+//stop-band attenuation of the Hilbert transformer window, in dB.
+#define SSB_HILBERT_ATTENUATION 60.0f
+
+//natural frequency, in radians per sample, and damping of the DSB carrier loop.
+#define DSB_LOOP_NATURAL_FREQUENCY 0.01
+#define DSB_LOOP_DAMPING 0.707
+//DSB frequency acquisition: fraction of the measured frequency error corrected at each update, and samples
+//summed before comparing phases, which bounds the measurable error to a quarter of the sample rate over that.
+#define DSB_FLL_GAIN 0.05
+#define DSB_FLL_SUM 2
+//averaging of the DSB lock level over the blocks, and the level under which the frequency acquisition runs.
+#define DSB_LOCK_AVERAGING 0.05
+#define DSB_LOCK_THRESHOLD 0.25
+
+// Plain C++ versions, also used for the tails of the vectorized ones.
+static void magnitudeGeneric(const float *x, float *out, size_t numSamples) {
+    for (size_t k = 0; k < numSamples; k++) {
+        out[k] = sqrtf(x[2 * k] * x[2 * k] + x[2 * k + 1] * x[2 * k + 1]);
+    }
+}
+
+static void hilbertGeneric(const float *x, const float *h, size_t numTaps, float *y, size_t numSamples) {
+    for (size_t i = 0; i < numSamples; i++) {
+        float acc = 0;
+
+        for (size_t j = 0; j < numTaps; j++) {
+            acc += h[j] * x[i + 2 * j];
+        }
+        y[i] = acc;
+    }
+}
+
+#if CUBICSDR_SIMD_X86
+CUBICSDR_TARGET_SSE2 static void magnitudeSSE2(const float *x, float *out, size_t numSamples) {
+    size_t k = 0;
+
+    for (; k + 4 <= numSamples; k += 4) {
+        __m128 a = _mm_loadu_ps(x + 2 * k);
+        __m128 b = _mm_loadu_ps(x + 2 * k + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+
+        __m128 p = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_ps(out + k, _mm_sqrt_ps(p));
+    }
+
+    magnitudeGeneric(x + 2 * k, out + k, numSamples - k);
+}
+
+//4 outputs at a time, each tap broadcast against 4 consecutive inputs.
+CUBICSDR_TARGET_SSE2 static void hilbertSSE2(const float *x, const float *h, size_t numTaps, float *y, size_t numSamples) {
+    size_t i = 0;
+
+    for (; i + 4 <= numSamples; i += 4) {
+        __m128 acc = _mm_setzero_ps();
+
+        for (size_t j = 0; j < numTaps; j++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(h[j]), _mm_loadu_ps(x + i + 2 * j)));
+        }
+        _mm_storeu_ps(y + i, acc);
+    }
+
+    hilbertGeneric(x + i, h, numTaps, y + i, numSamples - i);
+}
+
+CUBICSDR_TARGET_AVX2 static void magnitudeAVX2(const float *x, float *out, size_t numSamples) {
+    size_t k = 0;
+
+    for (; k + 8 <= numSamples; k += 8) {
+        __m256 a = _mm256_loadu_ps(x + 2 * k);
+        __m256 b = _mm256_loadu_ps(x + 2 * k + 8);
+        a = _mm256_mul_ps(a, a);
+        b = _mm256_mul_ps(b, b);
+
+        __m256 p = _mm256_add_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        p = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(p), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        _mm256_storeu_ps(out + k, _mm256_sqrt_ps(p));
+    }
+
+    magnitudeGeneric(x + 2 * k, out + k, numSamples - k);
+}
+
+CUBICSDR_TARGET_AVX2 static void hilbertAVX2(const float *x, const float *h, size_t numTaps, float *y, size_t numSamples) {
+    size_t i = 0;
+
+    for (; i + 8 <= numSamples; i += 8) {
+        __m256 acc = _mm256_setzero_ps();
+
+        for (size_t j = 0; j < numTaps; j++) {
+            acc = _mm256_fmadd_ps(_mm256_set1_ps(h[j]), _mm256_loadu_ps(x + i + 2 * j), acc);
+        }
+        _mm256_storeu_ps(y + i, acc);
+    }
+
+    hilbertGeneric(x + i, h, numTaps, y + i, numSamples - i);
+}
+#endif
+
+#if CUBICSDR_SIMD_NEON
+static void magnitudeNEON(const float *x, float *out, size_t numSamples) {
+    size_t k = 0;
+
+#if defined(__aarch64__)
+    for (; k + 4 <= numSamples; k += 4) {
+        float32x4x2_t v = vld2q_f32(x + 2 * k);
+        float32x4_t p = vmulq_f32(v.val[0], v.val[0]);
+
+        p = vmlaq_f32(p, v.val[1], v.val[1]);
+        vst1q_f32(out + k, vsqrtq_f32(p));
+    }
+#endif
+
+    magnitudeGeneric(x + 2 * k, out + k, numSamples - k);
+}
+
+static void hilbertNEON(const float *x, const float *h, size_t numTaps, float *y, size_t numSamples) {
+    size_t i = 0;
+
+    for (; i + 4 <= numSamples; i += 4) {
+        float32x4_t acc = vdupq_n_f32(0);
+
+        for (size_t j = 0; j < numTaps; j++) {
+            acc = vmlaq_n_f32(acc, vld1q_f32(x + i + 2 * j), h[j]);
+        }
+        vst1q_f32(y + i, acc);
+    }
+
+    hilbertGeneric(x + i, h, numTaps, y + i, numSamples - i);
+}
+#endif
+
+AMDemodulator::AMDemodulator() {
+    simdLevel = CPUFeatures::getSIMDLevel();
+
+    switch (simdLevel) {
+#if CUBICSDR_SIMD_X86
+        case CPUFeatures::SIMD_AVX2:
+            magnitudeKernel = &magnitudeAVX2;
+            break;
+        case CPUFeatures::SIMD_SSE2:
+            magnitudeKernel = &magnitudeSSE2;
+            break;
+#endif
+#if CUBICSDR_SIMD_NEON
+        case CPUFeatures::SIMD_NEON:
+            magnitudeKernel = &magnitudeNEON;
+            break;
+#endif
+        default:
+            simdLevel = CPUFeatures::SIMD_NONE;
+            magnitudeKernel = &magnitudeGeneric;
+            break;
+    }
+
+    reset();
+}
+
+void AMDemodulator::reset() {
+    dcIn = dcOut = 0;
+}
+
+CPUFeatures::SIMDLevel AMDemodulator::getSIMDLevel() {
+    return simdLevel;
+}
+
+void AMDemodulator::demodulate(const liquid_float_complex *in, size_t numSamples, float *out) {
+    magnitudeKernel((const float *)in, out, numSamples);
+
+    float x1 = dcIn, y1 = dcOut;
+
+    for (size_t i = 0; i < numSamples; i++) {
+        float x = out[i];
+
+        y1 = x - x1 + AM_DC_BLOCKER_POLE * y1;
+        x1 = x;
+        out[i] = y1;
+    }
+
+    dcIn = x1;
+    dcOut = y1;
+}
+
+SSBDemodulator::SSBDemodulator(bool upper) : upper(upper) {
+    simdLevel = CPUFeatures::getSIMDLevel();
+
+    switch (simdLevel) {
+#if CUBICSDR_SIMD_X86
+        case CPUFeatures::SIMD_AVX2:
+            hilbertKernel = &hilbertAVX2;
+            break;
+        case CPUFeatures::SIMD_SSE2:
+            hilbertKernel = &hilbertSSE2;
+            break;
+#endif
+#if CUBICSDR_SIMD_NEON
+        case CPUFeatures::SIMD_NEON:
+            hilbertKernel = &hilbertNEON;
+            break;
+#endif
+        default:
+            simdLevel = CPUFeatures::SIMD_NONE;
+            hilbertKernel = &hilbertGeneric;
+            break;
+    }
+
+    // Kaiser windowed ideal Hilbert transformer, h[k] = 2 / (pi k) for odd k, 0 for even k,
+    // -m <= k <= m: with m even, the odd k are at the odd positions of the 2 m + 1 taps window.
+    unsigned int m = MODEM_KERNELS_HILBERT_SEMI_LENGTH;
+    float beta = kaiser_beta_As(SSB_HILBERT_ATTENUATION);
+
+    taps.resize(m);
+
+    for (unsigned int j = 0; j < m; j++) {
+        //sample i + 2 j + 1 of the buffer is k = m - 1 - 2 j samples older than the delayed I.
+        int k = (int)m - 1 - 2 * (int)j;
+        unsigned int n = (unsigned int)(k + (int)m);
+
+        taps[j] = (float)(2.0 / (M_PI * k)) * kaiser(n, 2 * m + 1, beta, 0);
+    }
+
+    reset();
+}
+
+void SSBDemodulator::reset() {
+    size_t history = 2 * MODEM_KERNELS_HILBERT_SEMI_LENGTH;
+
+    inphase.assign(history, 0);
+    quadrature.assign(history, 0);
+}
+
+CPUFeatures::SIMDLevel SSBDemodulator::getSIMDLevel() {
+    return simdLevel;
+}
+
+void SSBDemodulator::demodulate(const liquid_float_complex *in, size_t numSamples, float *out) {
+    size_t m = MODEM_KERNELS_HILBERT_SEMI_LENGTH;
+    size_t history = 2 * m;
+
+    inphase.resize(history + numSamples);
+    quadrature.resize(history + numSamples);
+    transformed.resize(numSamples);
+
+    for (size_t i = 0; i < numSamples; i++) {
+        inphase[history + i] = in[i].real;
+        quadrature[history + i] = in[i].imag;
+    }
+
+    hilbertKernel(&quadrature[1], &taps[0], taps.size(), &transformed[0], numSamples);
+
+    //I delayed by m, the group delay of the transformer.
+    const float *delayed = &inphase[m];
+
+    if (upper) {
+        for (size_t i = 0; i < numSamples; i++) {
+            out[i] = delayed[i] - transformed[i];
+        }
+    } else {
+        for (size_t i = 0; i < numSamples; i++) {
+            out[i] = delayed[i] + transformed[i];
+        }
+    }
+
+    std::copy(inphase.begin() + numSamples, inphase.begin() + numSamples + history, inphase.begin());
+    std::copy(quadrature.begin() + numSamples, quadrature.begin() + numSamples + history, quadrature.begin());
+    inphase.resize(history);
+    quadrature.resize(history);
+}
+
+DSBDemodulator::DSBDemodulator() {
+    reset();
+}
+
+void DSBDemodulator::reset() {
+    phase = 0;
+    frequency = 0;
+    lockLevel = 0;
+}
+
+void DSBDemodulator::demodulate(const liquid_float_complex *in, size_t numSamples, float *out) {
+    const double alpha = 2.0 * DSB_LOOP_DAMPING * DSB_LOOP_NATURAL_FREQUENCY;
+    const double beta = DSB_LOOP_NATURAL_FREQUENCY * DSB_LOOP_NATURAL_FREQUENCY;
+
+    for (size_t start = 0; start < numSamples; start += MODEM_KERNELS_DSB_LOOP_BLOCK) {
+        size_t len = std::min((size_t)MODEM_KERNELS_DSB_LOOP_BLOCK, numSamples - start);
+        const liquid_float_complex *x = in + start;
+        float *y = out + start;
+
+        // 4 interleaved phasors exp(-j (phase + (4 n + l) frequency)), each stepped by exp(-j 4 frequency),
+        // so that the lanes are independent.
+        float stepRe = (float)cos(frequency), stepIm = (float)-sin(frequency);
+        float pr[4], pi[4];
+
+        pr[0] = (float)cos(phase);
+        pi[0] = (float)-sin(phase);
+        for (int l = 1; l < 4; l++) {
+            pr[l] = pr[l - 1] * stepRe - pi[l - 1] * stepIm;
+            pi[l] = pr[l - 1] * stepIm + pi[l - 1] * stepRe;
+        }
+
+        float step2Re = stepRe * stepRe - stepIm * stepIm, step2Im = 2 * stepRe * stepIm;
+        float step4Re = step2Re * step2Re - step2Im * step2Im, step4Im = 2 * step2Re * step2Im;
+
+        //Costas error, sum of I * Q, normalized by the power: sin(2 e) / 2 for a phase error e.
+        float errorSum[4] = { 0, 0, 0, 0 }, powerSum[4] = { 0, 0, 0, 0 };
+        //the mixed samples squared, i.e. the doubled carrier left, m^2 exp(2 j e), for the frequency acquisition.
+        float squaredRe[MODEM_KERNELS_DSB_LOOP_BLOCK], squaredIm[MODEM_KERNELS_DSB_LOOP_BLOCK];
+
+        size_t k = 0;
+        for (; k + 4 <= len; k += 4) {
+            for (int l = 0; l < 4; l++) {
+                float vr = x[k + l].real * pr[l] - x[k + l].imag * pi[l];
+                float vi = x[k + l].real * pi[l] + x[k + l].imag * pr[l];
+
+                y[k + l] = vr;
+                errorSum[l] += vr * vi;
+                powerSum[l] += vr * vr + vi * vi;
+                squaredRe[k + l] = vr * vr - vi * vi;
+                squaredIm[k + l] = 2 * vr * vi;
+
+                float r = pr[l] * step4Re - pi[l] * step4Im;
+                pi[l] = pr[l] * step4Im + pi[l] * step4Re;
+                pr[l] = r;
+            }
+        }
+        for (int l = 0; k < len; k++, l++) {
+            float vr = x[k].real * pr[l] - x[k].imag * pi[l];
+            float vi = x[k].real * pi[l] + x[k].imag * pr[l];
+
+            y[k] = vr;
+            errorSum[l] += vr * vi;
+            powerSum[l] += vr * vr + vi * vi;
+            squaredRe[k] = vr * vr - vi * vi;
+            squaredIm[k] = 2 * vr * vi;
+        }
+
+        float error = errorSum[0] + errorSum[1] + errorSum[2] + errorSum[3];
+        float power = powerSum[0] + powerSum[1] + powerSum[2] + powerSum[3];
+
+        //Frequency acquisition, until locked: the Costas error averages out over a block once the residual
+        //frequency is more than a few tens of Hz, so the residual is also measured directly, as half the phase
+        //step of the doubled carrier between sums of DSB_FLL_SUM samples, weighted by the coherence of the steps.
+        float squaredSum = 0, crossRe = 0, crossIm = 0, sumPower = 0;
+        float prevRe = 0, prevIm = 0;
+
+        for (size_t i = 0; i + DSB_FLL_SUM <= len; i += DSB_FLL_SUM) {
+            float sumRe = 0, sumIm = 0;
+            for (size_t j = i; j < i + DSB_FLL_SUM; j++) {
+                sumRe += squaredRe[j];
+                sumIm += squaredIm[j];
+            }
+            if (i > 0) {
+                crossRe += sumRe * prevRe + sumIm * prevIm;
+                crossIm += sumIm * prevRe - sumRe * prevIm;
+                sumPower += sumRe * sumRe + sumIm * sumIm;
+            }
+            squaredSum += sumRe;
+            prevRe = sumRe;
+            prevIm = sumIm;
+        }
+
+        if (power > 0) {
+            lockLevel += DSB_LOCK_AVERAGING * (squaredSum / power - lockLevel);
+        }
+
+        if (lockLevel < DSB_LOCK_THRESHOLD && sumPower > 0) {
+            double coherence = sqrt((double)crossRe * crossRe + (double)crossIm * crossIm) / sumPower;
+            frequency += DSB_FLL_GAIN * coherence * atan2(crossIm, crossRe) / (2.0 * DSB_FLL_SUM);
+        }
+
+        error = (power > 0) ? (error / power) : 0;
+
+        phase += (double)len * (frequency + alpha * error);
+        frequency += (double)len * beta * error;
+
+        phase = fmod(phase, 2.0 * M_PI);
+    }
+}
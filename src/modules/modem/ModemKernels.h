@@ -0,0 +1,88 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "liquid/liquid.h"
+#include "CPUFeatures.h"
+
+//Taps on each side of the SSB Hilbert transformer, even: 2 * 48 + 1 taps, half of them zero,
+//keeping the opposite side-band 65 dB down from 2% to 48% of the sample rate. Closer to DC the
+//rejection falls off: about 34 dB at 1.5%, 19 dB at 1% and 9 dB at 0.5% of the sample rate.
+#define MODEM_KERNELS_HILBERT_SEMI_LENGTH 48
+
+//Samples between two updates of the DSB carrier loop.
+#define MODEM_KERNELS_DSB_LOOP_BLOCK 32
+
+//Block demodulators of the analog modems, working on whole buffers of the modem input
+//instead of one liquid call per sample. The best kernels for the CPU (SSE2, AVX2, NEON
+//or plain C++) are selected at construction.
+
+//Envelope detector of AM: |x|, without its DC.
+class AMDemodulator {
+public:
+    AMDemodulator();
+
+    void demodulate(const liquid_float_complex *in, size_t numSamples, float *out);
+    void reset();
+
+    CPUFeatures::SIMDLevel getSIMDLevel();
+
+    //out[k] = |x[k]| for numSamples interleaved complex values.
+    typedef void (*MagnitudeKernel)(const float *x, float *out, size_t numSamples);
+
+private:
+    CPUFeatures::SIMDLevel simdLevel;
+    MagnitudeKernel magnitudeKernel;
+
+    //DC blocker state, previous input and output.
+    float dcIn, dcOut;
+};
+
+//Single side-band by the phasing method: the upper side-band is I - H(Q), the lower one I + H(Q),
+//H being a Hilbert transformer and I delayed to match it.
+class SSBDemodulator {
+public:
+    SSBDemodulator(bool upper);
+
+    void demodulate(const liquid_float_complex *in, size_t numSamples, float *out);
+    void reset();
+
+    CPUFeatures::SIMDLevel getSIMDLevel();
+
+    //y[i] = sum_j h[j] * x[i + 2 j], j < numTaps, for i < numSamples.
+    typedef void (*HilbertKernel)(const float *x, const float *h, size_t numTaps, float *y, size_t numSamples);
+
+private:
+    bool upper;
+
+    CPUFeatures::SIMDLevel simdLevel;
+    HilbertKernel hilbertKernel;
+
+    //non-zero taps of the Hilbert transformer, newest sample last.
+    std::vector<float> taps;
+
+    //I and Q, the last 2 * MODEM_KERNELS_HILBERT_SEMI_LENGTH samples of the previous buffer first.
+    std::vector<float> inphase, quadrature;
+    std::vector<float> transformed;
+};
+
+//Coherent double side-band, suppressed carrier: a Costas loop locks on the carrier, updated once
+//per MODEM_KERNELS_DSB_LOOP_BLOCK samples from their averaged phase error, the mix runs on
+//interleaved phasors in between. Until locked, a frequency acquisition on the doubled carrier
+//pulls in offsets the loop alone cannot, up to an eighth of the sample rate.
+class DSBDemodulator {
+public:
+    DSBDemodulator();
+
+    void demodulate(const liquid_float_complex *in, size_t numSamples, float *out);
+    void reset();
+
+private:
+    //carrier phase and frequency estimates, in radians and radians per sample.
+    double phase, frequency;
+    //averaged cos(2 e) for the phase error e, near 1 when locked and the signal is well above the noise.
+    double lockLevel;
+};
@@ -0,0 +1,184 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "SymbolSlicer.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+//grid extent, relative to the largest constellation point.
+#define SYMBOL_SLICER_EXTENT 1.25f
+//cells per constellation point on each axis, and bounds of the grid size.
+#define SYMBOL_SLICER_CELLS_PER_POINT 8
+#define SYMBOL_SLICER_MIN_GRID 16
+#define SYMBOL_SLICER_MAX_GRID 128
+
+bool SymbolSlicer::isSupported(modem mod) {
+    modulation_scheme scheme = modem_get_scheme(mod);
+
+    //differential PSK depends on the previous symbol, APSK and the 'square' QAM decide
+    //by ring or quadrant first, OOK by a threshold.
+    return (scheme >= LIQUID_MODEM_PSK2 && scheme <= LIQUID_MODEM_PSK256) ||
+           (scheme >= LIQUID_MODEM_ASK2 && scheme <= LIQUID_MODEM_ASK256) ||
+           (scheme >= LIQUID_MODEM_QAM4 && scheme <= LIQUID_MODEM_QAM256) ||
+           scheme == LIQUID_MODEM_BPSK || scheme == LIQUID_MODEM_QPSK ||
+           (scheme >= LIQUID_MODEM_V29 && scheme <= LIQUID_MODEM_ARB);
+}
+
+SymbolSlicer::SymbolSlicer(modem mod) {
+    unsigned int numSymbols = 1 << modem_get_bps(mod);
+
+    pointsRe.resize(numSymbols);
+    pointsIm.resize(numSymbols);
+    allSymbols.resize(numSymbols);
+
+    radius = 0;
+    float minRadius = FLT_MAX;
+
+    for (unsigned int s = 0; s < numSymbols; s++) {
+        liquid_float_complex p;
+        modem_modulate(mod, s, &p);
+
+        pointsRe[s] = p.real;
+        pointsIm[s] = p.imag;
+        allSymbols[s] = s;
+
+        float r = sqrtf(p.real * p.real + p.imag * p.imag);
+        radius = std::max(radius, r);
+        minRadius = std::min(minRadius, r);
+    }
+
+    constantModulus = (radius - minRadius) <= radius * 1e-4f;
+
+    if (radius <= 0) {
+        radius = 1;
+    }
+
+    gridSize = SYMBOL_SLICER_CELLS_PER_POINT * (int)ceil(sqrt((double)numSymbols));
+    gridSize = std::min(std::max(gridSize, SYMBOL_SLICER_MIN_GRID), SYMBOL_SLICER_MAX_GRID);
+
+    float extent = radius * SYMBOL_SLICER_EXTENT;
+    float cellSize = 2.0f * extent / (float)gridSize;
+
+    gridMin = -extent;
+    gridScale = 1.0f / cellSize;
+
+    //nearest symbol of each cell corner.
+    int numCorners = gridSize + 1;
+    std::vector<unsigned int> corners(numCorners * numCorners);
+
+    for (int y = 0; y < numCorners; y++) {
+        for (int x = 0; x < numCorners; x++) {
+            corners[y * numCorners + x] = nearest(gridMin + x * cellSize, gridMin + y * cellSize, &allSymbols[0], numSymbols);
+        }
+    }
+
+    //decision regions are convex: a cell whose corners all have the same symbol is within its region.
+    //Otherwise a symbol can only win somewhere in the cell if its distance to the cell is below
+    //the largest distance of the cell to the closest point.
+    cells.resize(gridSize * gridSize);
+    candidates.clear();
+
+    for (int y = 0; y < gridSize; y++) {
+        for (int x = 0; x < gridSize; x++) {
+            unsigned int s = corners[y * numCorners + x];
+
+            if (corners[y * numCorners + x + 1] == s && corners[(y + 1) * numCorners + x] == s && corners[(y + 1) * numCorners + x + 1] == s) {
+                cells[y * gridSize + x] = (int)s;
+                continue;
+            }
+
+            float x0 = gridMin + x * cellSize, x1 = x0 + cellSize;
+            float y0 = gridMin + y * cellSize, y1 = y0 + cellSize;
+            float threshold = FLT_MAX;
+
+            for (unsigned int c = 0; c < numSymbols; c++) {
+                float dx = std::max(fabsf(pointsRe[c] - x0), fabsf(pointsRe[c] - x1));
+                float dy = std::max(fabsf(pointsIm[c] - y0), fabsf(pointsIm[c] - y1));
+                threshold = std::min(threshold, dx * dx + dy * dy);
+            }
+
+            size_t start = candidates.size();
+            candidates.push_back(0);
+
+            for (unsigned int c = 0; c < numSymbols; c++) {
+                float dx = std::max(std::max(x0 - pointsRe[c], pointsRe[c] - x1), 0.0f);
+                float dy = std::max(std::max(y0 - pointsIm[c], pointsIm[c] - y1), 0.0f);
+
+                if (dx * dx + dy * dy <= threshold) {
+                    candidates.push_back(c);
+                }
+            }
+
+            candidates[start] = (unsigned int)(candidates.size() - start - 1);
+            cells[y * gridSize + x] = -1 - (int)start;
+        }
+    }
+}
+
+unsigned int SymbolSlicer::nearest(float re, float im, const unsigned int *symbols, size_t numSymbols) {
+    unsigned int best = symbols[0];
+    float bestDistance = FLT_MAX;
+
+    for (size_t k = 0; k < numSymbols; k++) {
+        unsigned int s = symbols[k];
+        float dx = re - pointsRe[s], dy = im - pointsIm[s];
+        float d = dx * dx + dy * dy;
+
+        if (d < bestDistance) {
+            bestDistance = d;
+            best = s;
+        }
+    }
+
+    return best;
+}
+
+void SymbolSlicer::slice(const liquid_float_complex *in, size_t numSamples, unsigned int *out) {
+    sampleCells.resize(numSamples);
+
+    float size = (float)gridSize;
+
+    //cell of each sample, in one pass without branches to the tables.
+    for (size_t i = 0; i < numSamples; i++) {
+        float re = in[i].real, im = in[i].imag;
+
+        if (constantModulus) {
+            float m = sqrtf(re * re + im * im);
+            float scale = (m > 0) ? (radius / m) : 0;
+            re *= scale;
+            im *= scale;
+        }
+
+        float fx = (re - gridMin) * gridScale;
+        float fy = (im - gridMin) * gridScale;
+        bool inside = (fx >= 0) && (fx < size) && (fy >= 0) && (fy < size);
+
+        sampleCells[i] = inside ? ((int)fy * gridSize + (int)fx) : -1;
+    }
+
+    for (size_t i = 0; i < numSamples; i++) {
+        int cell = sampleCells[i];
+
+        if (cell >= 0 && cells[cell] >= 0) {
+            out[i] = (unsigned int)cells[cell];
+            continue;
+        }
+
+        float re = in[i].real, im = in[i].imag;
+
+        if (constantModulus) {
+            float m = sqrtf(re * re + im * im);
+            float scale = (m > 0) ? (radius / m) : 0;
+            re *= scale;
+            im *= scale;
+        }
+
+        if (cell >= 0) {
+            size_t start = (size_t)(-1 - cells[cell]);
+            out[i] = nearest(re, im, &candidates[start + 1], candidates[start]);
+        } else {
+            out[i] = nearest(re, im, &allSymbols[0], allSymbols.size());
+        }
+    }
+}
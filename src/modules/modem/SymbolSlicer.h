@@ -0,0 +1,44 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "liquid/liquid.h"
+
+//Hard decisions of a liquid modem on whole buffers: the symbol of the nearest constellation point,
+//as modem_demodulate() decides it for the PSK, ASK, QAM and arbitrary constellations.
+//The plane around the constellation is divided into a grid, each cell holding its symbol when the
+//cell is within a single decision region, else the few symbols whose region crosses it.
+//Constellations of constant modulus are sliced on the normalized samples, so that the amplitude
+//of the input does not matter, as in liquid.
+class SymbolSlicer {
+public:
+    //True if the hard decisions of mod are the nearest constellation points.
+    static bool isSupported(modem mod);
+
+    //The constellation is read from mod by modulating each symbol.
+    SymbolSlicer(modem mod);
+
+    void slice(const liquid_float_complex *in, size_t numSamples, unsigned int *out);
+
+private:
+    unsigned int nearest(float re, float im, const unsigned int *symbols, size_t numSymbols);
+
+    std::vector<float> pointsRe, pointsIm;
+    std::vector<unsigned int> allSymbols;
+    bool constantModulus;
+    float radius;
+
+    //grid of gridSize x gridSize cells over [gridMin, -gridMin] on both axes.
+    int gridSize;
+    float gridMin, gridScale;
+
+    //symbol of each cell, or -1 - index in candidates of the cell's count of symbols followed by them.
+    std::vector<int> cells;
+    std::vector<unsigned int> candidates;
+
+    //cell of each sample, -1 when outside of the grid.
+    std::vector<int> sampleCells;
+};
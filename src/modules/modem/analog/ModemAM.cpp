@@ -4,12 +4,10 @@
 #include "ModemAM.h"
 
 ModemAM::ModemAM() : ModemAnalog() {
-    demodAM = ampmodem_create(0.5, LIQUID_AMPMODEM_DSB, 0);
     useSignalOutput(true);
 }
 
 ModemAM::~ModemAM() {
-    ampmodem_destroy(demodAM);
 }
 
 ModemBase *ModemAM::factory() {
@@ -34,9 +32,7 @@ void ModemAM::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput* au
         return;
     }
     
-	for (size_t i = 0; i < bufSize; i++) {
-		ampmodem_demodulate(demodAM, input->data[i], &demodOutputData[i]);
-	}
+    demodAM.demodulate(&input->data[0], bufSize, &demodOutputData[0]);
     
     buildAudioOutput(amkit,audioOut,true);
 }
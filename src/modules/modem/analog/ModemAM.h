@@ -4,6 +4,7 @@
 #pragma once
 #include "Modem.h"
 #include "ModemAnalog.h"
+#include "ModemKernels.h"
 
 class ModemAM : public ModemAnalog {
 public:
@@ -19,5 +20,5 @@ public:
     void demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *audioOut);
     
 private:
-    ampmodem demodAM;
+    AMDemodulator demodAM;
 };
\ No newline at end of file
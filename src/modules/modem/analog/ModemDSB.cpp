@@ -4,12 +4,10 @@
 #include "ModemDSB.h"
 
 ModemDSB::ModemDSB() : ModemAnalog() {
-    demodAM_DSB = ampmodem_create(0.5, LIQUID_AMPMODEM_DSB, 1);
     useSignalOutput(true);
 }
 
 ModemDSB::~ModemDSB() {
-    ampmodem_destroy(demodAM_DSB);
 }
 
 ModemBase *ModemDSB::factory() {
@@ -34,9 +32,7 @@ void ModemDSB::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *a
         return;
     }
     
-	for (size_t i = 0; i < bufSize; i++) {
-		ampmodem_demodulate(demodAM_DSB, input->data[i], &demodOutputData[i]);
-	}
+    demodAM_DSB.demodulate(&input->data[0], bufSize, &demodOutputData[0]);
     
     buildAudioOutput(amkit, audioOut, true);
 }
@@ -4,6 +4,7 @@
 #pragma once
 #include "Modem.h"
 #include "ModemAnalog.h"
+#include "ModemKernels.h"
 
 class ModemDSB : public ModemAnalog {
 public:
@@ -19,5 +20,5 @@ public:
     void demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *audioOut);
     
 private:
-    ampmodem demodAM_DSB;
+    DSBDemodulator demodAM_DSB;
 };
\ No newline at end of file
@@ -3,28 +3,18 @@
 
 #pragma once
 #include "Modem.h"
+#include "FMStereoDecoder.h"
 
 class ModemKitFMStereo: public ModemKit {
 public:
-    ModemKitFMStereo() : audioResampler(nullptr), stereoResampler(nullptr), audioResampleRatio(0), firStereoLeft(nullptr), firStereoRight(nullptr), iirStereoPilot(nullptr) {
+    ModemKitFMStereo() : decoder(nullptr), demph(0), iirDemphR(nullptr), iirDemphL(nullptr) {
     }
     
-    msresamp_rrrf audioResampler;
-    msresamp_rrrf stereoResampler;
-    double audioResampleRatio;
-    
-    firfilt_rrrf firStereoLeft;
-    firfilt_rrrf firStereoRight;
-    iirfilt_crcf iirStereoPilot;
+    FMStereoDecoder *decoder;
 
     int demph;
     iirfilt_rrrf iirDemphR;
     iirfilt_rrrf iirDemphL;
-
-    firhilbf firStereoR2C;
-    firhilbf firStereoC2R;
-    
-    nco_crcf stereoPilot;
 };
 
 
@@ -52,9 +42,6 @@ public:
     
 private:
     std::vector<float> demodOutputData;
-    std::vector<float> demodStereoData;
-    std::vector<float> resampledOutputData;
-    std::vector<float> resampledStereoData;
     freqdem demodFM;
     
     int _demph;
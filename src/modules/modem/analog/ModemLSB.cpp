@@ -3,12 +3,7 @@
 
 #include "ModemLSB.h"
 
-ModemLSB::ModemLSB() : ModemAnalog() {
-    // half band filter used for side-band elimination
-    ssbFilt = iirfilt_crcf_create_lowpass(6, 0.25);
-	ssbShift = nco_crcf_create(LIQUID_NCO);
-    nco_crcf_set_frequency(ssbShift,  (float)((2.0 * M_PI) * 0.25));
-    c2rFilt = firhilbf_create(5, 90.0);
+ModemLSB::ModemLSB() : ModemAnalog(), ssbDemod(false) {
     useSignalOutput(true);
 }
 
@@ -21,9 +16,6 @@ std::string ModemLSB::getName() {
 }
 
 ModemLSB::~ModemLSB() {
-	iirfilt_crcf_destroy(ssbFilt);
-	nco_crcf_destroy(ssbShift);
-    firhilbf_destroy(c2rFilt);
 }
 
 int ModemLSB::checkSampleRate(long long sampleRate, int /* audioSampleRate */) {
@@ -50,15 +42,8 @@ void ModemLSB::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *a
         return;
     }
     
-    liquid_float_complex x, y;
-    for (size_t i = 0; i < bufSize; i++) { // Reject upper band
-        nco_crcf_step(ssbShift);
-        nco_crcf_mix_up(ssbShift, input->data[i], &x);
-		iirfilt_crcf_execute(ssbFilt, x, &y);
-        nco_crcf_mix_down(ssbShift, y, &x);
-        float usb_discard;
-        firhilbf_c2r_execute(c2rFilt, x, &demodOutputData[i], &usb_discard);
-    }
+    // Reject upper band
+    ssbDemod.demodulate(&input->data[0], bufSize, &demodOutputData[0]);
     
     buildAudioOutput(akit, audioOut, true);
 }
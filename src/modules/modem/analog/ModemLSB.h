@@ -3,6 +3,7 @@
 
 #pragma once
 #include "ModemAnalog.h"
+#include "ModemKernels.h"
 
 class ModemLSB : public ModemAnalog {
 public:
@@ -19,7 +20,5 @@ public:
     void demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *audioOut);
     
 private:
-	iirfilt_crcf ssbFilt;
-    firhilbf c2rFilt;
-    nco_crcf ssbShift;
+    SSBDemodulator ssbDemod;
 };
\ No newline at end of file
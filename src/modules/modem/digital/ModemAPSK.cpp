@@ -102,9 +102,7 @@ void ModemAPSK::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *
     
     digitalStart(dkit, demodAPSK, input);
     
-    for (size_t i = 0, bufSize = input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodAPSK, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodAPSK, input);
     
     updateDemodulatorLock(demodAPSK, 0.005f);
     
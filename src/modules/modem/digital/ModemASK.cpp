@@ -107,9 +107,7 @@ void ModemASK::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *
     
     digitalStart(dkit, demodASK, input);
 
-    for (size_t i = 0, bufSize = input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodASK, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodASK, input);
     updateDemodulatorLock(demodASK, 0.005f);
     
     digitalFinish(dkit, demodASK);
@@ -23,9 +23,7 @@ void ModemBPSK::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *
     ModemKitDigital *dkit = (ModemKitDigital *)kit;
     digitalStart(dkit, demodBPSK, input);
 
-    for (size_t i = 0, bufSize=input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodBPSK, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodBPSK, input);
     updateDemodulatorLock(demodBPSK, 0.005f);
     
     digitalFinish(dkit, demodBPSK);
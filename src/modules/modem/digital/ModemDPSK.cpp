@@ -108,9 +108,7 @@ void ModemDPSK::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *
    
     digitalStart(dkit, demodDPSK, input);
  
-    for (size_t i = 0, bufSize = input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodDPSK, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodDPSK, input);
     updateDemodulatorLock(demodDPSK, 0.005f);
     
     digitalFinish(dkit, demodDPSK);
@@ -30,9 +30,7 @@ void ModemOOK::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *
     ModemKitDigital *dkit = (ModemKitDigital *)kit;
     digitalStart(dkit, demodOOK, input);
    
-    for (size_t i = 0, bufSize=input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodOOK, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodOOK, input);
     updateDemodulatorLock(demodOOK, 0.005f);
     
     digitalFinish(dkit, demodOOK);
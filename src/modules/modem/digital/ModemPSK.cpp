@@ -109,9 +109,7 @@ void ModemPSK::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *
 
     digitalStart(dkit, demodPSK, input);
     
-    for (size_t i = 0, bufSize = input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodPSK, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodPSK, input);
     updateDemodulatorLock(demodPSK, 0.005f);
     
     digitalFinish(dkit, demodPSK);
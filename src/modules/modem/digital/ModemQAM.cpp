@@ -101,9 +101,7 @@ void ModemQAM::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *
     ModemKitDigital *dkit = (ModemKitDigital *)kit;
     digitalStart(dkit, demodQAM, input);
    
-    for (size_t i = 0, bufSize = input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodQAM, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodQAM, input);
     updateDemodulatorLock(demodQAM, 0.5f);
     
     digitalFinish(dkit, demodQAM);
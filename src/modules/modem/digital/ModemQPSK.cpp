@@ -23,9 +23,7 @@ void ModemQPSK::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *
     ModemKitDigital *dkit = (ModemKitDigital *)kit;
     digitalStart(dkit, demodQPSK, input);
 
-    for (size_t i = 0, bufSize = input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodQPSK, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodQPSK, input);
     updateDemodulatorLock(demodQPSK, 0.8f);
     
     digitalFinish(dkit, demodQPSK);
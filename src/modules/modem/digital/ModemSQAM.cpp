@@ -72,9 +72,7 @@ void ModemSQAM::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput *
 
     digitalStart(dkit, demodSQAM, input);
     
-    for (size_t i = 0, bufSize = input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodSQAM, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodSQAM, input);
     updateDemodulatorLock(demodSQAM, 0.005f);
     
     digitalFinish(dkit, demodSQAM);
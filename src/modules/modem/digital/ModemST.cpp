@@ -23,9 +23,7 @@ void ModemST::demodulate(ModemKit *kit, ModemIQData *input, AudioThreadInput * /
     ModemKitDigital *dkit = (ModemKitDigital *)kit;
     digitalStart(dkit, demodST, input);
 
-    for (size_t i = 0, bufSize = input->data.size(); i < bufSize; i++) {
-        modem_demodulate(demodST, input->data[i], &demodOutputDataDigital[i]);
-    }
+    demodulateSymbols(demodST, input);
     updateDemodulatorLock(demodST, 0.005f);
     
     digitalFinish(dkit, demodST);
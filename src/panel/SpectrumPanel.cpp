@@ -9,6 +9,7 @@
 #include "CubicSDR.h"
 #include "ColorTheme.h"
 #include "CubicSDRDefs.h"
+#include <algorithm>
 
 SpectrumPanel::SpectrumPanel() {
     floorValue = 0;
@@ -18,6 +19,19 @@ SpectrumPanel::SpectrumPanel() {
     fftSize = DEFAULT_FFT_SIZE;
     bandwidth = DEFAULT_DEMOD_BW;
     freq = 0;
+
+    buffersInitialized = false;
+    lineBuffer = gridBuffer = 0;
+    lineBufferCapacity = gridBufferCapacity = 0;
+    majorTicksFirst = majorTicksCount = minorTicksFirst = minorTicksCount = 0;
+    labelFontSize = 12;
+    labelPos = 0;
+    gridValid = false;
+    gridFloor = gridCeil = gridWidth = gridHeight = 0;
+    gridFontScale = 0;
+    gridFreq = gridBandwidth = 0;
+
+    drawStats = PipelineMetrics::getThreadStats("SpectrumPanel draw");
     
     setFill(GLPANEL_FILL_GRAD_Y);
     setFillColor(ThemeMgr::mgr.currentTheme->fftBackground * 2.0, ThemeMgr::mgr.currentTheme->fftBackground);
@@ -105,83 +119,82 @@ void SpectrumPanel::setPeakPoints(std::vector<float> &points) {
     this->peak_points.assign(points.begin(), points.end());
 }
 
+void SpectrumPanel::setPyramid(SpectrumPyramidPtr pyramid_in) {
+    pyramid = pyramid_in;
+}
 
-void SpectrumPanel::drawPanelContents() {
-    glDisable(GL_TEXTURE_2D);
-    
-    glEnable(GL_BLEND);
-    glEnable(GL_LINE_SMOOTH);
-    glHint( GL_LINE_SMOOTH_HINT, GL_NICEST );
 
-    glLoadMatrixf((transform * (CubicVR::mat4::translate(-1.0f, -0.75f, 0.0f) * CubicVR::mat4::scale(2.0f, 1.5f, 1.0f))).to_ptr());
+void SpectrumPanel::updateGrid(float viewWidth, float viewHeight) {
+    double fontScale = GLFont::getScaleFactor();
 
-    if (points.size()) {
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        double range = ceilValue-floorValue;
-        double ranges[3][4] = { { 90.0, 5000.0, 10.0, 100.0 }, { 20.0, 150.0, 10.0, 10.0 }, { -20.0, 30.0, 10.0, 1.0 } };
-        
-        for (int i = 0; i < 3; i++) {
-            double p = 0;
-            double rangeMin = ranges[i][0];
-            double rangeMax = ranges[i][1];
-            double rangeTrans = ranges[i][2];
-            double rangeStep = ranges[i][3];
-            
-            if (range >= rangeMin && range <= rangeMax) {
-                double a = 1.0;
-                
-                if (range <= rangeMin+rangeTrans) {
-                    a *= (range-rangeMin)/rangeTrans;
-                }
-                if (range >= rangeMax-rangeTrans) {
-                    a *= (rangeTrans-(range-(rangeMax-rangeTrans)))/rangeTrans;
-                }
-                
-                glColor4f(0.12f, 0.12f, 0.12f, a);
-                glBegin(GL_LINES);
-                for (double l = floorValue; l<=ceilValue+rangeStep; l+=rangeStep) {
-                    p += rangeStep/range;
-                    glVertex2f(0,p);  glVertex2f(1,p);
-                }
-                glEnd();
+    if (gridValid && gridFloor == floorValue && gridCeil == ceilValue && gridFreq == freq && gridBandwidth == bandwidth
+        && gridWidth == viewWidth && gridHeight == viewHeight && gridFontScale == fontScale) {
+        return;
+    }
+
+    gridValid = true;
+    gridFloor = floorValue;
+    gridCeil = ceilValue;
+    gridFreq = freq;
+    gridBandwidth = bandwidth;
+    gridWidth = viewWidth;
+    gridHeight = viewHeight;
+    gridFontScale = fontScale;
+
+    gridVertices.clear();
+    gridBands.clear();
+    tickLabels.clear();
+
+    //dB grid lines, in the spectrum coordinates.
+    double range = ceilValue-floorValue;
+    double ranges[3][4] = { { 90.0, 5000.0, 10.0, 100.0 }, { 20.0, 150.0, 10.0, 10.0 }, { -20.0, 30.0, 10.0, 1.0 } };
+
+    for (int i = 0; i < 3; i++) {
+        double p = 0;
+        double rangeMin = ranges[i][0];
+        double rangeMax = ranges[i][1];
+        double rangeTrans = ranges[i][2];
+        double rangeStep = ranges[i][3];
+
+        if (range >= rangeMin && range <= rangeMax) {
+            double a = 1.0;
+
+            if (range <= rangeMin+rangeTrans) {
+                a *= (range-rangeMin)/rangeTrans;
             }
+            if (range >= rangeMax-rangeTrans) {
+                a *= (rangeTrans-(range-(rangeMax-rangeTrans)))/rangeTrans;
+            }
+
+            GridBand band;
+            band.first = (int) gridVertices.size() / 2;
+            band.alpha = (float) a;
+
+            for (double l = floorValue; l<=ceilValue+rangeStep; l+=rangeStep) {
+                p += rangeStep/range;
+                gridVertices.push_back(0);
+                gridVertices.push_back(p);
+                gridVertices.push_back(1);
+                gridVertices.push_back(p);
+            }
+
+            band.count = (int) gridVertices.size() / 2 - band.first;
+            gridBands.push_back(band);
         }
-        
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glColor3f(ThemeMgr::mgr.currentTheme->fftLine.r, ThemeMgr::mgr.currentTheme->fftLine.g, ThemeMgr::mgr.currentTheme->fftLine.b);
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glVertexPointer(2, GL_FLOAT, 0, &points[0]);
-        glDrawArrays(GL_LINE_STRIP, 0, points.size() / 2);
-        if (peak_points.size()) {
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            glColor4f(0, 1.0, 0, 0.5);
-            glVertexPointer(2, GL_FLOAT, 0, &peak_points[0]);
-            glDrawArrays(GL_LINE_STRIP, 0, peak_points.size() / 2);
-        }
-        glDisableClientState(GL_VERTEX_ARRAY);
     }
-  
-    GLint vp[4];
-    glGetIntegerv( GL_VIEWPORT, vp);
-    
-    float viewHeight = (float) vp[3];
-    float viewWidth = (float) vp[2];
-    glLoadMatrixf(transform.to_ptr());
 
-    
+    //frequency ticks, in the panel coordinates.
     long long leftFreq = (double) freq - ((double) bandwidth / 2.0);
     long long rightFreq = leftFreq + (double) bandwidth;
 
     long long hzStep = 1000000;
-    
+
     long double mhzStep = (100000.0 / (long double) (rightFreq - leftFreq)) * 2.0;
     double mhzVisualStep = 0.1;
 
     std::stringstream label;
     label.precision(1);
 
-    double fontScale = GLFont::getScaleFactor();
-
     if (mhzStep * 0.5 * viewWidth < 40 * fontScale) {
         mhzStep = (250000.0 / (long double) (rightFreq - leftFreq)) * 2.0;
         mhzVisualStep = 0.25;
@@ -195,12 +208,12 @@ void SpectrumPanel::drawPanelContents() {
             mhzStep = (1000000.0 / (long double) (rightFreq - leftFreq)) * 2.0;
             mhzVisualStep = 1.0;
         }
-        
+
         if (mhzStep * 0.5 * viewWidth < 40 * fontScale) {
             mhzStep = (2500000.0 / (long double) (rightFreq - leftFreq)) * 2.0;
             mhzVisualStep = 2.5;
         }
-        
+
         if (mhzStep * 0.5 * viewWidth < 40 * fontScale) {
             mhzStep = (5000000.0 / (long double) (rightFreq - leftFreq)) * 2.0;
             mhzVisualStep = 5.0;
@@ -220,24 +233,24 @@ void SpectrumPanel::drawPanelContents() {
         mhzVisualStep = 0.01;
         label.precision(2);
     }
-    
+
     long long firstMhz = (leftFreq / hzStep) * hzStep;
     long double mhzStart = ((long double) (firstMhz - leftFreq) / (long double) (rightFreq - leftFreq)) * 2.0;
     long double currentMhz = trunc(floor(firstMhz / (long double)1000000.0));
-    
-    
-    double hPos = 1.0 - (16.0 / viewHeight) *  GLFont::getScaleFactor();
+
+    labelPos = 1.0 - (16.0 / viewHeight) * fontScale;
     double lMhzPos = 1.0 - (5.0 / viewHeight);
-    
-    int fontSize = 12;
-    
+
+    labelFontSize = 12;
+
     if (viewHeight > 135) {
 
-        fontSize = 16;
-        hPos = 1.0 - (18.0 / viewHeight) *  GLFont::getScaleFactor();
+        labelFontSize = 16;
+        labelPos = 1.0 - (18.0 / viewHeight) * fontScale;
     }
-    
-    GLFont::Drawer refDrawingFont = GLFont::getFont(fontSize, GLFont::getScaleFactor());
+
+    //the major ticks (whole MHz) are drawn wider, so they are kept after the minor ones.
+    std::vector<float> majorTicks;
 
     for (double m = -1.0 + mhzStart, mMax = 1.0 + ((mhzStart>0)?mhzStart:-mhzStart); m <= mMax; m += mhzStep) {
         if (m < -1.0) {
@@ -248,34 +261,214 @@ void SpectrumPanel::drawPanelContents() {
             break;
         }
         label << std::fixed << currentMhz;
-        
+
         double fractpart, intpart;
-        
+
         fractpart = modf(currentMhz, &intpart);
-        
-        if (fractpart < 0.001) {
-            glLineWidth(4.0);
-            glColor3f(ThemeMgr::mgr.currentTheme->freqLine.r, ThemeMgr::mgr.currentTheme->freqLine.g, ThemeMgr::mgr.currentTheme->freqLine.b);
-        } else {
-            glLineWidth(1.0);
-            glColor3f(ThemeMgr::mgr.currentTheme->freqLine.r * 0.65, ThemeMgr::mgr.currentTheme->freqLine.g * 0.65,
-                      ThemeMgr::mgr.currentTheme->freqLine.b * 0.65);
-        }
-        
-        glDisable(GL_TEXTURE_2D);
-        glBegin(GL_LINES);
-        glVertex2f(m, lMhzPos);
-        glVertex2f(m, 1);
-        glEnd();
-        
-        glColor4f(ThemeMgr::mgr.currentTheme->text.r, ThemeMgr::mgr.currentTheme->text.g, ThemeMgr::mgr.currentTheme->text.b,1.0);
-        
-        refDrawingFont.drawString(label.str(), m, hPos, GLFont::GLFONT_ALIGN_CENTER, GLFont::GLFONT_ALIGN_CENTER, 0, 0, true);
-        
+
+        std::vector<float> &ticks = (fractpart < 0.001) ? majorTicks : gridVertices;
+
+        ticks.push_back(m);
+        ticks.push_back(lMhzPos);
+        ticks.push_back(m);
+        ticks.push_back(1);
+
+        TickLabel tickLabel;
+        tickLabel.text = label.str();
+        tickLabel.pos = m;
+        tickLabels.push_back(tickLabel);
+
         label.str(std::string());
-        
+
         currentMhz += mhzVisualStep;
     }
+
+    minorTicksCount = (int) gridVertices.size() / 2;
+    minorTicksFirst = 0;
+    for (size_t i = 0; i < gridBands.size(); i++) {
+        minorTicksFirst += gridBands[i].count;
+    }
+    minorTicksCount -= minorTicksFirst;
+
+    majorTicksFirst = (int) gridVertices.size() / 2;
+    majorTicksCount = (int) majorTicks.size() / 2;
+    gridVertices.insert(gridVertices.end(), majorTicks.begin(), majorTicks.end());
+
+    uploadVertices(gridBuffer, gridBufferCapacity, gridVertices, GL_STATIC_DRAW);
+}
+
+int SpectrumPanel::appendLine(std::vector<float> &src, SpectrumPyramidPtr srcPyramid, size_t numPixels) {
+    size_t count = src.size() / 2;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    if (numPixels == 0 || count <= numPixels * 2) {
+        lineVertices.insert(lineVertices.end(), src.begin(), src.begin() + count * 2);
+        return (int) count;
+    }
+
+    pixel_min.resize(numPixels);
+    pixel_max.resize(numPixels);
+
+    if (srcPyramid && srcPyramid->getSize() == count) {
+        srcPyramid->sample(0, (double) count, numPixels, &pixel_min[0], &pixel_max[0], nullptr);
+    } else {
+        for (size_t p = 0, i = 0; p < numPixels; p++) {
+            size_t iEnd = std::max(i + 1, ((p + 1) * count) / numPixels);
+            float minValue = src[i * 2 + 1], maxValue = minValue;
+
+            for (; i < iEnd; i++) {
+                minValue = std::min(minValue, src[i * 2 + 1]);
+                maxValue = std::max(maxValue, src[i * 2 + 1]);
+            }
+            pixel_min[p] = minValue;
+            pixel_max[p] = maxValue;
+        }
+    }
+
+    //a vertical segment per pixel, starting from the end nearest to the previous one
+    //so that the strip joins them without crossing the pixel.
+    float last = pixel_min[0];
+
+    for (size_t p = 0; p < numPixels; p++) {
+        float x = ((float) p + 0.5f) / (float) numPixels;
+        bool down = (last > (pixel_min[p] + pixel_max[p]) * 0.5f);
+
+        lineVertices.push_back(x);
+        lineVertices.push_back(down ? pixel_max[p] : pixel_min[p]);
+        lineVertices.push_back(x);
+        lineVertices.push_back(down ? pixel_min[p] : pixel_max[p]);
+
+        last = down ? pixel_min[p] : pixel_max[p];
+    }
+
+    return (int) numPixels * 2;
+}
+
+void SpectrumPanel::uploadVertices(GLuint buffer, size_t& capacity, std::vector<float> &vertices, GLenum usage) {
+    if (!buffer || vertices.empty()) {
+        return;
+    }
+
+    size_t size = vertices.size() * sizeof(float);
+
+    glExtBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    if (size > capacity) {
+        glExtBufferData(GL_ARRAY_BUFFER, size, &vertices[0], usage);
+        capacity = size;
+    } else {
+        glExtBufferSubData(GL_ARRAY_BUFFER, 0, size, &vertices[0]);
+    }
+
+    glExtBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SpectrumPanel::drawPanelContents() {
+    PipelineMetrics::BusyScope busy(drawStats);
+
+    if (!buffersInitialized) {
+        buffersInitialized = true;
+
+        if (GLExtHasVertexBuffers()) {
+            glExtGenBuffers(1, &lineBuffer);
+            glExtGenBuffers(1, &gridBuffer);
+        }
+    }
+
+    GLint vp[4];
+    glGetIntegerv( GL_VIEWPORT, vp);
+
+    float viewHeight = (float) vp[3];
+    float viewWidth = (float) vp[2];
+
+    updateGrid(viewWidth, viewHeight);
+
+    //offsets into the bound buffers, or pointers into the vectors.
+    const char *gridBase = gridBuffer ? nullptr : (gridVertices.empty() ? nullptr : (const char *) &gridVertices[0]);
+
+    glDisable(GL_TEXTURE_2D);
+    
+    glEnable(GL_BLEND);
+    glEnable(GL_LINE_SMOOTH);
+    glHint( GL_LINE_SMOOTH_HINT, GL_NICEST );
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+
+    glLoadMatrixf((transform * (CubicVR::mat4::translate(-1.0f, -0.75f, 0.0f) * CubicVR::mat4::scale(2.0f, 1.5f, 1.0f))).to_ptr());
+
+    if (points.size()) {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+
+        if (gridBuffer) {
+            glExtBindBuffer(GL_ARRAY_BUFFER, gridBuffer);
+        }
+        glVertexPointer(2, GL_FLOAT, 0, gridBase);
+
+        for (size_t i = 0; i < gridBands.size(); i++) {
+            glColor4f(0.12f, 0.12f, 0.12f, gridBands[i].alpha);
+            glDrawArrays(GL_LINES, gridBands[i].first, gridBands[i].count);
+        }
+
+        //more points than pixels: draw the min to max range of the points of each pixel instead.
+        lineVertices.clear();
+
+        int lineCount = appendLine(points, pyramid, (size_t) viewWidth);
+        int peakCount = appendLine(peak_points, nullptr, (size_t) viewWidth);
+
+        uploadVertices(lineBuffer, lineBufferCapacity, lineVertices, GL_STREAM_DRAW);
+
+        if (lineBuffer) {
+            glExtBindBuffer(GL_ARRAY_BUFFER, lineBuffer);
+        }
+        const char *lineBase = lineBuffer ? nullptr : (const char *) &lineVertices[0];
+
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glColor3f(ThemeMgr::mgr.currentTheme->fftLine.r, ThemeMgr::mgr.currentTheme->fftLine.g, ThemeMgr::mgr.currentTheme->fftLine.b);
+
+        glVertexPointer(2, GL_FLOAT, 0, lineBase);
+        glDrawArrays(GL_LINE_STRIP, 0, lineCount);
+
+        if (peakCount) {
+            glColor4f(0, 1.0, 0, 0.5);
+            glDrawArrays(GL_LINE_STRIP, lineCount, peakCount);
+        }
+    }
+  
+    glLoadMatrixf(transform.to_ptr());
+
+    if (gridBuffer) {
+        glExtBindBuffer(GL_ARRAY_BUFFER, gridBuffer);
+    }
+    glVertexPointer(2, GL_FLOAT, 0, gridBase);
+
+    if (minorTicksCount) {
+        glLineWidth(1.0);
+        glColor3f(ThemeMgr::mgr.currentTheme->freqLine.r * 0.65, ThemeMgr::mgr.currentTheme->freqLine.g * 0.65,
+                  ThemeMgr::mgr.currentTheme->freqLine.b * 0.65);
+        glDrawArrays(GL_LINES, minorTicksFirst, minorTicksCount);
+    }
+
+    if (majorTicksCount) {
+        glLineWidth(4.0);
+        glColor3f(ThemeMgr::mgr.currentTheme->freqLine.r, ThemeMgr::mgr.currentTheme->freqLine.g, ThemeMgr::mgr.currentTheme->freqLine.b);
+        glDrawArrays(GL_LINES, majorTicksFirst, majorTicksCount);
+    }
+
+    if (gridBuffer) {
+        glExtBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glColor4f(ThemeMgr::mgr.currentTheme->text.r, ThemeMgr::mgr.currentTheme->text.g, ThemeMgr::mgr.currentTheme->text.b,1.0);
+
+    GLFont::Drawer refDrawingFont = GLFont::getFont(labelFontSize, GLFont::getScaleFactor());
+
+    for (size_t i = 0; i < tickLabels.size(); i++) {
+        refDrawingFont.drawString(tickLabels[i].text, tickLabels[i].pos, labelPos, GLFont::GLFONT_ALIGN_CENTER, GLFont::GLFONT_ALIGN_CENTER, 0, 0, true);
+    }
     
     glLineWidth(1.0);
 
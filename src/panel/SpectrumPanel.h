@@ -4,6 +4,8 @@
 #pragma once
 
 #include "GLPanel.h"
+#include "SpectrumPyramid.h"
+#include "PipelineMetrics.h"
 
 class SpectrumPanel : public GLPanel {
 public:
@@ -11,6 +13,8 @@ public:
     
     void setPoints(std::vector<float> &points);
     void setPeakPoints(std::vector<float> &points);
+    //levels of the points, to decimate them faster to the panel width when they are more than its pixels.
+    void setPyramid(SpectrumPyramidPtr pyramid_in);
     
     float getFloorValue();
     void setFloorValue(float floorValue);
@@ -37,13 +41,55 @@ protected:
     void drawPanelContents();
 
 private:
+    struct GridBand {
+        int first, count;
+        float alpha;
+    };
+
+    struct TickLabel {
+        std::string text;
+        float pos;
+    };
+
+    //the vertices of the dB grid lines and of the frequency ticks, and the tick labels,
+    //only rebuilt when the levels range, the frequency, the bandwidth or the panel size changed.
+    void updateGrid(float viewWidth, float viewHeight);
+    //append the line strip of the points (x, y pairs) to lineVertices, as the min and max of each pixel
+    //when they are more than twice numPixels. Returns the number of vertices.
+    int appendLine(std::vector<float> &src, SpectrumPyramidPtr srcPyramid, size_t numPixels);
+    //put vertices into the buffer, growing it if needed; no-op when drawing from client memory.
+    void uploadVertices(GLuint buffer, size_t& capacity, std::vector<float> &vertices, GLenum usage);
+
     float floorValue, ceilValue;
     int fftSize;
     long long freq;
     long long bandwidth;
     std::vector<float> points;
     std::vector<float> peak_points;
+    SpectrumPyramidPtr pyramid;
+    std::vector<float> pixel_min, pixel_max;
+
+    //vertex buffers when available, else 0 and the vertices are drawn from client memory.
+    bool buffersInitialized;
+    GLuint lineBuffer, gridBuffer;
+    size_t lineBufferCapacity, gridBufferCapacity;
+    //the spectrum line then the peak line.
+    std::vector<float> lineVertices;
+
+    std::vector<float> gridVertices;
+    std::vector<GridBand> gridBands;
+    int majorTicksFirst, majorTicksCount, minorTicksFirst, minorTicksCount;
+    std::vector<TickLabel> tickLabels;
+    int labelFontSize;
+    float labelPos;
+    bool gridValid;
+    float gridFloor, gridCeil, gridWidth, gridHeight;
+    double gridFontScale;
+    long long gridFreq, gridBandwidth;
     
+    //draw time of the panels, one block per frame.
+    PipelineMetrics::ThreadStats *drawStats;
+
     GLTextPanel dbPanelCeil;
     GLTextPanel dbPanelFloor;
     bool showDb, useDbOfs;
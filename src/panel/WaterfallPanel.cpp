@@ -2,44 +2,88 @@
 // SPDX-License-Identifier: GPL-2.0+
 
 #include "WaterfallPanel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
 
-WaterfallPanel::WaterfallPanel() : GLPanel(), fft_size(0), waterfall_lines(0), waterfall_slice(NULL), activeTheme(NULL) {
+//wait step for the upload that last read a pixel buffer, before writing it again.
+#define WATERFALL_PBO_WAIT_NANOS (50 * 1000 * 1000)
+
+//The levels looked up in the 256 texels gradient, the vertex stage being the fixed function one.
+static const char *gradientShaderSource =
+    "uniform sampler2D levels;\n"
+    "uniform sampler1D gradient;\n"
+    "void main() {\n"
+    "    float level = texture2D(levels, gl_TexCoord[0].st).r;\n"
+    "    gl_FragColor = texture1D(gradient, level * (255.0 / 256.0) + (0.5 / 256.0));\n"
+    "}\n";
+
+WaterfallPanel::WaterfallPanel() : GLPanel(), waterfall_row(0), fft_size(0), waterfall_lines(0), useShader(false), gradientTexture(0), gradientProgram(0),
+        uploadPath(UPLOAD_CLIENT_MEMORY), pixelBufferIndex(0), pixelBufferSize(0), activeTheme(NULL) {
 	setFillColor(RGBA4f(0,0,0));
     for (int i = 0; i < 2; i++) {
         waterfall[i] = 0;
     }
+    for (int i = 0; i < WATERFALL_PBO_RING_SIZE; i++) {
+        pixelBuffers[i] = 0;
+        pixelBufferData[i] = NULL;
+        pixelBufferFences[i] = NULL;
+    }
+    lines_buffered.store(0);
+    texInitialized.store(false);
+    bufferInitialized.store(false);
+    historyPending.store(false);
 }
 
 void WaterfallPanel::setup(unsigned int fft_size_in, int num_waterfall_lines_in) {
     waterfall_lines = num_waterfall_lines_in;
     fft_size = fft_size_in;
     lines_buffered.store(0);
-    
+
     if (points.size() != fft_size) {
         points.resize(fft_size);
     }
-    
+
     texInitialized.store(false);
     bufferInitialized.store(false);
+    historyPending.store(false);
 }
 
 void WaterfallPanel::refreshTheme() {
+    Gradient& gradient = ThemeMgr::mgr.currentTheme->waterfallGradient;
+
+    if (useShader) {
+        std::vector<float> texels(256 * 3);
+
+        for (int i = 0; i < 256; i++) {
+            texels[i * 3] = gradient.getRed()[i];
+            texels[i * 3 + 1] = gradient.getGreen()[i];
+            texels[i * 3 + 2] = gradient.getBlue()[i];
+        }
+
+        glBindTexture(GL_TEXTURE_1D, gradientTexture);
+        glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB, 256, 0, GL_RGB, GL_FLOAT, (GLvoid *) &texels[0]);
+        glBindTexture(GL_TEXTURE_1D, 0);
+        return;
+    }
+
     glEnable (GL_TEXTURE_2D);
-    
+
     for (int i = 0; i < 2; i++) {
         glBindTexture(GL_TEXTURE_2D, waterfall[i]);
-        
-        glPixelTransferi(GL_MAP_COLOR, GL_TRUE);
-        glPixelMapfv(GL_PIXEL_MAP_I_TO_R, 256, &(ThemeMgr::mgr.currentTheme->waterfallGradient.getRed())[0]);
-        glPixelMapfv(GL_PIXEL_MAP_I_TO_G, 256, &(ThemeMgr::mgr.currentTheme->waterfallGradient.getGreen())[0]);
-        glPixelMapfv(GL_PIXEL_MAP_I_TO_B, 256, &(ThemeMgr::mgr.currentTheme->waterfallGradient.getBlue())[0]);
+
+        glPixelMapfv(GL_PIXEL_MAP_I_TO_R, 256, &(gradient.getRed())[0]);
+        glPixelMapfv(GL_PIXEL_MAP_I_TO_G, 256, &(gradient.getGreen())[0]);
+        glPixelMapfv(GL_PIXEL_MAP_I_TO_B, 256, &(gradient.getBlue())[0]);
     }
 }
 
 void WaterfallPanel::setPoints(std::vector<float> &points) {
     size_t halfPts = points.size()/2;
     if (halfPts == fft_size) {
-       
+
         for (unsigned int i = 0; i < fft_size; i++) {
             this->points[i] = points[i*2+1];
         }
@@ -48,114 +92,352 @@ void WaterfallPanel::setPoints(std::vector<float> &points) {
     }
 }
 
+unsigned char *WaterfallPanel::getStagingLine(int j, int n) {
+    size_t offset = ((size_t) j * WATERFALL_UPLOAD_MAX_LINES + n) * (fft_size / 2);
+
+    if (uploadPath == UPLOAD_PERSISTENT_BUFFER) {
+        return pixelBufferData[pixelBufferIndex] + offset;
+    }
+    return &lineBuffer[offset];
+}
+
 void WaterfallPanel::step() {
     unsigned int half_fft_size = fft_size / 2;
 
-    if (!bufferInitialized.load()) {
-        delete waterfall_slice;
-        waterfall_slice = new unsigned char[half_fft_size];
-        bufferInitialized.store(true);
-    }
-    
+    bufferInitialized.store(true);
+
     if (!texInitialized.load()) {
         return;
     }
-    
-    if (points.size() && points.size() == fft_size) {
+
+    int n = lines_buffered.load();
+
+    if (points.size() && points.size() == fft_size && n < WATERFALL_UPLOAD_MAX_LINES) {
         for (int j = 0; j < 2; j++) {
+            unsigned char *line = getStagingLine(j, n);
+
             for (int i = 0, iMax = half_fft_size; i < iMax; i++) {
                 float v = points[j * half_fft_size + i];
-                
+
                 float wv = v < 0 ? 0 : (v > 0.99 ? 0.99 : v);
-                
-                waterfall_slice[i] = (unsigned char) floor(wv * 255.0);
-            }
-            
-            unsigned int newBufSize = (half_fft_size*lines_buffered.load()+half_fft_size);
-            if (lineBuffer[j].size() < newBufSize) {
-                lineBuffer[j].resize(newBufSize);
-                rLineBuffer[j].resize(newBufSize);
+
+                line[i] = (unsigned char) floor(wv * 255.0);
             }
-            memcpy(&(lineBuffer[j][half_fft_size*lines_buffered.load()]), waterfall_slice, sizeof(unsigned char) * half_fft_size);
         }
         lines_buffered++;
     }
 }
 
+void WaterfallPanel::setLines(const unsigned char *lines, int numLines, int lineWidth) {
+    unsigned int half_fft_size = fft_size / 2;
+
+    if (!half_fft_size || lineWidth <= 0) {
+        return;
+    }
+
+    for (int j = 0; j < 2; j++) {
+        historyBuffer[j].assign(half_fft_size * waterfall_lines, 0);
+    }
+
+    //each texel is the max of the levels it covers, so that narrow peaks survive the narrower FFT sizes.
+    //The latest line goes to the last row, as if the lines had been stepped from the first one.
+    for (int k = 0, kMax = std::min(numLines, waterfall_lines); k < kMax; k++) {
+        const unsigned char *line = &lines[k * lineWidth];
+        size_t row = (size_t) (waterfall_lines - 1 - k);
+
+        for (unsigned int i = 0; i < fft_size; i++) {
+            int first = (int)(((long long)i * lineWidth) / fft_size);
+            int last = std::max(first + 1, (int)(((long long)(i + 1) * lineWidth) / fft_size));
+            unsigned char v = 0;
+
+            for (int x = first; x < last; x++) {
+                v = std::max(v, line[x]);
+            }
+            historyBuffer[i / half_fft_size][row * half_fft_size + (i % half_fft_size)] = v;
+        }
+    }
+
+    lines_buffered.store(0);
+    historyPending.store(true);
+}
+
+bool WaterfallPanel::initShader() {
+    GLuint shader = glExtCreateShader(GL_FRAGMENT_SHADER);
+    GLint status = 0;
+
+    glExtShaderSource(shader, 1, &gradientShaderSource, NULL);
+    glExtCompileShader(shader);
+    glExtGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+    if (!status) {
+        glExtDeleteShader(shader);
+        std::cout << "Waterfall gradient shader failed to compile, using color index textures." << std::endl;
+        return false;
+    }
+
+    gradientProgram = glExtCreateProgram();
+    glExtAttachShader(gradientProgram, shader);
+    glExtLinkProgram(gradientProgram);
+    //freed along with the program.
+    glExtDeleteShader(shader);
+    glExtGetProgramiv(gradientProgram, GL_LINK_STATUS, &status);
+
+    if (!status) {
+        glExtDeleteProgram(gradientProgram);
+        gradientProgram = 0;
+        std::cout << "Waterfall gradient shader failed to link, using color index textures." << std::endl;
+        return false;
+    }
+
+    glExtUseProgram(gradientProgram);
+    glExtUniform1i(glExtGetUniformLocation(gradientProgram, "levels"), 0);
+    glExtUniform1i(glExtGetUniformLocation(gradientProgram, "gradient"), 1);
+    glExtUseProgram(0);
+
+    return true;
+}
+
+void WaterfallPanel::initUploadBuffers() {
+    pixelBufferSize = 2 * WATERFALL_UPLOAD_MAX_LINES * (size_t) (fft_size / 2);
+    pixelBufferIndex = 0;
+    uploadPath = UPLOAD_CLIENT_MEMORY;
+
+    if (GLExtHasBufferStorage()) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bool mapped = true;
+
+        glExtGenBuffers(WATERFALL_PBO_RING_SIZE, pixelBuffers);
+
+        for (int i = 0; i < WATERFALL_PBO_RING_SIZE; i++) {
+            glExtBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[i]);
+            glExtBufferStorage(GL_PIXEL_UNPACK_BUFFER, pixelBufferSize, NULL, flags);
+            pixelBufferData[i] = (unsigned char *) glExtMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pixelBufferSize, flags);
+            mapped = mapped && (pixelBufferData[i] != NULL);
+        }
+        glExtBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (mapped) {
+            uploadPath = UPLOAD_PERSISTENT_BUFFER;
+        } else {
+            glExtDeleteBuffers(WATERFALL_PBO_RING_SIZE, pixelBuffers);
+            for (int i = 0; i < WATERFALL_PBO_RING_SIZE; i++) {
+                pixelBuffers[i] = 0;
+                pixelBufferData[i] = NULL;
+            }
+        }
+    }
+
+    if (uploadPath == UPLOAD_CLIENT_MEMORY && GLExtHasPixelBuffers()) {
+        glExtGenBuffers(WATERFALL_PBO_RING_SIZE, pixelBuffers);
+
+        for (int i = 0; i < WATERFALL_PBO_RING_SIZE; i++) {
+            glExtBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[i]);
+            glExtBufferData(GL_PIXEL_UNPACK_BUFFER, pixelBufferSize, NULL, GL_STREAM_DRAW);
+        }
+        glExtBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        uploadPath = UPLOAD_PIXEL_BUFFER;
+    }
+
+    if (uploadPath == UPLOAD_PERSISTENT_BUFFER) {
+        lineBuffer.clear();
+    } else {
+        lineBuffer.assign(pixelBufferSize, 0);
+    }
+}
+
+void WaterfallPanel::releaseTextures() {
+    for (int i = 0; i < 2; i++) {
+        if (waterfall[i]) {
+            glDeleteTextures(1, &waterfall[i]);
+            waterfall[i] = 0;
+        }
+    }
+
+    if (gradientTexture) {
+        glDeleteTextures(1, &gradientTexture);
+        gradientTexture = 0;
+    }
+
+    if (gradientProgram) {
+        glExtDeleteProgram(gradientProgram);
+        gradientProgram = 0;
+    }
+
+    for (int i = 0; i < WATERFALL_PBO_RING_SIZE; i++) {
+        if (pixelBufferFences[i]) {
+            glExtDeleteSync(pixelBufferFences[i]);
+            pixelBufferFences[i] = NULL;
+        }
+    }
+
+    //deleting the buffers unmaps them.
+    if (pixelBuffers[0]) {
+        glExtDeleteBuffers(WATERFALL_PBO_RING_SIZE, pixelBuffers);
+        for (int i = 0; i < WATERFALL_PBO_RING_SIZE; i++) {
+            pixelBuffers[i] = 0;
+            pixelBufferData[i] = NULL;
+        }
+    }
+}
+
+void WaterfallPanel::initTextures() {
+    int half_fft_size = fft_size / 2;
+
+    releaseTextures();
+
+    useShader = GLExtHasShaders() && initShader();
+
+    glGenTextures(2, waterfall);
+
+    //Creates 2x 2D textures into card memory.
+    //of size half_fft_size * waterfall_lines, which can be BIG.
+    //The limit of the size of Waterfall is the size of the maximum supported 2D texture
+    //by the graphic card. (half_fft_size * waterfall_lines, i.e DEFAULT_DEMOD_WATERFALL_LINES_NB * DEFAULT_FFT_SIZE/2)
+    std::vector<unsigned char> waterfall_tex(half_fft_size * waterfall_lines, 0);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, waterfall[i]);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        if (useShader) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, half_fft_size, waterfall_lines, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, (GLvoid *) &waterfall_tex[0]);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, half_fft_size, waterfall_lines, 0, GL_COLOR_INDEX, GL_UNSIGNED_BYTE, (GLvoid *) &waterfall_tex[0]);
+        }
+    }
+
+    if (useShader) {
+        glGenTextures(1, &gradientTexture);
+        glBindTexture(GL_TEXTURE_1D, gradientTexture);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_1D, 0);
+    }
+
+    waterfall_row = 0;
+
+    initUploadBuffers();
+
+    refreshTheme();
+}
+
 void WaterfallPanel::update() {
     int half_fft_size = fft_size / 2;
-    
+
     if (!bufferInitialized.load()) {
         return;
     }
-    
-    if (!texInitialized.load()) {
-        for (int i = 0; i < 2; i++) {
-            if (waterfall[i]) {
-                glDeleteTextures(1, &waterfall[i]);
-                waterfall[i] = 0;
-            }
-            
-            waterfall_ofs[i] = waterfall_lines - 1;
-        }
-
-        glGenTextures(2, waterfall);
-        
-        unsigned char *waterfall_tex;
-        
-        //Creates 2x 2D textures into card memory.
-        //of size half_fft_size * waterfall_lines, which can be BIG.
-        //The limit of the size of Waterfall is the size of the maximum supported 2D texture 
-        //by the graphic card. (half_fft_size * waterfall_lines, i.e DEFAULT_DEMOD_WATERFALL_LINES_NB * DEFAULT_FFT_SIZE/2)
-        waterfall_tex = new unsigned char[half_fft_size * waterfall_lines];
-        memset(waterfall_tex, 0, half_fft_size * waterfall_lines);
-        
-        for (int i = 0; i < 2; i++) {
-            glBindTexture(GL_TEXTURE_2D, waterfall[i]);
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-            
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, half_fft_size, waterfall_lines, 0, GL_COLOR_INDEX, GL_UNSIGNED_BYTE, (GLvoid *) waterfall_tex);
-        }
-        
-        delete[] waterfall_tex;
-
-        refreshTheme();
 
+    if (!texInitialized.load()) {
+        initTextures();
         texInitialized.store(true);
     }
-    
-    for (int i = 0, iMax = lines_buffered.load(); i < iMax; i++) {
+
+    GLenum format = useShader ? GL_LUMINANCE : GL_COLOR_INDEX;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    //the color index textures get the gradient at upload.
+    glPixelTransferi(GL_MAP_COLOR, useShader ? GL_FALSE : GL_TRUE);
+
+    //the whole waterfall at once, from the first row.
+    if (historyPending.load()) {
         for (int j = 0; j < 2; j++) {
-            memcpy(&(rLineBuffer[j][i*half_fft_size]),
-                   &(lineBuffer[j][((iMax-1)*half_fft_size)-(i*half_fft_size)]), sizeof(unsigned char) * half_fft_size);
+            glBindTexture(GL_TEXTURE_2D, waterfall[j]);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, half_fft_size, waterfall_lines,
+                            format, GL_UNSIGNED_BYTE, (GLvoid *) &(historyBuffer[j][0]));
         }
+        waterfall_row = 0;
+        lines_buffered.store(0);
+        historyPending.store(false);
+        glPixelTransferi(GL_MAP_COLOR, GL_FALSE);
+        return;
     }
-    
-    int run_ofs = 0;
-    while (lines_buffered.load()) {
-        int run_lines = lines_buffered.load();
-        if (run_lines > waterfall_ofs[0]) {
-            run_lines = waterfall_ofs[0];
+
+    int numLines = lines_buffered.load();
+
+    if (numLines == 0) {
+        glPixelTransferi(GL_MAP_COLOR, GL_FALSE);
+        return;
+    }
+
+    //the lines are read from the client memory, or at their offset in the bound pixel buffer.
+    uintptr_t base = 0;
+
+    if (uploadPath == UPLOAD_PERSISTENT_BUFFER) {
+        glExtBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[pixelBufferIndex]);
+    } else if (uploadPath == UPLOAD_PIXEL_BUFFER) {
+        glExtBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[pixelBufferIndex]);
+
+        unsigned char *mapped = (unsigned char *) glExtMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pixelBufferSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+        if (mapped) {
+            for (int j = 0; j < 2; j++) {
+                size_t offset = (size_t) j * WATERFALL_UPLOAD_MAX_LINES * half_fft_size;
+                memcpy(mapped + offset, &lineBuffer[offset], (size_t) numLines * half_fft_size);
+            }
+            glExtUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        } else {
+            glExtBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            base = (uintptr_t) &lineBuffer[0];
         }
-        for (int j = 0; j < 2; j++) {
-            glBindTexture(GL_TEXTURE_2D, waterfall[j]);
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, waterfall_ofs[j]-run_lines, half_fft_size, run_lines,
-                            GL_COLOR_INDEX, GL_UNSIGNED_BYTE, (GLvoid *) &(rLineBuffer[j][run_ofs]));
-            
-            waterfall_ofs[j]-=run_lines;
-            
-            if (waterfall_ofs[j] == 0) {
-                waterfall_ofs[j] = waterfall_lines;
+    } else {
+        base = (uintptr_t) &lineBuffer[0];
+    }
+
+    //the lines, oldest first, go to the rows from waterfall_row on, wrapping to the first one.
+    for (int j = 0; j < 2; j++) {
+        glBindTexture(GL_TEXTURE_2D, waterfall[j]);
+
+        for (int done = 0, row = waterfall_row; done < numLines;) {
+            int run_lines = std::min(numLines - done, waterfall_lines - row);
+            uintptr_t offset = ((uintptr_t) j * WATERFALL_UPLOAD_MAX_LINES + done) * half_fft_size;
+
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, half_fft_size, run_lines,
+                            format, GL_UNSIGNED_BYTE, (GLvoid *) (base + offset));
+
+            done += run_lines;
+            row = (row + run_lines) % waterfall_lines;
+        }
+    }
+
+    waterfall_row = (waterfall_row + numLines) % waterfall_lines;
+    lines_buffered.store(0);
+
+    if (uploadPath != UPLOAD_CLIENT_MEMORY) {
+        glExtBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (uploadPath == UPLOAD_PERSISTENT_BUFFER) {
+            pixelBufferFences[pixelBufferIndex] = glExtFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        pixelBufferIndex = (pixelBufferIndex + 1) % WATERFALL_PBO_RING_SIZE;
+
+        //step() writes the next lines into the next buffer right away, so it must be free:
+        //the uploads complete in order, this one being the oldest pending there is no other buffer to use instead.
+        if (pixelBufferFences[pixelBufferIndex]) {
+            GLenum waitResult;
+
+            do {
+                waitResult = glExtClientWaitSync(pixelBufferFences[pixelBufferIndex], GL_SYNC_FLUSH_COMMANDS_BIT, WATERFALL_PBO_WAIT_NANOS);
+            } while (waitResult == GL_TIMEOUT_EXPIRED);
+
+            if (waitResult == GL_WAIT_FAILED) {
+                glFinish();
             }
+            glExtDeleteSync(pixelBufferFences[pixelBufferIndex]);
+            pixelBufferFences[pixelBufferIndex] = NULL;
         }
-        run_ofs += run_lines*half_fft_size;
-        lines_buffered.store(lines_buffered.load()-run_lines);
     }
+
+    glPixelTransferi(GL_MAP_COLOR, GL_FALSE);
 }
 
 void WaterfallPanel::drawPanelContents() {
@@ -164,56 +446,71 @@ void WaterfallPanel::drawPanelContents() {
     }
 
     int half_fft_size = fft_size / 2;
-    
+
     glLoadMatrixf(transform.to_ptr());
-    
+
     glEnable (GL_TEXTURE_2D);
     glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
-    
+
     if (activeTheme != ThemeMgr::mgr.currentTheme) {
         refreshTheme();
         activeTheme = ThemeMgr::mgr.currentTheme;
     }
+
+    if (useShader) {
+        glExtActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_1D, gradientTexture);
+        glExtActiveTexture(GL_TEXTURE0);
+        glExtUseProgram(gradientProgram);
+    }
+
     glColor3f(1.0, 1.0, 1.0);
-    
+
     GLint vp[4];
     glGetIntegerv(GL_VIEWPORT, vp);
-    
+
     float viewWidth = (float) vp[2];
-    
+
     // some bias to prevent seams at odd scales
     float half_pixel = 1.0 / viewWidth;
     float half_texel = 1.0 / (float) half_fft_size;
     float vtexel = 1.0 / (float) waterfall_lines;
-    float vofs = (float) (waterfall_ofs[0]) * vtexel;
-    
+    //the latest line is at the top, the older ones below in decreasing rows.
+    float vofs = (float) waterfall_row * vtexel;
+
     glBindTexture(GL_TEXTURE_2D, waterfall[0]);
     glBegin (GL_QUADS);
-    glTexCoord2f(0.0 + half_texel, 1.0 + vofs);
+    glTexCoord2f(0.0 + half_texel, vofs - 1.0);
     glVertex3f(-1.0, -1.0, 0.0);
-    glTexCoord2f(1.0 - half_texel, 1.0 + vofs);
+    glTexCoord2f(1.0 - half_texel, vofs - 1.0);
     glVertex3f(0.0 + half_pixel, -1.0, 0.0);
-    glTexCoord2f(1.0 - half_texel, 0.0 + vofs);
+    glTexCoord2f(1.0 - half_texel, vofs);
     glVertex3f(0.0 + half_pixel, 1.0, 0.0);
-    glTexCoord2f(0.0 + half_texel, 0.0 + vofs);
+    glTexCoord2f(0.0 + half_texel, vofs);
     glVertex3f(-1.0, 1.0, 0.0);
     glEnd();
-    
-    vofs = (float) (waterfall_ofs[1]) * vtexel;
+
     glBindTexture(GL_TEXTURE_2D, waterfall[1]);
     glBegin(GL_QUADS);
-    glTexCoord2f(0.0 + half_texel, 1.0 + vofs);
+    glTexCoord2f(0.0 + half_texel, vofs - 1.0);
     glVertex3f(0.0 - half_pixel, -1.0, 0.0);
-    glTexCoord2f(1.0 - half_texel, 1.0 + vofs);
+    glTexCoord2f(1.0 - half_texel, vofs - 1.0);
     glVertex3f(1.0, -1.0, 0.0);
-    glTexCoord2f(1.0 - half_texel, 0.0 + vofs);
+    glTexCoord2f(1.0 - half_texel, vofs);
     glVertex3f(1.0, 1.0, 0.0);
-    glTexCoord2f(0.0 + half_texel, 0.0 + vofs);
+    glTexCoord2f(0.0 + half_texel, vofs);
     glVertex3f(0.0 - half_pixel, 1.0, 0.0);
     glEnd();
-    
+
     glBindTexture(GL_TEXTURE_2D, 0);
-    
+
+    if (useShader) {
+        glExtUseProgram(0);
+        glExtActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_1D, 0);
+        glExtActiveTexture(GL_TEXTURE0);
+    }
+
     glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
     glDisable(GL_TEXTURE_2D);
 }
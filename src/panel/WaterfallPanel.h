@@ -6,30 +6,71 @@
 #include "GLPanel.h"
 #include <atomic>
 
+//pixel buffer objects of the upload ring.
+#define WATERFALL_PBO_RING_SIZE 3
+//lines uploaded at most per update(), the extra ones being dropped.
+#define WATERFALL_UPLOAD_MAX_LINES 128
+
+//The waterfall, as two textures of half the FFT each, used as rings of lines:
+//each line is written at the row after the previous one, and the quads are drawn from the latest row down.
+//Lines are 8 bit levels, colored through the theme gradient by a fragment shader when available,
+//else by the color index pixel maps at upload.
+//They are staged in display order in a ring of persistently mapped pixel buffers when available,
+//else in a pixel buffer or in memory, and uploaded once per update() for all the lines since the previous one.
 class WaterfallPanel : public GLPanel {
 public:
+    enum UploadPath {
+        UPLOAD_CLIENT_MEMORY, UPLOAD_PIXEL_BUFFER, UPLOAD_PERSISTENT_BUFFER
+    };
+
     WaterfallPanel();
     void setup(unsigned int fft_size_in, int num_waterfall_lines_in);
     void refreshTheme();
     void setPoints(std::vector<float> &points);
     void step();
+    //Replace the whole waterfall by numLines lines of lineWidth levels, the latest first,
+    //e.g. read back from a WaterfallHistory; uploaded on the next update().
+    void setLines(const unsigned char *lines, int numLines, int lineWidth);
     void update();
-    
+
 protected:
     void drawPanelContents();
-    
+
 private:
+    //(re)create the textures, the gradient shader and the upload buffers, GL context current.
+    void initTextures();
+    void releaseTextures();
+    bool initShader();
+    void initUploadBuffers();
+
+    //where step() writes the line n of the half j, until the next update().
+    unsigned char *getStagingLine(int j, int n);
+
     std::vector<float> points;
 
     GLuint waterfall[2];
-    int waterfall_ofs[2];
+    //next row written in the textures, the latest line being the one before.
+    int waterfall_row;
     unsigned int fft_size;
     int waterfall_lines;
-    unsigned char *waterfall_slice;
-    std::vector<unsigned char> lineBuffer[2];
-    std::vector<unsigned char> rLineBuffer[2];
+    //the lines since the last update, in display order, WATERFALL_UPLOAD_MAX_LINES of each half,
+    //when not staged in a persistently mapped buffer.
+    std::vector<unsigned char> lineBuffer;
+    std::vector<unsigned char> historyBuffer[2];
+    std::atomic_bool historyPending;
     std::atomic_int lines_buffered;
     std::atomic_bool texInitialized, bufferInitialized;
-    
+
+    bool useShader;
+    GLuint gradientTexture, gradientProgram;
+
+    UploadPath uploadPath;
+    GLuint pixelBuffers[WATERFALL_PBO_RING_SIZE];
+    //persistent mappings, and the fences of the uploads still reading them.
+    unsigned char *pixelBufferData[WATERFALL_PBO_RING_SIZE];
+    void *pixelBufferFences[WATERFALL_PBO_RING_SIZE];
+    int pixelBufferIndex;
+    size_t pixelBufferSize;
+
     ColorTheme *activeTheme;
 };
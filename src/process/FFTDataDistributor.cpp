@@ -4,11 +4,12 @@
 #include "FFTDataDistributor.h"
 #include <algorithm>
 #include <ThreadBlockingQueue.h>
+#include "PipelineMetrics.h"
 
 //50 ms
 #define HEARTBEAT_CHECK_PERIOD_MICROS (50 * 1000) 
 
-FFTDataDistributor::FFTDataDistributor() : outputBuffers("FFTDataDistributorBuffers"), fftSize(DEFAULT_FFT_SIZE), linesPerSecond(DEFAULT_WATERFALL_LPS), lineRateAccum(0.0) {
+FFTDataDistributor::FFTDataDistributor() : fftSize(DEFAULT_FFT_SIZE), fullRate(false), linesPerSecond(DEFAULT_WATERFALL_LPS), lineRateAccum(0.0) {
 
 }
 
@@ -25,6 +26,78 @@ unsigned int FFTDataDistributor::getLinesPerSecond() {
 	return this->linesPerSecond;
 }
 
+void FFTDataDistributor::setFullRate(bool enabled) {
+    fullRate.store(enabled);
+}
+
+bool FFTDataDistributor::isFullRate() {
+    return fullRate.load();
+}
+
+void FFTDataDistributor::writeRing(uint64_t from, const liquid_float_complex *src, size_t count) {
+    liquid_float_complex *ringData = ring->data();
+    size_t pos = (size_t)(from % bufferMax);
+    size_t first = std::min(count, bufferMax - pos);
+
+    memcpy(&ringData[pos], src, first * sizeof(liquid_float_complex));
+    memcpy(&ringData[0], src + first, (count - first) * sizeof(liquid_float_complex));
+
+    //update the mirror of the head of the ring, i.e. [0, ringMirror) at bufferMax.
+    if (pos < ringMirror) {
+        memcpy(&ringData[bufferMax + pos], &ringData[pos], (std::min(pos + first, ringMirror) - pos) * sizeof(liquid_float_complex));
+    }
+    if (count > first) {
+        memcpy(&ringData[bufferMax], &ringData[0], std::min(count - first, ringMirror) * sizeof(liquid_float_complex));
+    }
+}
+
+void FFTDataDistributor::replaceRing(size_t capacity, size_t lineSize) {
+    std::shared_ptr<RingSegment> previous = ring;
+    size_t previousMax = bufferMax;
+
+    //reuse the spare ring once no line uses it anymore.
+    if (spareRing && spareRing.use_count() == 1 && spareRing->size() == capacity + lineSize) {
+        ring = spareRing;
+    } else {
+        ring = std::make_shared<RingSegment>(capacity + lineSize);
+    }
+    spareRing = previous;
+
+    bufferMax = capacity;
+    ringMirror = lineSize;
+    linesInUse.clear();
+
+    //keep the unread samples, at their place in the new ring.
+    if (previous && bufferedItems) {
+        size_t pos = (size_t)(readIndex % previousMax);
+        size_t first = std::min(bufferedItems, previousMax - pos);
+
+        writeRing(readIndex, &(*previous)[pos], first);
+        writeRing(readIndex + first, &(*previous)[0], bufferedItems - first);
+    }
+}
+
+bool FFTDataDistributor::isRingInUse(uint64_t end) {
+    while (!linesInUse.empty() && linesInUse.front().first.expired()) {
+        linesInUse.pop_front();
+    }
+
+    //the oldest line in use starts where the ring is written bufferMax samples later.
+    return !linesInUse.empty() && end > linesInUse.front().second + bufferMax;
+}
+
+void FFTDataDistributor::distributeLine(uint64_t start, size_t size) {
+    DemodulatorThreadIQDataPtr outp = std::make_shared<DemodulatorThreadIQData>();
+
+    outp->frequency = inputFrequency;
+    outp->sampleRate = inputSampleRate;
+    outp->setView(ring, (size_t)(start % bufferMax), size);
+
+    linesInUse.push_back(std::make_pair(std::weak_ptr<DemodulatorThreadIQData>(outp), start));
+    //authorize distribute with losses
+    distribute(outp, NON_BLOCKING_TIMEOUT);
+}
+
 void FFTDataDistributor::process() {
 
 	while (!input->empty()) {
@@ -37,46 +110,57 @@ void FFTDataDistributor::process() {
             continue;
         }
 
+        size_t lineSize = fftSize.load();
+
 		if (inp) {
-            //Settings have changed, set new values and dump all previous samples stored in inputBuffer: 
-			if (inputBuffer.sampleRate != inp->sampleRate || inputBuffer.frequency != inp->frequency) {
+            static PipelineMetrics::ThreadStats *busyStats = PipelineMetrics::getThreadStats("FFTDataDistributor");
+            static PipelineMetrics::LatencyStats *latencyStats = PipelineMetrics::getLatencyStats("Waterfall input");
+
+            PipelineMetrics::BusyScope busy(busyStats);
+            latencyStats->record(inp->captureTime);
+
+            //in full rate mode, a line is all of the samples of a display line.
+            if (fullRate.load() && linesPerSecond) {
+                lineSize = std::max(lineSize, (size_t)(inp->sampleRate / linesPerSecond));
+            }
+
+            //Settings have changed, set new values and dump all previous samples stored in the ring: 
+			if (inputSampleRate != inp->sampleRate || inputFrequency != inp->frequency) {
 
                 //bufferMax must be at least fftSize (+ margin), else the waterfall get frozen, because no longer updated.
-                bufferMax = std::max((size_t)(inp->sampleRate * FFT_DISTRIBUTOR_BUFFER_IN_SECONDS), (size_t)(1.2 * fftSize.load()));
+                size_t newBufferMax = std::max((size_t)(inp->sampleRate * FFT_DISTRIBUTOR_BUFFER_IN_SECONDS), (size_t)(1.2 * lineSize));
 
-//                std::cout << "Buffer Max: " << bufferMax << std::endl;
-                bufferOffset = 0;
+//                std::cout << "Buffer Max: " << newBufferMax << std::endl;
                 bufferedItems = 0;
-				inputBuffer.sampleRate = inp->sampleRate;
-				inputBuffer.frequency = inp->frequency;
-                inputBuffer.data.resize(bufferMax);
+				inputSampleRate = inp->sampleRate;
+				inputFrequency = inp->frequency;
+                replaceRing(newBufferMax, lineSize);
 			}
 
-            //adjust (bufferMax ; inputBuffer.data) in case of FFT size change only.
-            if (bufferMax < (size_t)(1.2 * fftSize.load())) {
-                bufferMax = (size_t)(1.2 * fftSize.load());
-                inputBuffer.data.resize(bufferMax);
+            //adjust (bufferMax ; ring mirror) in case of FFT size change only, keeping the unread samples.
+            if (bufferMax < (size_t)(1.2 * lineSize) || ringMirror != lineSize) {
+                replaceRing(std::max(bufferMax, (size_t)(1.2 * lineSize)), lineSize);
             }
 
             size_t nbSamplesToAdd = inp->data.size();
 
-            //No room left in inputBuffer.data to accept inp->data.size() more samples.
-            //so make room by sliding left of bufferOffset, which is fine because 
-            //those samples has already been processed.
-            if ((bufferOffset + bufferedItems + inp->data.size()) > bufferMax) {
-                memmove(&inputBuffer.data[0], &inputBuffer.data[bufferOffset], bufferedItems*sizeof(liquid_float_complex));
-                bufferOffset = 0;
-                //if there are too much samples, we may even overflow !
-                //as a fallback strategy, drop the last incomming new samples not fitting in inputBuffer.data.
-                if (bufferedItems + inp->data.size() > bufferMax) {
-                    //clamp nbSamplesToAdd
-                    nbSamplesToAdd = bufferMax - bufferedItems;
-                    std::cout << "FFTDataDistributor::process() incoming samples overflow, dropping the last " << (inp->data.size() - nbSamplesToAdd) << " input samples..." << std::endl;
-                }
+            //No room left in the ring to accept inp->data.size() more samples without overwriting unread ones:
+            //as a fallback strategy, drop the last incomming new samples not fitting in.
+            if (bufferedItems + nbSamplesToAdd > bufferMax) {
+                //clamp nbSamplesToAdd
+                nbSamplesToAdd = bufferMax - bufferedItems;
+                std::cout << "FFTDataDistributor::process() incoming samples overflow, dropping the last " << (inp->data.size() - nbSamplesToAdd) << " input samples..." << std::endl;
+            }
+
+            uint64_t writeIndex = readIndex + bufferedItems;
+
+            //lines sent earlier are still being used where the new samples go: leave them their ring.
+            if (isRingInUse(writeIndex + nbSamplesToAdd)) {
+                replaceRing(bufferMax, lineSize);
             }
             
             //store nbSamplesToAdd incoming samples. 
-            memcpy(&inputBuffer.data[bufferOffset+bufferedItems],&inp->data[0], nbSamplesToAdd *sizeof(liquid_float_complex));
+            writeRing(writeIndex, inp->data.data(), nbSamplesToAdd);
             bufferedItems += nbSamplesToAdd;
             //
 		
@@ -86,9 +170,9 @@ void FFTDataDistributor::process() {
 		}
 
 		// number of seconds contained in input
-		double inputTime = (double)bufferedItems / (double)inputBuffer.sampleRate;
+		double inputTime = (double)bufferedItems / (double)inputSampleRate;
 		// number of lines in input
-		double inputLines = (double)bufferedItems / (double)fftSize;
+		double inputLines = (double)bufferedItems / (double)lineSize;
 
 		// ratio required to achieve the desired rate:
         // it means we can achieive 'lineRateStep' times the target linesPerSecond.
@@ -96,48 +180,41 @@ void FFTDataDistributor::process() {
 		double lineRateStep = ((double)linesPerSecond * inputTime)/(double)inputLines;
 
         //we have enough samples to FFT at least one 'line' of 'fftSize' frequencies for display:
-		if (bufferedItems >= fftSize) {
+		if (bufferedItems >= lineSize) {
 			size_t numProcessed = 0;
-			if (lineRateAccum + (lineRateStep * ((double)bufferedItems/(double)fftSize)) < 1.0) {
+            if (fullRate.load()) {
+                //every sample goes into a line.
+                for (; numProcessed + lineSize <= bufferedItems; numProcessed += lineSize) {
+                    distributeLine(readIndex + numProcessed, lineSize);
+                }
+            } else if (lineRateAccum + (lineRateStep * ((double)bufferedItems/(double)lineSize)) < 1.0) {
 				// move along, nothing to see here..
-				lineRateAccum += (lineRateStep * ((double)bufferedItems/(double)fftSize));
+				lineRateAccum += (lineRateStep * ((double)bufferedItems/(double)lineSize));
 				numProcessed = bufferedItems;
 			} else {
-				for (size_t i = 0, iMax = bufferedItems; i < iMax; i += fftSize) {
-					if ((i + fftSize) > iMax) {
+				for (size_t i = 0, iMax = bufferedItems; i < iMax; i += lineSize) {
+					if ((i + lineSize) > iMax) {
 						break;
 					}
 					lineRateAccum += lineRateStep;
 
 					if (lineRateAccum >= 1.0) {
-                        //each i represents a FFT computation
-                        DemodulatorThreadIQDataPtr outp = outputBuffers.getBuffer();
-
-						outp->frequency = inputBuffer.frequency;
-						outp->sampleRate = inputBuffer.sampleRate;
-						outp->data.assign(inputBuffer.data.begin()+bufferOffset+i,
-                                          inputBuffer.data.begin()+bufferOffset+i+ fftSize);
-                        //authorize distribute with losses
-						distribute(outp, NON_BLOCKING_TIMEOUT);
+                        //each i represents a FFT computation, of a view of the ring.
+                        distributeLine(readIndex + i, lineSize);
 
 						while (lineRateAccum >= 1.0) {
 							lineRateAccum -= 1.0;
 						}
 					}
 
-					numProcessed += fftSize;
+					numProcessed += lineSize;
 				} //end for 
 			}
-            //advance bufferOffset read pointer, 
+            //advance the readIndex read pointer, 
             //reduce size of bufferedItems.
 			if (numProcessed) {
                 bufferedItems -= numProcessed;
-                bufferOffset += numProcessed;
-            }
-            //clamp to zero the number of remaining items.
-            if (bufferedItems <= 0) {
-                bufferedItems = 0;
-                bufferOffset = 0;
+                readIndex += numProcessed;
             }
 		} //end if bufferedItems >= fftSize
 	} //en while
@@ -7,25 +7,55 @@
 #include "DemodDefs.h"
 #include <cmath>
 #include <cstring>
+#include <cstdint>
 #include <atomic>
+#include <deque>
 
+//Cut the input samples into lines of fftSize samples, at linesPerSecond.
+//The input is stored once into a ring, and the lines are views of it sent without copy:
+//the ring is followed by a mirror of its first fftSize samples so that any line of it is contiguous,
+//and it is swapped for another one, rather than overwritten, while lines of it are still in use.
+//In full rate mode, every input sample goes into a line instead: the lines are all of the samples
+//of each display line, for the consumer to fold the FFTs of.
 class FFTDataDistributor : public VisualProcessor<DemodulatorThreadIQData, DemodulatorThreadIQData> {
 public:
     FFTDataDistributor();
     void setFFTSize(unsigned int size);
     void setLinesPerSecond(unsigned int lines);
     unsigned int getLinesPerSecond();
+    void setFullRate(bool enabled);
+    bool isFullRate();
 
 protected:
     virtual void process();
-    
-    DemodulatorThreadIQData inputBuffer, tempBuffer;
-    ReBuffer<DemodulatorThreadIQData> outputBuffers;
+
+    typedef std::vector<liquid_float_complex> RingSegment;
+
+    //store count samples from src at the absolute input index from.
+    void writeRing(uint64_t from, const liquid_float_complex *src, size_t count);
+    //move the unread samples to a ring of capacity samples with a mirror of lineSize,
+    //the lines still in use keeping the previous one.
+    void replaceRing(size_t capacity, size_t lineSize);
+    //true if storing the samples up to the absolute input index end would overwrite a line in use.
+    bool isRingInUse(uint64_t end);
+    //send the line of size samples from the absolute input index start.
+    void distributeLine(uint64_t start, size_t size);
+
+    std::shared_ptr<RingSegment> ring, spareRing;
+    size_t ringMirror = 0;
+
+    //lines sent, with their first absolute input index, oldest first.
+    std::deque<std::pair<std::weak_ptr<DemodulatorThreadIQData>, uint64_t>> linesInUse;
+
     std::atomic<unsigned int> fftSize;
+    std::atomic_bool fullRate;
    
     unsigned int linesPerSecond;
     double lineRateAccum;
+    long long inputFrequency = 0;
+    long long inputSampleRate = 0;
     size_t bufferMax = 0;
-    size_t bufferOffset = 0;
     size_t bufferedItems = 0;
+    //absolute input index of the first unread sample, the next one being written at readIndex + bufferedItems.
+    uint64_t readIndex = 0;
 };
@@ -22,6 +22,15 @@ int FFTVisualDataThread::getLinesPerSecond() {
     return linesPerSecond.load();
 }
 
+void FFTVisualDataThread::setFullRate(bool enabled, SpectrumEstimator::FoldType fold) {
+    wproc.setFullRate(enabled, fold);
+    fftDistrib.setFullRate(enabled);
+}
+
+bool FFTVisualDataThread::isFullRate() {
+    return fftDistrib.isFullRate();
+}
+
 SpectrumVisualProcessor *FFTVisualDataThread::getProcessor() {
     return &wproc;
 }
@@ -14,6 +14,9 @@ public:
     
     void setLinesPerSecond(int lps);
     int getLinesPerSecond();
+    //FFT all of the input and fold it into each line, instead of sampling lines of it.
+    void setFullRate(bool enabled, SpectrumEstimator::FoldType fold);
+    bool isFullRate();
     SpectrumVisualProcessor *getProcessor();
     
     virtual void run();
@@ -22,7 +25,7 @@ public:
     
 protected:
     FFTDataDistributor fftDistrib;
-    DemodulatorThreadInputQueuePtr fftQueue = std::make_shared<DemodulatorThreadInputQueue>();
+    DemodulatorThreadInputQueuePtr fftQueue = std::make_shared<ThreadBlockingQueue<DemodulatorThreadIQDataPtr>>();
     SpectrumVisualProcessor wproc;
     
     std::atomic_int linesPerSecond;
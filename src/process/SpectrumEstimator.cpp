@@ -0,0 +1,395 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "SpectrumEstimator.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+//Frames per task at least, when spread over a worker pool.
+#define SPECTRUM_ESTIMATOR_MIN_FRAMES_PER_TASK 4
+
+#define SPECTRUM_ESTIMATOR_MAX_OVERLAP 75
+
+// Plain C++ versions, also used for the tails of the vectorized ones.
+static void windowGeneric(const float *src, const float *window, float *dst, size_t numFloats) {
+    for (size_t i = 0; i < numFloats; i++) {
+        dst[i] = src[i] * window[i];
+    }
+}
+
+static void powerGeneric(const float *x, float *sum, size_t numBins) {
+    for (size_t k = 0; k < numBins; k++) {
+        sum[k] += x[2 * k] * x[2 * k] + x[2 * k + 1] * x[2 * k + 1];
+    }
+}
+
+static void powerMaxGeneric(const float *x, float *sum, size_t numBins) {
+    for (size_t k = 0; k < numBins; k++) {
+        sum[k] = std::max(sum[k], x[2 * k] * x[2 * k] + x[2 * k + 1] * x[2 * k + 1]);
+    }
+}
+
+#if CUBICSDR_SIMD_X86
+CUBICSDR_TARGET_SSE2 static void windowSSE2(const float *src, const float *window, float *dst, size_t numFloats) {
+    size_t i = 0;
+
+    for (; i + 4 <= numFloats; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(window + i)));
+    }
+
+    windowGeneric(src + i, window + i, dst + i, numFloats - i);
+}
+
+//4 bins at a time: the squares of 2 x [re, im, re, im] are split into their re and im parts, then added.
+CUBICSDR_TARGET_SSE2 static void powerSSE2(const float *x, float *sum, size_t numBins) {
+    size_t k = 0;
+
+    for (; k + 4 <= numBins; k += 4) {
+        __m128 a = _mm_loadu_ps(x + 2 * k);
+        __m128 b = _mm_loadu_ps(x + 2 * k + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+        _mm_storeu_ps(sum + k, _mm_add_ps(_mm_loadu_ps(sum + k), _mm_add_ps(re, im)));
+    }
+
+    powerGeneric(x + 2 * k, sum + k, numBins - k);
+}
+
+CUBICSDR_TARGET_SSE2 static void powerMaxSSE2(const float *x, float *sum, size_t numBins) {
+    size_t k = 0;
+
+    for (; k + 4 <= numBins; k += 4) {
+        __m128 a = _mm_loadu_ps(x + 2 * k);
+        __m128 b = _mm_loadu_ps(x + 2 * k + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+        _mm_storeu_ps(sum + k, _mm_max_ps(_mm_loadu_ps(sum + k), _mm_add_ps(re, im)));
+    }
+
+    powerMaxGeneric(x + 2 * k, sum + k, numBins - k);
+}
+
+CUBICSDR_TARGET_AVX2 static void windowAVX2(const float *src, const float *window, float *dst, size_t numFloats) {
+    size_t i = 0;
+
+    for (; i + 8 <= numFloats; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(window + i)));
+    }
+
+    windowGeneric(src + i, window + i, dst + i, numFloats - i);
+}
+
+//8 bins at a time: the shuffles work within 128 bit lanes, so the bin pairs come out
+//as [0 1 4 5 2 3 6 7] and are put back in order by 64 bit chunks.
+CUBICSDR_TARGET_AVX2 static void powerAVX2(const float *x, float *sum, size_t numBins) {
+    size_t k = 0;
+
+    for (; k + 8 <= numBins; k += 8) {
+        __m256 a = _mm256_loadu_ps(x + 2 * k);
+        __m256 b = _mm256_loadu_ps(x + 2 * k + 8);
+        a = _mm256_mul_ps(a, a);
+        b = _mm256_mul_ps(b, b);
+
+        __m256 p = _mm256_add_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        p = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(p), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        _mm256_storeu_ps(sum + k, _mm256_add_ps(_mm256_loadu_ps(sum + k), p));
+    }
+
+    powerGeneric(x + 2 * k, sum + k, numBins - k);
+}
+
+CUBICSDR_TARGET_AVX2 static void powerMaxAVX2(const float *x, float *sum, size_t numBins) {
+    size_t k = 0;
+
+    for (; k + 8 <= numBins; k += 8) {
+        __m256 a = _mm256_loadu_ps(x + 2 * k);
+        __m256 b = _mm256_loadu_ps(x + 2 * k + 8);
+        a = _mm256_mul_ps(a, a);
+        b = _mm256_mul_ps(b, b);
+
+        __m256 p = _mm256_add_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        p = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(p), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        _mm256_storeu_ps(sum + k, _mm256_max_ps(_mm256_loadu_ps(sum + k), p));
+    }
+
+    powerMaxGeneric(x + 2 * k, sum + k, numBins - k);
+}
+#endif
+
+#if CUBICSDR_SIMD_NEON
+static void windowNEON(const float *src, const float *window, float *dst, size_t numFloats) {
+    size_t i = 0;
+
+    for (; i + 4 <= numFloats; i += 4) {
+        vst1q_f32(dst + i, vmulq_f32(vld1q_f32(src + i), vld1q_f32(window + i)));
+    }
+
+    windowGeneric(src + i, window + i, dst + i, numFloats - i);
+}
+
+//4 bins at a time, de-interleaved by the load.
+static void powerNEON(const float *x, float *sum, size_t numBins) {
+    size_t k = 0;
+
+    for (; k + 4 <= numBins; k += 4) {
+        float32x4x2_t v = vld2q_f32(x + 2 * k);
+        float32x4_t s = vld1q_f32(sum + k);
+
+        s = vmlaq_f32(s, v.val[0], v.val[0]);
+        s = vmlaq_f32(s, v.val[1], v.val[1]);
+        vst1q_f32(sum + k, s);
+    }
+
+    powerGeneric(x + 2 * k, sum + k, numBins - k);
+}
+
+static void powerMaxNEON(const float *x, float *sum, size_t numBins) {
+    size_t k = 0;
+
+    for (; k + 4 <= numBins; k += 4) {
+        float32x4x2_t v = vld2q_f32(x + 2 * k);
+        float32x4_t p = vmulq_f32(v.val[0], v.val[0]);
+
+        p = vmlaq_f32(p, v.val[1], v.val[1]);
+        vst1q_f32(sum + k, vmaxq_f32(vld1q_f32(sum + k), p));
+    }
+
+    powerMaxGeneric(x + 2 * k, sum + k, numBins - k);
+}
+#endif
+
+SpectrumEstimator::Context::Context(size_t fftSize) : fftIn(fftSize), fftOut(fftSize), powerSum(fftSize, 0.0f) {
+    fftPlan = fft_create_plan(fftSize, &fftIn[0], &fftOut[0], LIQUID_FFT_FORWARD, 0);
+}
+
+SpectrumEstimator::Context::~Context() {
+    fft_destroy_plan(fftPlan);
+}
+
+SpectrumEstimator::SpectrumEstimator() : fftSize(0), step(0), powerScale(1.0f), historySize(0), workerPool(nullptr), numFrames(0), fold(FOLD_MEAN) {
+    simdLevel = CPUFeatures::getSIMDLevel();
+
+    switch (simdLevel) {
+#if CUBICSDR_SIMD_X86
+        case CPUFeatures::SIMD_AVX2:
+            windowKernel = &windowAVX2;
+            powerKernel = &powerAVX2;
+            powerMaxKernel = &powerMaxAVX2;
+            break;
+        case CPUFeatures::SIMD_SSE2:
+            windowKernel = &windowSSE2;
+            powerKernel = &powerSSE2;
+            powerMaxKernel = &powerMaxSSE2;
+            break;
+#endif
+#if CUBICSDR_SIMD_NEON
+        case CPUFeatures::SIMD_NEON:
+            windowKernel = &windowNEON;
+            powerKernel = &powerNEON;
+            powerMaxKernel = &powerMaxNEON;
+            break;
+#endif
+        default:
+            simdLevel = CPUFeatures::SIMD_NONE;
+            windowKernel = &windowGeneric;
+            powerKernel = &powerGeneric;
+            powerMaxKernel = &powerMaxGeneric;
+            break;
+    }
+}
+
+SpectrumEstimator::~SpectrumEstimator() {
+}
+
+void SpectrumEstimator::setup(size_t fftSize_in, WindowType windowType, int overlapPercent, WorkerPool *workerPool_in) {
+    fftSize = fftSize_in;
+    workerPool = workerPool_in;
+
+    overlapPercent = std::min(std::max(overlapPercent, 0), SPECTRUM_ESTIMATOR_MAX_OVERLAP);
+    step = std::max((size_t)1, fftSize * (100 - overlapPercent) / 100);
+
+    makeWindow(windowType);
+
+    history.resize(fftSize);
+
+    size_t numContexts = (workerPool != nullptr) ? (workerPool->getNumThreads() + 1) : 1;
+
+    contexts.clear();
+    for (size_t i = 0; i < numContexts; i++) {
+        contexts.push_back(std::unique_ptr<Context>(new Context(fftSize)));
+    }
+
+    reset();
+}
+
+size_t SpectrumEstimator::getFFTSize() {
+    return fftSize;
+}
+
+void SpectrumEstimator::setFold(FoldType fold_in) {
+    fold = fold_in;
+    reset();
+}
+
+SpectrumEstimator::FoldType SpectrumEstimator::getFold() {
+    return fold;
+}
+
+void SpectrumEstimator::makeWindow(WindowType windowType) {
+    //cosine sum coefficients of each window, periodic (DFT-even) form.
+    static const double coefs[4][5] = {
+        { 1.0, 0, 0, 0, 0 },
+        { 0.5, 0.5, 0, 0, 0 },
+        { 0.35875, 0.48829, 0.14128, 0.01168, 0 },
+        { 0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368 }
+    };
+
+    const double *a = coefs[std::min(std::max((int)windowType, 0), 3)];
+    double sum = 0;
+
+    window.resize(fftSize * 2);
+
+    for (size_t n = 0; n < fftSize; n++) {
+        double x = 2.0 * M_PI * (double)n / (double)fftSize;
+        double w = a[0] - a[1] * cos(x) + a[2] * cos(2.0 * x) - a[3] * cos(3.0 * x) + a[4] * cos(4.0 * x);
+
+        window[2 * n] = window[2 * n + 1] = (float)w;
+        sum += w;
+    }
+
+    //a tone of amplitude A peaks at A * sum(w) instead of A * fftSize.
+    double gain = (double)fftSize / sum;
+    powerScale = (float)(gain * gain);
+}
+
+void SpectrumEstimator::reset() {
+    historySize = 0;
+    numFrames = 0;
+
+    for (std::unique_ptr<Context>& ctx : contexts) {
+        std::fill(ctx->powerSum.begin(), ctx->powerSum.end(), 0.0f);
+    }
+}
+
+void SpectrumEstimator::processFrame(Context& ctx, size_t start, const liquid_float_complex *in) {
+    float *dst = (float *)&ctx.fftIn[0];
+    size_t done = 0;
+
+    // the frame can start in the history, and continue in the new input.
+    if (start < historySize) {
+        done = std::min(fftSize, historySize - start);
+        windowKernel((const float *)&history[start], &window[0], dst, 2 * done);
+    }
+    if (done < fftSize) {
+        const liquid_float_complex *src = in + (start + done - historySize);
+        windowKernel((const float *)src, &window[2 * done], dst + 2 * done, 2 * (fftSize - done));
+    }
+
+    fft_execute(ctx.fftPlan);
+
+    if (fold == FOLD_MAX) {
+        powerMaxKernel((const float *)&ctx.fftOut[0], &ctx.powerSum[0], fftSize);
+    } else {
+        powerKernel((const float *)&ctx.fftOut[0], &ctx.powerSum[0], fftSize);
+    }
+}
+
+void SpectrumEstimator::feed(const liquid_float_complex *in, size_t numSamples) {
+    if (fftSize == 0 || numSamples == 0) {
+        return;
+    }
+
+    size_t total = historySize + numSamples;
+    size_t frames = (total >= fftSize) ? ((total - fftSize) / step + 1) : 0;
+
+    if (frames > 0) {
+        size_t numParts = 1;
+
+        if (workerPool != nullptr) {
+            numParts = std::max((size_t)1, std::min(contexts.size(), frames / SPECTRUM_ESTIMATOR_MIN_FRAMES_PER_TASK));
+        }
+
+        if (numParts > 1) {
+            workerPool->parallelFor(numParts, [this, in, frames, numParts](size_t p) {
+                for (size_t f = frames * p / numParts, fEnd = frames * (p + 1) / numParts; f < fEnd; f++) {
+                    processFrame(*contexts[p], f * step, in);
+                }
+            });
+        } else {
+            for (size_t f = 0; f < frames; f++) {
+                processFrame(*contexts[0], f * step, in);
+            }
+        }
+
+        numFrames += frames;
+    }
+
+    // Keep the samples from the start of the next frame on.
+    size_t next = frames * step;
+
+    if (next < historySize) {
+        std::memmove(&history[0], &history[next], (historySize - next) * sizeof(liquid_float_complex));
+        std::memcpy(&history[historySize - next], in, numSamples * sizeof(liquid_float_complex));
+    } else {
+        std::memcpy(&history[0], in + (next - historySize), (total - next) * sizeof(liquid_float_complex));
+    }
+
+    historySize = total - next;
+}
+
+size_t SpectrumEstimator::getNumFrames() {
+    return numFrames;
+}
+
+void SpectrumEstimator::takeMagnitudes(std::vector<float>& magnitudes) {
+    magnitudes.assign(fftSize, 0.0f);
+
+    if (numFrames == 0) {
+        return;
+    }
+
+    std::vector<float>& total = contexts[0]->powerSum;
+
+    for (size_t c = 1; c < contexts.size(); c++) {
+        std::vector<float>& sum = contexts[c]->powerSum;
+
+        if (fold == FOLD_MAX) {
+            for (size_t k = 0; k < fftSize; k++) {
+                total[k] = std::max(total[k], sum[k]);
+            }
+        } else {
+            for (size_t k = 0; k < fftSize; k++) {
+                total[k] += sum[k];
+            }
+        }
+        std::fill(sum.begin(), sum.end(), 0.0f);
+    }
+
+    float scale = (fold == FOLD_MAX) ? powerScale : (powerScale / (float)numFrames);
+
+    for (size_t k = 0; k < fftSize; k++) {
+        magnitudes[k] = sqrtf(total[k] * scale);
+    }
+
+    std::fill(total.begin(), total.end(), 0.0f);
+    numFrames = 0;
+}
+
+CPUFeatures::SIMDLevel SpectrumEstimator::getSIMDLevel() {
+    return simdLevel;
+}
@@ -0,0 +1,100 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "liquid/liquid.h"
+#include "CPUFeatures.h"
+#include "WorkerPool.h"
+
+//Welch power spectrum estimator: every input sample goes through overlapping windowed frames,
+//whose power spectra are averaged until the result is taken.
+//Compared to a single FFT of the latest samples, all the input is used, which brings out weak
+//carriers and steadies the noise floor, and the window keeps strong signals from leaking over the band.
+class SpectrumEstimator {
+public:
+    enum WindowType {
+        WINDOW_RECTANGULAR = 0,
+        WINDOW_HANN = 1,
+        WINDOW_BLACKMAN_HARRIS = 2,
+        WINDOW_FLAT_TOP = 3
+    };
+
+    //How the frames are combined: averaged, or the max of each bin so that a burst as short
+    //as a frame shows at its full level.
+    enum FoldType {
+        FOLD_MEAN = 0,
+        FOLD_MAX = 1
+    };
+
+    SpectrumEstimator();
+    ~SpectrumEstimator();
+
+    //(Re)configure for frames of fftSize samples overlapping by overlapPercent (0 to 75),
+    //the frames being spread over workerPool if not nullptr. Resets the estimate.
+    void setup(size_t fftSize, WindowType window, int overlapPercent, WorkerPool *workerPool);
+    size_t getFFTSize();
+
+    //FOLD_MEAN by default. Resets the estimate.
+    void setFold(FoldType fold);
+    FoldType getFold();
+
+    //Forget the pending samples and the frames accumulated so far, e.g. after a change of input.
+    void reset();
+
+    //Process numSamples more input samples: all the frames completed are accumulated,
+    //the remaining samples are kept to start the next ones.
+    void feed(const liquid_float_complex *in, size_t numSamples);
+
+    //frames accumulated since the last takeMagnitudes().
+    size_t getNumFrames();
+
+    //Average, or max, over the accumulated frames, as magnitudes in FFT order, then restart accumulating.
+    //The magnitudes are scaled by the window coherent gain, so that a tone reads the same
+    //as with the unwindowed FFT of a single frame.
+    void takeMagnitudes(std::vector<float>& magnitudes);
+
+    CPUFeatures::SIMDLevel getSIMDLevel();
+
+    //dst[i] = src[i] * window[i] on numFloats floats, the window having each coefficient twice for I and Q.
+    typedef void (*WindowKernel)(const float *src, const float *window, float *dst, size_t numFloats);
+    //sum[k] += re(x[k])^2 + im(x[k])^2 for numBins complex bins, or sum[k] = max(sum[k], ...) for the max kernels.
+    typedef void (*PowerKernel)(const float *x, float *sum, size_t numBins);
+
+private:
+    //FFT and power sum of a series of frames, one per concurrent task.
+    struct Context {
+        Context(size_t fftSize);
+        ~Context();
+
+        std::vector<liquid_float_complex> fftIn, fftOut;
+        fftplan fftPlan;
+        //sum, or max, of the frame powers.
+        std::vector<float> powerSum;
+    };
+
+    void makeWindow(WindowType window);
+
+    //window, transform and accumulate the frame starting at start, counted from the beginning of the history.
+    void processFrame(Context& ctx, size_t start, const liquid_float_complex *in);
+
+    size_t fftSize, step;
+    std::vector<float> window;
+    //scale from the average power to the magnitude of an unwindowed FFT.
+    float powerScale;
+
+    //input samples not yet consumed by a frame, fewer than fftSize.
+    std::vector<liquid_float_complex> history;
+    size_t historySize;
+
+    std::vector<std::unique_ptr<Context>> contexts;
+    WorkerPool *workerPool;
+    size_t numFrames;
+    FoldType fold;
+
+    CPUFeatures::SIMDLevel simdLevel;
+    WindowKernel windowKernel;
+    PowerKernel powerKernel, powerMaxKernel;
+};
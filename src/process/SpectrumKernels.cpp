@@ -0,0 +1,454 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "SpectrumKernels.h"
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+#include <cstdint>
+#include <algorithm>
+
+//log2(1 + f) ~= f * (C1 + f * (C2 + f * (C3 + f * (C4 + f * C5)))) for f in [0, 1),
+//least squares fit, max error 2.8e-5.
+#define LOG2_C1 1.4418255f
+#define LOG2_C2 -0.708678912f
+#define LOG2_C3 0.415411186f
+#define LOG2_C4 -0.194408323f
+#define LOG2_C5 0.0458789501f
+
+// Plain C++ versions, also used for the tails of the vectorized ones.
+static void magnitudeGeneric(const float *x, float *out, size_t numBins) {
+    for (size_t k = 0; k < numBins; k++) {
+        out[k] = sqrtf(x[2 * k] * x[2 * k] + x[2 * k + 1] * x[2 * k + 1]);
+    }
+}
+
+static void averageGeneric(const float *in, float *ma, float *maa, float *peak, size_t numBins, float rate, float& minVal, float& maxVal) {
+    float vMin = minVal, vMax = maxVal;
+
+    for (size_t i = 0; i < numBins; i++) {
+        float r = in[i];
+        float a = ma[i];
+        float aa = maa[i];
+
+        if (aa != aa) {
+            aa = r;
+        }
+        aa += (a - aa) * rate;
+        if (a != a) {
+            a = r;
+        }
+        a += (r - a) * rate;
+
+        ma[i] = a;
+        maa[i] = aa;
+
+        if (aa < vMin) {
+            vMin = aa;
+        }
+        if (aa > vMax) {
+            vMax = aa;
+        }
+        if (peak && aa > peak[i]) {
+            peak[i] = aa;
+        }
+    }
+
+    minVal = vMin;
+    maxVal = vMax;
+}
+
+static inline float fastLog2(float x) {
+    uint32_t bits;
+
+    x = std::max(x, FLT_MIN);
+    memcpy(&bits, &x, sizeof(bits));
+
+    float e = (float)((int)(bits >> 23) - 127);
+    bits = (bits & 0x007fffff) | 0x3f800000;
+
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+
+    float f = m - 1.0f;
+
+    return e + f * (LOG2_C1 + f * (LOG2_C2 + f * (LOG2_C3 + f * (LOG2_C4 + f * LOG2_C5))));
+}
+
+static void logGeneric(const float *in, float *out, size_t n, float offset, float scale) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = fastLog2(in[i] + offset) * scale;
+    }
+}
+
+#if CUBICSDR_SIMD_X86
+//4 bins at a time, the squares of 2 x [re, im, re, im] being split into their re and im parts.
+CUBICSDR_TARGET_SSE2 static void magnitudeSSE2(const float *x, float *out, size_t numBins) {
+    size_t k = 0;
+
+    for (; k + 4 <= numBins; k += 4) {
+        __m128 a = _mm_loadu_ps(x + 2 * k);
+        __m128 b = _mm_loadu_ps(x + 2 * k + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+
+        __m128 p = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_ps(out + k, _mm_sqrt_ps(p));
+    }
+
+    magnitudeGeneric(x + 2 * k, out + k, numBins - k);
+}
+
+//NaN are replaced by a select on an unordered compare, and left out of min / max
+//as _mm_min_ps / _mm_max_ps return their second operand when either is NaN.
+CUBICSDR_TARGET_SSE2 static void averageSSE2(const float *in, float *ma, float *maa, float *peak, size_t numBins, float rate, float& minVal, float& maxVal) {
+    __m128 vRate = _mm_set1_ps(rate);
+    __m128 vMin = _mm_set1_ps(minVal);
+    __m128 vMax = _mm_set1_ps(maxVal);
+    size_t i = 0;
+
+    for (; i + 4 <= numBins; i += 4) {
+        __m128 r = _mm_loadu_ps(in + i);
+        __m128 a = _mm_loadu_ps(ma + i);
+        __m128 aa = _mm_loadu_ps(maa + i);
+
+        __m128 nan = _mm_cmpunord_ps(aa, aa);
+        aa = _mm_or_ps(_mm_and_ps(nan, r), _mm_andnot_ps(nan, aa));
+        aa = _mm_add_ps(aa, _mm_mul_ps(_mm_sub_ps(a, aa), vRate));
+
+        nan = _mm_cmpunord_ps(a, a);
+        a = _mm_or_ps(_mm_and_ps(nan, r), _mm_andnot_ps(nan, a));
+        a = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(r, a), vRate));
+
+        _mm_storeu_ps(ma + i, a);
+        _mm_storeu_ps(maa + i, aa);
+
+        vMin = _mm_min_ps(aa, vMin);
+        vMax = _mm_max_ps(aa, vMax);
+
+        if (peak) {
+            _mm_storeu_ps(peak + i, _mm_max_ps(aa, _mm_loadu_ps(peak + i)));
+        }
+    }
+
+    float mins[4], maxs[4];
+    _mm_storeu_ps(mins, vMin);
+    _mm_storeu_ps(maxs, vMax);
+    minVal = std::min(std::min(mins[0], mins[1]), std::min(mins[2], mins[3]));
+    maxVal = std::max(std::max(maxs[0], maxs[1]), std::max(maxs[2], maxs[3]));
+
+    averageGeneric(in + i, ma + i, maa + i, peak ? peak + i : nullptr, numBins - i, rate, minVal, maxVal);
+}
+
+CUBICSDR_TARGET_SSE2 static void logSSE2(const float *in, float *out, size_t n, float offset, float scale) {
+    __m128 vOffset = _mm_set1_ps(offset);
+    __m128 vScale = _mm_set1_ps(scale);
+    __m128 vMinNorm = _mm_set1_ps(FLT_MIN);
+    __m128 vOne = _mm_set1_ps(1.0f);
+    __m128i mantissaMask = _mm_set1_epi32(0x007fffff);
+    __m128i exponentOne = _mm_set1_epi32(0x3f800000);
+    __m128i bias = _mm_set1_epi32(127);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(in + i), vOffset), vMinNorm);
+        __m128i bits = _mm_castps_si128(x);
+
+        __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), bias));
+        __m128 f = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissaMask), exponentOne)), vOne);
+
+        __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(LOG2_C5), f), _mm_set1_ps(LOG2_C4));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG2_C3));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG2_C2));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(LOG2_C1));
+        p = _mm_mul_ps(p, f);
+
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(e, p), vScale));
+    }
+
+    logGeneric(in + i, out + i, n - i, offset, scale);
+}
+
+//8 bins at a time: the shuffles work within 128 bit lanes, so the bins come out
+//as [0 1 4 5 2 3 6 7] and are put back in order by 64 bit chunks.
+CUBICSDR_TARGET_AVX2 static void magnitudeAVX2(const float *x, float *out, size_t numBins) {
+    size_t k = 0;
+
+    for (; k + 8 <= numBins; k += 8) {
+        __m256 a = _mm256_loadu_ps(x + 2 * k);
+        __m256 b = _mm256_loadu_ps(x + 2 * k + 8);
+        a = _mm256_mul_ps(a, a);
+        b = _mm256_mul_ps(b, b);
+
+        __m256 p = _mm256_add_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        p = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(p), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        _mm256_storeu_ps(out + k, _mm256_sqrt_ps(p));
+    }
+
+    magnitudeGeneric(x + 2 * k, out + k, numBins - k);
+}
+
+CUBICSDR_TARGET_AVX2 static void averageAVX2(const float *in, float *ma, float *maa, float *peak, size_t numBins, float rate, float& minVal, float& maxVal) {
+    __m256 vRate = _mm256_set1_ps(rate);
+    __m256 vMin = _mm256_set1_ps(minVal);
+    __m256 vMax = _mm256_set1_ps(maxVal);
+    size_t i = 0;
+
+    for (; i + 8 <= numBins; i += 8) {
+        __m256 r = _mm256_loadu_ps(in + i);
+        __m256 a = _mm256_loadu_ps(ma + i);
+        __m256 aa = _mm256_loadu_ps(maa + i);
+
+        aa = _mm256_blendv_ps(aa, r, _mm256_cmp_ps(aa, aa, _CMP_UNORD_Q));
+        aa = _mm256_fmadd_ps(_mm256_sub_ps(a, aa), vRate, aa);
+
+        a = _mm256_blendv_ps(a, r, _mm256_cmp_ps(a, a, _CMP_UNORD_Q));
+        a = _mm256_fmadd_ps(_mm256_sub_ps(r, a), vRate, a);
+
+        _mm256_storeu_ps(ma + i, a);
+        _mm256_storeu_ps(maa + i, aa);
+
+        vMin = _mm256_min_ps(aa, vMin);
+        vMax = _mm256_max_ps(aa, vMax);
+
+        if (peak) {
+            _mm256_storeu_ps(peak + i, _mm256_max_ps(aa, _mm256_loadu_ps(peak + i)));
+        }
+    }
+
+    float mins[8], maxs[8];
+    _mm256_storeu_ps(mins, vMin);
+    _mm256_storeu_ps(maxs, vMax);
+    minVal = *std::min_element(mins, mins + 8);
+    maxVal = *std::max_element(maxs, maxs + 8);
+
+    averageGeneric(in + i, ma + i, maa + i, peak ? peak + i : nullptr, numBins - i, rate, minVal, maxVal);
+}
+
+CUBICSDR_TARGET_AVX2 static void logAVX2(const float *in, float *out, size_t n, float offset, float scale) {
+    __m256 vOffset = _mm256_set1_ps(offset);
+    __m256 vScale = _mm256_set1_ps(scale);
+    __m256 vMinNorm = _mm256_set1_ps(FLT_MIN);
+    __m256 vOne = _mm256_set1_ps(1.0f);
+    __m256i mantissaMask = _mm256_set1_epi32(0x007fffff);
+    __m256i exponentOne = _mm256_set1_epi32(0x3f800000);
+    __m256i bias = _mm256_set1_epi32(127);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(in + i), vOffset), vMinNorm);
+        __m256i bits = _mm256_castps_si256(x);
+
+        __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), bias));
+        __m256 f = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, mantissaMask), exponentOne)), vOne);
+
+        __m256 p = _mm256_fmadd_ps(_mm256_set1_ps(LOG2_C5), f, _mm256_set1_ps(LOG2_C4));
+        p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(LOG2_C3));
+        p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(LOG2_C2));
+        p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(LOG2_C1));
+        p = _mm256_mul_ps(p, f);
+
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_add_ps(e, p), vScale));
+    }
+
+    logGeneric(in + i, out + i, n - i, offset, scale);
+}
+#endif
+
+#if CUBICSDR_SIMD_NEON
+//4 bins at a time, de-interleaved by the load. No vector square root on 32 bit ARM.
+static void magnitudeNEON(const float *x, float *out, size_t numBins) {
+    size_t k = 0;
+
+#if defined(__aarch64__)
+    for (; k + 4 <= numBins; k += 4) {
+        float32x4x2_t v = vld2q_f32(x + 2 * k);
+        float32x4_t p = vmulq_f32(v.val[0], v.val[0]);
+
+        p = vmlaq_f32(p, v.val[1], v.val[1]);
+        vst1q_f32(out + k, vsqrtq_f32(p));
+    }
+#endif
+
+    magnitudeGeneric(x + 2 * k, out + k, numBins - k);
+}
+
+//NEON min / max propagate NaN, so NaN lanes are replaced by the current extremes first.
+static void averageNEON(const float *in, float *ma, float *maa, float *peak, size_t numBins, float rate, float& minVal, float& maxVal) {
+    float32x4_t vRate = vdupq_n_f32(rate);
+    float32x4_t vMin = vdupq_n_f32(minVal);
+    float32x4_t vMax = vdupq_n_f32(maxVal);
+    size_t i = 0;
+
+    for (; i + 4 <= numBins; i += 4) {
+        float32x4_t r = vld1q_f32(in + i);
+        float32x4_t a = vld1q_f32(ma + i);
+        float32x4_t aa = vld1q_f32(maa + i);
+
+        aa = vbslq_f32(vceqq_f32(aa, aa), aa, r);
+        aa = vmlaq_f32(aa, vsubq_f32(a, aa), vRate);
+
+        a = vbslq_f32(vceqq_f32(a, a), a, r);
+        a = vmlaq_f32(a, vsubq_f32(r, a), vRate);
+
+        vst1q_f32(ma + i, a);
+        vst1q_f32(maa + i, aa);
+
+        uint32x4_t valid = vceqq_f32(aa, aa);
+        vMin = vminq_f32(vMin, vbslq_f32(valid, aa, vMin));
+        vMax = vmaxq_f32(vMax, vbslq_f32(valid, aa, vMax));
+
+        if (peak) {
+            float32x4_t p = vld1q_f32(peak + i);
+            vst1q_f32(peak + i, vmaxq_f32(p, vbslq_f32(valid, aa, p)));
+        }
+    }
+
+    float mins[4], maxs[4];
+    vst1q_f32(mins, vMin);
+    vst1q_f32(maxs, vMax);
+    minVal = std::min(std::min(mins[0], mins[1]), std::min(mins[2], mins[3]));
+    maxVal = std::max(std::max(maxs[0], maxs[1]), std::max(maxs[2], maxs[3]));
+
+    averageGeneric(in + i, ma + i, maa + i, peak ? peak + i : nullptr, numBins - i, rate, minVal, maxVal);
+}
+
+static void logNEON(const float *in, float *out, size_t n, float offset, float scale) {
+    float32x4_t vOffset = vdupq_n_f32(offset);
+    float32x4_t vMinNorm = vdupq_n_f32(FLT_MIN);
+    float32x4_t vOne = vdupq_n_f32(1.0f);
+    uint32x4_t mantissaMask = vdupq_n_u32(0x007fffff);
+    uint32x4_t exponentOne = vdupq_n_u32(0x3f800000);
+    int32x4_t bias = vdupq_n_s32(127);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = vmaxq_f32(vaddq_f32(vld1q_f32(in + i), vOffset), vMinNorm);
+        uint32x4_t bits = vreinterpretq_u32_f32(x);
+
+        float32x4_t e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), bias));
+        float32x4_t f = vsubq_f32(vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, mantissaMask), exponentOne)), vOne);
+
+        float32x4_t p = vmlaq_f32(vdupq_n_f32(LOG2_C4), vdupq_n_f32(LOG2_C5), f);
+        p = vmlaq_f32(vdupq_n_f32(LOG2_C3), p, f);
+        p = vmlaq_f32(vdupq_n_f32(LOG2_C2), p, f);
+        p = vmlaq_f32(vdupq_n_f32(LOG2_C1), p, f);
+        p = vmulq_f32(p, f);
+
+        vst1q_f32(out + i, vmulq_n_f32(vaddq_f32(e, p), scale));
+    }
+
+    logGeneric(in + i, out + i, n - i, offset, scale);
+}
+#endif
+
+SpectrumKernels::SpectrumKernels() : mapNumBins(0), mapNumPoints(0), mapBinsPerPoint(0), mapFirstBin(0) {
+    simdLevel = CPUFeatures::getSIMDLevel();
+
+    switch (simdLevel) {
+#if CUBICSDR_SIMD_X86
+        case CPUFeatures::SIMD_AVX2:
+            magnitudeKernel = &magnitudeAVX2;
+            averageKernel = &averageAVX2;
+            logKernel = &logAVX2;
+            break;
+        case CPUFeatures::SIMD_SSE2:
+            magnitudeKernel = &magnitudeSSE2;
+            averageKernel = &averageSSE2;
+            logKernel = &logSSE2;
+            break;
+#endif
+#if CUBICSDR_SIMD_NEON
+        case CPUFeatures::SIMD_NEON:
+            magnitudeKernel = &magnitudeNEON;
+            averageKernel = &averageNEON;
+            logKernel = &logNEON;
+            break;
+#endif
+        default:
+            simdLevel = CPUFeatures::SIMD_NONE;
+            magnitudeKernel = &magnitudeGeneric;
+            averageKernel = &averageGeneric;
+            logKernel = &logGeneric;
+            break;
+    }
+
+    pointStart.push_back(0);
+}
+
+void SpectrumKernels::magnitudesShifted(const liquid_float_complex *in, float *out, size_t numBins) {
+    size_t half = numBins / 2;
+
+    magnitudeKernel((const float *)(in + half), out, numBins - half);
+    magnitudeKernel((const float *)in, out + (numBins - half), half);
+}
+
+void SpectrumKernels::average(const float *in, float *ma, float *maa, float *peak, size_t numBins, float rate, float& minVal, float& maxVal) {
+    averageKernel(in, ma, maa, peak, numBins, rate, minVal, maxVal);
+}
+
+void SpectrumKernels::setPointMap(size_t numBins, size_t numPoints, double binsPerPoint, double firstBin) {
+    if (numBins == mapNumBins && numPoints == mapNumPoints && binsPerPoint == mapBinsPerPoint && firstBin == mapFirstBin) {
+        return;
+    }
+
+    mapNumBins = numBins;
+    mapNumPoints = numPoints;
+    mapBinsPerPoint = binsPerPoint;
+    mapFirstBin = firstBin;
+
+    pointBins.clear();
+    pointStart.assign(1, 0);
+
+    //walk the bins as the former per-frame loop did, so that points get the same bins.
+    double accum = 0, i = 0;
+
+    for (size_t x = 0; x < numPoints; x++) {
+        accum += binsPerPoint;
+
+        while (accum >= 1.0) {
+            double idx = round(firstBin + i);
+
+            pointBins.push_back((idx > 0 && idx < (double)numBins) ? (int)idx : -1);
+            accum -= 1.0;
+            i++;
+        }
+
+        pointStart.push_back(pointBins.size());
+    }
+
+    pointMeans.resize(numPoints);
+    pointLogs.resize(numPoints);
+}
+
+void SpectrumKernels::mapPoints(const float *bins, float outsideValue, float offset, float scale, float *points) {
+    float lastMean = outsideValue;
+
+    for (size_t x = 0; x < mapNumPoints; x++) {
+        size_t start = pointStart[x], end = pointStart[x + 1];
+
+        if (end > start) {
+            float acc = 0;
+
+            for (size_t k = start; k < end; k++) {
+                int bin = pointBins[k];
+                acc += (bin >= 0) ? bins[bin] : outsideValue;
+            }
+            lastMean = acc / (float)(end - start);
+        }
+
+        pointMeans[x] = lastMean;
+    }
+
+    logKernel(pointMeans.data(), pointLogs.data(), mapNumPoints, offset, scale);
+
+    for (size_t x = 0; x < mapNumPoints; x++) {
+        points[x * 2] = (float)x / (float)mapNumPoints;
+        points[x * 2 + 1] = pointLogs[x];
+    }
+}
+
+CPUFeatures::SIMDLevel SpectrumKernels::getSIMDLevel() {
+    return simdLevel;
+}
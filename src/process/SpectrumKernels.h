@@ -0,0 +1,58 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "liquid/liquid.h"
+#include "CPUFeatures.h"
+
+//The per-bin and per-point stages of SpectrumVisualProcessor, in float:
+//the FFT magnitudes, the two-stage moving average with its min / max, and the mapping
+//of the averaged bins to the log scaled display points.
+//The best kernels for the CPU (SSE2, AVX2, NEON or plain C++) are selected at construction.
+class SpectrumKernels {
+public:
+    SpectrumKernels();
+
+    //Magnitudes of the numBins FFT outputs, DC centered:
+    //out[i] = |in[numBins / 2 + i]| and out[numBins / 2 + i] = |in[i]|.
+    void magnitudesShifted(const liquid_float_complex *in, float *out, size_t numBins);
+
+    //Moving averages of the bins, fused in one pass:
+    //  maa += (ma - maa) * rate, then ma += (in - ma) * rate,
+    //either being reset to 'in' first if NaN; peak = max(peak, maa) if peak is not nullptr.
+    //[minVal, maxVal] is extended to the range of maa.
+    void average(const float *in, float *ma, float *maa, float *peak, size_t numBins, float rate, float& minVal, float& maxVal);
+
+    //Assign the bins to the numPoints display points: point x gets the next binsPerPoint bins,
+    //the first one being firstBin. Only rebuilt when one of the parameters changes.
+    void setPointMap(size_t numBins, size_t numPoints, double binsPerPoint, double firstBin);
+
+    //points[2x] = x / numPoints, and points[2x + 1] = log2(mean + offset) * scale,
+    //mean being the average of the bins of point x, bins outside of [1, numBins) counting as outsideValue.
+    //A point without bins repeats the previous one.
+    void mapPoints(const float *bins, float outsideValue, float offset, float scale, float *points);
+
+    CPUFeatures::SIMDLevel getSIMDLevel();
+
+    //out[k] = |x[k]| for numBins interleaved complex values.
+    typedef void (*MagnitudeKernel)(const float *x, float *out, size_t numBins);
+    typedef void (*AverageKernel)(const float *in, float *ma, float *maa, float *peak, size_t numBins, float rate, float& minVal, float& maxVal);
+    //out[k] = log2(in[k] + offset) * scale, within about 3e-5 of log2().
+    typedef void (*LogKernel)(const float *in, float *out, size_t n, float offset, float scale);
+
+private:
+    CPUFeatures::SIMDLevel simdLevel;
+    MagnitudeKernel magnitudeKernel;
+    AverageKernel averageKernel;
+    LogKernel logKernel;
+
+    size_t mapNumBins, mapNumPoints;
+    double mapBinsPerPoint, mapFirstBin;
+    //bin of each point, as pointBins[pointStart[x]] to pointBins[pointStart[x + 1] - 1], -1 if outside.
+    std::vector<int> pointBins;
+    std::vector<size_t> pointStart;
+    std::vector<float> pointMeans, pointLogs;
+};
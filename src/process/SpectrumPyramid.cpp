@@ -0,0 +1,107 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "SpectrumPyramid.h"
+#include <cmath>
+#include <algorithm>
+
+SpectrumPyramid::SpectrumPyramid() : size(0) {
+}
+
+void SpectrumPyramid::build(const float *values, size_t count, size_t stride) {
+    size = count;
+
+    size_t numLevels = 1;
+    while (((size_t)1 << (numLevels - 1)) < count) {
+        numLevels++;
+    }
+    levels.resize(numLevels);
+
+    Level& base = levels[0];
+    base.minValues.resize(count);
+    base.maxValues.resize(count);
+    base.sums.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        base.minValues[i] = base.maxValues[i] = base.sums[i] = values[i * stride];
+    }
+
+    //each cell reduces two cells of the level below, the last one possibly alone.
+    for (size_t k = 1; k < numLevels; k++) {
+        const Level& below = levels[k - 1];
+        Level& level = levels[k];
+        size_t belowCells = below.sums.size();
+        size_t cells = (belowCells + 1) / 2;
+
+        level.minValues.resize(cells);
+        level.maxValues.resize(cells);
+        level.sums.resize(cells);
+
+        for (size_t i = 0; i < cells; i++) {
+            size_t a = 2 * i, b = std::min(2 * i + 1, belowCells - 1);
+
+            level.minValues[i] = std::min(below.minValues[a], below.minValues[b]);
+            level.maxValues[i] = std::max(below.maxValues[a], below.maxValues[b]);
+            level.sums[i] = (a != b) ? (below.sums[a] + below.sums[b]) : below.sums[a];
+        }
+    }
+}
+
+size_t SpectrumPyramid::getSize() const {
+    return size;
+}
+
+size_t SpectrumPyramid::getNumLevels() const {
+    return levels.size();
+}
+
+void SpectrumPyramid::sample(double start, double end, size_t numPixels, float *minOut, float *maxOut, float *meanOut) const {
+    if (size == 0 || numPixels == 0) {
+        return;
+    }
+
+    double valuesPerPixel = (end - start) / (double)numPixels;
+
+    for (size_t p = 0; p < numPixels; p++) {
+        double a = start + valuesPerPixel * (double)p;
+
+        //values [first, last) of the pixel, clamped to the line.
+        long long first = (long long)floor(a);
+        long long last = (long long)floor(a + valuesPerPixel);
+
+        first = std::min(std::max(first, 0LL), (long long)size - 1);
+        last = std::min(std::max(last, first + 1), (long long)size);
+
+        size_t i = (size_t)first, iEnd = (size_t)last;
+        float minValue = levels[0].minValues[i], maxValue = levels[0].maxValues[i];
+        double sum = 0;
+
+        //largest aligned cells first: at most two per level.
+        while (i < iEnd) {
+            size_t k = 0;
+
+            while (k + 1 < levels.size() && (i & (((size_t)1 << (k + 1)) - 1)) == 0 && i + ((size_t)1 << (k + 1)) <= iEnd) {
+                k++;
+            }
+
+            size_t cell = i >> k;
+            const Level& level = levels[k];
+
+            minValue = std::min(minValue, level.minValues[cell]);
+            maxValue = std::max(maxValue, level.maxValues[cell]);
+            sum += level.sums[cell];
+
+            i += (size_t)1 << k;
+        }
+
+        if (minOut) {
+            minOut[p] = minValue;
+        }
+        if (maxOut) {
+            maxOut[p] = maxValue;
+        }
+        if (meanOut) {
+            meanOut[p] = (float)(sum / (double)(iEnd - (size_t)first));
+        }
+    }
+}
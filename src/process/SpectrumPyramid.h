@@ -0,0 +1,37 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+//Min / max / mean mip-map of a spectrum line: level k holds the min, max and sum
+//of each run of 2^k values, so that any range of the line can be reduced in a few lookups.
+//Built once per spectrum output and shared read-only by the panels, each sampling it
+//at its own pixel width and zoom.
+class SpectrumPyramid {
+public:
+    SpectrumPyramid();
+
+    //Rebuild from count values, taken every stride floats from values.
+    void build(const float *values, size_t count, size_t stride = 1);
+
+    size_t getSize() const;
+    size_t getNumLevels() const;
+
+    //numPixels columns over the values [start, end), each the min, max and mean of the values it covers,
+    //at least one; any of the outputs can be nullptr.
+    void sample(double start, double end, size_t numPixels, float *minOut, float *maxOut, float *meanOut) const;
+
+private:
+    struct Level {
+        std::vector<float> minValues, maxValues, sums;
+    };
+
+    std::vector<Level> levels;
+    size_t size;
+};
+
+typedef std::shared_ptr<const SpectrumPyramid> SpectrumPyramidPtr;
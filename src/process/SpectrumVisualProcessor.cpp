@@ -2,16 +2,17 @@
 // SPDX-License-Identifier: GPL-2.0+
 
 #include "SpectrumVisualProcessor.h"
-#include "CubicSDR.h"
+#include "CubicSDRDefs.h"
+#include "PipelineMetrics.h"
+#include <cstring>
 
 //50 ms
 #define HEARTBEAT_CHECK_PERIOD_MICROS (50 * 1000) 
 
-SpectrumVisualProcessor::SpectrumVisualProcessor() : outputBuffers("SpectrumVisualProcessorBuffers") {
+SpectrumVisualProcessor::SpectrumVisualProcessor() : outputBuffers("SpectrumVisualProcessorBuffers"), frameBuffers("SpectrumFrameBuffers") {
     lastInputBandwidth = 0;
     lastBandwidth = 0;
     lastDataSize = 0;
-    resampler = nullptr;
     resamplerRatio = 0;
 
     fftInput = nullptr;
@@ -24,9 +25,9 @@ SpectrumVisualProcessor::SpectrumVisualProcessor() : outputBuffers("SpectrumVisu
     fftSize = 0;
     centerFreq = 0;
     bandwidth = 0;
+    deviceSampleRate = DEFAULT_SAMPLE_RATE;
     hideDC = false;
     
-    freqShifter = nco_crcf_create(LIQUID_NCO);
     shiftFrequency = 0;
     
     fft_ceil_ma = fft_ceil_maa = 100.0;
@@ -40,11 +41,22 @@ SpectrumVisualProcessor::SpectrumVisualProcessor() : outputBuffers("SpectrumVisu
     lastView = false;
     peakHold = false;
     peakReset = false;
-    
+
+    welchEnabled = false;
+    welchParallel = false;
+    welchChanged = false;
+    welchWindow = SpectrumEstimator::WINDOW_HANN;
+    welchOverlap = 50;
+    welchInputFrequency = 0;
+    welchInputRate = 0;
+
+    fullRateEnabled = false;
+    fullRateFold = SpectrumEstimator::FOLD_MAX;
+
+    followFrames = false;
 }
 
 SpectrumVisualProcessor::~SpectrumVisualProcessor() {
-    nco_crcf_destroy(freqShifter);
 }
 
 bool SpectrumVisualProcessor::isView() {
@@ -175,6 +187,9 @@ void SpectrumVisualProcessor::setup(unsigned int fftSize_in) {
         fft_destroy_plan(fftPlan);
     }
     fftPlan = fft_create_plan(fftSizeInternal, fftInput, fftOutput, LIQUID_FFT_FORWARD, 0);
+
+    //the Welch estimator follows the FFT size on the next process().
+    welchChanged = true;
 }
 
 void SpectrumVisualProcessor::setFFTSize(unsigned int fftSize_in) {
@@ -201,6 +216,68 @@ unsigned int SpectrumVisualProcessor::getFFTSize() {
 }
 
 
+void SpectrumVisualProcessor::setWelchEstimator(bool enabled, SpectrumEstimator::WindowType window, int overlapPercent, bool parallel) {
+
+    std::lock_guard < std::mutex > busy_lock(busy_run);
+
+    welchEnabled = enabled;
+    welchWindow = window;
+    welchOverlap = overlapPercent;
+    welchParallel = parallel;
+    welchChanged = true;
+}
+
+bool SpectrumVisualProcessor::isWelchEstimator() {
+
+    std::lock_guard < std::mutex > busy_lock(busy_run);
+
+    return welchEnabled;
+}
+
+void SpectrumVisualProcessor::setFullRate(bool enabled, SpectrumEstimator::FoldType fold) {
+
+    std::lock_guard < std::mutex > busy_lock(busy_run);
+
+    fullRateEnabled = enabled;
+    fullRateFold = fold;
+    welchChanged = true;
+}
+
+bool SpectrumVisualProcessor::isFullRate() {
+
+    std::lock_guard < std::mutex > busy_lock(busy_run);
+
+    return fullRateEnabled;
+}
+
+void SpectrumVisualProcessor::attachFrameOutput(SpectrumFrameQueuePtr frameOut) {
+
+    std::lock_guard < std::mutex > busy_lock(busy_run);
+
+    frameOutputs.push_back(frameOut);
+}
+
+void SpectrumVisualProcessor::setFrameInput(SpectrumFrameQueuePtr frameIn) {
+
+    std::lock_guard < std::mutex > busy_lock(busy_run);
+
+    frameInput = frameIn;
+}
+
+void SpectrumVisualProcessor::setFollowFrames(bool follow) {
+
+    std::lock_guard < std::mutex > busy_lock(busy_run);
+
+    followFrames = follow;
+}
+
+bool SpectrumVisualProcessor::isFollowingFrames() {
+
+    std::lock_guard < std::mutex > busy_lock(busy_run);
+
+    return frameInput && followFrames && !welchEnabled && !fullRateEnabled;
+}
+
 void SpectrumVisualProcessor::setHideDC(bool hideDC) {
 
 	std::lock_guard < std::mutex > busy_lock(busy_run);
@@ -208,6 +285,13 @@ void SpectrumVisualProcessor::setHideDC(bool hideDC) {
     this->hideDC = hideDC;
 }
 
+void SpectrumVisualProcessor::setDeviceSampleRate(long long deviceSampleRate_in) {
+
+	std::lock_guard < std::mutex > busy_lock(busy_run);
+
+    deviceSampleRate = deviceSampleRate_in;
+}
+
 
 void SpectrumVisualProcessor::process() {
     if (!isOutputEmpty()) {
@@ -230,6 +314,13 @@ void SpectrumVisualProcessor::process() {
 	if (executeSetup) {
 		setup(newFFTSize);
 	}
+
+    if (isFollowingFrames()) {
+        //the input is not needed, the frames come from the followed processor.
+        input->flush();
+        processFrames();
+        return;
+    }
    
     DemodulatorThreadIQDataPtr iqData;
     
@@ -241,44 +332,56 @@ void SpectrumVisualProcessor::process() {
         return;
     }
 
+    static PipelineMetrics::ThreadStats *busyStats = PipelineMetrics::getThreadStats("SpectrumVisualProcessor");
+    static PipelineMetrics::LatencyStats *latencyStats = PipelineMetrics::getLatencyStats("Spectrum input");
+
+    PipelineMetrics::BusyScope busy(busyStats);
+    latencyStats->record(iqData->captureTime);
+
     //then get the busy_lock for the rest of the processing.
     std::lock_guard < std::mutex > busy_lock(busy_run);    
-   
-    bool doPeak = peakHold && (peakReset == 0);
-    
-    if (fft_result.size() != fftSizeInternal) {
 
-        if (fft_result.capacity() < fftSizeInternal) {
-            fft_result.reserve(fftSizeInternal);
-            fft_result_ma.reserve(fftSizeInternal);
-            fft_result_maa.reserve(fftSizeInternal);
-            fft_result_peak.reserve(fftSizeInternal);
-        }
-        fft_result.resize(fftSizeInternal);
-        fft_result_ma.resize(fftSizeInternal);
-        fft_result_maa.resize(fftSizeInternal);
-        fft_result_temp.resize(fftSizeInternal);
-        fft_result_peak.resize(fftSizeInternal);
-    }
-    
-    if (peakReset != 0) {
-        peakReset--;
-        if (peakReset == 0) {
-            for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
-                fft_result_peak[i] = fft_floor_maa;
+    //the full rate mode runs the Welch estimator, in parallel whatever the Welch settings.
+    bool estimatorEnabled = welchEnabled || fullRateEnabled;
+
+    if (welchChanged) {
+        welchChanged = false;
+
+        if ((welchEnabled && welchParallel) || fullRateEnabled) {
+            if (!welchWorkerPool) {
+                welchWorkerPool.reset(new WorkerPool("SpectrumWelchWorkers", WorkerPool::getDefaultNumThreads(SPECTRUM_WELCH_MAX_WORKER_THREADS)));
             }
-            fft_ceil_peak = fft_floor_maa;
-            fft_floor_peak = fft_ceil_maa;
+        } else {
+            welchWorkerPool.reset();
+        }
+
+        if (fullRateEnabled) {
+            int overlap = (fullRateFold == SpectrumEstimator::FOLD_MAX) ? SPECTRUM_FULL_RATE_MAX_OVERLAP : SPECTRUM_FULL_RATE_MEAN_OVERLAP;
+
+            welchEstimator.setup(fftSizeInternal, SpectrumEstimator::WINDOW_HANN, overlap, welchWorkerPool.get());
+            welchEstimator.setFold(fullRateFold);
+        } else if (welchEnabled) {
+            welchEstimator.setup(fftSizeInternal, welchWindow, welchOverlap, welchWorkerPool.get());
+            welchEstimator.setFold(SpectrumEstimator::FOLD_MEAN);
         }
     }
+   
+    bool doPeak = prepareBins();
     
-    std::vector<liquid_float_complex> *data = &iqData->data;
+    //either the samples of the block or a line view of the FFTDataDistributor ring.
+    const liquid_float_complex *samples = iqData->getSamples();
+    size_t numSamples = iqData->getNumSamples();
     
-    if (data && data->size()) {
+    if (samples && numSamples) {
         unsigned int num_written;
         long resampleBw = iqData->sampleRate;
         bool newResampler = false;
         int bwDiff = 0;
+
+        //restart the Welch frames on any discontinuity of their input.
+        bool welchRestart = (iqData->frequency != welchInputFrequency || iqData->sampleRate != welchInputRate || is_view != lastView);
+        welchInputFrequency = iqData->frequency;
+        welchInputRate = iqData->sampleRate;
         
         if (is_view) {
             if (!iqData->sampleRate) {
@@ -286,8 +389,11 @@ void SpectrumVisualProcessor::process() {
                 return;
             }
             
+            int zoomStages = 0;
+
             while (resampleBw / SPECTRUM_VZM >= (long) bandwidth) {
                 resampleBw /= SPECTRUM_VZM;
+                zoomStages++;
             }
             
             resamplerRatio = (double) (resampleBw) / (double) iqData->sampleRate;
@@ -295,79 +401,50 @@ void SpectrumVisualProcessor::process() {
             size_t desired_input_size = fftSizeInternal / resamplerRatio;
             
             this->desiredInputSize = desired_input_size;
+
+            if (fullRateEnabled) {
+                //all of the block, to keep the input contiguous.
+                desired_input_size = numSamples;
+            } else if (welchEnabled) {
+                //all of the block is averaged, up to the span limit.
+                desired_input_size *= SPECTRUM_WELCH_MAX_VIEW_SPAN;
+            }
             
-            if (iqData->data.size() < desired_input_size) {
-                //                std::cout << "fft underflow, desired: " << desired_input_size << " actual:" << input->data.size() << std::endl;
-                desired_input_size = iqData->data.size();
+            if (numSamples < desired_input_size) {
+                //                std::cout << "fft underflow, desired: " << desired_input_size << " actual:" << numSamples << std::endl;
+                desired_input_size = numSamples;
             }
             
             if (centerFreq != iqData->frequency) {
                 if ((centerFreq - iqData->frequency) != shiftFrequency || lastInputBandwidth != iqData->sampleRate) {
-                    if (abs(iqData->frequency - centerFreq) < (wxGetApp().getSampleRate() / 2)) {
+                    if (abs(iqData->frequency - centerFreq) < (deviceSampleRate / 2)) {
                         long lastShiftFrequency = shiftFrequency;
                         shiftFrequency = centerFreq - iqData->frequency;
-                        nco_crcf_set_frequency(freqShifter, (2.0 * M_PI) * (((double) abs(shiftFrequency)) / ((double) iqData->sampleRate)));
                         
-                        if (is_view) {
-                            long freqDiff = shiftFrequency - lastShiftFrequency;
-                            
-                            if (lastBandwidth!=0) {
-                                double binPerHz = double(lastBandwidth) / double(fftSizeInternal);
-                                
-                                unsigned int numShift = floor(double(abs(freqDiff)) / binPerHz);
-                                
-                                if (numShift < fftSizeInternal/2 && numShift) {
-                                    if (freqDiff > 0) {
-                                        memmove(&fft_result_ma[0], &fft_result_ma[numShift], (fftSizeInternal-numShift) * sizeof(double));
-                                        memmove(&fft_result_maa[0], &fft_result_maa[numShift], (fftSizeInternal-numShift) * sizeof(double));
-//                                        memmove(&fft_result_peak[0], &fft_result_peak[numShift], (fftSizeInternal-numShift) * sizeof(double));
-//                                        memset(&fft_result_peak[fftSizeInternal-numShift], 0, numShift * sizeof(double));
-                                    } else {
-                                        memmove(&fft_result_ma[numShift], &fft_result_ma[0], (fftSizeInternal-numShift) * sizeof(double));
-                                        memmove(&fft_result_maa[numShift], &fft_result_maa[0], (fftSizeInternal-numShift) * sizeof(double));
-//                                        memmove(&fft_result_peak[numShift], &fft_result_peak[0], (fftSizeInternal-numShift) * sizeof(double));
-//                                        memset(&fft_result_peak[0], 0, numShift * sizeof(double));
-                                    }
-                                }
-                            }
-                        }
+                        shiftAverages(shiftFrequency - lastShiftFrequency, lastBandwidth);
                     }
                     peakReset = PEAK_RESET_COUNT;
+                    welchRestart = true;
                 }
-                
-                if (shiftBuffer.size() != desired_input_size) {
-                    if (shiftBuffer.capacity() < desired_input_size) {
-                        shiftBuffer.reserve(desired_input_size);
-                    }
-                    shiftBuffer.resize(desired_input_size);
-                }
-                
-                if (shiftFrequency < 0) {
-                    nco_crcf_mix_block_up(freqShifter, &iqData->data[0], &shiftBuffer[0], desired_input_size);
-                } else {
-                    nco_crcf_mix_block_down(freqShifter, &iqData->data[0], &shiftBuffer[0], desired_input_size);
-                }
+
+                zoomDecimator.setShift((double) shiftFrequency / (double) iqData->sampleRate);
             } else {
-                shiftBuffer.assign(iqData->data.begin(), iqData->data.begin()+desired_input_size);
+                zoomDecimator.setShift(0);
             }
             
-            if (!resampler || resampleBw != lastBandwidth || lastInputBandwidth != iqData->sampleRate) {
-                float As = 480.0;
-                
-                if (resampler) {
-                    msresamp_crcf_destroy(resampler);
-                }
-                
-                resampler = msresamp_crcf_create(resamplerRatio, As);
+            if (resampleBw != lastBandwidth || lastInputBandwidth != iqData->sampleRate) {
+                //the half-band stages are kept, only their history is cleared.
+                zoomDecimator.setDecimation(zoomStages);
                 
                 bwDiff = resampleBw-lastBandwidth;
                 lastBandwidth = resampleBw;
                 lastInputBandwidth = iqData->sampleRate;
                 newResampler = true;
                 peakReset = PEAK_RESET_COUNT;
+                welchRestart = true;
             }
              
-            unsigned int out_size = ceil((double) (desired_input_size) * resamplerRatio) + 512;
+            size_t out_size = zoomDecimator.getMaxOutput(desired_input_size);
             
             if (resampleBuffer.size() != out_size) {
                 if (resampleBuffer.capacity() < out_size) {
@@ -376,9 +453,14 @@ void SpectrumVisualProcessor::process() {
                 resampleBuffer.resize(out_size);
             }
             
-            msresamp_crcf_execute(resampler, &shiftBuffer[0], desired_input_size, &resampleBuffer[0], &num_written);
+            num_written = zoomDecimator.execute(samples, desired_input_size, &resampleBuffer[0]);
             
-            if (num_written < fftSizeInternal) {
+            if (estimatorEnabled) {
+                if (welchRestart) {
+                    welchEstimator.reset();
+                }
+                welchEstimator.feed(resampleBuffer.data(), num_written);
+            } else if (num_written < fftSizeInternal) {
                 memcpy(fftInData, resampleBuffer.data(), num_written * sizeof(liquid_float_complex));
                 memset(&(fftInData[num_written]), 0, (fftSizeInternal-num_written) * sizeof(liquid_float_complex));
             } else {
@@ -387,18 +469,25 @@ void SpectrumVisualProcessor::process() {
         } else {
             this->desiredInputSize = fftSizeInternal;
 
-            num_written = data->size();
-            if (data->size() < fftSizeInternal) {
-                memcpy(fftInData, data->data(), data->size() * sizeof(liquid_float_complex));
-                memset(&fftInData[data->size()], 0, (fftSizeInternal - data->size()) * sizeof(liquid_float_complex));
+            num_written = numSamples;
+            if (estimatorEnabled) {
+                if (welchRestart) {
+                    welchEstimator.reset();
+                }
+                welchEstimator.feed(samples, numSamples);
+            } else if (numSamples < fftSizeInternal) {
+                memcpy(fftInData, samples, numSamples * sizeof(liquid_float_complex));
+                memset(&fftInData[numSamples], 0, (fftSizeInternal - numSamples) * sizeof(liquid_float_complex));
             } else {
-                memcpy(fftInData, data->data(), fftSizeInternal * sizeof(liquid_float_complex));
+                memcpy(fftInData, samples, fftSizeInternal * sizeof(liquid_float_complex));
             }
         }
         
         bool execute = false;
 
-        if (num_written >= fftSizeInternal) {
+        if (estimatorEnabled) {
+            execute = (welchEstimator.getNumFrames() > 0);
+        } else if (num_written >= fftSizeInternal) {
             execute = true;
             memcpy(fftInput, fftInData, fftSizeInternal * sizeof(liquid_float_complex));
             memcpy(fftLastData, fftInput, fftSizeInternal * sizeof(liquid_float_complex));
@@ -421,219 +510,314 @@ void SpectrumVisualProcessor::process() {
         }
         
         if (execute) {
-            SpectrumVisualDataPtr output = outputBuffers.getBuffer();
-            
-            if (output->spectrum_points.size() != fftSize * 2) {
-                output->spectrum_points.resize(fftSize * 2);
-            }
-            if (doPeak) {
-                if (output->spectrum_hold_points.size() != fftSize * 2) {
-                    output->spectrum_hold_points.resize(fftSize * 2);
-                }
+            if (estimatorEnabled) {
+                welchEstimator.takeMagnitudes(welchMagnitudes);
+
+                memcpy(&fft_result[0], &welchMagnitudes[fftSizeInternal / 2], (fftSizeInternal / 2) * sizeof(float));
+                memcpy(&fft_result[fftSizeInternal / 2], &welchMagnitudes[0], (fftSizeInternal / 2) * sizeof(float));
             } else {
-                output->spectrum_hold_points.resize(0);
+                fft_execute(fftPlan);
+
+                kernels.magnitudesShifted(fftOutput, &fft_result[0], fftSizeInternal);
             }
             
-            float fft_ceil = 0, fft_floor = 1;
+            //folded full rate outputs are no frames for the followers.
+            if (!fullRateEnabled) {
+                publishFrame(iqData->frequency, iqData->sampleRate, resampleBw);
+            }
 
-            fft_execute(fftPlan);
-            
-            for (int i = 0, iMax = fftSizeInternal / 2; i < iMax; i++) {
-                float a = fftOutput[i].real;
-                float b = fftOutput[i].imag;
-                float c = sqrt(a * a + b * b);
-                
-                float x = fftOutput[fftSizeInternal / 2 + i].real;
-                float y = fftOutput[fftSizeInternal / 2 + i].imag;
-                float z = sqrt(x * x + y * y);
-                
-                fft_result[i] = (z);
-                fft_result[fftSizeInternal / 2 + i] = (c);
+            if (newResampler && lastView) {
+                rescaleAverages(bwDiff);
             }
+
+            publishBins(iqData->frequency, resampleBw, centerFreq, bandwidth, doPeak);
+        }
+    }  
+    
+    lastView = is_view;
+}
+
+
+bool SpectrumVisualProcessor::prepareBins() {
+    if (fft_result.size() != fftSizeInternal) {
+
+        if (fft_result.capacity() < fftSizeInternal) {
+            fft_result.reserve(fftSizeInternal);
+            fft_result_ma.reserve(fftSizeInternal);
+            fft_result_maa.reserve(fftSizeInternal);
+            fft_result_peak.reserve(fftSizeInternal);
+        }
+        fft_result.resize(fftSizeInternal);
+        fft_result_ma.resize(fftSizeInternal);
+        fft_result_maa.resize(fftSizeInternal);
+        fft_result_temp.resize(fftSizeInternal);
+        fft_result_peak.resize(fftSizeInternal);
+    }
+    
+    if (peakReset != 0) {
+        peakReset--;
+        if (peakReset == 0) {
+            for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
+                fft_result_peak[i] = fft_floor_maa;
+            }
+            fft_ceil_peak = fft_floor_maa;
+            fft_floor_peak = fft_ceil_maa;
+        }
+    }
+
+    return peakHold && (peakReset == 0);
+}
+
+void SpectrumVisualProcessor::shiftAverages(long freqDiff, long binsBandwidth) {
+    if (binsBandwidth == 0) {
+        return;
+    }
+
+    double binPerHz = double(binsBandwidth) / double(fftSizeInternal);
+
+    unsigned int numShift = floor(double(abs(freqDiff)) / binPerHz);
+
+    if (numShift < fftSizeInternal/2 && numShift) {
+        if (freqDiff > 0) {
+            memmove(&fft_result_ma[0], &fft_result_ma[numShift], (fftSizeInternal-numShift) * sizeof(float));
+            memmove(&fft_result_maa[0], &fft_result_maa[numShift], (fftSizeInternal-numShift) * sizeof(float));
+        } else {
+            memmove(&fft_result_ma[numShift], &fft_result_ma[0], (fftSizeInternal-numShift) * sizeof(float));
+            memmove(&fft_result_maa[numShift], &fft_result_maa[0], (fftSizeInternal-numShift) * sizeof(float));
+        }
+    }
+}
+
+void SpectrumVisualProcessor::rescaleAverages(long bwDiff) {
+    if (bwDiff < 0) {
+        for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
+            fft_result_temp[i] = fft_result_ma[(fftSizeInternal/4) + (i/2)];
+        }
+        for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
+            fft_result_ma[i] = fft_result_temp[i];
             
-            if (newResampler && lastView) {
-                if (bwDiff < 0) {
-                    for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
-                        fft_result_temp[i] = fft_result_ma[(fftSizeInternal/4) + (i/2)];
-                    }
-                    for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
-                        fft_result_ma[i] = fft_result_temp[i];
-                        
-                        fft_result_temp[i] = fft_result_maa[(fftSizeInternal/4) + (i/2)];
-                    }
-                    for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
-                        fft_result_maa[i] = fft_result_temp[i];
-                    }
-                } else {
-                    for (size_t i = 0, iMax = fftSizeInternal; i < iMax; i++) {
-                        if (i < fftSizeInternal/4) {
-                            fft_result_temp[i] = 0; // fft_result_ma[fftSizeInternal/4];
-                        } else if (i >= fftSizeInternal - fftSizeInternal/4) {
-                            fft_result_temp[i] = 0; // fft_result_ma[fftSizeInternal - fftSizeInternal/4-1];
-                        } else {
-                            fft_result_temp[i] = fft_result_ma[(i-fftSizeInternal/4)*2];
-                        }
-                    }
-                    for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
-                        fft_result_ma[i] = fft_result_temp[i];
-                        
-                        if (i < fftSizeInternal/4) {
-                            fft_result_temp[i] = 0; //fft_result_maa[fftSizeInternal/4];
-                        } else if (i >= fftSizeInternal - fftSizeInternal/4) {
-                            fft_result_temp[i] = 0; // fft_result_maa[fftSizeInternal - fftSizeInternal/4-1];
-                        } else {
-                            fft_result_temp[i] = fft_result_maa[(i-fftSizeInternal/4)*2];
-                        }
-                    }
-                    for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
-                        fft_result_maa[i] = fft_result_temp[i];
-                    }
-                }
+            fft_result_temp[i] = fft_result_maa[(fftSizeInternal/4) + (i/2)];
+        }
+        for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
+            fft_result_maa[i] = fft_result_temp[i];
+        }
+    } else {
+        for (size_t i = 0, iMax = fftSizeInternal; i < iMax; i++) {
+            if (i < fftSizeInternal/4) {
+                fft_result_temp[i] = 0; // fft_result_ma[fftSizeInternal/4];
+            } else if (i >= fftSizeInternal - fftSizeInternal/4) {
+                fft_result_temp[i] = 0; // fft_result_ma[fftSizeInternal - fftSizeInternal/4-1];
+            } else {
+                fft_result_temp[i] = fft_result_ma[(i-fftSizeInternal/4)*2];
             }
+        }
+        for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
+            fft_result_ma[i] = fft_result_temp[i];
             
-            for (int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
-                if (fft_result_maa[i] != fft_result_maa[i]) fft_result_maa[i] = fft_result[i];
-                fft_result_maa[i] += (fft_result_ma[i] - fft_result_maa[i]) * fft_average_rate;
-                if (fft_result_ma[i] != fft_result_ma[i]) fft_result_ma[i] = fft_result[i];
-                fft_result_ma[i] += (fft_result[i] - fft_result_ma[i]) * fft_average_rate;
-                
-                if (fft_result_maa[i] > fft_ceil || fft_ceil != fft_ceil) {
-                    fft_ceil = fft_result_maa[i];
-                }
-                if (fft_result_maa[i] < fft_floor || fft_floor != fft_floor) {
-                    fft_floor = fft_result_maa[i];
-                }
-                if (doPeak) {
-                    if (fft_result_maa[i] > fft_result_peak[i]) {
-                        fft_result_peak[i] = fft_result_maa[i];
-                    }
-                }
+            if (i < fftSizeInternal/4) {
+                fft_result_temp[i] = 0; //fft_result_maa[fftSizeInternal/4];
+            } else if (i >= fftSizeInternal - fftSizeInternal/4) {
+                fft_result_temp[i] = 0; // fft_result_maa[fftSizeInternal - fftSizeInternal/4-1];
+            } else {
+                fft_result_temp[i] = fft_result_maa[(i-fftSizeInternal/4)*2];
             }
+        }
+        for (unsigned int i = 0, iMax = fftSizeInternal; i < iMax; i++) {
+            fft_result_maa[i] = fft_result_temp[i];
+        }
+    }
+}
+
+void SpectrumVisualProcessor::publishFrame(long long frequency, long sampleRate, long binsBandwidth) {
+    if (frameOutputs.empty()) {
+        return;
+    }
+
+    SpectrumFramePtr frame = frameBuffers.getBuffer();
+
+    frame->bins.assign(fft_result.begin(), fft_result.end());
+    frame->frequency = frequency;
+    frame->sampleRate = sampleRate;
+    frame->binsBandwidth = binsBandwidth;
+    frame->shiftFrequency = shiftFrequency;
+    frame->isView = is_view;
+    frame->centerFreq = centerFreq;
+    frame->bandwidth = bandwidth;
+
+    for (SpectrumFrameQueuePtr& frameOut : frameOutputs) {
+        //the followers only need the latest frame.
+        frameOut->try_push(frame);
+    }
+}
+
+void SpectrumVisualProcessor::publishBins(long long frequency, long binsBandwidth, long long viewCenterFreq, size_t viewBandwidth, bool doPeak) {
+    SpectrumVisualDataPtr output = outputBuffers.getBuffer();
+    
+    if (output->spectrum_points.size() != fftSize * 2) {
+        output->spectrum_points.resize(fftSize * 2);
+    }
+    if (doPeak) {
+        if (output->spectrum_hold_points.size() != fftSize * 2) {
+            output->spectrum_hold_points.resize(fftSize * 2);
+        }
+    } else {
+        output->spectrum_hold_points.resize(0);
+    }
+    
+    float fft_ceil = 0, fft_floor = 1;
+
+    kernels.average(&fft_result[0], &fft_result_ma[0], &fft_result_maa[0], doPeak ? &fft_result_peak[0] : nullptr,
+                    fftSizeInternal, fft_average_rate, fft_floor, fft_ceil);
+    
+    if (fft_ceil_ma != fft_ceil_ma) fft_ceil_ma = fft_ceil;
+    fft_ceil_ma = fft_ceil_ma + (fft_ceil - fft_ceil_ma) * 0.05;
+    if (fft_ceil_maa != fft_ceil_maa) fft_ceil_maa = fft_ceil;
+    fft_ceil_maa = fft_ceil_maa + (fft_ceil_ma - fft_ceil_maa) * 0.05;
+    
+    if (fft_floor_ma != fft_floor_ma) fft_floor_ma = fft_floor;
+    fft_floor_ma = fft_floor_ma + (fft_floor - fft_floor_ma) * 0.05;
+    if (fft_floor_maa != fft_floor_maa) fft_floor_maa = fft_floor;
+    fft_floor_maa = fft_floor_maa + (fft_floor_ma - fft_floor_maa) * 0.05;
+
+    if (doPeak) {
+        if (fft_ceil_maa > fft_ceil_peak) {
+            fft_ceil_peak = fft_ceil_maa;
+        }
+        if (fft_floor_maa < fft_floor_peak) {
+            fft_floor_peak = fft_floor_maa;
+        }
+    }
+    
+    float sf = scaleFactor;
+
+    double visualRatio = (double(viewBandwidth) / double(binsBandwidth));
+    double visualStart = (double(fftSizeInternal) / 2.0) - (double(fftSizeInternal) * (visualRatio / 2.0));
+
+    double point_ceil = doPeak?fft_ceil_peak:fft_ceil_maa;
+    double point_floor = doPeak?fft_floor_peak:fft_floor_maa;
+
+    //log10(v + 0.25 - (floor - 0.75)) / log10((ceil + 0.25) - (floor - 0.75)), as a ratio of log2.
+    float pointOffset = float(0.25 - (point_floor - 0.75));
+    float pointScale = float(sf / log2((point_ceil + 0.25) - (point_floor - 0.75)));
+
+    kernels.setPointMap(fftSizeInternal, output->spectrum_points.size() / 2, visualRatio * double(SPECTRUM_VZM), visualStart);
+
+    kernels.mapPoints(&fft_result_maa[0], float(fft_floor_maa), pointOffset, pointScale, &output->spectrum_points[0]);
+    if (doPeak) {
+        kernels.mapPoints(&fft_result_peak[0], float(fft_floor_maa), pointOffset, pointScale, &output->spectrum_hold_points[0]);
+    }
+    
+    if (hideDC) { // DC-spike removal
+        long long freqMin = viewCenterFreq-(viewBandwidth/2);
+        long long freqMax = viewCenterFreq+(viewBandwidth/2);
+        long long zeroPt = (frequency-freqMin);
+        
+        if (freqMin < frequency && freqMax > frequency) {
+            int freqRange = int(freqMax-freqMin);
+            int freqStep = freqRange/fftSize;
+            int fftStart = (zeroPt/freqStep)-(2000/freqStep);
+            int fftEnd = (zeroPt/freqStep)+(2000/freqStep);
             
-            if (fft_ceil_ma != fft_ceil_ma) fft_ceil_ma = fft_ceil;
-            fft_ceil_ma = fft_ceil_ma + (fft_ceil - fft_ceil_ma) * 0.05;
-            if (fft_ceil_maa != fft_ceil_maa) fft_ceil_maa = fft_ceil;
-            fft_ceil_maa = fft_ceil_maa + (fft_ceil_ma - fft_ceil_maa) * 0.05;
+//                    std::cout << "range:" << freqRange << ", step: " << freqStep << ", start: " << fftStart << ", end: " << fftEnd << std::endl;
             
-            if (fft_floor_ma != fft_floor_ma) fft_floor_ma = fft_floor;
-            fft_floor_ma = fft_floor_ma + (fft_floor - fft_floor_ma) * 0.05;
-            if (fft_floor_maa != fft_floor_maa) fft_floor_maa = fft_floor;
-            fft_floor_maa = fft_floor_maa + (fft_floor_ma - fft_floor_maa) * 0.05;
-
-            if (doPeak) {
-                if (fft_ceil_maa > fft_ceil_peak) {
-                    fft_ceil_peak = fft_ceil_maa;
-                }
-                if (fft_floor_maa < fft_floor_peak) {
-                    fft_floor_peak = fft_floor_maa;
-                }
+            if (fftEnd-fftStart < 2) {
+                fftEnd++;
+                fftStart--;
             }
             
-            float sf = scaleFactor;
- 
-            double visualRatio = (double(bandwidth) / double(resampleBw));
-            double visualStart = (double(fftSizeInternal) / 2.0) - (double(fftSizeInternal) * (visualRatio / 2.0));
-            double visualAccum = 0;
-            double peak_acc = 0, acc = 0, accCount = 0, i = 0;
-   
-            double point_ceil = doPeak?fft_ceil_peak:fft_ceil_maa;
-            double point_floor = doPeak?fft_floor_peak:fft_floor_maa;
-            
-            for (int x = 0, xMax = output->spectrum_points.size() / 2; x < xMax; x++) {
-                visualAccum += visualRatio * double(SPECTRUM_VZM);
-
-                while (visualAccum >= 1.0) {
-                    unsigned int idx = round(visualStart+i);
-                    if (idx > 0 && idx < fftSizeInternal) {
-                        acc += fft_result_maa[idx];
-                        if (doPeak) {
-                            peak_acc += fft_result_peak[idx];
-                        }
-                    } else {
-                        acc += fft_floor_maa;
-                        if (doPeak) {
-                            peak_acc += fft_floor_maa;
-                        }
-                    }
-                    accCount += 1.0;
-                    visualAccum -= 1.0;
-                    i++;
+            int numSteps = (fftEnd-fftStart);
+            int halfWay = fftStart+(numSteps/2);
+
+            if ((fftEnd+numSteps/2+1 < (long long) fftSize) && (fftStart-numSteps/2-1 >= 0) && (fftEnd > fftStart)) {
+                int n = 1;
+                for (int i = fftStart; i < halfWay; i++) {
+                    output->spectrum_points[i * 2 + 1] = output->spectrum_points[(fftStart - n) * 2 + 1];
+                    n++;
                 }
-
-                output->spectrum_points[x * 2] = ((float) x / (float) xMax);
-                if (doPeak) {
-                    output->spectrum_hold_points[x * 2] = ((float) x / (float) xMax);
+                n = 1;
+                for (int i = halfWay; i < fftEnd; i++) {
+                    output->spectrum_points[i * 2 + 1] = output->spectrum_points[(fftEnd + n) * 2 + 1];
+                    n++;
                 }
-                if (accCount) {
-                    output->spectrum_points[x * 2 + 1] = ((log10((acc/accCount)+0.25 - (point_floor-0.75)) / log10((point_ceil+0.25) - (point_floor-0.75))))*sf;
-                    acc = 0.0;
-                    if (doPeak) {
-                        output->spectrum_hold_points[x * 2 + 1] = ((log10((peak_acc/accCount)+0.25 - (point_floor-0.75)) / log10((point_ceil+0.25) - (point_floor-0.75))))*sf;
-                        peak_acc = 0.0;
-                    }
-                    accCount = 0.0;
-                }
-            }
-            
-            if (hideDC) { // DC-spike removal
-                long long freqMin = centerFreq-(bandwidth/2);
-                long long freqMax = centerFreq+(bandwidth/2);
-                long long zeroPt = (iqData->frequency-freqMin);
-                
-                if (freqMin < iqData->frequency && freqMax > iqData->frequency) {
-                    int freqRange = int(freqMax-freqMin);
-                    int freqStep = freqRange/fftSize;
-                    int fftStart = (zeroPt/freqStep)-(2000/freqStep);
-                    int fftEnd = (zeroPt/freqStep)+(2000/freqStep);
-                    
-//                    std::cout << "range:" << freqRange << ", step: " << freqStep << ", start: " << fftStart << ", end: " << fftEnd << std::endl;
-                    
-                    if (fftEnd-fftStart < 2) {
-                        fftEnd++;
-                        fftStart--;
+                if (doPeak) {
+                    int n = 1;
+                    for (int i = fftStart; i < halfWay; i++) {
+                        output->spectrum_hold_points[i * 2 + 1] = output->spectrum_hold_points[(fftStart - n) * 2 + 1];
+                        n++;
                     }
-                    
-                    int numSteps = (fftEnd-fftStart);
-                    int halfWay = fftStart+(numSteps/2);
-
-                    if ((fftEnd+numSteps/2+1 < (long long) fftSize) && (fftStart-numSteps/2-1 >= 0) && (fftEnd > fftStart)) {
-                        int n = 1;
-                        for (int i = fftStart; i < halfWay; i++) {
-                            output->spectrum_points[i * 2 + 1] = output->spectrum_points[(fftStart - n) * 2 + 1];
-                            n++;
-                        }
-                        n = 1;
-                        for (int i = halfWay; i < fftEnd; i++) {
-                            output->spectrum_points[i * 2 + 1] = output->spectrum_points[(fftEnd + n) * 2 + 1];
-                            n++;
-                        }
-                        if (doPeak) {
-                            int n = 1;
-                            for (int i = fftStart; i < halfWay; i++) {
-                                output->spectrum_hold_points[i * 2 + 1] = output->spectrum_hold_points[(fftStart - n) * 2 + 1];
-                                n++;
-                            }
-                            n = 1;
-                            for (int i = halfWay; i < fftEnd; i++) {
-                                output->spectrum_hold_points[i * 2 + 1] = output->spectrum_hold_points[(fftEnd + n) * 2 + 1];
-                                n++;
-                            }
-                        }
+                    n = 1;
+                    for (int i = halfWay; i < fftEnd; i++) {
+                        output->spectrum_hold_points[i * 2 + 1] = output->spectrum_hold_points[(fftEnd + n) * 2 + 1];
+                        n++;
                     }
                 }
             }
-            
-            output->fft_ceiling = point_ceil/sf;
-            output->fft_floor = point_floor;
+        }
+    }
+    
+    output->fft_ceiling = point_ceil/sf;
+    output->fft_floor = point_floor;
+
+    output->centerFreq = viewCenterFreq;
+    output->bandwidth = viewBandwidth;
+
+    output->spectrum_pyramid.build(&output->spectrum_points[1], fftSize, 2);
+
+    distribute(output);
+}
+
+void SpectrumVisualProcessor::processFrames() {
+    SpectrumFramePtr frame, latestFrame;
+    SpectrumFrameQueuePtr frameIn;
+
+    {
+        std::lock_guard < std::mutex > busy_lock(busy_run);
+        frameIn = frameInput;
+    }
+
+    while (frameIn && frameIn->try_pop(frame)) {
+        latestFrame = frame;
+    }
+
+    if (!latestFrame) {
+        return;
+    }
 
-            output->centerFreq = centerFreq;
-            output->bandwidth = bandwidth;
+    std::lock_guard < std::mutex > busy_lock(busy_run);
 
-            distribute(output);
+    //skip the frames of a former FFT size.
+    if (latestFrame->bins.size() != fftSizeInternal) {
+        return;
+    }
+
+    bool doPeak = prepareBins();
+
+    //follow the view changes of the producer as its own averages did.
+    if (latestFrame->isView) {
+        bool newView = false;
+
+        if (latestFrame->shiftFrequency != shiftFrequency) {
+            shiftAverages(latestFrame->shiftFrequency - shiftFrequency, lastBandwidth);
+            shiftFrequency = latestFrame->shiftFrequency;
+            newView = true;
         }
-    }  
-    
-    lastView = is_view;
+        if (latestFrame->binsBandwidth != lastBandwidth) {
+            if (lastView) {
+                rescaleAverages(latestFrame->binsBandwidth - lastBandwidth);
+            }
+            lastBandwidth = latestFrame->binsBandwidth;
+            newView = true;
+        }
+        if (newView) {
+            peakReset = PEAK_RESET_COUNT;
+        }
+    }
+
+    memcpy(&fft_result[0], &latestFrame->bins[0], fftSizeInternal * sizeof(float));
+
+    publishBins(latestFrame->frequency, latestFrame->binsBandwidth, latestFrame->centerFreq, latestFrame->bandwidth, doPeak);
+
+    lastView = latestFrame->isView;
 }
 
 
@@ -5,16 +5,31 @@
 
 #include "VisualProcessor.h"
 #include "DemodDefs.h"
+#include "SpectrumEstimator.h"
+#include "SpectrumKernels.h"
+#include "ZoomDecimator.h"
+#include "SpectrumPyramid.h"
+#include "WorkerPool.h"
 #include <cmath>
 #include <memory>
 
 #define SPECTRUM_VZM 2
 #define PEAK_RESET_COUNT 30
 
+//worker threads at most for the Welch estimator frames.
+#define SPECTRUM_WELCH_MAX_WORKER_THREADS 4
+//in view mode, input blocks are shifted and resampled up to this many FFT sizes of their samples.
+#define SPECTRUM_WELCH_MAX_VIEW_SPAN 8
+//frame overlap of the full rate mode, enough for a burst anywhere to fall near the top of a Hann window.
+#define SPECTRUM_FULL_RATE_MAX_OVERLAP 75
+#define SPECTRUM_FULL_RATE_MEAN_OVERLAP 50
+
 class SpectrumVisualData {
 public:
     std::vector<float> spectrum_points;
     std::vector<float> spectrum_hold_points;
+    //mip-map of the spectrum_points levels, for the panels to sample at their own width.
+    SpectrumPyramid spectrum_pyramid;
     double fft_ceiling, fft_floor;
     long long centerFreq;
     int bandwidth;
@@ -26,6 +41,28 @@ typedef std::shared_ptr<SpectrumVisualData> SpectrumVisualDataPtr;
 typedef ThreadBlockingQueue<SpectrumVisualDataPtr> SpectrumVisualDataQueue;
 typedef std::shared_ptr<SpectrumVisualDataQueue> SpectrumVisualDataQueuePtr;
 
+//The FFT magnitudes of one frame of a SpectrumVisualProcessor, shared with the processors
+//following it, which average and map the same bins instead of running their own FFT.
+class SpectrumFrame {
+public:
+    //DC centered magnitudes, over binsBandwidth around the input frequency shifted by shiftFrequency.
+    std::vector<float> bins;
+    long long frequency;
+    long sampleRate;
+    long binsBandwidth;
+    long shiftFrequency;
+    //view of the producer when the frame was computed.
+    bool isView;
+    long long centerFreq;
+    long bandwidth;
+
+    virtual ~SpectrumFrame() {};
+};
+
+typedef std::shared_ptr<SpectrumFrame> SpectrumFramePtr;
+typedef ThreadBlockingQueue<SpectrumFramePtr> SpectrumFrameQueue;
+typedef std::shared_ptr<SpectrumFrameQueue> SpectrumFrameQueuePtr;
+
 class SpectrumVisualProcessor : public VisualProcessor<DemodulatorThreadIQData, SpectrumVisualData> {
 public:
     SpectrumVisualProcessor();
@@ -53,14 +90,58 @@ public:
     void setFFTSize(unsigned int fftSize);
     unsigned int getFFTSize();
     void setHideDC(bool hideDC);
+
+    //Sample rate of the device, which bounds the view center shifts applied to the input.
+    void setDeviceSampleRate(long long deviceSampleRate_in);
     
     void setScaleFactor(float sf);
     float getScaleFactor();
+
+    //Estimate the spectrum with Welch averaging of all the input, through overlapping windowed FFTs,
+    //instead of a single FFT of the latest samples per update. parallel spreads the FFTs over worker threads.
+    void setWelchEstimator(bool enabled, SpectrumEstimator::WindowType window, int overlapPercent, bool parallel);
+    bool isWelchEstimator();
+
+    //Full rate mode: each output is folded from overlapping Hann windowed FFTs of all of its input,
+    //spread over worker threads, so that no burst falls between outputs whatever their rate.
+    //The input blocks must be contiguous, as the FFTDataDistributor full rate lines.
+    //Takes precedence over the Welch estimator; no frames are published meanwhile.
+    void setFullRate(bool enabled, SpectrumEstimator::FoldType fold);
+    bool isFullRate();
+
+    //Publish the FFT magnitudes of each frame to frameOut, for another processor to follow.
+    void attachFrameOutput(SpectrumFrameQueuePtr frameOut);
+
+    //Take the frames of another processor from frameIn instead of running an FFT of the input,
+    //while following is enabled and the Welch estimator and full rate mode are not (they need all of the input).
+    void setFrameInput(SpectrumFrameQueuePtr frameIn);
+    void setFollowFrames(bool follow);
+    bool isFollowingFrames();
     
 protected:
     virtual void process();
+
+    //process() from the frames of another processor.
+    void processFrames();
+
+    //Size the bin vectors for the FFT size and count down the peak reset, returns if peaks are held.
+    bool prepareBins();
+
+    //Follow a shift of the view by freqDiff Hz in the moving averages, binsBandwidth being the former one.
+    void shiftAverages(long freqDiff, long binsBandwidth);
+
+    //Rescale the moving averages after a zoom change of the view, bwDiff being the bandwidth difference.
+    void rescaleAverages(long bwDiff);
+
+    //Share fft_result with the followers, if any.
+    void publishFrame(long long frequency, long sampleRate, long binsBandwidth);
+
+    //Average fft_result, then map it to the display points of a new output, distributed to all outputs.
+    //frequency is the one of the input, binsBandwidth the bandwidth the bins span.
+    void publishBins(long long frequency, long binsBandwidth, long long viewCenterFreq, size_t viewBandwidth, bool doPeak);
     
     ReBuffer<SpectrumVisualData> outputBuffers;
+    BufferPool<SpectrumFrame> frameBuffers;
   
     
 private:
@@ -72,6 +153,7 @@ private:
 	size_t fftSizeInternal;
 	long long centerFreq;
 	size_t bandwidth;
+	long long deviceSampleRate;
 
 
     long lastInputBandwidth;
@@ -88,18 +170,18 @@ private:
     double fft_ceil_peak, fft_floor_peak;
     float fft_average_rate;
     
-    std::vector<double> fft_result;
-    std::vector<double> fft_result_ma;
-    std::vector<double> fft_result_maa;
-    std::vector<double> fft_result_peak;
-    std::vector<double> fft_result_temp;
+    std::vector<float> fft_result;
+    std::vector<float> fft_result_ma;
+    std::vector<float> fft_result_maa;
+    std::vector<float> fft_result_peak;
+    std::vector<float> fft_result_temp;
+    SpectrumKernels kernels;
     
-    msresamp_crcf resampler;
+    //view mode shift and decimation.
+    ZoomDecimator zoomDecimator;
     double resamplerRatio;
-    nco_crcf freqShifter;
     long shiftFrequency;
     
-    std::vector<liquid_float_complex> shiftBuffer;
     std::vector<liquid_float_complex> resampleBuffer;
     size_t desiredInputSize;
    
@@ -108,4 +190,21 @@ private:
     int peakReset;
     float scaleFactor;
     bool fftSizeChanged;
+
+    bool welchEnabled, welchParallel, welchChanged;
+    SpectrumEstimator::WindowType welchWindow;
+    int welchOverlap;
+    SpectrumEstimator welchEstimator;
+    std::unique_ptr<WorkerPool> welchWorkerPool;
+    std::vector<float> welchMagnitudes;
+    //input the estimator frames come from, they are restarted when it changes.
+    long long welchInputFrequency;
+    long welchInputRate;
+
+    bool fullRateEnabled;
+    SpectrumEstimator::FoldType fullRateFold;
+
+    std::vector<SpectrumFrameQueuePtr> frameOutputs;
+    SpectrumFrameQueuePtr frameInput;
+    bool followFrames;
 };
@@ -18,8 +18,8 @@ public:
     typedef typename std::shared_ptr<InputDataType> InputDataTypePtr;
     typedef typename std::shared_ptr<OutputDataType> OutputDataTypePtr;
 
-    typedef  ThreadBlockingQueue<InputDataTypePtr> VisualInputQueueType;
-    typedef  ThreadBlockingQueue<OutputDataTypePtr> VisualOutputQueueType;
+    typedef  ThreadQueue<InputDataTypePtr> VisualInputQueueType;
+    typedef  ThreadQueue<OutputDataTypePtr> VisualOutputQueueType;
 
     typedef  std::shared_ptr<VisualInputQueueType> VisualInputQueueTypePtr;
     typedef  std::shared_ptr<VisualOutputQueueType> VisualOutputQueueTypePtr;
@@ -0,0 +1,594 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "WaterfallHistory.h"
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define WATERFALL_HISTORY_MAGIC "CSDRWFH1"
+#define WATERFALL_HISTORY_VERSION 1
+//the header takes a page of its own, so that rows start aligned.
+#define WATERFALL_HISTORY_HEADER_SIZE 4096
+//rows moved between two checks for an interrupted migration.
+#define WATERFALL_HISTORY_MIGRATE_CHECK_ROWS 4096
+
+struct WaterfallHistory::FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t rowWidth;
+    uint64_t capacity;
+    uint64_t overviewCapacity;
+    //rows ever appended: row seq is in slot seq % capacity, the last capacity of them being kept.
+    uint64_t totalRows;
+};
+
+struct WaterfallHistory::RowHeader {
+    int64_t timestamp;
+    int64_t centerFreq;
+    int64_t bandwidth;
+};
+
+WaterfallHistory::WaterfallHistory() : header(nullptr), fileData(nullptr), fileSize(0), overviewBase(0), overviewCapacity(0),
+    queueHead(0), queueCount(0), openCapacity(0), openRequested(false), writerStop(false), writerThread(nullptr) {
+    rowStride = sizeof(RowHeader) + ((WATERFALL_HISTORY_ROW_WIDTH + 7) & ~7);
+#ifdef _WIN32
+    fileHandle = mappingHandle = nullptr;
+#else
+    fileDescriptor = -1;
+#endif
+}
+
+WaterfallHistory::~WaterfallHistory() {
+    close();
+}
+
+void WaterfallHistory::open(const std::string& path, size_t capacity) {
+    std::lock_guard < std::mutex > controlLock(controlMutex);
+
+    //bounded in bytes, whatever the line rate.
+    size_t maxCapacity = (size_t)((WATERFALL_HISTORY_MAX_FILE_SIZE - WATERFALL_HISTORY_HEADER_SIZE) / rowStride - 1)
+                         * WATERFALL_HISTORY_OVERVIEW_ROWS / (WATERFALL_HISTORY_OVERVIEW_ROWS + 1);
+
+    capacity = std::max(std::min(capacity, maxCapacity), (size_t)WATERFALL_HISTORY_OVERVIEW_ROWS);
+
+    std::lock_guard < std::mutex > lock(queueMutex);
+
+    //a newer request replaces one the writer has not started yet, and interrupts one in progress.
+    openPath = path;
+    openCapacity = capacity;
+    openRequested = true;
+
+    if (!writerThread) {
+        queueHead = queueCount = 0;
+        writerStop = false;
+        writerThread = new std::thread(&WaterfallHistory::writerMain, this);
+    }
+    queueCondition.notify_all();
+}
+
+void WaterfallHistory::reopen(const std::string& path, size_t capacity) {
+    {
+        std::lock_guard < std::mutex > lock(fileMutex);
+
+        if (header && path == filePath && header->capacity == capacity) {
+            return;
+        }
+        unmap();
+        header = nullptr;
+    }
+
+    //a history of another capacity, e.g. for another line rate, keeps its latest rows.
+    FileHeader existing;
+    std::ifstream existingFile(path.c_str(), std::ios::in | std::ios::binary);
+
+    if (existingFile.read((char *)&existing, sizeof(FileHeader)) && memcmp(existing.magic, WATERFALL_HISTORY_MAGIC, 8) == 0 &&
+        existing.version == WATERFALL_HISTORY_VERSION && existing.rowWidth == WATERFALL_HISTORY_ROW_WIDTH &&
+        existing.capacity >= WATERFALL_HISTORY_OVERVIEW_ROWS && existing.capacity != capacity && existing.totalRows > 0) {
+        existingFile.close();
+
+        if (!migrate(path, (size_t)existing.capacity, capacity)) {
+            //left to the next request.
+            if (openInterrupted()) {
+                return;
+            }
+            std::cout << "WaterfallHistory: unable to move the rows of '" << path << "' to the new capacity, the history is started over." << std::endl;
+        }
+    }
+    existingFile.close();
+
+    if (!mapHistory(path, capacity)) {
+        std::cout << "WaterfallHistory: unable to map '" << path << "', the waterfall history is disabled." << std::endl;
+    }
+}
+
+bool WaterfallHistory::mapHistory(const std::string& path, size_t capacity) {
+    std::lock_guard < std::mutex > lock(fileMutex);
+
+    size_t ovCapacity = capacity / WATERFALL_HISTORY_OVERVIEW_ROWS + 1;
+    size_t size = WATERFALL_HISTORY_HEADER_SIZE + (capacity + ovCapacity) * rowStride;
+
+    if (!map(path, size)) {
+        return false;
+    }
+
+    header = (FileHeader *)fileData;
+    filePath = path;
+    overviewBase = WATERFALL_HISTORY_HEADER_SIZE + capacity * rowStride;
+    overviewCapacity = ovCapacity;
+
+    //continue the rows of an existing file of the same layout, else start over.
+    if (memcmp(header->magic, WATERFALL_HISTORY_MAGIC, 8) != 0 || header->version != WATERFALL_HISTORY_VERSION ||
+        header->rowWidth != WATERFALL_HISTORY_ROW_WIDTH || header->capacity != capacity || header->overviewCapacity != ovCapacity) {
+        memcpy(header->magic, WATERFALL_HISTORY_MAGIC, 8);
+        header->version = WATERFALL_HISTORY_VERSION;
+        header->rowWidth = WATERFALL_HISTORY_ROW_WIDTH;
+        header->capacity = capacity;
+        header->overviewCapacity = ovCapacity;
+        header->totalRows = 0;
+    }
+
+    //the rows of the overview row in progress are in the file already.
+    overviewAccum.assign(WATERFALL_HISTORY_ROW_WIDTH, 0);
+
+    for (uint64_t seq = header->totalRows - header->totalRows % WATERFALL_HISTORY_OVERVIEW_ROWS; seq < header->totalRows; seq++) {
+        maxInto(&overviewAccum[0], ringRow(WATERFALL_HISTORY_HEADER_SIZE, capacity, seq) + sizeof(RowHeader));
+    }
+
+    return true;
+}
+
+bool WaterfallHistory::openInterrupted() {
+    std::lock_guard < std::mutex > lock(queueMutex);
+
+    return writerStop || openRequested;
+}
+
+void WaterfallHistory::close() {
+    std::lock_guard < std::mutex > controlLock(controlMutex);
+
+    //the rows already queued are written first, an open in progress is given up.
+    stopWriter();
+
+    std::lock_guard < std::mutex > lock(fileMutex);
+
+    unmap();
+    header = nullptr;
+}
+
+bool WaterfallHistory::isOpen() {
+    std::lock_guard < std::mutex > lock(fileMutex);
+
+    return header != nullptr;
+}
+
+void WaterfallHistory::stopWriter() {
+    std::thread *thread;
+
+    {
+        std::lock_guard < std::mutex > lock(queueMutex);
+
+        thread = writerThread;
+        writerThread = nullptr;
+        writerStop = true;
+        openRequested = false;
+        queueCondition.notify_all();
+    }
+
+    if (thread) {
+        thread->join();
+        delete thread;
+    }
+}
+
+void WaterfallHistory::writerMain() {
+    std::unique_lock < std::mutex > lock(queueMutex);
+
+    while (true) {
+        queueCondition.wait(lock, [this]() { return queueCount > 0 || openRequested || writerStop; });
+
+        //the file first, the rows queued meanwhile then go to it.
+        if (openRequested) {
+            std::string path = openPath;
+            size_t capacity = openCapacity;
+
+            openRequested = false;
+            lock.unlock();
+            reopen(path, capacity);
+            lock.lock();
+            continue;
+        }
+
+        //stopped once the queue is empty.
+        if (queueCount == 0) {
+            break;
+        }
+
+        //the row stays in the queue while written, append() only fills the other slots.
+        PendingRow& row = queue[queueHead];
+        lock.unlock();
+
+        {
+            std::lock_guard < std::mutex > fileLock(fileMutex);
+            writeRow(&row.levels[0], row.levels.size(), row.centerFreq, row.bandwidth, row.timestamp);
+        }
+
+        lock.lock();
+        queueHead = (queueHead + 1) % WATERFALL_HISTORY_QUEUE_ROWS;
+        queueCount--;
+    }
+}
+
+bool WaterfallHistory::migrate(const std::string& path, size_t oldCapacity, size_t capacity) {
+    std::string newPath = path + ".migrate";
+    bool moved = false;
+
+    std::remove(newPath.c_str());
+
+    {
+        WaterfallHistory from, to;
+
+        if (from.mapHistory(path, oldCapacity) && to.mapHistory(newPath, capacity)) {
+            std::lock_guard < std::mutex > fromLock(from.fileMutex);
+            std::lock_guard < std::mutex > toLock(to.fileMutex);
+
+            size_t count = std::min(from.numRows(), (size_t)to.header->capacity);
+            Row row;
+
+            moved = true;
+
+            //oldest first.
+            for (size_t age = count; age-- > 0; ) {
+                if (age % WATERFALL_HISTORY_MIGRATE_CHECK_ROWS == 0 && openInterrupted()) {
+                    moved = false;
+                    break;
+                }
+
+                const unsigned char *levels = from.findRow(age, row);
+
+                if (levels) {
+                    to.storeRow(levels, row.centerFreq, row.bandwidth, row.timestamp);
+                }
+            }
+        }
+    }
+
+    if (!moved) {
+        std::remove(newPath.c_str());
+        return false;
+    }
+
+    //rename() does not replace an existing file everywhere.
+    std::remove(path.c_str());
+
+    return std::rename(newPath.c_str(), path.c_str()) == 0;
+}
+
+int64_t WaterfallHistory::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+unsigned char *WaterfallHistory::ringRow(size_t base, size_t ringCapacity, uint64_t seq) {
+    return fileData + base + (size_t)(seq % ringCapacity) * rowStride;
+}
+
+void WaterfallHistory::maxInto(unsigned char *dst, const unsigned char *src) {
+    for (size_t i = 0; i < WATERFALL_HISTORY_ROW_WIDTH; i++) {
+        dst[i] = std::max(dst[i], src[i]);
+    }
+}
+
+void WaterfallHistory::append(const float *levels, size_t count, size_t stride, long long centerFreq, long long bandwidth, int64_t timestamp) {
+    if (count == 0) {
+        return;
+    }
+
+    std::lock_guard < std::mutex > lock(queueMutex);
+
+    //closed, or the writer is behind.
+    if (!writerThread || queueCount == WATERFALL_HISTORY_QUEUE_ROWS) {
+        return;
+    }
+
+    PendingRow& row = queue[(queueHead + queueCount) % WATERFALL_HISTORY_QUEUE_ROWS];
+
+    row.levels.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        row.levels[i] = levels[i * stride];
+    }
+    row.centerFreq = centerFreq;
+    row.bandwidth = bandwidth;
+    row.timestamp = timestamp;
+
+    queueCount++;
+    queueCondition.notify_one();
+}
+
+void WaterfallHistory::writeRow(const float *levels, size_t count, long long centerFreq, long long bandwidth, int64_t timestamp) {
+    if (!header) {
+        return;
+    }
+
+    //peaks are kept when reducing a large FFT to the row width.
+    pyramid.build(levels, count, 1);
+    rowLevels.resize(WATERFALL_HISTORY_ROW_WIDTH);
+    pyramid.sample(0, (double)count, WATERFALL_HISTORY_ROW_WIDTH, nullptr, &rowLevels[0], nullptr);
+
+    //same quantization as the waterfall textures.
+    rowQuantized.resize(WATERFALL_HISTORY_ROW_WIDTH);
+
+    for (size_t i = 0; i < WATERFALL_HISTORY_ROW_WIDTH; i++) {
+        float v = rowLevels[i];
+        float wv = v < 0 ? 0 : (v > 0.99 ? 0.99 : v);
+
+        rowQuantized[i] = (unsigned char) floor(wv * 255.0);
+    }
+
+    storeRow(&rowQuantized[0], centerFreq, bandwidth, timestamp);
+}
+
+void WaterfallHistory::storeRow(const unsigned char *levels, long long centerFreq, long long bandwidth, int64_t timestamp) {
+    uint64_t seq = header->totalRows;
+    unsigned char *row = ringRow(WATERFALL_HISTORY_HEADER_SIZE, header->capacity, seq);
+    RowHeader *rowHeader = (RowHeader *)row;
+    unsigned char *rowData = row + sizeof(RowHeader);
+
+    memcpy(rowData, levels, WATERFALL_HISTORY_ROW_WIDTH);
+
+    rowHeader->timestamp = timestamp;
+    rowHeader->centerFreq = centerFreq;
+    rowHeader->bandwidth = bandwidth;
+
+    maxInto(&overviewAccum[0], rowData);
+
+    if ((seq + 1) % WATERFALL_HISTORY_OVERVIEW_ROWS == 0) {
+        unsigned char *ovRow = ringRow(overviewBase, overviewCapacity, seq / WATERFALL_HISTORY_OVERVIEW_ROWS);
+
+        //time of the first row of the group, frequency of the last one.
+        RowHeader *firstHeader = (RowHeader *)ringRow(WATERFALL_HISTORY_HEADER_SIZE, header->capacity, seq + 1 - WATERFALL_HISTORY_OVERVIEW_ROWS);
+        RowHeader *ovHeader = (RowHeader *)ovRow;
+
+        ovHeader->timestamp = firstHeader->timestamp;
+        ovHeader->centerFreq = centerFreq;
+        ovHeader->bandwidth = bandwidth;
+        memcpy(ovRow + sizeof(RowHeader), &overviewAccum[0], WATERFALL_HISTORY_ROW_WIDTH);
+
+        std::fill(overviewAccum.begin(), overviewAccum.end(), 0);
+    }
+
+    //published last, so that a crash never exposes a partial row.
+    header->totalRows = seq + 1;
+}
+
+size_t WaterfallHistory::getNumRows() {
+    std::lock_guard < std::mutex > lock(fileMutex);
+
+    return numRows();
+}
+
+size_t WaterfallHistory::numRows() {
+    if (!header) {
+        return 0;
+    }
+    return (size_t)std::min(header->totalRows, header->capacity);
+}
+
+size_t WaterfallHistory::getCapacity() {
+    std::lock_guard < std::mutex > lock(fileMutex);
+
+    return header ? (size_t)header->capacity : 0;
+}
+
+bool WaterfallHistory::getRow(size_t age, Row& row, unsigned char *levels) {
+    std::lock_guard < std::mutex > lock(fileMutex);
+
+    const unsigned char *rowLevels = findRow(age, row);
+
+    if (!rowLevels) {
+        return false;
+    }
+    if (levels) {
+        memcpy(levels, rowLevels, WATERFALL_HISTORY_ROW_WIDTH);
+    }
+    return true;
+}
+
+const unsigned char *WaterfallHistory::findRow(size_t age, Row& row) {
+    if (age >= numRows()) {
+        return nullptr;
+    }
+
+    unsigned char *data = ringRow(WATERFALL_HISTORY_HEADER_SIZE, header->capacity, header->totalRows - 1 - age);
+    RowHeader *rowHeader = (RowHeader *)data;
+
+    row.timestamp = rowHeader->timestamp;
+    row.centerFreq = rowHeader->centerFreq;
+    row.bandwidth = rowHeader->bandwidth;
+
+    return data + sizeof(RowHeader);
+}
+
+size_t WaterfallHistory::readLines(size_t firstAge, size_t rowsPerLine, size_t numLines, unsigned char *out) {
+    std::lock_guard < std::mutex > lock(fileMutex);
+
+    memset(out, 0, numLines * WATERFALL_HISTORY_ROW_WIDTH);
+
+    size_t available = numRows();
+    rowsPerLine = std::max(rowsPerLine, (size_t)1);
+
+    if (firstAge >= available) {
+        return 0;
+    }
+
+    uint64_t oldest = header->totalRows - available;
+    uint64_t completeOverviews = header->totalRows / WATERFALL_HISTORY_OVERVIEW_ROWS;
+    uint64_t oldestOverview = (completeOverviews > overviewCapacity) ? (completeOverviews - overviewCapacity) : 0;
+    size_t numFilled = 0;
+
+    for (size_t l = 0; l < numLines; l++) {
+        size_t lineAge = firstAge + l * rowsPerLine;
+
+        if (lineAge >= available) {
+            break;
+        }
+
+        unsigned char *line = out + l * WATERFALL_HISTORY_ROW_WIDTH;
+        //rows [first, last] of the line, by sequence number.
+        uint64_t last = header->totalRows - 1 - lineAge;
+        uint64_t first = (last + 1 >= oldest + rowsPerLine) ? (last + 1 - rowsPerLine) : oldest;
+        uint64_t seq = first;
+
+        while (seq <= last) {
+            uint64_t ov = seq / WATERFALL_HISTORY_OVERVIEW_ROWS;
+
+            //whole overview rows where they fit, single rows at the ends.
+            if (rowsPerLine >= WATERFALL_HISTORY_OVERVIEW_ROWS && seq % WATERFALL_HISTORY_OVERVIEW_ROWS == 0 &&
+                seq + WATERFALL_HISTORY_OVERVIEW_ROWS - 1 <= last && ov < completeOverviews && ov >= oldestOverview) {
+                maxInto(line, ringRow(overviewBase, overviewCapacity, ov) + sizeof(RowHeader));
+                seq += WATERFALL_HISTORY_OVERVIEW_ROWS;
+            } else {
+                maxInto(line, ringRow(WATERFALL_HISTORY_HEADER_SIZE, header->capacity, seq) + sizeof(RowHeader));
+                seq++;
+            }
+        }
+
+        numFilled++;
+    }
+
+    return numFilled;
+}
+
+bool WaterfallHistory::exportImage(const std::string& path, size_t firstAge, size_t count) {
+    std::lock_guard < std::mutex > lock(fileMutex);
+
+    size_t available = numRows();
+
+    if (firstAge >= available) {
+        return false;
+    }
+    count = std::min(count, available - firstAge);
+
+    std::ofstream image(path.c_str(), std::ios::out | std::ios::binary);
+    std::ofstream index((path + ".csv").c_str(), std::ios::out);
+
+    if (!image.is_open() || !index.is_open()) {
+        return false;
+    }
+
+    image << "P5\n" << WATERFALL_HISTORY_ROW_WIDTH << " " << count << "\n255\n";
+    index << "line,timestamp_us,center_frequency_hz,bandwidth_hz\n";
+
+    Row row;
+
+    for (size_t l = 0; l < count; l++) {
+        //oldest first, from the top.
+        const unsigned char *levels = findRow(firstAge + count - 1 - l, row);
+
+        if (!levels) {
+            return false;
+        }
+        image.write((const char *)levels, WATERFALL_HISTORY_ROW_WIDTH);
+        index << l << "," << row.timestamp << "," << row.centerFreq << "," << row.bandwidth << "\n";
+    }
+
+    return image.good() && index.good();
+}
+
+#ifdef _WIN32
+bool WaterfallHistory::map(const std::string& path, size_t size) {
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        return false;
+    }
+
+    //the mapping sets the file size.
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFF), nullptr);
+
+    if (mappingHandle == nullptr) {
+        unmap();
+        return false;
+    }
+
+    fileData = (unsigned char *)MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+
+    if (fileData == nullptr) {
+        unmap();
+        return false;
+    }
+
+    fileSize = size;
+    return true;
+}
+
+void WaterfallHistory::unmap() {
+    if (fileData) {
+        FlushViewOfFile(fileData, 0);
+        UnmapViewOfFile(fileData);
+        fileData = nullptr;
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+    }
+    fileSize = 0;
+}
+#else
+bool WaterfallHistory::map(const std::string& path, size_t size) {
+    fileDescriptor = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+
+    if (fileDescriptor < 0) {
+        return false;
+    }
+
+    //a sparse file: blocks are only allocated as the rows get written.
+    struct stat st;
+    if (fstat(fileDescriptor, &st) != 0 || ((size_t)st.st_size != size && ftruncate(fileDescriptor, (off_t)size) != 0)) {
+        unmap();
+        return false;
+    }
+
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+
+    if (data == MAP_FAILED) {
+        unmap();
+        return false;
+    }
+
+    fileData = (unsigned char *)data;
+    fileSize = size;
+    return true;
+}
+
+void WaterfallHistory::unmap() {
+    if (fileData) {
+        //written back asynchronously, not to stall on close.
+        msync(fileData, fileSize, MS_ASYNC);
+        munmap(fileData, fileSize);
+        fileData = nullptr;
+    }
+    if (fileDescriptor >= 0) {
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+    }
+    fileSize = 0;
+}
+#endif
@@ -0,0 +1,150 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "SpectrumPyramid.h"
+
+//Levels per history row, whatever the FFT size.
+#define WATERFALL_HISTORY_ROW_WIDTH 2048
+//Rows combined in each row of the overview, for zoomed out reads.
+#define WATERFALL_HISTORY_OVERVIEW_ROWS 64
+//Rows waiting for the writer thread, above which new ones are dropped.
+#define WATERFALL_HISTORY_QUEUE_ROWS 16
+//Largest history file, in bytes, whatever the capacity asked for: a file is allocated
+//in full up front on some systems.
+#define WATERFALL_HISTORY_MAX_FILE_SIZE (1024ULL * 1024 * 1024)
+
+//Waterfall rows kept in a memory-mapped ring file, so that hours of them can be
+//scrolled back to without holding them in RAM: each row is the 8 bit quantized
+//levels of a waterfall line, with its time and center frequency.
+//The file also holds an overview ring, each row of it the max of WATERFALL_HISTORY_OVERVIEW_ROWS rows,
+//so that zoomed out reads over hours only touch a small part of the file.
+//Rows are addressed by age, 0 being the latest one.
+//The file is opened, and rows are reduced, quantized and written, by a thread of the history, so that
+//open() and append() return at once; all the functions can be called from any thread.
+class WaterfallHistory {
+public:
+    struct Row {
+        //microseconds since the epoch.
+        int64_t timestamp;
+        long long centerFreq;
+        long long bandwidth;
+    };
+
+    WaterfallHistory();
+    ~WaterfallHistory();
+
+    //Open the ring file at path for capacity rows, at most WATERFALL_HISTORY_MAX_FILE_SIZE bytes of them,
+    //continuing it if it has the same layout. A history file of another capacity has its latest rows moved
+    //to the new layout, other files are started over. This is done by the writer thread: isOpen() is false
+    //until the file is mapped, and a failure is only logged.
+    void open(const std::string& path, size_t capacity);
+    void close();
+    bool isOpen();
+
+    //Append a row of count levels in [0, 1], taken every stride floats from levels,
+    //reduced or stretched to WATERFALL_HISTORY_ROW_WIDTH. The row is copied and written
+    //by the writer thread, or dropped if WATERFALL_HISTORY_QUEUE_ROWS rows are already waiting.
+    void append(const float *levels, size_t count, size_t stride, long long centerFreq, long long bandwidth, int64_t timestamp);
+
+    size_t getNumRows();
+    size_t getCapacity();
+
+    //levels, if not null, receives the WATERFALL_HISTORY_ROW_WIDTH levels of the row.
+    bool getRow(size_t age, Row& row, unsigned char *levels = nullptr);
+
+    //numLines lines of WATERFALL_HISTORY_ROW_WIDTH levels into out, from the row of age firstAge back in time,
+    //each the max of rowsPerLine rows; lines past the oldest row are zero. Returns the number of lines with rows.
+    size_t readLines(size_t firstAge, size_t rowsPerLine, size_t numLines, unsigned char *out);
+
+    //Write rows [firstAge, firstAge + count) as a PGM image, the latest at the bottom,
+    //and their times and frequencies as a CSV next to it.
+    bool exportImage(const std::string& path, size_t firstAge, size_t count);
+
+    //microseconds since the epoch, for append().
+    static int64_t now();
+
+private:
+    struct FileHeader;
+    struct RowHeader;
+
+    //a row copied by append(), waiting for the writer thread.
+    struct PendingRow {
+        std::vector<float> levels;
+        long long centerFreq;
+        long long bandwidth;
+        int64_t timestamp;
+    };
+
+    void writerMain();
+    void stopWriter();
+
+    //on the writer thread: close the current file, then migrate and map the one at path.
+    void reopen(const std::string& path, size_t capacity);
+    //map the file at path for capacity rows, starting it over unless it has that layout.
+    bool mapHistory(const std::string& path, size_t capacity);
+    //true once close() or another open() is waiting, for the writer to give up the open in progress.
+    bool openInterrupted();
+
+    //reduce, quantize and store a row of count levels; the file lock is held.
+    void writeRow(const float *levels, size_t count, long long centerFreq, long long bandwidth, int64_t timestamp);
+    //store a row of WATERFALL_HISTORY_ROW_WIDTH quantized levels.
+    void storeRow(const unsigned char *levels, long long centerFreq, long long bandwidth, int64_t timestamp);
+    //the levels of the row in the mapping, or null; the file lock is held.
+    const unsigned char *findRow(size_t age, Row& row);
+    size_t numRows();
+
+    //Move the latest rows of the history file at path, of oldCapacity rows, to a file of capacity rows in its place.
+    //Given up, leaving the file as it is, when openInterrupted().
+    bool migrate(const std::string& path, size_t oldCapacity, size_t capacity);
+
+    //row of the sequence number seq in a ring of capacity rows starting at base.
+    unsigned char *ringRow(size_t base, size_t ringCapacity, uint64_t seq);
+    void maxInto(unsigned char *dst, const unsigned char *src);
+
+    bool map(const std::string& path, size_t fileSize);
+    void unmap();
+
+    FileHeader *header;
+    std::string filePath;
+    unsigned char *fileData;
+    size_t fileSize;
+    size_t rowStride, overviewBase, overviewCapacity;
+
+#ifdef _WIN32
+    void *fileHandle, *mappingHandle;
+#else
+    int fileDescriptor;
+#endif
+
+    SpectrumPyramid pyramid;
+    std::vector<float> rowLevels;
+    std::vector<unsigned char> rowQuantized;
+    std::vector<unsigned char> overviewAccum;
+
+    //guards the mapping and the header.
+    std::mutex fileMutex;
+
+    //serializes open() and close().
+    std::mutex controlMutex;
+
+    //ring of queueCount rows from queueHead, each kept until written so that their buffers are reused.
+    //Also guards the open request for the writer thread.
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    PendingRow queue[WATERFALL_HISTORY_QUEUE_ROWS];
+    size_t queueHead, queueCount;
+    std::string openPath;
+    size_t openCapacity;
+    bool openRequested;
+    bool writerStop;
+    std::thread *writerThread;
+};
@@ -0,0 +1,321 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "ZoomDecimator.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+//Half-band taps at odd offsets from the center, i.e. a 63 taps filter,
+//Kaiser window for 100 dB: flat to 0.21 and stopband from 0.3 of the input rate,
+//so that a decimated output is clean up to 85% of its Nyquist frequency.
+#define ZOOM_HALFBAND_PAIRS 16
+#define ZOOM_HALFBAND_ATTENUATION 100.0
+
+//input samples a window spans.
+#define ZOOM_HALFBAND_SPAN (4 * ZOOM_HALFBAND_PAIRS - 1)
+
+//samples between renormalizations of the shift phasor.
+#define ZOOM_PHASOR_RENORMALIZE 1024
+
+// y[n] = 0.5 * odd[n + P - 1] + sum_j h[j] * (even[n + P - 1 - j] + even[n + P + j]), P = ZOOM_HALFBAND_PAIRS,
+// on complex samples as interleaved floats.
+// Plain C++ version, also used for the tails of the vectorized ones.
+static void halfBandGeneric(const float *even, const float *odd, const float *h, float *y, size_t numOut) {
+    for (size_t n = 0; n < numOut; n++) {
+        const float *left = even + 2 * (n + ZOOM_HALFBAND_PAIRS - 1);
+        const float *right = even + 2 * (n + ZOOM_HALFBAND_PAIRS);
+        float re = 0.5f * odd[2 * (n + ZOOM_HALFBAND_PAIRS - 1)];
+        float im = 0.5f * odd[2 * (n + ZOOM_HALFBAND_PAIRS - 1) + 1];
+
+        for (int j = 0; j < ZOOM_HALFBAND_PAIRS; j++) {
+            re += h[j] * (left[-2 * j] + right[2 * j]);
+            im += h[j] * (left[-2 * j + 1] + right[2 * j + 1]);
+        }
+
+        y[2 * n] = re;
+        y[2 * n + 1] = im;
+    }
+}
+
+#if CUBICSDR_SIMD_X86
+//2 complex outputs at a time, as the taps are real.
+CUBICSDR_TARGET_SSE2 static void halfBandSSE2(const float *even, const float *odd, const float *h, float *y, size_t numOut) {
+    __m128 half = _mm_set1_ps(0.5f);
+    size_t n = 0;
+
+    for (; n + 2 <= numOut; n += 2) {
+        const float *left = even + 2 * (n + ZOOM_HALFBAND_PAIRS - 1);
+        const float *right = even + 2 * (n + ZOOM_HALFBAND_PAIRS);
+        __m128 acc = _mm_mul_ps(half, _mm_loadu_ps(odd + 2 * (n + ZOOM_HALFBAND_PAIRS - 1)));
+
+        for (int j = 0; j < ZOOM_HALFBAND_PAIRS; j++) {
+            __m128 sum = _mm_add_ps(_mm_loadu_ps(left - 2 * j), _mm_loadu_ps(right + 2 * j));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(h[j]), sum));
+        }
+
+        _mm_storeu_ps(y + 2 * n, acc);
+    }
+
+    halfBandGeneric(even + 2 * n, odd + 2 * n, h, y + 2 * n, numOut - n);
+}
+
+//4 complex outputs at a time.
+CUBICSDR_TARGET_AVX2 static void halfBandAVX2(const float *even, const float *odd, const float *h, float *y, size_t numOut) {
+    __m256 half = _mm256_set1_ps(0.5f);
+    size_t n = 0;
+
+    for (; n + 4 <= numOut; n += 4) {
+        const float *left = even + 2 * (n + ZOOM_HALFBAND_PAIRS - 1);
+        const float *right = even + 2 * (n + ZOOM_HALFBAND_PAIRS);
+        __m256 acc = _mm256_mul_ps(half, _mm256_loadu_ps(odd + 2 * (n + ZOOM_HALFBAND_PAIRS - 1)));
+
+        for (int j = 0; j < ZOOM_HALFBAND_PAIRS; j++) {
+            __m256 sum = _mm256_add_ps(_mm256_loadu_ps(left - 2 * j), _mm256_loadu_ps(right + 2 * j));
+            acc = _mm256_fmadd_ps(_mm256_set1_ps(h[j]), sum, acc);
+        }
+
+        _mm256_storeu_ps(y + 2 * n, acc);
+    }
+
+    halfBandGeneric(even + 2 * n, odd + 2 * n, h, y + 2 * n, numOut - n);
+}
+#endif
+
+#if CUBICSDR_SIMD_NEON
+//2 complex outputs at a time.
+static void halfBandNEON(const float *even, const float *odd, const float *h, float *y, size_t numOut) {
+    size_t n = 0;
+
+    for (; n + 2 <= numOut; n += 2) {
+        const float *left = even + 2 * (n + ZOOM_HALFBAND_PAIRS - 1);
+        const float *right = even + 2 * (n + ZOOM_HALFBAND_PAIRS);
+        float32x4_t acc = vmulq_n_f32(vld1q_f32(odd + 2 * (n + ZOOM_HALFBAND_PAIRS - 1)), 0.5f);
+
+        for (int j = 0; j < ZOOM_HALFBAND_PAIRS; j++) {
+            float32x4_t sum = vaddq_f32(vld1q_f32(left - 2 * j), vld1q_f32(right + 2 * j));
+            acc = vmlaq_n_f32(acc, sum, h[j]);
+        }
+
+        vst1q_f32(y + 2 * n, acc);
+    }
+
+    halfBandGeneric(even + 2 * n, odd + 2 * n, h, y + 2 * n, numOut - n);
+}
+#endif
+
+ZoomDecimator::Stage::Stage() : bufferSize(0) {
+}
+
+ZoomDecimator::ZoomDecimator() : numStages(0), shiftEnabled(false) {
+    phasor.real = 1.0f;
+    phasor.imag = 0.0f;
+    rotation = phasor;
+
+    simdLevel = CPUFeatures::getSIMDLevel();
+
+    switch (simdLevel) {
+#if CUBICSDR_SIMD_X86
+        case CPUFeatures::SIMD_AVX2:
+            halfBandKernel = &halfBandAVX2;
+            break;
+        case CPUFeatures::SIMD_SSE2:
+            halfBandKernel = &halfBandSSE2;
+            break;
+#endif
+#if CUBICSDR_SIMD_NEON
+        case CPUFeatures::SIMD_NEON:
+            halfBandKernel = &halfBandNEON;
+            break;
+#endif
+        default:
+            simdLevel = CPUFeatures::SIMD_NONE;
+            halfBandKernel = &halfBandGeneric;
+            break;
+    }
+}
+
+ZoomDecimator::~ZoomDecimator() {
+}
+
+//modified Bessel function of the first kind, order 0, by its series.
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+
+    for (int k = 1; k < 64 && term > sum * 1e-17; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static std::vector<float> designHalfBandTaps() {
+    double beta = 0.1102 * (ZOOM_HALFBAND_ATTENUATION - 8.7);
+    double halfWidth = 2.0 * ZOOM_HALFBAND_PAIRS;
+    std::vector<double> h(ZOOM_HALFBAND_PAIRS);
+    double sum = 0;
+
+    for (int j = 0; j < ZOOM_HALFBAND_PAIRS; j++) {
+        double n = 2 * j + 1;
+        double r = n / halfWidth;
+
+        h[j] = sin(M_PI * n / 2.0) / (M_PI * n) * besselI0(beta * sqrt(1.0 - r * r)) / besselI0(beta);
+        sum += h[j];
+    }
+
+    //the center tap stays 0.5, and the others are scaled for unity gain at DC.
+    std::vector<float> taps(ZOOM_HALFBAND_PAIRS);
+
+    for (int j = 0; j < ZOOM_HALFBAND_PAIRS; j++) {
+        taps[j] = (float)(h[j] * 0.25 / sum);
+    }
+    return taps;
+}
+
+const std::vector<float>& ZoomDecimator::getHalfBandTaps() {
+    static const std::vector<float> taps = designHalfBandTaps();
+
+    return taps;
+}
+
+void ZoomDecimator::setDecimation(int numStages_in) {
+    numStages = std::max(numStages_in, 0);
+
+    while ((int)stages.size() < numStages) {
+        stages.push_back(std::unique_ptr<Stage>(new Stage()));
+    }
+
+    reset();
+}
+
+int ZoomDecimator::getDecimation() {
+    return numStages;
+}
+
+CPUFeatures::SIMDLevel ZoomDecimator::getSIMDLevel() {
+    return simdLevel;
+}
+
+void ZoomDecimator::setShift(double shift) {
+    shiftEnabled = (shift != 0);
+
+    rotation.real = (float)cos(-2.0 * M_PI * shift);
+    rotation.imag = (float)sin(-2.0 * M_PI * shift);
+}
+
+void ZoomDecimator::reset() {
+    for (std::unique_ptr<Stage>& stage : stages) {
+        stage->bufferSize = 0;
+    }
+}
+
+size_t ZoomDecimator::getMaxOutput(size_t numSamples) {
+    if (numStages == 0) {
+        return numSamples;
+    }
+
+    //each stage outputs at most half of its input and history.
+    return (numSamples >> numStages) + ZOOM_HALFBAND_SPAN;
+}
+
+liquid_float_complex *ZoomDecimator::appendInput(Stage& stage, size_t numSamples) {
+    if (stage.buffer.size() < stage.bufferSize + numSamples) {
+        stage.buffer.resize(stage.bufferSize + numSamples);
+    }
+
+    liquid_float_complex *dst = &stage.buffer[stage.bufferSize];
+    stage.bufferSize += numSamples;
+
+    return dst;
+}
+
+size_t ZoomDecimator::decimate(Stage& stage, liquid_float_complex *out) {
+    if (stage.bufferSize < ZOOM_HALFBAND_SPAN) {
+        return 0;
+    }
+
+    //windows start at every even sample, the last one ending at the end of the input.
+    size_t numOut = (stage.bufferSize - ZOOM_HALFBAND_SPAN) / 2 + 1;
+    size_t numEven = numOut + 2 * ZOOM_HALFBAND_PAIRS - 1;
+    size_t numOdd = numOut + ZOOM_HALFBAND_PAIRS - 1;
+
+    //the center tap applies to the odd samples, the others to the even ones:
+    //split them for the kernel to run on contiguous samples.
+    if (evenSamples.size() < numEven) {
+        evenSamples.resize(numEven);
+        oddSamples.resize(numEven);
+    }
+
+    const liquid_float_complex *x = stage.buffer.data();
+
+    for (size_t i = 0; i < numEven; i++) {
+        evenSamples[i] = x[2 * i];
+    }
+    for (size_t i = 0; i < numOdd; i++) {
+        oddSamples[i] = x[2 * i + 1];
+    }
+
+    halfBandKernel((const float *)evenSamples.data(), (const float *)oddSamples.data(), getHalfBandTaps().data(), (float *)out, numOut);
+
+    // Keep the samples from the start of the next window on.
+    size_t next = 2 * numOut;
+
+    memmove(&stage.buffer[0], &stage.buffer[next], (stage.bufferSize - next) * sizeof(liquid_float_complex));
+    stage.bufferSize -= next;
+
+    return numOut;
+}
+
+size_t ZoomDecimator::execute(const liquid_float_complex *in, size_t numSamples, liquid_float_complex *out) {
+    liquid_float_complex *dst = (numStages == 0) ? out : appendInput(*stages[0], numSamples);
+
+    // The shift is applied while staging the input of the first stage.
+    if (shiftEnabled) {
+        float pr = phasor.real, pi = phasor.imag;
+        float rr = rotation.real, ri = rotation.imag;
+
+        for (size_t i = 0; i < numSamples; i++) {
+            float xr = in[i].real, xi = in[i].imag;
+
+            dst[i].real = xr * pr - xi * pi;
+            dst[i].imag = xr * pi + xi * pr;
+
+            float t = pr * rr - pi * ri;
+            pi = pr * ri + pi * rr;
+            pr = t;
+
+            //keep the phasor on the unit circle despite the rounding of the recurrence.
+            if ((i % ZOOM_PHASOR_RENORMALIZE) == ZOOM_PHASOR_RENORMALIZE - 1) {
+                float mag = sqrtf(pr * pr + pi * pi);
+                pr /= mag;
+                pi /= mag;
+            }
+        }
+
+        float mag = sqrtf(pr * pr + pi * pi);
+        phasor.real = pr / mag;
+        phasor.imag = pi / mag;
+    } else if (dst != in) {
+        memmove(dst, in, numSamples * sizeof(liquid_float_complex));
+    }
+
+    if (numStages == 0) {
+        return numSamples;
+    }
+
+    for (int s = 0; s + 1 < numStages; s++) {
+        Stage& next = *stages[s + 1];
+        size_t room = stages[s]->bufferSize / 2 + 1;
+
+        liquid_float_complex *nextInput = appendInput(next, room);
+        size_t numOut = decimate(*stages[s], nextInput);
+
+        next.bufferSize -= room - numOut;
+    }
+
+    return decimate(*stages[numStages - 1], out);
+}
@@ -0,0 +1,72 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include "liquid/liquid.h"
+#include "CPUFeatures.h"
+
+//Frequency shift and decimation by a power of two, for the zoomed spectrum:
+//a cascade of identical half-band FIR stages, the shift being applied while
+//the input is staged for the first one.
+//The half-band taps are designed once for all, and the stages are kept when the
+//zoom changes, so that zooming in and out only resets their history.
+class ZoomDecimator {
+public:
+    ZoomDecimator();
+    ~ZoomDecimator();
+
+    //Decimate by 2^numStages, 0 for a shift only. The filter history is cleared.
+    void setDecimation(int numStages);
+    int getDecimation();
+
+    //Shift the input by -shift, in cycles per input sample.
+    void setShift(double shift);
+
+    //Clear the filter history, e.g. after an input discontinuity.
+    void reset();
+
+    //Output samples execute() writes at most for numSamples input samples.
+    size_t getMaxOutput(size_t numSamples);
+
+    //Shift and decimate numSamples input samples, returns the number of samples written to out.
+    size_t execute(const liquid_float_complex *in, size_t numSamples, liquid_float_complex *out);
+
+    CPUFeatures::SIMDLevel getSIMDLevel();
+
+    //numOut outputs of a half-band stage, from its even and odd input samples.
+    typedef void (*HalfBandKernel)(const float *even, const float *odd, const float *h, float *y, size_t numOut);
+
+private:
+    //one half-band decimator: its input, i.e. the history still needed followed by the new samples.
+    struct Stage {
+        Stage();
+
+        std::vector<liquid_float_complex> buffer;
+        size_t bufferSize;
+    };
+
+    //room for numSamples new samples at the end of the stage input.
+    liquid_float_complex *appendInput(Stage& stage, size_t numSamples);
+
+    //decimate all the complete windows of the stage input into out, keeping what the next ones need.
+    size_t decimate(Stage& stage, liquid_float_complex *out);
+
+    //the taps at odd offsets 1, 3, 5... from the center, the others being zero but the center one of 0.5.
+    static const std::vector<float>& getHalfBandTaps();
+
+    std::vector<std::unique_ptr<Stage>> stages;
+    int numStages;
+
+    liquid_float_complex phasor, rotation;
+    bool shiftEnabled;
+
+    //input of the stage being run, split into its even and odd samples.
+    std::vector<liquid_float_complex> evenSamples, oddSamples;
+
+    CPUFeatures::SIMDLevel simdLevel;
+    HalfBandKernel halfBandKernel;
+};
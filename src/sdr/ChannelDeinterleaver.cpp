@@ -0,0 +1,181 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "ChannelDeinterleaver.h"
+#include <algorithm>
+
+//Size of the interleaved input read per tile, to stay well within L1 data cache
+//together with the output it is copied to.
+#define DEINTERLEAVE_TILE_BYTES (16 * 1024)
+#define DEINTERLEAVE_TILE_MIN_FRAMES 16
+#define DEINTERLEAVE_TILE_MAX_FRAMES 1024
+
+// Plain C++ versions, also used for the tails of the vectorized ones.
+static void copyColumnGeneric(const liquid_float_complex *in, int numChannels, int column,
+                              liquid_float_complex *out, size_t firstFrame, size_t endFrame) {
+    const liquid_float_complex *src = in + firstFrame * numChannels + column;
+
+    for (size_t f = firstFrame; f < endFrame; f++) {
+        out[f] = *src;
+        src += numChannels;
+    }
+}
+
+static void copyColumnPairGeneric(const liquid_float_complex *in, int numChannels, int column,
+                                  liquid_float_complex *out0, liquid_float_complex *out1, size_t firstFrame, size_t endFrame) {
+    const liquid_float_complex *src = in + firstFrame * numChannels + column;
+
+    for (size_t f = firstFrame; f < endFrame; f++) {
+        out0[f] = src[0];
+        out1[f] = src[1];
+        src += numChannels;
+    }
+}
+
+#if CUBICSDR_SIMD_X86
+//A complex sample is moved as the half of a __m128, 2 frames at a time.
+CUBICSDR_TARGET_SSE2 static void copyColumnSSE2(const liquid_float_complex *in, int numChannels, int column,
+                                                liquid_float_complex *out, size_t firstFrame, size_t endFrame) {
+    const float *src = (const float *)(in + firstFrame * numChannels + column);
+    float *dst = (float *)(out + firstFrame);
+    size_t stride = 2 * numChannels;
+    size_t f = firstFrame;
+
+    for (; f + 2 <= endFrame; f += 2) {
+        __m128 v = _mm_setzero_ps();
+        v = _mm_loadl_pi(v, (const __m64 *)src);
+        v = _mm_loadh_pi(v, (const __m64 *)(src + stride));
+        _mm_storeu_ps(dst, v);
+
+        src += 2 * stride;
+        dst += 4;
+    }
+
+    copyColumnGeneric(in, numChannels, column, out, f, endFrame);
+}
+
+//2 adjacent channels x 2 frames are loaded as 2 __m128, and transposed.
+CUBICSDR_TARGET_SSE2 static void copyColumnPairSSE2(const liquid_float_complex *in, int numChannels, int column,
+                                                    liquid_float_complex *out0, liquid_float_complex *out1, size_t firstFrame, size_t endFrame) {
+    const float *src = (const float *)(in + firstFrame * numChannels + column);
+    float *dst0 = (float *)(out0 + firstFrame);
+    float *dst1 = (float *)(out1 + firstFrame);
+    size_t stride = 2 * numChannels;
+    size_t f = firstFrame;
+
+    for (; f + 2 <= endFrame; f += 2) {
+        __m128 a = _mm_loadu_ps(src);           // [ch0(f), ch1(f)]
+        __m128 b = _mm_loadu_ps(src + stride);  // [ch0(f+1), ch1(f+1)]
+
+        _mm_storeu_ps(dst0, _mm_movelh_ps(a, b));   // [ch0(f), ch0(f+1)]
+        _mm_storeu_ps(dst1, _mm_movehl_ps(b, a));   // [ch1(f), ch1(f+1)]
+
+        src += 2 * stride;
+        dst0 += 4;
+        dst1 += 4;
+    }
+
+    copyColumnPairGeneric(in, numChannels, column, out0, out1, f, endFrame);
+}
+#endif
+
+#if CUBICSDR_SIMD_NEON
+static void copyColumnNEON(const liquid_float_complex *in, int numChannels, int column,
+                           liquid_float_complex *out, size_t firstFrame, size_t endFrame) {
+    const float *src = (const float *)(in + firstFrame * numChannels + column);
+    float *dst = (float *)(out + firstFrame);
+    size_t stride = 2 * numChannels;
+    size_t f = firstFrame;
+
+    for (; f + 2 <= endFrame; f += 2) {
+        vst1q_f32(dst, vcombine_f32(vld1_f32(src), vld1_f32(src + stride)));
+
+        src += 2 * stride;
+        dst += 4;
+    }
+
+    copyColumnGeneric(in, numChannels, column, out, f, endFrame);
+}
+
+static void copyColumnPairNEON(const liquid_float_complex *in, int numChannels, int column,
+                               liquid_float_complex *out0, liquid_float_complex *out1, size_t firstFrame, size_t endFrame) {
+    const float *src = (const float *)(in + firstFrame * numChannels + column);
+    float *dst0 = (float *)(out0 + firstFrame);
+    float *dst1 = (float *)(out1 + firstFrame);
+    size_t stride = 2 * numChannels;
+    size_t f = firstFrame;
+
+    for (; f + 2 <= endFrame; f += 2) {
+        float32x4_t a = vld1q_f32(src);
+        float32x4_t b = vld1q_f32(src + stride);
+
+        vst1q_f32(dst0, vcombine_f32(vget_low_f32(a), vget_low_f32(b)));
+        vst1q_f32(dst1, vcombine_f32(vget_high_f32(a), vget_high_f32(b)));
+
+        src += 2 * stride;
+        dst0 += 4;
+        dst1 += 4;
+    }
+
+    copyColumnPairGeneric(in, numChannels, column, out0, out1, f, endFrame);
+}
+#endif
+
+ChannelDeinterleaver::ChannelDeinterleaver() {
+    simdLevel = CPUFeatures::getSIMDLevel();
+
+    switch (simdLevel) {
+#if CUBICSDR_SIMD_X86
+        //moving 8 byte samples, AVX2 brings nothing over SSE2 here.
+        case CPUFeatures::SIMD_AVX2:
+        case CPUFeatures::SIMD_SSE2:
+            simdLevel = CPUFeatures::SIMD_SSE2;
+            columnKernel = &copyColumnSSE2;
+            columnPairKernel = &copyColumnPairSSE2;
+            break;
+#endif
+#if CUBICSDR_SIMD_NEON
+        case CPUFeatures::SIMD_NEON:
+            columnKernel = &copyColumnNEON;
+            columnPairKernel = &copyColumnPairNEON;
+            break;
+#endif
+        default:
+            simdLevel = CPUFeatures::SIMD_NONE;
+            columnKernel = &copyColumnGeneric;
+            columnPairKernel = &copyColumnPairGeneric;
+            break;
+    }
+}
+
+size_t ChannelDeinterleaver::getTileFrames(int numChannels) {
+    size_t tileFrames = DEINTERLEAVE_TILE_BYTES / (std::max(numChannels, 1) * sizeof(liquid_float_complex));
+
+    tileFrames = std::min(std::max(tileFrames, (size_t)DEINTERLEAVE_TILE_MIN_FRAMES), (size_t)DEINTERLEAVE_TILE_MAX_FRAMES);
+
+    //even, for the 2 frames steps of the kernels.
+    return tileFrames & ~(size_t)1;
+}
+
+CPUFeatures::SIMDLevel ChannelDeinterleaver::getSIMDLevel() {
+    return simdLevel;
+}
+
+void ChannelDeinterleaver::deinterleave(const liquid_float_complex *in, int numChannels, const int *columns,
+                                        liquid_float_complex * const *out, size_t numOut, size_t firstFrame, size_t endFrame) {
+    size_t tileFrames = getTileFrames(numChannels);
+
+    for (size_t tileStart = firstFrame; tileStart < endFrame; tileStart += tileFrames) {
+        size_t tileEnd = std::min(tileStart + tileFrames, endFrame);
+
+        for (size_t k = 0; k < numOut;) {
+            if (k + 1 < numOut && columns[k + 1] == columns[k] + 1) {
+                columnPairKernel(in, numChannels, columns[k], out[k], out[k + 1], tileStart, tileEnd);
+                k += 2;
+            } else {
+                columnKernel(in, numChannels, columns[k], out[k], tileStart, tileEnd);
+                k++;
+            }
+        }
+    }
+}
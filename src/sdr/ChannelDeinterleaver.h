@@ -0,0 +1,42 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include "liquid/liquid.h"
+#include "CPUFeatures.h"
+
+//Extracts channels out of the interleaved output of the channelizers, i.e a block of
+//frames of numChannels samples [frame 0: ch 0, ch 1, ... ch N-1, frame 1: ch 0, ...]
+//as a tiled transpose: the block is walked by tiles of frames small enough to stay in L1 cache
+//while every requested channel is copied out of them, so the whole block is read from memory once,
+//instead of once per channel for a strided copy loop.
+//Adjacent channels are transposed in pairs with SIMD loads where available.
+class ChannelDeinterleaver {
+public:
+    ChannelDeinterleaver();
+
+    //For each k in [0, numOut) and frame f in [firstFrame, endFrame):
+    //out[k][f] = in[f * numChannels + columns[k]]
+    //columns should preferably be sorted, to benefit from the paired transposes.
+    //Disjoint frame ranges can be processed concurrently.
+    void deinterleave(const liquid_float_complex *in, int numChannels, const int *columns,
+                      liquid_float_complex * const *out, size_t numOut, size_t firstFrame, size_t endFrame);
+
+    //number of frames per tile for numChannels channels.
+    static size_t getTileFrames(int numChannels);
+
+    CPUFeatures::SIMDLevel getSIMDLevel();
+
+    //Type of the kernels: copy frames [firstFrame, endFrame) of 1 column, or 2 adjacent columns.
+    typedef void (*ColumnKernel)(const liquid_float_complex *in, int numChannels, int column,
+                                 liquid_float_complex *out, size_t firstFrame, size_t endFrame);
+    typedef void (*ColumnPairKernel)(const liquid_float_complex *in, int numChannels, int column,
+                                     liquid_float_complex *out0, liquid_float_complex *out1, size_t firstFrame, size_t endFrame);
+
+private:
+    ColumnKernel columnKernel;
+    ColumnPairKernel columnPairKernel;
+    CPUFeatures::SIMDLevel simdLevel;
+};
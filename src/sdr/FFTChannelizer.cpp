@@ -0,0 +1,293 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "FFTChannelizer.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+//The FFT size is the smallest power of two giving bins at most that wide, within the min/max sizes:
+#define FFT_CHANNELIZER_MAX_BIN_HZ 1000
+#define FFT_CHANNELIZER_MIN_SIZE 1024
+#define FFT_CHANNELIZER_MAX_SIZE 65536
+
+//stop-band attenuation of the channel filters, as the polyphase channelizers.
+#define FFT_CHANNELIZER_FILTER_AS 60.0f
+
+FFTChannelizer::Channel::Channel(int ifftSize) : offset(0), bandwidth(0), decimation(1), centerBin(0),
+    ifftSize(ifftSize), residualPhase(0), residualStep(0) {
+    response.resize(ifftSize);
+    ifftIn.resize(ifftSize);
+    ifftOut.resize(ifftSize);
+    ifftPlan = fft_create_plan(ifftSize, &ifftIn[0], &ifftOut[0], LIQUID_FFT_BACKWARD, 0);
+}
+
+FFTChannelizer::Channel::~Channel() {
+    fft_destroy_plan(ifftPlan);
+}
+
+FFTChannelizer::FFTChannelizer() : sampleRate(0), fftSize(0), overlap(0), step(0), transitionWidth(0),
+    fftPlan(nullptr), frameFill(0), frameStart(0) {
+}
+
+FFTChannelizer::~FFTChannelizer() {
+    clearChannels();
+
+    if (fftPlan) {
+        fft_destroy_plan(fftPlan);
+    }
+}
+
+void FFTChannelizer::setSampleRate(long long sampleRate) {
+    this->sampleRate = sampleRate;
+
+    fftSize = FFT_CHANNELIZER_MIN_SIZE;
+    while (fftSize < FFT_CHANNELIZER_MAX_SIZE && (double)sampleRate / (double)fftSize > FFT_CHANNELIZER_MAX_BIN_HZ) {
+        fftSize *= 2;
+    }
+
+    // Overlap-save: each frame of fftSize samples brings 'step' new ones,
+    // and the filters impulse responses can be up to overlap + 1 long.
+    overlap = fftSize / 4;
+    step = fftSize - overlap;
+    transitionWidth = estimate_req_filter_df(FFT_CHANNELIZER_FILTER_AS, overlap + 1) * (double)sampleRate;
+
+    liquid_float_complex zero;
+    zero.real = zero.imag = 0;
+
+    frameIn.assign(fftSize, zero);
+    spectrum.assign(fftSize, zero);
+
+    if (fftPlan) {
+        fft_destroy_plan(fftPlan);
+    }
+    fftPlan = fft_create_plan(fftSize, &frameIn[0], &spectrum[0], LIQUID_FFT_FORWARD, 0);
+
+    // The first frame starts with the 'overlap' zero samples preceding the input.
+    frameFill = 0;
+    frameStart = fftSize - overlap;
+
+    clearChannels();
+}
+
+long long FFTChannelizer::getSampleRate() {
+    return sampleRate;
+}
+
+int FFTChannelizer::getFFTSize() {
+    return fftSize;
+}
+
+void FFTChannelizer::clearChannels() {
+    channels.clear();
+}
+
+FFTChannelizer::Channel *FFTChannelizer::createChannel(long long offset, int bandwidth) {
+    double fs = (double)sampleRate;
+
+    // Largest power of two decimation for which the output rate still holds the channel bandwidth
+    // plus the filter transition band on each side.
+    int decimation = 1;
+    while (decimation * 2 <= fftSize / 4 && fs / (double)(decimation * 2) >= (double)bandwidth + 2.0 * transitionWidth) {
+        decimation *= 2;
+    }
+
+    int ifftSize = fftSize / decimation;
+    Channel *ch = new Channel(ifftSize);
+
+    ch->offset = offset;
+    ch->bandwidth = bandwidth;
+    ch->decimation = decimation;
+
+    // The bins rotation shifts by a whole number of bins, the rest is shifted at the output rate.
+    ch->centerBin = (int)llround((double)offset * (double)fftSize / fs);
+
+    double residual = (double)offset - (double)ch->centerBin * fs / (double)fftSize;
+    ch->residualPhase = 0;
+    ch->residualStep = -2.0 * M_PI * residual * (double)decimation / fs;
+
+    // Low-pass filter of the longest length the overlap allows, with its stop band starting
+    // at half the output rate: only the kept bins have a response, and nothing aliases in the inverse FFT.
+    int filterLen = overlap + 1;
+    std::vector<float> h(filterLen, 0);
+
+    if (decimation > 1) {
+        float cutoff = (float)(0.5 / (double)decimation - 0.5 * transitionWidth / fs);
+        liquid_firdes_kaiser(filterLen, cutoff, FFT_CHANNELIZER_FILTER_AS, 0.0f, &h[0]);
+    } else {
+        h[0] = 1.0f;
+    }
+
+    // unity gain in the pass band, and the 1/fftSize of the inverse transform:
+    float hSum = 0;
+    for (float v : h) {
+        hSum += v;
+    }
+
+    liquid_float_complex zero;
+    zero.real = zero.imag = 0;
+    std::vector<liquid_float_complex> hIn(fftSize, zero), hOut(fftSize);
+
+    for (int i = 0; i < filterLen; i++) {
+        hIn[i].real = h[i] / (hSum * (float)fftSize);
+    }
+
+    fftplan hPlan = fft_create_plan(fftSize, &hIn[0], &hOut[0], LIQUID_FFT_FORWARD, 0);
+    fft_execute(hPlan);
+    fft_destroy_plan(hPlan);
+
+    // keep the bins around DC, in FFT order.
+    int half = ifftSize / 2;
+    for (int j = 0; j < ifftSize; j++) {
+        ch->response[j] = hOut[(j < half) ? j : (fftSize - ifftSize + j)];
+    }
+
+    return ch;
+}
+
+void FFTChannelizer::setChannels(const std::vector<long long>& offsets, const std::vector<int>& bandwidths, std::vector<int>& channelIndex) {
+    std::vector<std::unique_ptr<Channel>> newChannels;
+
+    channelIndex.assign(offsets.size(), -1);
+
+    for (size_t r = 0; r < offsets.size(); r++) {
+        long long offset = offsets[r];
+        int bandwidth = bandwidths[r];
+
+        // shared with a previous request?
+        for (size_t c = 0; c < newChannels.size(); c++) {
+            if (newChannels[c]->offset == offset && newChannels[c]->bandwidth == bandwidth) {
+                channelIndex[r] = (int)c;
+                break;
+            }
+        }
+        if (channelIndex[r] >= 0) {
+            continue;
+        }
+
+        // already running?
+        bool running = false;
+        for (std::unique_ptr<Channel>& ch : channels) {
+            if (ch && ch->offset == offset && ch->bandwidth == bandwidth) {
+                newChannels.push_back(std::move(ch));
+                running = true;
+                break;
+            }
+        }
+
+        // else a new one
+        if (!running) {
+            newChannels.push_back(std::unique_ptr<Channel>(createChannel(offset, bandwidth)));
+        }
+
+        channelIndex[r] = (int)newChannels.size() - 1;
+    }
+
+    channels.swap(newChannels);
+}
+
+size_t FFTChannelizer::getNumChannels() {
+    return channels.size();
+}
+
+void FFTChannelizer::processChannel(Channel& ch) {
+    int ifftSize = ch.ifftSize;
+    int half = ifftSize / 2;
+    int decimation = ch.decimation;
+
+    // pick and filter the bins around the channel center
+    for (int j = 0; j < ifftSize; j++) {
+        int bin = ch.centerBin + ((j < half) ? j : (j - ifftSize));
+        bin = ((bin % fftSize) + fftSize) % fftSize;
+
+        const liquid_float_complex& x = spectrum[bin];
+        const liquid_float_complex& h = ch.response[j];
+
+        ch.ifftIn[j].real = x.real * h.real - x.imag * h.imag;
+        ch.ifftIn[j].imag = x.real * h.imag + x.imag * h.real;
+    }
+
+    fft_execute(ch.ifftPlan);
+
+    // The bins rotation is relative to the frame start: make its phase continuous from frame to frame,
+    // computed exactly on integers, then add the residual sub-bin shift.
+    long long k = ((ch.centerBin % fftSize) + fftSize) % fftSize;
+    long long phaseIndex = (k * frameStart) % fftSize;
+    double phase = -2.0 * M_PI * (double)phaseIndex / (double)fftSize + ch.residualPhase;
+
+    double rotReal = cos(phase), rotImag = sin(phase);
+    double stepReal = cos(ch.residualStep), stepImag = sin(ch.residualStep);
+
+    // the first overlap / decimation outputs are corrupted by the circular convolution.
+    int first = overlap / decimation;
+    size_t outPos = ch.output.size();
+    ch.output.resize(outPos + (ifftSize - first));
+
+    for (int n = first; n < ifftSize; n++) {
+        const liquid_float_complex& y = ch.ifftOut[n];
+        liquid_float_complex& out = ch.output[outPos++];
+
+        out.real = (float)(y.real * rotReal - y.imag * rotImag);
+        out.imag = (float)(y.real * rotImag + y.imag * rotReal);
+
+        double r = rotReal * stepReal - rotImag * stepImag;
+        rotImag = rotReal * stepImag + rotImag * stepReal;
+        rotReal = r;
+    }
+
+    ch.residualPhase = fmod(ch.residualPhase + (double)(ifftSize - first) * ch.residualStep, 2.0 * M_PI);
+}
+
+void FFTChannelizer::execute(const liquid_float_complex *in, size_t numSamples, WorkerPool *workerPool) {
+    for (std::unique_ptr<Channel>& ch : channels) {
+        ch->output.clear();
+    }
+
+    size_t pos = 0;
+
+    while (pos < numSamples) {
+        size_t take = std::min(numSamples - pos, (size_t)(step - frameFill));
+
+        std::memcpy(&frameIn[overlap + frameFill], in + pos, take * sizeof(liquid_float_complex));
+        frameFill += (int)take;
+        pos += take;
+
+        if (frameFill < step) {
+            break;
+        }
+
+        // full frame:
+        fft_execute(fftPlan);
+
+        if (workerPool != nullptr && channels.size() > 1) {
+            workerPool->parallelFor(channels.size(), [this](size_t c) {
+                processChannel(*channels[c]);
+            });
+        } else {
+            for (std::unique_ptr<Channel>& ch : channels) {
+                processChannel(*ch);
+            }
+        }
+
+        // the end of this frame is the overlap of the next one.
+        std::memmove(&frameIn[0], &frameIn[step], overlap * sizeof(liquid_float_complex));
+        frameFill = 0;
+        frameStart = (frameStart + step) % fftSize;
+    }
+}
+
+const std::vector<liquid_float_complex>& FFTChannelizer::getOutput(int channel) {
+    return channels[channel]->output;
+}
+
+long long FFTChannelizer::getOutputSampleRate(int channel) {
+    return sampleRate / channels[channel]->decimation;
+}
+
+long long FFTChannelizer::getOffset(int channel) {
+    return channels[channel]->offset;
+}
+
+int FFTChannelizer::getBandwidth(int channel) {
+    return channels[channel]->bandwidth;
+}
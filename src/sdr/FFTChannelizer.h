@@ -0,0 +1,90 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "liquid/liquid.h"
+#include "WorkerPool.h"
+
+//Fast-convolution (overlap-save FFT filterbank) channelizer.
+//One forward FFT of the full band is shared by every frame of input, then each channel
+//only picks the bins around its own center, applies its anti-aliasing filter response to them
+//and runs a small inverse FFT to produce its decimated output.
+//So the cost scales with the number of channels actually extracted, each one at an arbitrary
+//center and bandwidth, instead of the total number of channels of a polyphase filterbank.
+class FFTChannelizer {
+public:
+    FFTChannelizer();
+    ~FFTChannelizer();
+
+    //(Re)configure for a new input sample rate, the FFT size being chosen from it.
+    //All the channels are removed.
+    void setSampleRate(long long sampleRate);
+    long long getSampleRate();
+    int getFFTSize();
+
+    //Set the channels to extract, as frequency offsets from the input center frequency and bandwidths.
+    //Channels already extracted with the same offset and bandwidth keep their state, others are created,
+    //the ones no longer requested are removed.
+    //channelIndex receives the channel of each request, identical requests sharing the same channel.
+    void setChannels(const std::vector<long long>& offsets, const std::vector<int>& bandwidths, std::vector<int>& channelIndex);
+    size_t getNumChannels();
+
+    //Process numSamples input samples, refilling the output of each channel.
+    //The channels are processed in parallel on workerPool if not nullptr.
+    void execute(const liquid_float_complex *in, size_t numSamples, WorkerPool *workerPool);
+
+    //Output of the channel produced by the last execute(), centered exactly on the channel offset.
+    const std::vector<liquid_float_complex>& getOutput(int channel);
+    long long getOutputSampleRate(int channel);
+    long long getOffset(int channel);
+    int getBandwidth(int channel);
+
+private:
+    struct Channel {
+        Channel(int ifftSize);
+        ~Channel();
+
+        long long offset;
+        int bandwidth;
+
+        //decimation from the input rate, and nearest FFT bin of the offset.
+        int decimation;
+        int centerBin;
+
+        //filter response on the ifftSize bins around the channel center, scaled by 1/fftSize.
+        std::vector<liquid_float_complex> response;
+
+        int ifftSize;
+        std::vector<liquid_float_complex> ifftIn, ifftOut;
+        fftplan ifftPlan;
+
+        //phase of the remaining sub-bin shift, and its increment per output sample.
+        double residualPhase;
+        double residualStep;
+
+        std::vector<liquid_float_complex> output;
+    };
+
+    Channel *createChannel(long long offset, int bandwidth);
+    void processChannel(Channel& ch);
+    void clearChannels();
+
+    long long sampleRate;
+    int fftSize;
+    //overlap of consecutive frames, i.e max filter length - 1, and new samples per frame.
+    int overlap, step;
+    //transition band achievable by the filters, in Hz.
+    double transitionWidth;
+
+    std::vector<liquid_float_complex> frameIn, spectrum;
+    fftplan fftPlan;
+    //new samples gathered for the next frame.
+    int frameFill;
+    //index of the first sample of the current frame since the start, modulo fftSize.
+    long long frameStart;
+
+    std::vector<std::unique_ptr<Channel>> channels;
+};
@@ -0,0 +1,431 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "IQSampleConverter.h"
+#include <cstddef>
+#include <cstdint>
+
+//The kernels write liquid_float_complex as pairs of floats:
+static_assert(sizeof(liquid_float_complex) == 2 * sizeof(float), "liquid_float_complex must be made of 2 packed floats");
+static_assert(offsetof(liquid_float_complex, real) == 0, "liquid_float_complex real part must come first");
+
+//weight of each new block mean in the DC offset estimate.
+#define IQ_CONVERTER_DC_AVERAGE_RATE 0.05f
+
+// Plain C++ version, also used for the tails of the vectorized ones.
+template<typename T, bool swap>
+static void convertGeneric(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const T *src = (const T *)in;
+    float sumI = 0, sumQ = 0;
+
+    for (size_t i = 0; i < numSamples; i++) {
+        float re = (float)(swap ? src[2 * i + 1] : src[2 * i]);
+        float im = (float)(swap ? src[2 * i] : src[2 * i + 1]);
+
+        sumI += re;
+        sumQ += im;
+        out[2 * i] = re * scale - bias[0];
+        out[2 * i + 1] = im * scale - bias[1];
+    }
+    sum[0] += sumI;
+    sum[1] += sumQ;
+}
+
+#if CUBICSDR_SIMD_X86
+//Process 2 complex samples already converted to float.
+template<bool swap>
+CUBICSDR_TARGET_SSE2 static inline void processSSE2(__m128 v, float *out, __m128 vscale, __m128 vbias, __m128 &acc) {
+    if (swap) {
+        v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    }
+    acc = _mm_add_ps(acc, v);
+    _mm_storeu_ps(out, _mm_sub_ps(_mm_mul_ps(v, vscale), vbias));
+}
+
+CUBICSDR_TARGET_SSE2 static inline void reduceSSE2(__m128 acc, float *sum) {
+    float accum[4];
+    _mm_storeu_ps(accum, acc);
+    sum[0] += accum[0] + accum[2];
+    sum[1] += accum[1] + accum[3];
+}
+
+template<bool swap>
+CUBICSDR_TARGET_SSE2 static void convertCF32SSE2(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const float *src = (const float *)in;
+    const __m128 vbias = _mm_setr_ps(bias[0], bias[1], bias[0], bias[1]);
+    const __m128 vscale = _mm_set1_ps(scale);
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+
+    size_t numValues = numSamples * 2;
+    size_t i = 0;
+
+    // 4 complex samples per iteration
+    for (; i + 8 <= numValues; i += 8) {
+        __m128 v0 = _mm_loadu_ps(src + i);
+        __m128 v1 = _mm_loadu_ps(src + i + 4);
+
+        processSSE2<swap>(v0, out + i, vscale, vbias, acc0);
+        processSSE2<swap>(v1, out + i + 4, vscale, vbias, acc1);
+    }
+    reduceSSE2(_mm_add_ps(acc0, acc1), sum);
+
+    convertGeneric<float, swap>(src + i, out + i, (numValues - i) / 2, bias, scale, sum);
+}
+
+template<bool swap>
+CUBICSDR_TARGET_SSE2 static void convertCS16SSE2(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const int16_t *src = (const int16_t *)in;
+    const __m128 vbias = _mm_setr_ps(bias[0], bias[1], bias[0], bias[1]);
+    const __m128 vscale = _mm_set1_ps(scale);
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+
+    size_t numValues = numSamples * 2;
+    size_t i = 0;
+
+    // 4 complex samples per iteration
+    for (; i + 8 <= numValues; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+
+        //SSE2 has no sign extension, duplicate each int16 in a 32 bit lane and shift it down.
+        __m128 v0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 v1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+
+        processSSE2<swap>(v0, out + i, vscale, vbias, acc0);
+        processSSE2<swap>(v1, out + i + 4, vscale, vbias, acc1);
+    }
+    reduceSSE2(_mm_add_ps(acc0, acc1), sum);
+
+    convertGeneric<int16_t, swap>(src + i, out + i, (numValues - i) / 2, bias, scale, sum);
+}
+
+template<bool swap>
+CUBICSDR_TARGET_SSE2 static void convertCS8SSE2(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const int8_t *src = (const int8_t *)in;
+    const __m128 vbias = _mm_setr_ps(bias[0], bias[1], bias[0], bias[1]);
+    const __m128 vscale = _mm_set1_ps(scale);
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+
+    size_t numValues = numSamples * 2;
+    size_t i = 0;
+
+    // 8 complex samples per iteration
+    for (; i + 16 <= numValues; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+
+        //int8 -> int16 the same way, then int16 -> int32.
+        __m128i w0 = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+        __m128i w1 = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+
+        processSSE2<swap>(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(w0, w0), 16)), out + i, vscale, vbias, acc0);
+        processSSE2<swap>(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(w0, w0), 16)), out + i + 4, vscale, vbias, acc1);
+        processSSE2<swap>(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(w1, w1), 16)), out + i + 8, vscale, vbias, acc0);
+        processSSE2<swap>(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(w1, w1), 16)), out + i + 12, vscale, vbias, acc1);
+    }
+    reduceSSE2(_mm_add_ps(acc0, acc1), sum);
+
+    convertGeneric<int8_t, swap>(src + i, out + i, (numValues - i) / 2, bias, scale, sum);
+}
+
+//Process 4 complex samples already converted to float.
+template<bool swap>
+CUBICSDR_TARGET_AVX2 static inline void processAVX2(__m256 v, float *out, __m256 vscale, __m256 vbias, __m256 &acc) {
+    if (swap) {
+        //swap within each (I,Q) pair, the permute works per 128 bit lane.
+        v = _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1));
+    }
+    acc = _mm256_add_ps(acc, v);
+    _mm256_storeu_ps(out, _mm256_fmsub_ps(v, vscale, vbias));
+}
+
+CUBICSDR_TARGET_AVX2 static inline void reduceAVX2(__m256 acc, float *sum) {
+    float accum[8];
+    _mm256_storeu_ps(accum, acc);
+    sum[0] += accum[0] + accum[2] + accum[4] + accum[6];
+    sum[1] += accum[1] + accum[3] + accum[5] + accum[7];
+}
+
+template<bool swap>
+CUBICSDR_TARGET_AVX2 static void convertCF32AVX2(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const float *src = (const float *)in;
+    const __m256 vbias = _mm256_setr_ps(bias[0], bias[1], bias[0], bias[1], bias[0], bias[1], bias[0], bias[1]);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+
+    size_t numValues = numSamples * 2;
+    size_t i = 0;
+
+    // 8 complex samples per iteration
+    for (; i + 16 <= numValues; i += 16) {
+        processAVX2<swap>(_mm256_loadu_ps(src + i), out + i, vscale, vbias, acc0);
+        processAVX2<swap>(_mm256_loadu_ps(src + i + 8), out + i + 8, vscale, vbias, acc1);
+    }
+    reduceAVX2(_mm256_add_ps(acc0, acc1), sum);
+
+    convertGeneric<float, swap>(src + i, out + i, (numValues - i) / 2, bias, scale, sum);
+}
+
+template<bool swap>
+CUBICSDR_TARGET_AVX2 static void convertCS16AVX2(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const int16_t *src = (const int16_t *)in;
+    const __m256 vbias = _mm256_setr_ps(bias[0], bias[1], bias[0], bias[1], bias[0], bias[1], bias[0], bias[1]);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+
+    size_t numValues = numSamples * 2;
+    size_t i = 0;
+
+    // 8 complex samples per iteration
+    for (; i + 16 <= numValues; i += 16) {
+        __m256i v0 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        __m256i v1 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i + 8)));
+
+        processAVX2<swap>(_mm256_cvtepi32_ps(v0), out + i, vscale, vbias, acc0);
+        processAVX2<swap>(_mm256_cvtepi32_ps(v1), out + i + 8, vscale, vbias, acc1);
+    }
+    reduceAVX2(_mm256_add_ps(acc0, acc1), sum);
+
+    convertGeneric<int16_t, swap>(src + i, out + i, (numValues - i) / 2, bias, scale, sum);
+}
+
+template<bool swap>
+CUBICSDR_TARGET_AVX2 static void convertCS8AVX2(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const int8_t *src = (const int8_t *)in;
+    const __m256 vbias = _mm256_setr_ps(bias[0], bias[1], bias[0], bias[1], bias[0], bias[1], bias[0], bias[1]);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+
+    size_t numValues = numSamples * 2;
+    size_t i = 0;
+
+    // 8 complex samples per iteration
+    for (; i + 16 <= numValues; i += 16) {
+        __m256i v0 = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+        __m256i v1 = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(src + i + 8)));
+
+        processAVX2<swap>(_mm256_cvtepi32_ps(v0), out + i, vscale, vbias, acc0);
+        processAVX2<swap>(_mm256_cvtepi32_ps(v1), out + i + 8, vscale, vbias, acc1);
+    }
+    reduceAVX2(_mm256_add_ps(acc0, acc1), sum);
+
+    convertGeneric<int8_t, swap>(src + i, out + i, (numValues - i) / 2, bias, scale, sum);
+}
+#endif
+
+#if CUBICSDR_SIMD_NEON
+//Process 2 complex samples already converted to float.
+template<bool swap>
+static inline void processNEON(float32x4_t v, float *out, float32x4_t vscale, float32x4_t vbias, float32x4_t &acc) {
+    if (swap) {
+        v = vrev64q_f32(v);
+    }
+    acc = vaddq_f32(acc, v);
+    vst1q_f32(out, vsubq_f32(vmulq_f32(v, vscale), vbias));
+}
+
+static inline void reduceNEON(float32x4_t acc, float *sum) {
+    float accum[4];
+    vst1q_f32(accum, acc);
+    sum[0] += accum[0] + accum[2];
+    sum[1] += accum[1] + accum[3];
+}
+
+template<bool swap>
+static void convertCF32NEON(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const float *src = (const float *)in;
+    const float biasPair[4] = { bias[0], bias[1], bias[0], bias[1] };
+    const float32x4_t vbias = vld1q_f32(biasPair);
+    const float32x4_t vscale = vdupq_n_f32(scale);
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+
+    size_t numValues = numSamples * 2;
+    size_t i = 0;
+
+    // 4 complex samples per iteration
+    for (; i + 8 <= numValues; i += 8) {
+        processNEON<swap>(vld1q_f32(src + i), out + i, vscale, vbias, acc0);
+        processNEON<swap>(vld1q_f32(src + i + 4), out + i + 4, vscale, vbias, acc1);
+    }
+    reduceNEON(vaddq_f32(acc0, acc1), sum);
+
+    convertGeneric<float, swap>(src + i, out + i, (numValues - i) / 2, bias, scale, sum);
+}
+
+template<bool swap>
+static void convertCS16NEON(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const int16_t *src = (const int16_t *)in;
+    const float biasPair[4] = { bias[0], bias[1], bias[0], bias[1] };
+    const float32x4_t vbias = vld1q_f32(biasPair);
+    const float32x4_t vscale = vdupq_n_f32(scale);
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+
+    size_t numValues = numSamples * 2;
+    size_t i = 0;
+
+    // 4 complex samples per iteration
+    for (; i + 8 <= numValues; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+
+        processNEON<swap>(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), out + i, vscale, vbias, acc0);
+        processNEON<swap>(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), out + i + 4, vscale, vbias, acc1);
+    }
+    reduceNEON(vaddq_f32(acc0, acc1), sum);
+
+    convertGeneric<int16_t, swap>(src + i, out + i, (numValues - i) / 2, bias, scale, sum);
+}
+
+template<bool swap>
+static void convertCS8NEON(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum) {
+    const int8_t *src = (const int8_t *)in;
+    const float biasPair[4] = { bias[0], bias[1], bias[0], bias[1] };
+    const float32x4_t vbias = vld1q_f32(biasPair);
+    const float32x4_t vscale = vdupq_n_f32(scale);
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+
+    size_t numValues = numSamples * 2;
+    size_t i = 0;
+
+    // 8 complex samples per iteration
+    for (; i + 16 <= numValues; i += 16) {
+        int8x16_t v = vld1q_s8(src + i);
+        int16x8_t w0 = vmovl_s8(vget_low_s8(v));
+        int16x8_t w1 = vmovl_s8(vget_high_s8(v));
+
+        processNEON<swap>(vcvtq_f32_s32(vmovl_s16(vget_low_s16(w0))), out + i, vscale, vbias, acc0);
+        processNEON<swap>(vcvtq_f32_s32(vmovl_s16(vget_high_s16(w0))), out + i + 4, vscale, vbias, acc1);
+        processNEON<swap>(vcvtq_f32_s32(vmovl_s16(vget_low_s16(w1))), out + i + 8, vscale, vbias, acc0);
+        processNEON<swap>(vcvtq_f32_s32(vmovl_s16(vget_high_s16(w1))), out + i + 12, vscale, vbias, acc1);
+    }
+    reduceNEON(vaddq_f32(acc0, acc1), sum);
+
+    convertGeneric<int8_t, swap>(src + i, out + i, (numValues - i) / 2, bias, scale, sum);
+}
+#endif
+
+IQSampleConverter::IQSampleConverter() : format(FORMAT_CF32), formatScale(1.0f), iqSwap(false), dcRemoval(false) {
+    dcOfs[0] = dcOfs[1] = 0;
+
+    simdLevel = CPUFeatures::getSIMDLevel();
+
+    switch (simdLevel) {
+#if CUBICSDR_SIMD_X86
+        case CPUFeatures::SIMD_AVX2:
+            setKernels(FORMAT_CF32, &convertCF32AVX2<false>, &convertCF32AVX2<true>);
+            setKernels(FORMAT_CS16, &convertCS16AVX2<false>, &convertCS16AVX2<true>);
+            setKernels(FORMAT_CS8, &convertCS8AVX2<false>, &convertCS8AVX2<true>);
+            break;
+        case CPUFeatures::SIMD_SSE2:
+            setKernels(FORMAT_CF32, &convertCF32SSE2<false>, &convertCF32SSE2<true>);
+            setKernels(FORMAT_CS16, &convertCS16SSE2<false>, &convertCS16SSE2<true>);
+            setKernels(FORMAT_CS8, &convertCS8SSE2<false>, &convertCS8SSE2<true>);
+            break;
+#endif
+#if CUBICSDR_SIMD_NEON
+        case CPUFeatures::SIMD_NEON:
+            setKernels(FORMAT_CF32, &convertCF32NEON<false>, &convertCF32NEON<true>);
+            setKernels(FORMAT_CS16, &convertCS16NEON<false>, &convertCS16NEON<true>);
+            setKernels(FORMAT_CS8, &convertCS8NEON<false>, &convertCS8NEON<true>);
+            break;
+#endif
+        default:
+            simdLevel = CPUFeatures::SIMD_NONE;
+            setKernels(FORMAT_CF32, &convertGeneric<float, false>, &convertGeneric<float, true>);
+            setKernels(FORMAT_CS16, &convertGeneric<int16_t, false>, &convertGeneric<int16_t, true>);
+            setKernels(FORMAT_CS8, &convertGeneric<int8_t, false>, &convertGeneric<int8_t, true>);
+            break;
+    }
+}
+
+void IQSampleConverter::setKernels(SampleFormat format, ConvertKernel kernel, ConvertKernel swapKernel) {
+    kernels[format][0] = kernel;
+    kernels[format][1] = swapKernel;
+}
+
+void IQSampleConverter::setFormat(SampleFormat format, double fullScale) {
+    if (fullScale <= 0) {
+        fullScale = (format == FORMAT_CS16) ? 32768.0 : (format == FORMAT_CS8) ? 128.0 : 1.0;
+    }
+    this->format = format;
+    formatScale = (float)(1.0 / fullScale);
+}
+
+IQSampleConverter::SampleFormat IQSampleConverter::getFormat() {
+    return format;
+}
+
+void IQSampleConverter::setIQSwap(bool swap) {
+    iqSwap = swap;
+}
+
+bool IQSampleConverter::getIQSwap() {
+    return iqSwap;
+}
+
+void IQSampleConverter::setDCRemoval(bool dcRemoval) {
+    this->dcRemoval = dcRemoval;
+    dcOfs[0] = dcOfs[1] = 0;
+}
+
+bool IQSampleConverter::getDCRemoval() {
+    return dcRemoval;
+}
+
+bool IQSampleConverter::isIdentity() {
+    return format == FORMAT_CF32 && !iqSwap && !dcRemoval;
+}
+
+CPUFeatures::SIMDLevel IQSampleConverter::getSIMDLevel() {
+    return simdLevel;
+}
+
+const char *IQSampleConverter::getFormatName(SampleFormat format) {
+    switch (format) {
+        case FORMAT_CS16:
+            return "CS16";
+        case FORMAT_CS8:
+            return "CS8";
+        default:
+            return "CF32";
+    }
+}
+
+size_t IQSampleConverter::getFormatSampleSize(SampleFormat format) {
+    switch (format) {
+        case FORMAT_CS16:
+            return 2 * sizeof(int16_t);
+        case FORMAT_CS8:
+            return 2 * sizeof(int8_t);
+        default:
+            return 2 * sizeof(float);
+    }
+}
+
+void IQSampleConverter::convert(const void *in, liquid_float_complex *out, size_t numSamples) {
+    if (!numSamples) {
+        return;
+    }
+
+    //out = in * formatScale - dcOfs, in a single multiply-subtract:
+    float sum[2] = { 0, 0 };
+
+    kernels[format][iqSwap ? 1 : 0](in, (float *)out, numSamples, dcOfs, formatScale, sum);
+
+    if (dcRemoval) {
+        updateDCEstimate(sum, numSamples);
+    }
+}
+
+void IQSampleConverter::updateDCEstimate(const float *sum, size_t numSamples) {
+    for (int k = 0; k < 2; k++) {
+        float blockMean = sum[k] * formatScale / float(numSamples);
+        dcOfs[k] += (blockMean - dcOfs[k]) * IQ_CONVERTER_DC_AVERAGE_RATE;
+    }
+}
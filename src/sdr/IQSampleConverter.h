@@ -0,0 +1,70 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <cstddef>
+#include "liquid/liquid.h"
+#include "CPUFeatures.h"
+
+//Converts the raw interleaved samples coming out of SoapySDR readStream()
+//into liquid_float_complex, in one vectorized pass doing at the same time:
+//the conversion to float of integer formats with their full scale mapped to 1.0,
+//the optional I/Q swap and the optional DC offset removal.
+//The best kernels for the CPU (SSE2, AVX2, NEON or plain C++) are selected at construction.
+class IQSampleConverter {
+public:
+    //Supported stream formats, i.e the SoapySDR "CF32", "CS16" and "CS8".
+    enum SampleFormat {
+        FORMAT_CF32 = 0,
+        FORMAT_CS16 = 1,
+        FORMAT_CS8 = 2,
+        FORMAT_COUNT = 3
+    };
+
+    IQSampleConverter();
+
+    //Set the format of the input samples, and their full scale value,
+    //i.e the value mapped to 1.0, as reported by SoapySDR getNativeStreamFormat().
+    //fullScale <= 0 means the default for the format: 1.0, 32768.0 or 128.0.
+    void setFormat(SampleFormat format, double fullScale = 0);
+    SampleFormat getFormat();
+
+    void setIQSwap(bool swap);
+    bool getIQSwap();
+
+    //When enabled, the DC offset is estimated as a slow moving average
+    //of the block means, and subtracted from the samples. Restarts the estimate.
+    void setDCRemoval(bool dcRemoval);
+    bool getDCRemoval();
+
+    //true if convert() would leave CF32 samples unchanged.
+    bool isIdentity();
+
+    //Convert numSamples samples of the current format, i.e 2 * numSamples values [I, Q, I, Q, ...], into out.
+    //For FORMAT_CF32 only, 'in' and 'out' may point to the same memory, to convert in-place.
+    void convert(const void *in, liquid_float_complex *out, size_t numSamples);
+
+    CPUFeatures::SIMDLevel getSIMDLevel();
+
+    //SoapySDR format string, and size in bytes of one complex sample, of a format.
+    static const char *getFormatName(SampleFormat format);
+    static size_t getFormatSampleSize(SampleFormat format);
+
+    //Type of the kernels: apply swap(in) * scale - bias on numSamples complex samples,
+    //and accumulate the sum of the unscaled swap(in) into sum[2].
+    typedef void (*ConvertKernel)(const void *in, float *out, size_t numSamples, const float *bias, float scale, float *sum);
+
+private:
+    void setKernels(SampleFormat format, ConvertKernel kernel, ConvertKernel swapKernel);
+    void updateDCEstimate(const float *sum, size_t numSamples);
+
+    ConvertKernel kernels[FORMAT_COUNT][2];
+    CPUFeatures::SIMDLevel simdLevel;
+
+    SampleFormat format;
+    float formatScale;
+    bool iqSwap;
+    bool dcRemoval;
+    float dcOfs[2];
+};
@@ -0,0 +1,281 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "PFBChannelizer.h"
+#include <algorithm>
+#include <cstdlib>
+
+//half-length, in samples per channel, of the channelizers prototype filter.
+#define CHANNELIZER_FILTER_SEMILENGTH 4
+
+//multi-threaded mode: sub-blocks at least that many times longer than their channelizer priming.
+#define CHANNELIZER_SUBBLOCK_MIN_PRIME_RATIO 8
+
+PFBChannelizer::PFBChannelizer() : type(PFBCH), numChannels(0), sampleRate(0), chanBw(0),
+    channelizer(nullptr), channelizer2(nullptr), workerPool(nullptr), pfbch2Parity(0) {
+    dcFilter = iirfilt_crcf_create_dc_blocker(0.0005f);
+}
+
+PFBChannelizer::~PFBChannelizer() {
+    if (channelizer) {
+        firpfbch_crcf_destroy(channelizer);
+    }
+    if (channelizer2) {
+        firpfbch2_crcf_destroy(channelizer2);
+    }
+    clearParallelChannelizers();
+    iirfilt_crcf_destroy(dcFilter);
+}
+
+void PFBChannelizer::clearParallelChannelizers() {
+    for (firpfbch_crcf ch : parallelChannelizers) {
+        firpfbch_crcf_destroy(ch);
+    }
+    for (firpfbch2_crcf ch : parallelChannelizers2) {
+        firpfbch2_crcf_destroy(ch);
+    }
+    parallelChannelizers.clear();
+    parallelChannelizers2.clear();
+}
+
+void PFBChannelizer::init(Type type_in, int numChannels_in, long long sampleRate_in, WorkerPool *workerPool_in) {
+    type = type_in;
+    numChannels = numChannels_in;
+    sampleRate = sampleRate_in;
+    workerPool = workerPool_in;
+
+    if (channelizer) {
+        firpfbch_crcf_destroy(channelizer);
+        channelizer = nullptr;
+    }
+    if (channelizer2) {
+        firpfbch2_crcf_destroy(channelizer2);
+        channelizer2 = nullptr;
+    }
+    clearParallelChannelizers();
+
+    if (type == PFBCH2) {
+        channelizer2 = firpfbch2_crcf_create_kaiser(LIQUID_ANALYZER, numChannels, CHANNELIZER_FILTER_SEMILENGTH, 60);
+    } else {
+        channelizer = firpfbch_crcf_create_kaiser(LIQUID_ANALYZER, numChannels, CHANNELIZER_FILTER_SEMILENGTH, 60);
+    }
+
+    chanBw = sampleRate / numChannels;
+    chanCenters.assign(numChannels + 1, 0);
+    dataOut.clear();
+
+    if (!workerPool) {
+        return;
+    }
+
+    // One channelizer per sub-block, i.e per thread, the calling one included.
+    size_t numParts = workerPool->getNumThreads() + 1;
+
+    for (size_t p = 0; p < numParts; p++) {
+        if (type == PFBCH2) {
+            parallelChannelizers2.push_back(firpfbch2_crcf_create_kaiser(LIQUID_ANALYZER, numChannels, CHANNELIZER_FILTER_SEMILENGTH, 60));
+        } else {
+            parallelChannelizers.push_back(firpfbch_crcf_create_kaiser(LIQUID_ANALYZER, numChannels, CHANNELIZER_FILTER_SEMILENGTH, 60));
+        }
+    }
+
+    primeBufs.assign(numParts, std::vector<liquid_float_complex>(numChannels));
+
+    // A zero history is the state of a newly created channelizer.
+    int stepIn = (type == PFBCH2) ? (numChannels / 2) : numChannels;
+    int primeSteps = (type == PFBCH2) ? 2 * (2 * CHANNELIZER_FILTER_SEMILENGTH + 1) : (2 * CHANNELIZER_FILTER_SEMILENGTH + 1);
+    liquid_float_complex zero;
+    zero.real = zero.imag = 0;
+
+    chanHistory.assign((primeSteps + 1) * stepIn, zero);
+    pfbch2Parity = 0;
+}
+
+PFBChannelizer::Type PFBChannelizer::getType() {
+    return type;
+}
+
+int PFBChannelizer::getNumChannels() {
+    return numChannels;
+}
+
+void PFBChannelizer::setCenterFrequency(long long centerFreq) {
+    for (int i = 0; i < numChannels / 2; i++) {
+        long long ofs = chanBw * i;
+        chanCenters[i] = centerFreq + ofs;
+        chanCenters[i + (numChannels / 2)] = centerFreq - (sampleRate / 2) + ofs;
+    }
+    chanCenters[numChannels] = centerFreq + (sampleRate / 2);
+}
+
+long long PFBChannelizer::getChannelCenter(int channel) {
+    return chanCenters[channel];
+}
+
+int PFBChannelizer::getChannelAt(long long frequency) {
+    int chan = -1;
+    long long minDelta = sampleRate;
+
+    for (int i = 0; i < numChannels + 1; i++) {
+        long long fdelta = std::llabs(frequency - chanCenters[i]);
+        if (fdelta < minDelta) {
+            minDelta = fdelta;
+            chan = i;
+        }
+    }
+    return chan;
+}
+
+long long PFBChannelizer::getChannelSampleRate() {
+    //firpfbch2 outputs at twice the channel spacing.
+    return (type == PFBCH2) ? (chanBw * 2) : chanBw;
+}
+
+void PFBChannelizer::execute(const liquid_float_complex *in, size_t numSamples) {
+    // firpfbch produces [numChannels] interleaved output samples for every [numChannels] input samples,
+    // firpfbch2 for every [numChannels/2] input samples.
+    int stepIn = (type == PFBCH2) ? (numChannels / 2) : numChannels;
+    int numSteps = (int)(numSamples / stepIn);
+    size_t outSize = (size_t)numSteps * numChannels;
+
+    if (dataOut.size() != outSize) {
+        dataOut.resize(outSize);
+    }
+
+    if (workerPool) {
+        executeParallel(in, numSteps);
+    } else if (type == PFBCH2) {
+        for (int step = 0; step < numSteps; step++) {
+            firpfbch2_crcf_execute(channelizer2, const_cast<liquid_float_complex *>(&in[step * stepIn]), &dataOut[step * numChannels]);
+        }
+    } else {
+        for (int step = 0; step < numSteps; step++) {
+            firpfbch_crcf_analyzer_execute(channelizer, const_cast<liquid_float_complex *>(&in[step * stepIn]), &dataOut[step * numChannels]);
+        }
+    }
+}
+
+// The channelizer output only depends on its last inputs: the filter windows of firpfbch
+// hold the last 2*m executions, those of firpfbch2 the last 4*m, plus an execution parity.
+// So each sub-block is run by its own channelizer, reset then primed with the inputs preceding the sub-block,
+// which gives exactly the output a single channelizer would produce on the whole block.
+void PFBChannelizer::executeParallel(const liquid_float_complex *in, int numSteps) {
+    bool pfbch2 = (type == PFBCH2);
+
+    // input samples per channelizer execution, each one producing numChannels output samples.
+    int stepIn = pfbch2 ? (numChannels / 2) : numChannels;
+    // executions to fully prime a reset channelizer, with one more window length for safety.
+    int primeSteps = pfbch2 ? 2 * (2 * CHANNELIZER_FILTER_SEMILENGTH + 1) : (2 * CHANNELIZER_FILTER_SEMILENGTH + 1);
+    int historySize = (int)chanHistory.size();
+
+    int maxParts = (int)(pfbch2 ? parallelChannelizers2.size() : parallelChannelizers.size());
+    int numParts = std::max(1, std::min(maxParts, numSteps / (primeSteps * CHANNELIZER_SUBBLOCK_MIN_PRIME_RATIO)));
+
+    liquid_float_complex *input = const_cast<liquid_float_complex *>(in);
+    liquid_float_complex *history = &chanHistory[0];
+
+    workerPool->parallelFor(numParts, [&](size_t p) {
+        int firstStep = (int)((long long)numSteps * p / numParts);
+        int endStep = (int)((long long)numSteps * (p + 1) / numParts);
+
+        // firpfbch2 alternates between 2 halves of its windows: prime it with the parity
+        // a single channelizer would have at firstStep.
+        int prime = primeSteps;
+        if (pfbch2 && (prime & 1) != ((pfbch2Parity + firstStep) & 1)) {
+            prime++;
+        }
+
+        liquid_float_complex *primeOut = &primeBufs[p][0];
+
+        if (pfbch2) {
+            firpfbch2_crcf ch = parallelChannelizers2[p];
+            firpfbch2_crcf_reset(ch);
+
+            // the inputs before the block come from the history.
+            for (int step = firstStep - prime; step < firstStep; step++) {
+                liquid_float_complex *x = (step < 0) ? &history[historySize + step * stepIn] : &input[step * stepIn];
+                firpfbch2_crcf_execute(ch, x, primeOut);
+            }
+            for (int step = firstStep; step < endStep; step++) {
+                firpfbch2_crcf_execute(ch, &input[step * stepIn], &dataOut[step * numChannels]);
+            }
+        } else {
+            firpfbch_crcf ch = parallelChannelizers[p];
+            firpfbch_crcf_reset(ch);
+
+            for (int step = firstStep - prime; step < firstStep; step++) {
+                liquid_float_complex *x = (step < 0) ? &history[historySize + step * stepIn] : &input[step * stepIn];
+                firpfbch_crcf_analyzer_execute(ch, x, primeOut);
+            }
+            for (int step = firstStep; step < endStep; step++) {
+                firpfbch_crcf_analyzer_execute(ch, &input[step * stepIn], &dataOut[step * numChannels]);
+            }
+        }
+    });
+
+    // Keep the tail of the inputs for the next block
+    int numIn = numSteps * stepIn;
+
+    if (numIn >= historySize) {
+        std::copy(in + numIn - historySize, in + numIn, history);
+    } else {
+        std::copy(history + numIn, history + historySize, history);
+        std::copy(in, in + numIn, history + historySize - numIn);
+    }
+
+    pfbch2Parity = (pfbch2Parity + numSteps) & 1;
+}
+
+size_t PFBChannelizer::getChannelSize() {
+    return numChannels ? (dataOut.size() / numChannels) : 0;
+}
+
+void PFBChannelizer::extract(const int *channels, liquid_float_complex * const *out, size_t numOut, bool dcCorrected) {
+    size_t chanDataSize = getChannelSize();
+
+    if (numOut == 0 || chanDataSize == 0) {
+        return;
+    }
+
+    columns.resize(numOut);
+    outputs.resize(numOut);
+
+    for (size_t k = 0; k < numOut; k++) {
+        int chan = channels[k];
+
+        // Extra channel wraps left side band of lowest channel
+        // to fix frequency gap on right side of spectrum
+        columns[k] = (chan == numChannels) ? (numChannels/2) : chan;
+
+        if (chan == 0 && !dcCorrected) {   // Channel 0 requires DC correction, extract it in the DC buffer first
+            if (dcBuf.size() != chanDataSize) {
+                dcBuf.resize(chanDataSize);
+            }
+            outputs[k] = &dcBuf[0];
+        } else {
+            outputs[k] = out[k];
+        }
+    }
+
+    // Transpose all the channels at once, by frame ranges spread over the workers in the multi-threaded mode.
+    size_t numParts = 1;
+
+    if (workerPool) {
+        size_t tileFrames = ChannelDeinterleaver::getTileFrames(numChannels);
+        numParts = std::max((size_t)1, std::min(workerPool->getNumThreads() + 1, chanDataSize / tileFrames));
+    }
+
+    if (numParts > 1) {
+        workerPool->parallelFor(numParts, [this, chanDataSize, numParts, numOut](size_t p) {
+            deinterleaver.deinterleave(&dataOut[0], numChannels, &columns[0], &outputs[0], numOut,
+                                       chanDataSize * p / numParts, chanDataSize * (p + 1) / numParts);
+        });
+    } else {
+        deinterleaver.deinterleave(&dataOut[0], numChannels, &columns[0], &outputs[0], numOut, 0, chanDataSize);
+    }
+
+    // Run DC Filter from dcBuf to the channel 0 output buffer
+    if (channels[0] == 0 && !dcCorrected) {
+        iirfilt_crcf_execute_block(dcFilter, &dcBuf[0], chanDataSize, out[0]);
+    }
+}
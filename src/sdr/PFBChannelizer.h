@@ -0,0 +1,78 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <vector>
+#include "liquid/liquid.h"
+#include "WorkerPool.h"
+#include "ChannelDeinterleaver.h"
+
+//Polyphase filterbank channelizer of SDRPostThread: splits the input band in numChannels channels,
+//with firpfbch at the channel spacing or firpfbch2 at twice the channel spacing, then extracts the channels in use.
+//Channel numChannels is the left side band of channel numChannels / 2, to fill the gap at the right edge of the band.
+//In the multi-threaded mode, the input is channelized by sub-blocks, and the channels extracted by frame ranges,
+//in parallel on a worker pool.
+class PFBChannelizer {
+public:
+    enum Type {
+        PFBCH, PFBCH2
+    };
+
+    PFBChannelizer();
+    ~PFBChannelizer();
+
+    //(Re)create the channelizer for numChannels channels of an input at sampleRate, from a zero history.
+    //The multi-threaded mode runs on workerPool if not nullptr, which must outlive its use here.
+    void init(Type type, int numChannels, long long sampleRate, WorkerPool *workerPool);
+    Type getType();
+    int getNumChannels();
+
+    //Channel centers around centerFreq.
+    void setCenterFrequency(long long centerFreq);
+    //center of channel [0, numChannels], and the channel nearest to frequency, -1 if none.
+    long long getChannelCenter(int channel);
+    int getChannelAt(long long frequency);
+    long long getChannelSampleRate();
+
+    //Channelize numSamples input samples, a multiple of numChannels.
+    void execute(const liquid_float_complex *in, size_t numSamples);
+    //samples per channel of the last execute().
+    size_t getChannelSize();
+
+    //Copy channels[k] of the last execute() to out[k], getChannelSize() samples each, the channels in increasing order.
+    //Channel 0 goes through a DC blocker, unless the input is already dcCorrected.
+    void extract(const int *channels, liquid_float_complex * const *out, size_t numOut, bool dcCorrected);
+
+private:
+    void clearParallelChannelizers();
+    void executeParallel(const liquid_float_complex *in, int numSteps);
+
+    Type type;
+    int numChannels;
+    long long sampleRate, chanBw;
+    std::vector<long long> chanCenters;
+
+    firpfbch_crcf channelizer;
+    firpfbch2_crcf channelizer2;
+    //interleaved output of the last execute(), numChannels samples per execution of the channelizer.
+    std::vector<liquid_float_complex> dataOut;
+
+    iirfilt_crcf dcFilter;
+    std::vector<liquid_float_complex> dcBuf;
+
+    ChannelDeinterleaver deinterleaver;
+    std::vector<int> columns;
+    std::vector<liquid_float_complex *> outputs;
+
+    //multi-threaded mode:
+    WorkerPool *workerPool;
+    //one channelizer per sub-block.
+    std::vector<firpfbch_crcf> parallelChannelizers;
+    std::vector<firpfbch2_crcf> parallelChannelizers2;
+    //tail of the previous input block, to prime the channelizer of the first sub-block.
+    std::vector<liquid_float_complex> chanHistory;
+    std::vector<std::vector<liquid_float_complex>> primeBufs;
+    //number of PFBCH2 executions so far, modulo 2.
+    int pfbch2Parity;
+};
@@ -4,28 +4,37 @@
 #include "SDRPostThread.h"
 #include "CubicSDRDefs.h"
 #include "CubicSDR.h"
+#include "PipelineMetrics.h"
 
 #include <vector>
+#include <algorithm>
 #include <deque>
 #include <memory>
 
 //50 ms
 #define HEARTBEAT_CHECK_PERIOD_MICROS (50 * 1000) 
 
-SDRPostThread::SDRPostThread() : IOThread(), buffers("SDRPostThreadBuffers"), visualDataBuffers("SDRPostThreadVisualDataBuffers"), frequency(0) {
+//a single channel block can be pending in the input pipes of many demodulators at once.
+#define DEMOD_BUFFER_POOL_CAPACITY 1024
+
+//multi-threaded mode: at most that many worker threads.
+#define CHANNELIZER_MAX_WORKER_THREADS 8
+
+SDRPostThread::SDRPostThread() : IOThread(), buffers("SDRPostThreadBuffers", DEMOD_BUFFER_POOL_CAPACITY), frequency(0) {
     iqDataInQueue = nullptr;
     iqDataOutQueue = nullptr;
     iqVisualQueue = nullptr;
 
     numChannels = 0;
-    channelizer = nullptr;
-    channelizer2 = nullptr;
     
     // Channel mode default is PFBCH
     chanMode = (int)SDRPostPFBCH;
     lastChanMode = 0;
     
     sampleRate = 0;
+
+    parallelMode.store(false);
+    lastParallelMode = false;
     
     doRefresh.store(false);
     dcFilter = iirfilt_crcf_create_dc_blocker(0.0005f);
@@ -115,40 +124,23 @@ void SDRPostThread::resetAllDemodulators() {
 }
 
 
-// Update the channel positions and frequencies
-void SDRPostThread::updateChannels() {
-    // calculate channel center frequencies, todo: cache
-    for (int i = 0; i < numChannels/2; i++) {
-        int ofs = ((chanBw) * i);
-        chanCenters[i] = frequency + ofs;
-        chanCenters[i+(numChannels/2)] = frequency - (sampleRate/2) + ofs;
-    }
-    chanCenters[numChannels] = frequency + (sampleRate/2);
+void SDRPostThread::setChannelizerType(SDRPostThreadChannelizerType chType) {
+    chanMode.store((int)chType);
 }
 
 
-// Find the channelizer channel that corresponds to the given frequency
-int SDRPostThread::getChannelAt(long long frequency) {
-    int chan = -1;
-    long long minDelta = sampleRate;
-    for (int i = 0; i < numChannels+1; i++) {
-        long long fdelta = abs(frequency - chanCenters[i]);
-        if (fdelta < minDelta) {
-            minDelta = fdelta;
-            chan = i;
-        }
-    }
-    return chan;
+SDRPostThreadChannelizerType SDRPostThread::getChannelizerType() {
+    return (SDRPostThreadChannelizerType) chanMode.load();
 }
 
 
-void SDRPostThread::setChannelizerType(SDRPostThreadChannelizerType chType) {
-    chanMode.store((int)chType);
+void SDRPostThread::setParallelChannelizer(bool parallel) {
+    parallelMode.store(parallel);
 }
 
 
-SDRPostThreadChannelizerType SDRPostThread::getChannelizerType() {
-    return (SDRPostThreadChannelizerType) chanMode.load();
+bool SDRPostThread::getParallelChannelizer() {
+    return parallelMode.load();
 }
 
 
@@ -167,12 +159,18 @@ void SDRPostThread::run() {
     iqVisualQueue = std::static_pointer_cast<DemodulatorThreadInputQueue>(getOutputQueue("IQVisualDataOutput"));
     iqActiveDemodVisualQueue = std::static_pointer_cast<DemodulatorThreadInputQueue>(getOutputQueue("IQActiveDemodVisualDataOutput"));
     
+    PipelineMetrics::ThreadStats *busyStats = PipelineMetrics::getThreadStats("SDRPostThread");
+    PipelineMetrics::LatencyStats *latencyStats = PipelineMetrics::getLatencyStats("SDRPostThread input");
+
     while (!stopping) {
         SDRThreadIQDataPtr data_in;
         
         if (!iqDataInQueue->pop(data_in, HEARTBEAT_CHECK_PERIOD_MICROS)) {
             continue;
         }
+
+        PipelineMetrics::BusyScope busy(busyStats);
+        latencyStats->record(data_in->captureTime);
          
         bool doUpdate = false;
 
@@ -180,9 +178,11 @@ void SDRPostThread::run() {
            
             if(data_in->numChannels > 1) {
                 if (chanMode == 1) {
-                    runPFBCH(data_in.get());
+                    runPFBCH(data_in, PFBChannelizer::PFBCH);
                 } else if (chanMode == 2) {
-                    runPFBCH2(data_in.get());
+                    runPFBCH(data_in, PFBChannelizer::PFBCH2);
+                } else if (chanMode == 3) {
+                    runFFTChannelizer(data_in);
                 }
             } else {
                 runSingleCH(data_in.get());
@@ -221,18 +221,6 @@ void SDRPostThread::terminate() {
     iqActiveDemodVisualQueue->flush();
 }
 
-// Copy the full badwidth into a new DemodulatorThreadIQDataPtr.
-DemodulatorThreadIQDataPtr SDRPostThread::getFullSampleRateIqData(SDRThreadIQData *data_in) {
-
-    DemodulatorThreadIQDataPtr iqDataOut = visualDataBuffers.getBuffer();
-
-    iqDataOut->frequency = data_in->frequency;
-    iqDataOut->sampleRate = data_in->sampleRate;
-    iqDataOut->data.assign(data_in->data.begin(), data_in->data.begin() + data_in->data.size());
-
-    return iqDataOut;
-}
-
 // Push visual data; i.e. Main Waterfall (all frames) and Spectrum (active frame)
 void SDRPostThread::pushVisualData(DemodulatorThreadIQDataPtr iqDataOut) {
 
@@ -265,17 +253,11 @@ void SDRPostThread::runSingleCH(SDRThreadIQData *data_in) {
     
     size_t outSize = data_in->data.size();
     
-    if (outSize > dataOut.capacity()) {
-        dataOut.reserve(outSize);
-    }
-    if (outSize != dataOut.size()) {
-        dataOut.resize(outSize);
-    }
-    
     DemodulatorThreadIQDataPtr demodDataOut = buffers.getBuffer();
 
     demodDataOut->frequency = frequency;
     demodDataOut->sampleRate = sampleRate;
+    demodDataOut->captureTime = data_in->captureTime;
     
     if (demodDataOut->data.size() != outSize) {
         if (demodDataOut->data.capacity() < outSize) {
@@ -284,8 +266,12 @@ void SDRPostThread::runSingleCH(SDRThreadIQData *data_in) {
         demodDataOut->data.resize(outSize);
     }
     
-    //Only 1 channel, apply DC blocker.
-    iirfilt_crcf_execute_block(dcFilter, &data_in->data[0], data_in->data.size(), &demodDataOut->data[0]);
+    //Only 1 channel, apply DC blocker, unless the device or the SDR thread did already.
+    if (data_in->dcCorrected) {
+        std::copy(data_in->data.begin(), data_in->data.end(), demodDataOut->data.begin());
+    } else {
+        iirfilt_crcf_execute_block(dcFilter, &data_in->data[0], data_in->data.size(), &demodDataOut->data[0]);
+    }
 
     //push the DC-corrected data as Main Spactrum + Waterfall data.
     pushVisualData(demodDataOut);
@@ -298,17 +284,17 @@ void SDRPostThread::runSingleCH(SDRThreadIQData *data_in) {
     for (size_t i = 0; i < runDemods.size(); i++) {
         // try-push() : we do our best to only stimulate active demods, but some could happen to be dead, full, or indeed non-active.
         //so in short never block here no matter what.
-        runDemods[i]->getIQInputDataPipe()->try_push(demodDataOut);
+        runDemods[i]->pushIQData(demodDataOut);
     }
 }
 
 
 // Handle active channels, channel 0 offset correction, de-interlacing and push data to demodulators
-void SDRPostThread::runDemodChannels(int channelBandwidth) {
+void SDRPostThread::runDemodChannels(int64_t captureTime, bool dcCorrected) {
     DemodulatorInstancePtr activeDemod = wxGetApp().getDemodMgr().getCurrentModem();
 
     // Calculate channel data size
-    size_t chanDataSize = dataOut.size()/numChannels;
+    size_t chanDataSize = pfbChannelizer.getChannelSize();
 
     // Channel for the 'active' demod that's displaying visual data
     int activeDemodChannel = -1;
@@ -320,7 +306,7 @@ void SDRPostThread::runDemodChannels(int channelBandwidth) {
     // Find nearest channel for each demodulator
     for (size_t i = 0; i < runDemods.size(); i++) {
         DemodulatorInstancePtr demod = runDemods[i];
-        demodChannel[i] = getChannelAt(demod->getFrequency());
+        demodChannel[i] = pfbChannelizer.getChannelAt(demod->getFrequency());
         if (demod == activeDemod) {
             activeDemodChannel = demodChannel[i];
         }
@@ -333,7 +319,12 @@ void SDRPostThread::runDemodChannels(int channelBandwidth) {
         }
     }
 
-    // Run channels
+    // List the channels to run and get their buffers here,
+    // so that only the de-interleaving of the channels is done in parallel.
+    runChannels.clear();
+    runChannelData.clear();
+    runOutputs.clear();
+
     for (int i = 0; i < numChannels+1; i++) {
         bool doDemodVis = (activeDemodChannel == i) && (iqActiveDemodVisualQueue != nullptr);
         
@@ -344,8 +335,9 @@ void SDRPostThread::runDemodChannels(int channelBandwidth) {
         
         // Get a channel buffer
         DemodulatorThreadIQDataPtr demodDataOut = buffers.getBuffer();
-        demodDataOut->frequency = chanCenters[i];
-        demodDataOut->sampleRate = channelBandwidth;
+        demodDataOut->frequency = pfbChannelizer.getChannelCenter(i);
+        demodDataOut->sampleRate = pfbChannelizer.getChannelSampleRate();
+        demodDataOut->captureTime = captureTime;
 
         // Resize and update capacity of buffer if necessary
         if (demodDataOut->data.size() != chanDataSize) {
@@ -354,38 +346,23 @@ void SDRPostThread::runDemodChannels(int channelBandwidth) {
             }
             demodDataOut->data.resize(chanDataSize);
         }
-        
-        // Start copying interleaved data at given channel index
-        int idx = i;
-        
-        // Extra channel wraps left side band of lowest channel
-        // to fix frequency gap on right side of spectrum
-        if (i == numChannels) {
-            idx = (numChannels/2);
-        }
-        
-        // prepare channel data buffer
-        if (i == 0) {   // Channel 0 requires DC correction
-            // Update DC Buffer size if needed
-            if (dcBuf.size() != chanDataSize) {
-                dcBuf.resize(chanDataSize);
-            }
-            // Copy interleaved channel data to dc buffer
-            for (size_t j = 0; j < chanDataSize; j++) {
-                dcBuf[j] = dataOut[idx];
-                idx += numChannels;
-            }
-            // Run DC Filter from dcBuf to demod output buffer
-            iirfilt_crcf_execute_block(dcFilter, &dcBuf[0], chanDataSize, &demodDataOut->data[0]);
-        } else {
-            // Copy interleaved channel data to demod output buffer
-            for (size_t j = 0; j < chanDataSize; j++) {
-                demodDataOut->data[j] = dataOut[idx];
-                idx += numChannels;
-            }
-        }
-        
-        if (doDemodVis) {
+
+        runChannels.push_back(i);
+        runChannelData.push_back(demodDataOut);
+        runOutputs.push_back(&demodDataOut->data[0]);
+    }
+
+    // Fill the channel buffers, DC correcting channel 0 unless the input already is.
+    if (!runChannels.empty()) {
+        pfbChannelizer.extract(&runChannels[0], &runOutputs[0], runChannels.size(), dcCorrected);
+    }
+
+    // Push the channels to their demodulators, in order
+    for (size_t k = 0; k < runChannels.size(); k++) {
+        int i = runChannels[k];
+        DemodulatorThreadIQDataPtr demodDataOut = runChannelData[k];
+
+        if ((activeDemodChannel == i) && (iqActiveDemodVisualQueue != nullptr)) {
             //non-blocking push here, we can afford to loose some samples for a ever-changing visual display.
             iqActiveDemodVisualQueue->try_push(demodDataOut);
         }
@@ -395,121 +372,131 @@ void SDRPostThread::runDemodChannels(int channelBandwidth) {
                 
                 // try-push() : we do our best to only stimulate active demods, but some could happen to be dead, full, or indeed non-active.
                 //so in short never block here no matter what.
-                runDemods[j]->getIQInputDataPipe()->try_push(demodDataOut);
+                runDemods[j]->pushIQData(demodDataOut);
             }
         } //end for
     }
-}
-
 
-void SDRPostThread::initPFBCH() {
-    //    std::cout << "Initializing post-process FIR polyphase filterbank channelizer with " << numChannels << " channels." << std::endl;
-    if (channelizer) {
-        firpfbch_crcf_destroy(channelizer);
-    }
-    channelizer = firpfbch_crcf_create_kaiser(LIQUID_ANALYZER, numChannels, 4, 60);
-    
-    chanBw = (sampleRate / numChannels);
-    
-    chanCenters.resize(numChannels+1);
-    demodChannelActive.resize(numChannels+1);
-    
-    //    std::cout << "Channel bandwidth spacing: " << (chanBw) << std::endl;
+    //do not hold the buffers until the next run.
+    runChannelData.clear();
 }
 
-void SDRPostThread::runPFBCH(SDRThreadIQData *data_in) {
+
+void SDRPostThread::runPFBCH(const SDRThreadIQDataPtr& data_in, PFBChannelizer::Type type) {
+    int mode = (type == PFBChannelizer::PFBCH2) ? 2 : 1;
     bool refreshed = false;
-    if (numChannels != data_in->numChannels || sampleRate != data_in->sampleRate || chanMode != lastChanMode || doRefresh.load()) {
+
+    if (numChannels != data_in->numChannels || sampleRate != data_in->sampleRate || chanMode != lastChanMode ||
+        parallelMode.load() != lastParallelMode || doRefresh.load()) {
         numChannels = data_in->numChannels;
         sampleRate = data_in->sampleRate;
-        initPFBCH();
-        lastChanMode = 1;
+        lastChanMode = mode;
+        lastParallelMode = parallelMode.load();
+
+        if (lastParallelMode && !workerPool) {
+            workerPool.reset(new WorkerPool("SDRPostThreadWorkers", WorkerPool::getDefaultNumThreads(CHANNELIZER_MAX_WORKER_THREADS)));
+        }
+
+        //    std::cout << "Initializing post-process FIR polyphase filterbank channelizer with " << numChannels << " channels." << std::endl;
+        pfbChannelizer.init(type, numChannels, sampleRate, lastParallelMode ? workerPool.get() : nullptr);
+        demodChannelActive.resize(numChannels+1);
         refreshed = true;
     }
-    
+
     if (refreshed || frequency != data_in->frequency) {
         frequency = data_in->frequency;
         updateActiveDemodulators();
-        updateChannels();
+        pfbChannelizer.setCenterFrequency(frequency);
     }
 
-    //push the full data_in into (Main spectrum + waterfall) visual queue:
-    DemodulatorThreadIQDataPtr fullSampleRateIQ = getFullSampleRateIqData(data_in);
-    pushVisualData(fullSampleRateIQ);
-    
-    size_t outSize = data_in->data.size();
-    
-    if (outSize > dataOut.capacity()) {
-        dataOut.reserve(outSize);
-    }
-    if (outSize != dataOut.size()) {
-        dataOut.resize(outSize);
-    }
-    
+    //push the full data_in into (Main spectrum + waterfall) visual queue, shared as-is:
+    pushVisualData(data_in);
+
     // Find active demodulators
     if (runDemods.size() > 0) {
         // Channelize data
-        // firpfbch produces [numChannels] interleaved output samples for every [numChannels] samples
-        for (int i = 0, iMax = data_in->data.size(); i < iMax; i+=numChannels) {
-            firpfbch_crcf_analyzer_execute(channelizer, &data_in->data[i], &dataOut[i]);
-        }
-        
-        runDemodChannels(chanBw);
+        pfbChannelizer.execute(&data_in->data[0], data_in->data.size());
+
+        runDemodChannels(data_in->captureTime, data_in->dcCorrected);
     }
 }
 
 
-void SDRPostThread::initPFBCH2() {
-    //    std::cout << "Initializing post-process FIR polyphase filterbank channelizer with " << numChannels << " channels." << std::endl;
-    if (channelizer2) {
-        firpfbch2_crcf_destroy(channelizer2);
-    }
-    channelizer2 = firpfbch2_crcf_create_kaiser(LIQUID_ANALYZER, numChannels, 4, 60);
-    
-    chanBw = (sampleRate / numChannels);
-    
-    chanCenters.resize(numChannels+1);
-    demodChannelActive.resize(numChannels+1);
-    //    std::cout << "Channel bandwidth spacing: " << (chanBw) << std::endl;
-}
+void SDRPostThread::runFFTChannelizer(const SDRThreadIQDataPtr& data_in) {
+    bool refreshed = doRefresh.load();
 
-void SDRPostThread::runPFBCH2(SDRThreadIQData *data_in) {
-    bool refreshed = false;
-    if (numChannels != data_in->numChannels || sampleRate != data_in->sampleRate || chanMode != lastChanMode || doRefresh.load()) {
+    //only a new sample rate or mode rebuilds the channelizer, which drops all of its channels:
+    //a change of the demodulators is applied by setChannels() below.
+    if (sampleRate != data_in->sampleRate || chanMode != lastChanMode) {
         numChannels = data_in->numChannels;
         sampleRate = data_in->sampleRate;
-        initPFBCH2();
-        lastChanMode = 2;
+        fftChannelizer.setSampleRate(sampleRate);
+        lastChanMode = 3;
         refreshed = true;
     }
 
+    if (parallelMode.load() != lastParallelMode) {
+        lastParallelMode = parallelMode.load();
+        if (lastParallelMode && !workerPool) {
+            workerPool.reset(new WorkerPool("SDRPostThreadWorkers", WorkerPool::getDefaultNumThreads(CHANNELIZER_MAX_WORKER_THREADS)));
+        }
+    }
+
     if (refreshed || frequency != data_in->frequency) {
         frequency = data_in->frequency;
         updateActiveDemodulators();
-        updateChannels();
     }
 
-    //push the full data_in into (Main spectrum + waterfall) visual queue:
-    DemodulatorThreadIQDataPtr fullSampleRateIQ = getFullSampleRateIqData(data_in);
-    pushVisualData(fullSampleRateIQ);
-    
-    size_t outSize = data_in->data.size() * 2;
-    
-    if (outSize > dataOut.capacity()) {
-        dataOut.reserve(outSize);
+    //push the full data_in into (Main spectrum + waterfall) visual queue, shared as-is:
+    pushVisualData(data_in);
+
+    // One channel per distinct demodulator frequency and bandwidth,
+    // the channelizer keeps running the ones it already had.
+    fftChannelOffsets.resize(runDemods.size());
+    fftChannelBandwidths.resize(runDemods.size());
+
+    for (size_t i = 0; i < runDemods.size(); i++) {
+        fftChannelOffsets[i] = runDemods[i]->getFrequency() - frequency;
+        fftChannelBandwidths[i] = runDemods[i]->getBandwidth();
     }
-    if (outSize != dataOut.size()) {
-        dataOut.resize(outSize);
+
+    fftChannelizer.setChannels(fftChannelOffsets, fftChannelBandwidths, demodChannel);
+
+    if (runDemods.empty()) {
+        return;
     }
-    
-    // Find active demodulators
-    if (runDemods.size() > 0) {
-        // Channelize data
-        // firpfbch2 produces [numChannels] interleaved output samples for every [numChannels/2] input samples
-        for (int i = 0, iMax = data_in->data.size(); i < iMax; i += numChannels/2) {
-            firpfbch2_crcf_execute(channelizer2, &data_in->data[i], &dataOut[i*2]);
+
+    fftChannelizer.execute(&data_in->data[0], data_in->data.size(), lastParallelMode ? workerPool.get() : nullptr);
+
+    DemodulatorInstancePtr activeDemod = wxGetApp().getDemodMgr().getCurrentModem();
+
+    for (int c = 0, cMax = (int)fftChannelizer.getNumChannels(); c < cMax; c++) {
+        const std::vector<liquid_float_complex>& chanOut = fftChannelizer.getOutput(c);
+
+        //not a full frame yet.
+        if (chanOut.empty()) {
+            continue;
+        }
+
+        DemodulatorThreadIQDataPtr demodDataOut = buffers.getBuffer();
+        demodDataOut->frequency = frequency + fftChannelizer.getOffset(c);
+        demodDataOut->sampleRate = fftChannelizer.getOutputSampleRate(c);
+        demodDataOut->captureTime = data_in->captureTime;
+        demodDataOut->data.assign(chanOut.begin(), chanOut.end());
+
+        for (size_t j = 0; j < runDemods.size(); j++) {
+            if (demodChannel[j] != c) {
+                continue;
+            }
+
+            if (runDemods[j] == activeDemod && iqActiveDemodVisualQueue != nullptr) {
+                //non-blocking push here, we can afford to loose some samples for a ever-changing visual display.
+                iqActiveDemodVisualQueue->try_push(demodDataOut);
+            }
+
+            // try-push() : we do our best to only stimulate active demods, but some could happen to be dead, full, or indeed non-active.
+            //so in short never block here no matter what.
+            runDemods[j]->pushIQData(demodDataOut);
         }
-        
-        runDemodChannels(chanBw * 2);
     }
 }
@@ -4,11 +4,16 @@
 #pragma once
 
 #include "SoapySDRThread.h"
+#include "WorkerPool.h"
+#include "PFBChannelizer.h"
+#include "FFTChannelizer.h"
 #include <algorithm>
 
 enum SDRPostThreadChannelizerType {
     SDRPostPFBCH = 1,
-    SDRPostPFBCH2 = 2
+    SDRPostPFBCH2 = 2,
+    //fast-convolution channelizer, one output per demodulator frequency and bandwidth.
+    SDRPostFFTOS = 3
 };
 
 class SDRPostThread : public IOThread {
@@ -25,6 +30,11 @@ public:
 
     void setChannelizerType(SDRPostThreadChannelizerType chType);
     SDRPostThreadChannelizerType getChannelizerType();
+
+    //Multi-threaded mode: the channelizer runs on sub-blocks, and the channels
+    //are de-interleaved, in parallel on a pool of worker threads.
+    void setParallelChannelizer(bool parallel);
+    bool getParallelChannelizer();
     
     
 protected:
@@ -34,41 +44,47 @@ protected:
     DemodulatorThreadInputQueuePtr iqActiveDemodVisualQueue;
 
 private:
-    // Copy the full samplerate into a new DemodulatorThreadIQDataPtr.
-    DemodulatorThreadIQDataPtr getFullSampleRateIqData(SDRThreadIQData *data_in);
+    // Push to the Main Spectrum + Waterfall; SDR blocks are pushed as-is, they must no longer be modified.
     void pushVisualData(DemodulatorThreadIQDataPtr iqDataOut);
 
     void runSingleCH(SDRThreadIQData *data_in);
 
-    void runDemodChannels(int channelBandwidth);
+    // Push the channels of the last pfbChannelizer execution to their demodulators.
+    void runDemodChannels(int64_t captureTime, bool dcCorrected);
 
-    void initPFBCH();
-    void runPFBCH(SDRThreadIQData *data_in);
+    // Run the PFBCH or PFBCH2 channelizer, on the worker pool in multi-threaded mode.
+    void runPFBCH(const SDRThreadIQDataPtr& data_in, PFBChannelizer::Type type);
 
-    void initPFBCH2();
-    void runPFBCH2(SDRThreadIQData *data_in);
+    // Extract a channel per demodulator with the FFT overlap-save channelizer.
+    void runFFTChannelizer(const SDRThreadIQDataPtr& data_in);
 
     void updateActiveDemodulators();
-    void updateChannels();    
-    int getChannelAt(long long frequency);
 
-    ReBuffer<DemodulatorThreadIQData> buffers;
-    std::vector<liquid_float_complex> dataOut;
-    std::vector<long long> chanCenters;
-    long long chanBw = 0;
+    BufferPool<DemodulatorThreadIQData> buffers;
     
     std::vector<DemodulatorInstancePtr> runDemods;
     std::vector<int> demodChannel;
     std::vector<int> demodChannelActive;
 
-    ReBuffer<DemodulatorThreadIQData> visualDataBuffers;
     atomic_bool doRefresh;
     atomic_int chanMode;
 
     int numChannels, sampleRate, lastChanMode;
     long long frequency;
-    firpfbch_crcf channelizer;
-    firpfbch2_crcf channelizer2;
+    //single channel mode:
     iirfilt_crcf dcFilter;
-    std::vector<liquid_float_complex> dcBuf;
+
+    //multi-threaded mode:
+    atomic_bool parallelMode;
+    bool lastParallelMode;
+    std::unique_ptr<WorkerPool> workerPool;
+
+    PFBChannelizer pfbChannelizer;
+    std::vector<int> runChannels;
+    std::vector<DemodulatorThreadIQDataPtr> runChannelData;
+    std::vector<liquid_float_complex *> runOutputs;
+
+    FFTChannelizer fftChannelizer;
+    std::vector<long long> fftChannelOffsets;
+    std::vector<int> fftChannelBandwidths;
 };
@@ -5,15 +5,18 @@
 #include "CubicSDRDefs.h"
 #include <vector>
 #include "CubicSDR.h"
+#include "PipelineMetrics.h"
 #include <string>
 #include <algorithm>
 #include <SoapySDR/Logger.h>
+#include <SoapySDR/Formats.h>
 #include <chrono>
 
 #define TARGET_DISPLAY_FPS 60
 
 SDRThread::SDRThread() : IOThread(), buffers("SDRThreadBuffers") {
     device = nullptr;
+    busyStats = PipelineMetrics::getThreadStats("SDRThread");
 
     deviceConfig.store(nullptr);
     deviceInfo.store(nullptr);
@@ -87,19 +90,55 @@ bool SDRThread::init() {
     
     std::string streamExceptionStr("");
     
-    //1. setup stream for CF32:
+    //1. setup stream, for CF32 or for the device native format if requested and supported:
+    IQSampleConverter::SampleFormat streamFormat = IQSampleConverter::FORMAT_CF32;
+    double streamFullScale = 0;
+
+    if (devConfig->getNativeStreamFormat()) {
+        double nativeFullScale = 0;
+        std::string nativeFormat = device->getNativeStreamFormat(SOAPY_SDR_RX, 0, nativeFullScale);
+
+        if (nativeFormat == SOAPY_SDR_CS16) {
+            streamFormat = IQSampleConverter::FORMAT_CS16;
+            streamFullScale = nativeFullScale;
+        } else if (nativeFormat == SOAPY_SDR_CS8) {
+            streamFormat = IQSampleConverter::FORMAT_CS8;
+            streamFullScale = nativeFullScale;
+        } else {
+            std::cout << "SDRThread: native stream format '" << nativeFormat << "' is not supported, using CF32 instead." << std::endl;
+        }
+    }
+
     try {
-        stream = device->setupStream(SOAPY_SDR_RX,"CF32", std::vector<size_t>(), currentStreamArgs);
+        stream = device->setupStream(SOAPY_SDR_RX, IQSampleConverter::getFormatName(streamFormat), std::vector<size_t>(), currentStreamArgs);
     } catch(exception e) {
         streamExceptionStr = e.what();
     }
 
+    //fallback to CF32 if the native format has been refused:
+    if (!stream && streamFormat != IQSampleConverter::FORMAT_CF32) {
+        std::cout << "SDRThread: " << IQSampleConverter::getFormatName(streamFormat) << " stream setup failed, retrying with CF32..." << std::endl;
+
+        streamFormat = IQSampleConverter::FORMAT_CF32;
+        streamFullScale = 0;
+
+        try {
+            stream = device->setupStream(SOAPY_SDR_RX, SOAPY_SDR_CF32, std::vector<size_t>(), currentStreamArgs);
+        } catch(exception e) {
+            streamExceptionStr = e.what();
+        }
+    }
+
     if (!stream) {
         wxGetApp().sdrThreadNotify(SDRThread::SDR_THREAD_FAILED, std::string("Stream setup failed, stream is null. ") + streamExceptionStr);
         std::cout << "Stream setup failed, stream is null. " << streamExceptionStr << std::endl;
         return false;
     }
 
+    sampleConverter.setFormat(streamFormat, streamFullScale);
+    std::cout << "SDRThread: streaming " << IQSampleConverter::getFormatName(streamFormat) << " samples, converted with "
+              << CPUFeatures::getSIMDLevelName(sampleConverter.getSIMDLevel()) << " kernels." << std::endl;
+
     //2. Set sample rate:
     device->setSampleRate(SOAPY_SDR_RX, 0, sampleRate.load());
 
@@ -123,6 +162,8 @@ bool SDRThread::init() {
     } else {
         hasHardwareDC.store(false);
     }
+    //on request, and without hardware correction, remove the DC offset in the sample conversion:
+    sampleConverter.setDCRemoval(devConfig->getDCRemoval() && !hasHardwareDC.load());
 
     if (device->hasGainMode(SOAPY_SDR_RX, 0)) {
         device->setGainMode(SOAPY_SDR_RX, 0, agc_mode.load());
@@ -201,6 +242,10 @@ int SDRThread::readStream(SDRThreadIQDataQueuePtr iqDataOutQueue) {
     //TODO: use something roughly (1 / TARGET_DISPLAY_FPS) seconds * (factor) instead.?
     long timeoutUs = (1 << 30);
 
+    //busy time, excluding the waits in the device readStream():
+    int64_t busyStart = PipelineMetrics::now();
+    int64_t deviceNanos = 0;
+
     int n_read = 0;
     int nElems = numElems.load();
     int mtElems = mtuElems.load();
@@ -212,6 +257,8 @@ int SDRThread::readStream(SDRThreadIQDataQueuePtr iqDataOutQueue) {
     // readStream() is suited to device MTU and cannot be really adapted dynamically.
     //TODO: Add in doc the need to reduce SoapySDR device buffer length (if available) to restore higher fps.
 
+    sampleConverter.setIQSwap(iq_swap.load());
+
     //0. Retreive a new batch 
     SDRThreadIQDataPtr dataOut = buffers.getBuffer();
 
@@ -245,9 +292,19 @@ int SDRThread::readStream(SDRThreadIQDataQueuePtr iqDataOutQueue) {
     //2. attempt readStream() at most nElems, by mtElems-sized chunks, append in dataOut->data directly.
     while (n_read < nElems && !stopping) {
         
+        //If streaming CF32 and there is room for a whole mtElems-size chunk, let SoapySDR write straight into dataOut->data:
+        //a CF32 sample has the same layout as a liquid_float_complex, so only the optional
+        //I/Q swap / DC removal remains to be done, in-place.
+        //Else read into the intermediate buffs[0], to be converted into dataOut and overflowBuffer.
+        bool readDirect = (sampleConverter.getFormat() == IQSampleConverter::FORMAT_CF32) && (nElems - n_read) >= mtElems;
+
+        void *readBuffs[1] = { readDirect ? (void *)&dataOut->data[n_read] : buffs[0] };
+
         //Whatever the number of remaining samples needed to reach nElems,  we always try to read a mtElems-size chunk,
         //from which SoapySDR effectively returns n_stream_read.
-        int n_stream_read = device->readStream(stream, buffs, mtElems, flags, timeNs, timeoutUs);
+        int64_t deviceStart = PipelineMetrics::now();
+        int n_stream_read = device->readStream(stream, readBuffs, mtElems, flags, timeNs, timeoutUs);
+        deviceNanos += PipelineMetrics::now() - deviceStart;
         
         readStreamCode = n_stream_read;
 
@@ -260,89 +317,53 @@ int SDRThread::readStream(SDRThreadIQDataQueuePtr iqDataOutQueue) {
             std::cout << "SDRThread::readStream(): 2. SoapySDR read failed with code: " << n_stream_read << std::endl;
             break;
         }
-        
-        //sucess read beyond nElems, so with overflow:
-        if ((n_read + n_stream_read) > nElems) {
+
+        if (readDirect) {
+            
+            if (!sampleConverter.isIdentity()) {
+                sampleConverter.convert(&dataOut->data[n_read], &dataOut->data[n_read], n_stream_read);
+            }
+            n_read += n_stream_read;
+
+        } else if ((n_read + n_stream_read) > nElems) {
+            //sucess read beyond nElems, so with overflow:
 
             //n_requested is the exact number to reach nElems.
             int n_requested = nElems-n_read;
     
-            //Copy at most n_requested CF32 into .data liquid_float_complex,
-            //starting at n_read position.
-            //inspired from SoapyRTLSDR code, this mysterious void** is indeed an array of CF32(real/imag) samples, indeed an array of 
-            //float with the following layout [sample 1 real part , sample 1 imag part,  sample 2 real part , sample 2 imag part,sample 3 real part , sample 3 imag part,...etc]
-            //Since there is indeed no garantee that sizeof(liquid_float_complex) = 2 * sizeof (float)
-            //nor that the Re/Im layout of fields matches the float array order, assign liquid_float_complex field by field.
-            float *pp = (float *)buffs[0];
+            //Convert at most n_requested samples into .data liquid_float_complex, starting at n_read position.
+            //inspired from SoapyRTLSDR code, this mysterious void** is indeed an array of interleaved (real/imag) samples of the stream format,
+            //with the following layout [sample 1 real part , sample 1 imag part,  sample 2 real part , sample 2 imag part,sample 3 real part , sample 3 imag part,...etc]
+            const char *pp = (const char *)buffs[0];
 
             //safety
             assureBufferMinSize(dataOut.get(), n_read + n_requested);
 
-            if (iq_swap.load()) {
-                for (int i = 0; i < n_requested; i++) {
-                    dataOut->data[n_read + i].imag = pp[2 * i];
-                    dataOut->data[n_read + i].real = pp[2 * i + 1];
-                }
-            } else {
-                for (int i = 0; i < n_requested; i++) {
-                    dataOut->data[n_read + i].real = pp[2 * i];
-                    dataOut->data[n_read + i].imag = pp[2 * i + 1];
-                }
-            }
+            sampleConverter.convert(pp, &dataOut->data[n_read], n_requested);
            
-           //shift of n_requested samples, each one made of 2 floats...
-            pp += n_requested * 2;
+            //shift of n_requested samples, each one made of 2 values...
+            pp += n_requested * IQSampleConverter::getFormatSampleSize(sampleConverter.getFormat());
 
             //numNewOverflow are in exess, they have to be added in the existing overflowBuffer.
             int numNewOverflow = n_stream_read - n_requested;
 
-            //so push the remainder samples to overflowBuffer:
-            if (numNewOverflow > 0) {
-            //	std::cout << "SDRThread::readStream(): 2. SoapySDR read make nElems overflow by " << numNewOverflow << " samples..." << std::endl;
-            }
-
             //safety
             assureBufferMinSize(&overflowBuffer, numOverflow + numNewOverflow);
 
-            if (iq_swap.load()) {
+            //so push the remainder samples to overflowBuffer:
+            sampleConverter.convert(pp, &overflowBuffer.data[numOverflow], numNewOverflow);
 
-                for (int i = 0; i < numNewOverflow; i++) {
-                    overflowBuffer.data[numOverflow + i].imag = pp[2 * i];
-                    overflowBuffer.data[numOverflow + i].real = pp[2 * i + 1];
-                }
-            }
-            else {
-                for (int i = 0; i < numNewOverflow; i++) {
-                    overflowBuffer.data[numOverflow + i].real = pp[2 * i];
-                    overflowBuffer.data[numOverflow + i].imag = pp[2 * i + 1];
-                }
-            }
             numOverflow += numNewOverflow;
            
             n_read += n_requested;
-        } else if (n_stream_read > 0) { // no overflow, read the whole n_stream_read.
-
-            float *pp = (float *)buffs[0];
+        } else { // no overflow, read the whole n_stream_read.
 
             //safety
             assureBufferMinSize(dataOut.get(), n_read + n_stream_read);
 
-            if (iq_swap.load()) {
-                for (int i = 0; i < n_stream_read; i++) {
-                    dataOut->data[n_read + i].imag = pp[2 * i];
-                    dataOut->data[n_read + i].real = pp[2 * i + 1];
-                }
-            }
-            else {
-                for (int i = 0; i < n_stream_read; i++) {
-                    dataOut->data[n_read + i].real = pp[2 * i];
-                    dataOut->data[n_read + i].imag = pp[2 * i + 1];
-                }
-            } 
+            sampleConverter.convert(buffs[0], &dataOut->data[n_read], n_stream_read);
 
             n_read += n_stream_read;
-        } else {
-            break;
         }
     } //end while
     
@@ -354,8 +375,9 @@ int SDRThread::readStream(SDRThreadIQDataQueuePtr iqDataOutQueue) {
 
         dataOut->frequency = frequency.load();
         dataOut->sampleRate = sampleRate.load();
-        dataOut->dcCorrected = hasHardwareDC.load();
+        dataOut->dcCorrected = hasHardwareDC.load() || sampleConverter.getDCRemoval();
         dataOut->numChannels = numChannels.load();
+        dataOut->captureTime = PipelineMetrics::now();
         
         if (!iqDataOutQueue->try_push(dataOut)) {
             //The rest of the system saturates,
@@ -369,11 +391,16 @@ int SDRThread::readStream(SDRThreadIQDataQueuePtr iqDataOutQueue) {
     }
     else {
         readStreamCode = -31;
+        if (n_read > 0 && !stopping) {
+            iqDataOutQueue->add_drop();
+        }
         std::cout << "SDRThread::readStream(): 3.1 iqDataOutQueue output queue is full, discard processing of the batch..." << std::endl;
         //saturation, let a chance to the other threads to consume the existing samples
         std::this_thread::yield();
     }
 
+    busyStats->addBusy(PipelineMetrics::now() - busyStart - deviceNanos);
+
     return readStreamCode;
 }
 
@@ -9,6 +9,8 @@
 #include "DemodulatorMgr.h"
 #include "SDRDeviceInfo.h"
 #include "AppConfig.h"
+#include "IQSampleConverter.h"
+#include "PipelineMetrics.h"
 
 #include <SoapySDR/Version.hpp>
 #include <SoapySDR/Modules.hpp>
@@ -17,22 +19,23 @@
 
 #include <stddef.h>
 
-class SDRThreadIQData {
+//A block of samples as read from the device.
+//It is a DemodulatorThreadIQData so that the block itself can be shared with the
+//visual consumers of the full bandwidth without a copy: once pushed by SDRThread, it is read-only.
+class SDRThreadIQData : public DemodulatorThreadIQData {
 public:
-    long long frequency;
-    long long sampleRate;
     bool dcCorrected;
     int numChannels;
-    std::vector<liquid_float_complex> data;
 
     SDRThreadIQData() :
-            frequency(0), sampleRate(DEFAULT_SAMPLE_RATE), dcCorrected(true), numChannels(0) {
-
+            dcCorrected(true), numChannels(0) {
+        sampleRate = DEFAULT_SAMPLE_RATE;
     }
 
     SDRThreadIQData(long long bandwidth, long long frequency, std::vector<signed char> * /* data */) :
-            frequency(frequency), sampleRate(bandwidth) {
-
+            dcCorrected(true), numChannels(0) {
+        this->frequency = frequency;
+        this->sampleRate = bandwidth;
     }
 
     virtual ~SDRThreadIQData() {
@@ -40,7 +43,7 @@ public:
     }
 };
 typedef std::shared_ptr<SDRThreadIQData> SDRThreadIQDataPtr;
-typedef ThreadBlockingQueue<SDRThreadIQDataPtr> SDRThreadIQDataQueue;
+typedef ThreadQueue<SDRThreadIQDataPtr> SDRThreadIQDataQueue;
 typedef std::shared_ptr<SDRThreadIQDataQueue> SDRThreadIQDataQueuePtr;
 
 class SDRThread : public IOThread {
@@ -109,9 +112,11 @@ protected:
     SoapySDR::Stream *stream = nullptr;
     SoapySDR::Device *device;
     void *buffs[1] = { nullptr };
-    ReBuffer<SDRThreadIQData> buffers;
+    BufferPool<SDRThreadIQData> buffers;
     SDRThreadIQData overflowBuffer;
     int numOverflow;
+    IQSampleConverter sampleConverter;
+    PipelineMetrics::ThreadStats *busyStats;
     std::atomic<DeviceConfig *> deviceConfig;
     std::atomic<SDRDeviceInfo *> deviceInfo;
     
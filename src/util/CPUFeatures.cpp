@@ -0,0 +1,82 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "CPUFeatures.h"
+
+#if CUBICSDR_SIMD_X86 && defined(_MSC_VER)
+#include <intrin.h>
+
+static bool cpuidHas(int leaf, int reg, int bit) {
+    int info[4] = { 0, 0, 0, 0 };
+
+    __cpuid(info, 0);
+    if (info[0] < leaf) {
+        return false;
+    }
+    __cpuidex(info, leaf, 0);
+    return (info[reg] & (1 << bit)) != 0;
+}
+#endif
+
+bool CPUFeatures::hasSSE2() {
+#if CUBICSDR_SIMD_X86
+#if defined(_MSC_VER)
+    // CPUID.1:EDX.SSE2[bit 26]
+    static const bool sse2 = cpuidHas(1, 3, 26);
+#else
+    static const bool sse2 = __builtin_cpu_supports("sse2");
+#endif
+    return sse2;
+#else
+    return false;
+#endif
+}
+
+bool CPUFeatures::hasAVX2() {
+#if CUBICSDR_SIMD_X86
+#if defined(_MSC_VER)
+    // CPUID.7.0:EBX.AVX2[bit 5], CPUID.1:ECX.FMA[bit 12] and CPUID.1:ECX.OSXSAVE[bit 27]
+    // plus the OS saving the YMM registers state:
+    static const bool avx2 = cpuidHas(7, 1, 5) && cpuidHas(1, 2, 12) && cpuidHas(1, 2, 27) && ((_xgetbv(0) & 0x6) == 0x6);
+#else
+    static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+bool CPUFeatures::hasNEON() {
+#if CUBICSDR_SIMD_NEON
+    return true;
+#else
+    return false;
+#endif
+}
+
+CPUFeatures::SIMDLevel CPUFeatures::getSIMDLevel() {
+    if (hasAVX2()) {
+        return SIMD_AVX2;
+    }
+    if (hasSSE2()) {
+        return SIMD_SSE2;
+    }
+    if (hasNEON()) {
+        return SIMD_NEON;
+    }
+    return SIMD_NONE;
+}
+
+const char *CPUFeatures::getSIMDLevelName(SIMDLevel level) {
+    switch (level) {
+        case SIMD_SSE2:
+            return "SSE2";
+        case SIMD_AVX2:
+            return "AVX2";
+        case SIMD_NEON:
+            return "NEON";
+        default:
+            return "none";
+    }
+}
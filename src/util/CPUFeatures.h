@@ -0,0 +1,42 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+//Compile-time detection of the SIMD instruction sets the DSP kernels can be built for:
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define CUBICSDR_SIMD_X86 1
+    #include <immintrin.h>
+    //GCC and Clang need per-function target attributes to emit instructions
+    //beyond the baseline of the build, MSVC does not.
+    #if defined(__GNUC__) || defined(__clang__)
+        #define CUBICSDR_TARGET_SSE2 __attribute__((target("sse2")))
+        #define CUBICSDR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+    #else
+        #define CUBICSDR_TARGET_SSE2
+        #define CUBICSDR_TARGET_AVX2
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+    #define CUBICSDR_SIMD_NEON 1
+    #include <arm_neon.h>
+#endif
+
+/// Runtime detection of the SIMD capabilities of the CPU,
+/// used to pick the best variant of the vectorized DSP kernels once at startup.
+class CPUFeatures {
+public:
+    enum SIMDLevel {
+        SIMD_NONE = 0,
+        SIMD_SSE2 = 1,
+        SIMD_AVX2 = 2,
+        SIMD_NEON = 3
+    };
+
+    static bool hasSSE2();
+    static bool hasAVX2();
+    static bool hasNEON();
+
+    /// Best SIMD level available, AVX2 being preferred over SSE2.
+    static SIMDLevel getSIMDLevel();
+    static const char *getSIMDLevelName(SIMDLevel level);
+};
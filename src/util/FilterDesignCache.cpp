@@ -0,0 +1,209 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "FilterDesignCache.h"
+#include <map>
+#include <list>
+#include <mutex>
+#include <utility>
+#include <iterator>
+
+namespace {
+
+enum DesignType {
+    DESIGN_KAISER_LOWPASS, DESIGN_IIR_PROTOTYPE
+};
+
+//design type then its parameters, compared as is: the same computation gives the same floats.
+typedef std::vector<float> DesignKey;
+
+//ratio, attenuation.
+typedef std::pair<float, float> ResamplerKey;
+
+template <typename T>
+struct ResamplerPool {
+    typedef std::list<std::pair<ResamplerKey, T>> IdleList;
+
+    //every resampler made by the cache and not destroyed yet, busy or idle.
+    std::map<T, ResamplerKey> made;
+    //idle resamplers, least recently released first, and by key.
+    IdleList idleOrder;
+    std::multimap<ResamplerKey, typename IdleList::iterator> idle;
+};
+
+struct Registry {
+    std::mutex lock;
+    std::map<DesignKey, FilterDesignCache::Taps> taps;
+    std::map<DesignKey, FilterDesignCache::IIRCoefficientsPtr> iirs;
+    ResamplerPool<msresamp_crcf> resamplersCRCF;
+    ResamplerPool<msresamp_rrrf> resamplersRRRF;
+};
+
+Registry& getRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+//Designs of key, made by design() outside of the lock if not there yet.
+template <typename T, typename Design>
+std::shared_ptr<const T> getDesign(std::map<DesignKey, std::shared_ptr<const T>>& designs, const DesignKey& key, Design design) {
+    Registry& registry = getRegistry();
+
+    {
+        std::lock_guard<std::mutex> lock(registry.lock);
+
+        auto found = designs.find(key);
+        if (found != designs.end()) {
+            return found->second;
+        }
+    }
+
+    std::shared_ptr<const T> made = design();
+
+    std::lock_guard<std::mutex> lock(registry.lock);
+
+    //designed meanwhile by another thread: keep the first one, so that it is shared.
+    auto inserted = designs.insert(std::make_pair(key, made));
+    if (!inserted.second) {
+        return inserted.first->second;
+    }
+
+    //forget the designs no filter uses anymore.
+    for (auto d = designs.begin(); d != designs.end() && designs.size() > FILTER_DESIGN_CACHE_MAX_DESIGNS; ) {
+        if (d->second.use_count() == 1) {
+            d = designs.erase(d);
+        } else {
+            d++;
+        }
+    }
+
+    return made;
+}
+
+template <typename T>
+T createFromPool(ResamplerPool<T>& pool, float ratio, float attenuation, T (*create)(float, float)) {
+    Registry& registry = getRegistry();
+    ResamplerKey key(ratio, attenuation);
+
+    {
+        std::lock_guard<std::mutex> lock(registry.lock);
+
+        auto found = pool.idle.find(key);
+        if (found != pool.idle.end()) {
+            T resampler = found->second->second;
+            pool.idleOrder.erase(found->second);
+            pool.idle.erase(found);
+            return resampler;
+        }
+    }
+
+    T resampler = create(ratio, attenuation);
+
+    std::lock_guard<std::mutex> lock(registry.lock);
+    pool.made[resampler] = key;
+
+    return resampler;
+}
+
+template <typename T>
+void releaseToPool(ResamplerPool<T>& pool, T resampler, void (*reset)(T), void (*destroy)(T)) {
+    if (resampler == nullptr) {
+        return;
+    }
+
+    Registry& registry = getRegistry();
+    T evicted = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(registry.lock);
+
+        auto made = pool.made.find(resampler);
+
+        if (made == pool.made.end()) {
+            evicted = resampler;
+        } else {
+            //make room by dropping the resampler released the longest ago, likely of a ratio no longer used.
+            if (pool.idle.size() >= FILTER_DESIGN_CACHE_MAX_IDLE_RESAMPLERS) {
+                auto oldest = pool.idleOrder.begin();
+                auto range = pool.idle.equal_range(oldest->first);
+
+                for (auto i = range.first; i != range.second; i++) {
+                    if (i->second == oldest) {
+                        pool.idle.erase(i);
+                        break;
+                    }
+                }
+                evicted = oldest->second;
+                pool.made.erase(evicted);
+                pool.idleOrder.erase(oldest);
+            }
+
+            //as good as new, it is no longer used by anyone.
+            reset(resampler);
+            pool.idleOrder.push_back(std::make_pair(made->second, resampler));
+            pool.idle.insert(std::make_pair(made->second, std::prev(pool.idleOrder.end())));
+        }
+    }
+
+    if (evicted != nullptr) {
+        destroy(evicted);
+    }
+}
+
+} //namespace
+
+FilterDesignCache::Taps FilterDesignCache::getKaiserLowpass(unsigned int numTaps, float cutoff, float attenuation, float mu) {
+    DesignKey key = { (float)DESIGN_KAISER_LOWPASS, (float)numTaps, cutoff, attenuation, mu };
+
+    return getDesign(getRegistry().taps, key, [=]() {
+        std::shared_ptr<std::vector<float>> h = std::make_shared<std::vector<float>>(numTaps);
+        liquid_firdes_kaiser(numTaps, cutoff, attenuation, mu, &(*h)[0]);
+        return Taps(h);
+    });
+}
+
+FilterDesignCache::IIRCoefficientsPtr FilterDesignCache::getIIRPrototype(liquid_iirdes_filtertype filterType, liquid_iirdes_bandtype bandType,
+                                                                         unsigned int order, float cutoff, float center, float passRipple, float attenuation) {
+    DesignKey key = { (float)DESIGN_IIR_PROTOTYPE, (float)filterType, (float)bandType, (float)order, cutoff, center, passRipple, attenuation };
+
+    return getDesign(getRegistry().iirs, key, [=]() {
+        std::shared_ptr<IIRCoefficients> iir = std::make_shared<IIRCoefficients>();
+
+        //as in iirfilt_crcf_create_prototype(): band-pass and band-stop designs double the order.
+        unsigned int n = order;
+        if (bandType == LIQUID_IIRDES_BANDPASS || bandType == LIQUID_IIRDES_BANDSTOP) {
+            n *= 2;
+        }
+        unsigned int r = n % 2;
+        unsigned int L = (n - r) / 2;
+
+        iir->numSections = L + r;
+        iir->b.resize(3 * iir->numSections);
+        iir->a.resize(3 * iir->numSections);
+
+        liquid_iirdes(filterType, bandType, LIQUID_IIRDES_SOS, order, cutoff, center, passRipple, attenuation, &iir->b[0], &iir->a[0]);
+
+        return IIRCoefficientsPtr(iir);
+    });
+}
+
+iirfilt_crcf FilterDesignCache::createIIRFilter(const IIRCoefficientsPtr& coefficients) {
+    //iirfilt only reads the coefficients, but its API takes them mutable.
+    return iirfilt_crcf_create_sos(const_cast<float *>(&coefficients->b[0]), const_cast<float *>(&coefficients->a[0]), coefficients->numSections);
+}
+
+msresamp_crcf FilterDesignCache::createResamplerCRCF(float ratio, float attenuation) {
+    return createFromPool(getRegistry().resamplersCRCF, ratio, attenuation, &msresamp_crcf_create);
+}
+
+msresamp_rrrf FilterDesignCache::createResamplerRRRF(float ratio, float attenuation) {
+    return createFromPool(getRegistry().resamplersRRRF, ratio, attenuation, &msresamp_rrrf_create);
+}
+
+void FilterDesignCache::releaseResampler(msresamp_crcf resampler) {
+    releaseToPool(getRegistry().resamplersCRCF, resampler, &msresamp_crcf_reset, &msresamp_crcf_destroy);
+}
+
+void FilterDesignCache::releaseResampler(msresamp_rrrf resampler) {
+    releaseToPool(getRegistry().resamplersRRRF, resampler, &msresamp_rrrf_reset, &msresamp_rrrf_destroy);
+}
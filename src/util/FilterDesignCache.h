@@ -0,0 +1,49 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "liquid/liquid.h"
+
+//Designs kept past the filters using them, above this count the unused ones are forgotten.
+#define FILTER_DESIGN_CACHE_MAX_DESIGNS 64
+//Released resamplers kept for reuse, above this count the least recently released one is destroyed.
+#define FILTER_DESIGN_CACHE_MAX_IDLE_RESAMPLERS 16
+
+//Process-wide cache of the filter designs of the demodulators, so that rebuilding a modem kit
+//or resampler for a bandwidth, sample rate or demodulator type already seen does not redesign it:
+//- designed coefficients are shared by every filter built from the same parameters,
+//- msresamp objects, which liquid only builds from their ratio, are recycled: a released one
+//  is reset and handed out again to the next request for the same ratio and attenuation.
+//All the functions can be called from any thread; designs run outside of the lock.
+class FilterDesignCache {
+public:
+    typedef std::shared_ptr<const std::vector<float>> Taps;
+
+    //Second order sections of an IIR design, 3 coefficients per section in each of b and a.
+    struct IIRCoefficients {
+        std::vector<float> b, a;
+        unsigned int numSections;
+    };
+    typedef std::shared_ptr<const IIRCoefficients> IIRCoefficientsPtr;
+
+    //liquid_firdes_kaiser() taps.
+    static Taps getKaiserLowpass(unsigned int numTaps, float cutoff, float attenuation, float mu);
+
+    //liquid_iirdes() in second order sections, as iirfilt_crcf_create_prototype() designs them.
+    static IIRCoefficientsPtr getIIRPrototype(liquid_iirdes_filtertype filterType, liquid_iirdes_bandtype bandType,
+                                              unsigned int order, float cutoff, float center, float passRipple, float attenuation);
+
+    static iirfilt_crcf createIIRFilter(const IIRCoefficientsPtr& coefficients);
+
+    //msresamp_crcf_create() / msresamp_rrrf_create() equivalents, to give back with releaseResampler()
+    //instead of destroying them.
+    static msresamp_crcf createResamplerCRCF(float ratio, float attenuation);
+    static msresamp_rrrf createResamplerRRRF(float ratio, float attenuation);
+
+    //Keep the resampler for reuse, or destroy it. Resamplers not made by the cache are destroyed.
+    static void releaseResampler(msresamp_crcf resampler);
+    static void releaseResampler(msresamp_rrrf resampler);
+};
@@ -9,7 +9,9 @@
 #include <OpenGL/OpenGL.h>
 #endif
 
-#if defined(__linux__) || defined(__FreeBSD__)
+#include <cstdio>
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
 #include <dlfcn.h>
 #endif
 
@@ -19,13 +21,134 @@ PFNWGLGETEXTENSIONSSTRINGEXTPROC wglGetExtensionsStringEXT = NULL;
 PFNWGLSWAPINTERVALEXTPROC wglSwapIntervalEXT = NULL;
 PFNWGLGETSWAPINTERVALEXTPROC wglGetSwapIntervalEXT = NULL;
 
+#endif
+
 bool GLExtSupported(const char *extension_name) {
     const GLubyte *extensions = glGetString(GL_EXTENSIONS);
 
-    return (std::strstr((const char *)extensions, extension_name) != NULL);
+    return (extensions != NULL) && (std::strstr((const char *)extensions, extension_name) != NULL);
 }
 
+GLExtGenBuffersProc glExtGenBuffers = NULL;
+GLExtDeleteBuffersProc glExtDeleteBuffers = NULL;
+GLExtBindBufferProc glExtBindBuffer = NULL;
+GLExtBufferDataProc glExtBufferData = NULL;
+GLExtBufferSubDataProc glExtBufferSubData = NULL;
+GLExtBufferStorageProc glExtBufferStorage = NULL;
+GLExtMapBufferRangeProc glExtMapBufferRange = NULL;
+GLExtUnmapBufferProc glExtUnmapBuffer = NULL;
+GLExtFenceSyncProc glExtFenceSync = NULL;
+GLExtClientWaitSyncProc glExtClientWaitSync = NULL;
+GLExtDeleteSyncProc glExtDeleteSync = NULL;
+GLExtActiveTextureProc glExtActiveTexture = NULL;
+GLExtCreateShaderProc glExtCreateShader = NULL;
+GLExtShaderSourceProc glExtShaderSource = NULL;
+GLExtCompileShaderProc glExtCompileShader = NULL;
+GLExtGetShaderivProc glExtGetShaderiv = NULL;
+GLExtDeleteShaderProc glExtDeleteShader = NULL;
+GLExtCreateProgramProc glExtCreateProgram = NULL;
+GLExtAttachShaderProc glExtAttachShader = NULL;
+GLExtLinkProgramProc glExtLinkProgram = NULL;
+GLExtGetProgramivProc glExtGetProgramiv = NULL;
+GLExtUseProgramProc glExtUseProgram = NULL;
+GLExtDeleteProgramProc glExtDeleteProgram = NULL;
+GLExtGetUniformLocationProc glExtGetUniformLocation = NULL;
+GLExtUniform1iProc glExtUniform1i = NULL;
+
+static bool GLExt_vertexBuffers = false;
+static bool GLExt_pixelBuffers = false;
+static bool GLExt_bufferStorage = false;
+static bool GLExt_shaders = false;
+
+static void *getGLProc(const char *name) {
+#ifdef _WIN32
+    void *proc = (void *) wglGetProcAddress(name);
+
+    //some drivers return small values instead of NULL on failure.
+    if ((size_t) proc <= 3 || proc == (void *) -1) {
+        return NULL;
+    }
+    return proc;
+#else
+    return dlsym(RTLD_DEFAULT, name);
 #endif
+}
+
+//as major * 10 + minor.
+static int getGLVersion() {
+    const char *version = (const char *) glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+
+    if (version == NULL || sscanf(version, "%d.%d", &major, &minor) < 2) {
+        return 0;
+    }
+    return major * 10 + minor;
+}
+
+static void initGLProcs() {
+    glExtGenBuffers = (GLExtGenBuffersProc) getGLProc("glGenBuffers");
+    glExtDeleteBuffers = (GLExtDeleteBuffersProc) getGLProc("glDeleteBuffers");
+    glExtBindBuffer = (GLExtBindBufferProc) getGLProc("glBindBuffer");
+    glExtBufferData = (GLExtBufferDataProc) getGLProc("glBufferData");
+    glExtBufferSubData = (GLExtBufferSubDataProc) getGLProc("glBufferSubData");
+    glExtBufferStorage = (GLExtBufferStorageProc) getGLProc("glBufferStorage");
+    glExtMapBufferRange = (GLExtMapBufferRangeProc) getGLProc("glMapBufferRange");
+    glExtUnmapBuffer = (GLExtUnmapBufferProc) getGLProc("glUnmapBuffer");
+    glExtFenceSync = (GLExtFenceSyncProc) getGLProc("glFenceSync");
+    glExtClientWaitSync = (GLExtClientWaitSyncProc) getGLProc("glClientWaitSync");
+    glExtDeleteSync = (GLExtDeleteSyncProc) getGLProc("glDeleteSync");
+    glExtActiveTexture = (GLExtActiveTextureProc) getGLProc("glActiveTexture");
+    glExtCreateShader = (GLExtCreateShaderProc) getGLProc("glCreateShader");
+    glExtShaderSource = (GLExtShaderSourceProc) getGLProc("glShaderSource");
+    glExtCompileShader = (GLExtCompileShaderProc) getGLProc("glCompileShader");
+    glExtGetShaderiv = (GLExtGetShaderivProc) getGLProc("glGetShaderiv");
+    glExtDeleteShader = (GLExtDeleteShaderProc) getGLProc("glDeleteShader");
+    glExtCreateProgram = (GLExtCreateProgramProc) getGLProc("glCreateProgram");
+    glExtAttachShader = (GLExtAttachShaderProc) getGLProc("glAttachShader");
+    glExtLinkProgram = (GLExtLinkProgramProc) getGLProc("glLinkProgram");
+    glExtGetProgramiv = (GLExtGetProgramivProc) getGLProc("glGetProgramiv");
+    glExtUseProgram = (GLExtUseProgramProc) getGLProc("glUseProgram");
+    glExtDeleteProgram = (GLExtDeleteProgramProc) getGLProc("glDeleteProgram");
+    glExtGetUniformLocation = (GLExtGetUniformLocationProc) getGLProc("glGetUniformLocation");
+    glExtUniform1i = (GLExtUniform1iProc) getGLProc("glUniform1i");
+
+    int version = getGLVersion();
+
+    GLExt_vertexBuffers = (version >= 15 || GLExtSupported("GL_ARB_vertex_buffer_object"))
+        && glExtGenBuffers && glExtDeleteBuffers && glExtBindBuffer && glExtBufferData && glExtBufferSubData;
+
+    GLExt_pixelBuffers = (version >= 30 || (GLExtSupported("GL_ARB_pixel_buffer_object") && GLExtSupported("GL_ARB_map_buffer_range")))
+        && glExtGenBuffers && glExtDeleteBuffers && glExtBindBuffer && glExtBufferData && glExtMapBufferRange && glExtUnmapBuffer;
+
+    GLExt_bufferStorage = GLExt_pixelBuffers
+        && (version >= 44 || GLExtSupported("GL_ARB_buffer_storage"))
+        && (version >= 32 || GLExtSupported("GL_ARB_sync"))
+        && glExtBufferStorage && glExtFenceSync && glExtClientWaitSync && glExtDeleteSync;
+
+    GLExt_shaders = (version >= 20)
+        && glExtActiveTexture && glExtCreateShader && glExtShaderSource && glExtCompileShader && glExtGetShaderiv && glExtDeleteShader
+        && glExtCreateProgram && glExtAttachShader && glExtLinkProgram && glExtGetProgramiv && glExtUseProgram && glExtDeleteProgram
+        && glExtGetUniformLocation && glExtUniform1i;
+
+    std::cout << "OpenGL " << (const char *) glGetString(GL_VERSION) << ", vertex buffers: " << (GLExt_vertexBuffers ? "Yes" : "No") << ", pixel buffers: " << (GLExt_pixelBuffers ? "Yes" : "No")
+              << ", persistent mapping: " << (GLExt_bufferStorage ? "Yes" : "No") << ", shaders: " << (GLExt_shaders ? "Yes" : "No") << std::endl;
+}
+
+bool GLExtHasVertexBuffers() {
+    return GLExt_vertexBuffers;
+}
+
+bool GLExtHasPixelBuffers() {
+    return GLExt_pixelBuffers;
+}
+
+bool GLExtHasBufferStorage() {
+    return GLExt_bufferStorage;
+}
+
+bool GLExtHasShaders() {
+    return GLExt_shaders;
+}
 
 
 bool GLExt_initialized = false;
@@ -100,5 +223,7 @@ void initGLExtensions() {
     }
 #endif
 
+    initGLProcs();
+
     GLExt_initialized = true;
 }
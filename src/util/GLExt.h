@@ -4,6 +4,8 @@
 #pragma once
 
 #include "wx/glcanvas.h"
+#include <cstdint>
+#include <cstddef>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -17,11 +19,134 @@ extern PFNWGLGETEXTENSIONSSTRINGEXTPROC _wglGetExtensionsStringEXT;
 extern PFNWGLSWAPINTERVALEXTPROC       wglSwapIntervalEXT;
 extern PFNWGLGETSWAPINTERVALEXTPROC    wglGetSwapIntervalEXT;
 
-bool GLExtSupported(const char *extension_name);
-
 #endif
 
+bool GLExtSupported(const char *extension_name);
+
 extern bool GLExt_initialized;
 
 void initGLExtensions();
 
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+//Entry points beyond OpenGL 1.1, resolved by initGLExtensions() once a context is current,
+//nullptr if the driver has none. Prefixed not to clash with the prototypes of the system headers.
+typedef void (APIENTRY *GLExtGenBuffersProc)(GLsizei n, GLuint *buffers);
+typedef void (APIENTRY *GLExtDeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+typedef void (APIENTRY *GLExtBindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *GLExtBufferDataProc)(GLenum target, ptrdiff_t size, const void *data, GLenum usage);
+typedef void (APIENTRY *GLExtBufferSubDataProc)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const void *data);
+typedef void (APIENTRY *GLExtBufferStorageProc)(GLenum target, ptrdiff_t size, const void *data, GLbitfield flags);
+typedef void *(APIENTRY *GLExtMapBufferRangeProc)(GLenum target, ptrdiff_t offset, ptrdiff_t length, GLbitfield access);
+typedef GLboolean (APIENTRY *GLExtUnmapBufferProc)(GLenum target);
+typedef void *(APIENTRY *GLExtFenceSyncProc)(GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRY *GLExtClientWaitSyncProc)(void *sync, GLbitfield flags, uint64_t timeout);
+typedef void (APIENTRY *GLExtDeleteSyncProc)(void *sync);
+typedef void (APIENTRY *GLExtActiveTextureProc)(GLenum texture);
+typedef GLuint (APIENTRY *GLExtCreateShaderProc)(GLenum type);
+typedef void (APIENTRY *GLExtShaderSourceProc)(GLuint shader, GLsizei count, const char *const *string, const GLint *length);
+typedef void (APIENTRY *GLExtCompileShaderProc)(GLuint shader);
+typedef void (APIENTRY *GLExtGetShaderivProc)(GLuint shader, GLenum pname, GLint *params);
+typedef void (APIENTRY *GLExtDeleteShaderProc)(GLuint shader);
+typedef GLuint (APIENTRY *GLExtCreateProgramProc)();
+typedef void (APIENTRY *GLExtAttachShaderProc)(GLuint program, GLuint shader);
+typedef void (APIENTRY *GLExtLinkProgramProc)(GLuint program);
+typedef void (APIENTRY *GLExtGetProgramivProc)(GLuint program, GLenum pname, GLint *params);
+typedef void (APIENTRY *GLExtUseProgramProc)(GLuint program);
+typedef void (APIENTRY *GLExtDeleteProgramProc)(GLuint program);
+typedef GLint (APIENTRY *GLExtGetUniformLocationProc)(GLuint program, const char *name);
+typedef void (APIENTRY *GLExtUniform1iProc)(GLint location, GLint v0);
+
+extern GLExtGenBuffersProc glExtGenBuffers;
+extern GLExtDeleteBuffersProc glExtDeleteBuffers;
+extern GLExtBindBufferProc glExtBindBuffer;
+extern GLExtBufferDataProc glExtBufferData;
+extern GLExtBufferSubDataProc glExtBufferSubData;
+extern GLExtBufferStorageProc glExtBufferStorage;
+extern GLExtMapBufferRangeProc glExtMapBufferRange;
+extern GLExtUnmapBufferProc glExtUnmapBuffer;
+extern GLExtFenceSyncProc glExtFenceSync;
+extern GLExtClientWaitSyncProc glExtClientWaitSync;
+extern GLExtDeleteSyncProc glExtDeleteSync;
+extern GLExtActiveTextureProc glExtActiveTexture;
+extern GLExtCreateShaderProc glExtCreateShader;
+extern GLExtShaderSourceProc glExtShaderSource;
+extern GLExtCompileShaderProc glExtCompileShader;
+extern GLExtGetShaderivProc glExtGetShaderiv;
+extern GLExtDeleteShaderProc glExtDeleteShader;
+extern GLExtCreateProgramProc glExtCreateProgram;
+extern GLExtAttachShaderProc glExtAttachShader;
+extern GLExtLinkProgramProc glExtLinkProgram;
+extern GLExtGetProgramivProc glExtGetProgramiv;
+extern GLExtUseProgramProc glExtUseProgram;
+extern GLExtDeleteProgramProc glExtDeleteProgram;
+extern GLExtGetUniformLocationProc glExtGetUniformLocation;
+extern GLExtUniform1iProc glExtUniform1i;
+
+//Vertex buffer objects (GL 1.5).
+bool GLExtHasVertexBuffers();
+//Pixel unpack buffers with mapped ranges (GL 3.0).
+bool GLExtHasPixelBuffers();
+//Persistently mapped buffers and fences (GL 4.4 or ARB_buffer_storage + ARB_sync).
+bool GLExtHasBufferStorage();
+//GLSL fragment shaders and multi-texturing (GL 2.0).
+bool GLExtHasShaders();
+
+//Tokens of the above, for the headers without them.
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED 0x911D
+#endif
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0 0x84C0
+#endif
+#ifndef GL_TEXTURE1
+#define GL_TEXTURE1 0x84C1
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: GPL-2.0+
 
 #include "GLFont.h"
+#include "GLExt.h"
 
 #include <wx/string.h>
 
@@ -21,6 +22,9 @@
 #define GC_DRAW_COUNT_PERIOD 50
 #define GC_DRAW_COUNT_LIMIT 10
 
+//x, y, u, v, r, g, b, a
+#define GLFONT_BATCH_VERTEX_FLOATS 8
+
 GLFontStringCache::GLFontStringCache() {
     gc = 0;
 }
@@ -48,6 +52,8 @@ GLFont GLFont::fonts[GLFont::GLFontSize::GLFONT_SIZE_MAX] = {
 
 std::atomic<GLFont::GLFontScale> GLFont::currentScale{ GLFont::GLFontScale::GLFONT_SCALE_NORMAL };
 
+const void *GLFont::batchOwner = nullptr;
+
 
 GLFontChar::GLFontChar() :
         id(0), x(0), y(0), width(0), height(0), xoffset(0), yoffset(0), xadvance(0), aspect(1), index(0) {
@@ -551,10 +557,23 @@ void GLFont::drawString(const std::wstring& str, int pxHeight, float xpos, float
             stringCache[cacheIdx] = fc;
         }
 
-        drawCacheString(fc, xpos, ypos, hAlign, vAlign);
+        if (batchOwner) {
+            batchCacheString(fc, xpos, ypos, hAlign, vAlign);
+        } else {
+            drawCacheString(fc, xpos, ypos, hAlign, vAlign);
+        }
         
         return;
     }
+
+    if (batchOwner) {
+        GLFontStringCache *fc = cacheString(str, pxHeight, vpx, vpy);
+
+        batchCacheString(fc, xpos, ypos, hAlign, vAlign);
+        delete fc;
+
+        return;
+    }
     
     float size = (float) pxHeight / (float) vpy;
     float viewAspect = (float) vpx / (float) vpy;
@@ -698,6 +717,109 @@ void GLFont::drawCacheString(GLFontStringCache *fc, float xpos, float ypos, Alig
     glDisable(GL_TEXTURE_2D);
 }
 
+// Queue cached GLFontCacheString
+void GLFont::batchCacheString(GLFontStringCache *fc, float xpos, float ypos, Align hAlign, Align vAlign) {
+
+    float size = (float) fc->pxHeight / (float) fc->vpy;
+
+    switch (vAlign) {
+        case GLFONT_ALIGN_TOP:
+            ypos -= size;
+            break;
+        case GLFONT_ALIGN_CENTER:
+            ypos -= size/2.0;
+            break;
+        default:
+            break;
+    }
+
+    switch (hAlign) {
+        case GLFONT_ALIGN_RIGHT:
+            xpos -= fc->msgWidth;
+            break;
+        case GLFONT_ALIGN_CENTER:
+            xpos -= fc->msgWidth / 2.0;
+            break;
+        default:
+            break;
+    }
+
+    GLfloat mv[16], color[4];
+
+    glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+    glGetFloatv(GL_CURRENT_COLOR, color);
+
+    size_t numVertices = 4 * fc->drawlen;
+    size_t v = batchVertices.size();
+
+    batchVertices.resize(v + numVertices * GLFONT_BATCH_VERTEX_FLOATS);
+
+    //the panels and contexts only use 2D affine transforms.
+    for (size_t i = 0; i < numVertices; i++) {
+        float x = fc->gl_vertices[i * 2] + xpos;
+        float y = fc->gl_vertices[i * 2 + 1] + ypos;
+
+        batchVertices[v++] = mv[0] * x + mv[4] * y + mv[12];
+        batchVertices[v++] = mv[1] * x + mv[5] * y + mv[13];
+        batchVertices[v++] = fc->gl_uv[i * 2];
+        batchVertices[v++] = fc->gl_uv[i * 2 + 1];
+        batchVertices[v++] = color[0];
+        batchVertices[v++] = color[1];
+        batchVertices[v++] = color[2];
+        batchVertices[v++] = color[3];
+    }
+}
+
+// Draw the queued strings of owner
+void GLFont::drawBatch(const void *owner) {
+
+    if (batchVertices.empty()) {
+        return;
+    }
+
+    GLsizei numVertices = batchVertices.size() / GLFONT_BATCH_VERTEX_FLOATS;
+    GLsizei stride = GLFONT_BATCH_VERTEX_FLOATS * sizeof(float);
+    const char *base = (const char *) &batchVertices[0];
+
+    glBindTexture(GL_TEXTURE_2D, texId);
+
+    if (GLExtHasVertexBuffers()) {
+        BatchBuffer& batch = batchBuffers[owner];
+
+        if (!batch.buffer) {
+            glExtGenBuffers(1, &batch.buffer);
+        }
+
+        glExtBindBuffer(GL_ARRAY_BUFFER, batch.buffer);
+
+        //same text at the same places as the last frame: nothing to upload.
+        if (batchVertices != batch.vertices) {
+            size_t size = batchVertices.size() * sizeof(float);
+
+            if (size > batch.capacity) {
+                glExtBufferData(GL_ARRAY_BUFFER, size, &batchVertices[0], GL_STREAM_DRAW);
+                batch.capacity = size;
+            } else {
+                glExtBufferSubData(GL_ARRAY_BUFFER, 0, size, &batchVertices[0]);
+            }
+            batch.vertices.swap(batchVertices);
+        }
+        base = nullptr;
+    }
+
+    glVertexPointer(2, GL_FLOAT, stride, base);
+    glTexCoordPointer(2, GL_FLOAT, stride, base + 2 * sizeof(float));
+    glColorPointer(4, GL_FLOAT, stride, base + 4 * sizeof(float));
+
+    glDrawArrays(GL_QUADS, 0, numVertices);
+
+    if (GLExtHasVertexBuffers()) {
+        glExtBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    batchVertices.clear();
+}
+
 // Compile optimized GLFontCacheString
 GLFontStringCache *GLFont::cacheString(const std::wstring& str, int pxHeight, int vpx, int vpy) {
 
@@ -816,6 +938,60 @@ void GLFont::clearAllCaches() {
 }
 
 
+void GLFont::beginBatch(const void *owner) {
+
+    if (batchOwner) {
+        flushBatch();
+    }
+
+    batchOwner = owner;
+}
+
+void GLFont::flushBatch() {
+
+    if (!batchOwner) {
+        return;
+    }
+
+    //the color arrays leave the current color undefined.
+    glPushAttrib(GL_CURRENT_BIT);
+
+    //the vertices are already transformed.
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glEnable(GL_TEXTURE_2D);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    for (int i = 0; i < GLFont::GLFONT_SIZE_MAX; i++) {
+
+        fonts[i].drawBatch(batchOwner);
+    }
+
+    glVertexPointer(2, GL_FLOAT, 0, nullptr);
+    glTexCoordPointer(2, GL_FLOAT, 0, nullptr);
+    glColorPointer(4, GL_FLOAT, 0, nullptr);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+
+    glPopMatrix();
+    glPopAttrib();
+
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+
+    batchOwner = nullptr;
+}
+
 GLFont::Drawer GLFont::getFont(int requestedSize, double scaleFactor) {
 
     return GLFont::Drawer(requestedSize, scaleFactor);
@@ -118,6 +118,13 @@ public:
     //Return a valid font px height given the font size and scale factor
     static int getScaledPx(int basicFontSize, double scaleFactor);
 
+    //Between beginBatch() and flushBatch(), the strings drawn are only queued, transformed by the current
+    //modelview matrix and with the current color, to be drawn on flushBatch() with one glDrawArrays per font
+    //in a vertex buffer of owner (e.g. the GL context of a canvas), only uploaded again when the text changed.
+    //The text is thus drawn over the rest of the frame.
+    static void beginBatch(const void *owner);
+    static void flushBatch();
+
    
 private:
 
@@ -142,6 +149,10 @@ private:
     GLFontStringCache *cacheString(const std::wstring& str, int pxHeight, int vpx, int vpy);
     void drawCacheString(GLFontStringCache *fc, float xpos, float ypos, Align hAlign, Align vAlign);
 
+    //queue fc into batchVertices instead of drawing it.
+    void batchCacheString(GLFontStringCache *fc, float xpos, float ypos, Align hAlign, Align vAlign);
+    void drawBatch(const void *owner);
+
     void doCacheGC();
     void clearCache();
 
@@ -177,6 +188,21 @@ private:
     int gcCounter;
     SpinMutex cache_busy;
 
+    //vertices of the queued strings, interleaved as x, y, u, v, r, g, b, a.
+    std::vector<float> batchVertices;
+
+    struct BatchBuffer {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        //as last uploaded into buffer.
+        std::vector<float> vertices;
+    };
+
+    std::map<const void *, BatchBuffer> batchBuffers;
+
+    //owner of the current batch, nullptr if not batching.
+    static const void *batchOwner;
+
 public:
 
     //Proxy class computing and caching the selection of the underlying fonts
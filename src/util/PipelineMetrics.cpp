@@ -0,0 +1,278 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "PipelineMetrics.h"
+#include <map>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+namespace {
+
+struct Registry {
+    std::mutex lock;
+    std::map<std::string, std::unique_ptr<PipelineMetrics::ThreadStats>> threads;
+    std::map<std::string, std::unique_ptr<PipelineMetrics::LatencyStats>> latencies;
+    std::vector<std::pair<std::string, std::weak_ptr<ThreadQueueBase>>> queues;
+    int64_t resetTime;
+
+    Registry() : resetTime(PipelineMetrics::now()) {
+    }
+};
+
+Registry& getRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+} //namespace
+
+int64_t PipelineMetrics::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PipelineMetrics::ThreadStats::ThreadStats(const std::string& name) : name(name) {
+    busyNanos.store(0);
+    blocks.store(0);
+}
+
+void PipelineMetrics::ThreadStats::addBusy(int64_t nanos) {
+    busyNanos.fetch_add(nanos, std::memory_order_relaxed);
+    blocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+PipelineMetrics::LatencyStats::LatencyStats(const std::string& name) : name(name) {
+    count.store(0);
+    totalNanos.store(0);
+    maxNanos.store(0);
+    lastNanos.store(0);
+}
+
+void PipelineMetrics::LatencyStats::record(int64_t captureTime) {
+    if (captureTime == 0) {
+        return;
+    }
+
+    int64_t latency = now() - captureTime;
+
+    count.fetch_add(1, std::memory_order_relaxed);
+    totalNanos.fetch_add(latency, std::memory_order_relaxed);
+    lastNanos.store(latency, std::memory_order_relaxed);
+
+    int64_t highest = maxNanos.load(std::memory_order_relaxed);
+
+    while (latency > highest && !maxNanos.compare_exchange_weak(highest, latency, std::memory_order_relaxed)) {
+        //retry
+    }
+}
+
+PipelineMetrics::ThreadStats *PipelineMetrics::getThreadStats(const std::string& name) {
+    Registry& registry = getRegistry();
+    std::lock_guard < std::mutex > lock(registry.lock);
+
+    std::unique_ptr<ThreadStats>& stats = registry.threads[name];
+    if (!stats) {
+        stats.reset(new ThreadStats(name));
+    }
+    return stats.get();
+}
+
+PipelineMetrics::LatencyStats *PipelineMetrics::getLatencyStats(const std::string& name) {
+    Registry& registry = getRegistry();
+    std::lock_guard < std::mutex > lock(registry.lock);
+
+    std::unique_ptr<LatencyStats>& stats = registry.latencies[name];
+    if (!stats) {
+        stats.reset(new LatencyStats(name));
+    }
+    return stats.get();
+}
+
+void PipelineMetrics::registerQueue(const std::string& name, ThreadQueueBasePtr queue) {
+    Registry& registry = getRegistry();
+    std::lock_guard < std::mutex > lock(registry.lock);
+
+    //forget the dead queues here too, so that the list stays bounded by the live ones
+    //while the demodulators come and go with no snapshot taken.
+    registry.queues.erase(std::remove_if(registry.queues.begin(), registry.queues.end(),
+        [](const std::pair<std::string, std::weak_ptr<ThreadQueueBase>>& entry) {
+            return entry.second.expired();
+        }), registry.queues.end());
+
+    registry.queues.push_back(std::make_pair(name, std::weak_ptr<ThreadQueueBase>(queue)));
+}
+
+PipelineMetrics::Snapshot PipelineMetrics::getSnapshot() {
+    Registry& registry = getRegistry();
+    std::lock_guard < std::mutex > lock(registry.lock);
+
+    Snapshot snapshot;
+    snapshot.time = now();
+
+    for (auto& entry : registry.threads) {
+        ThreadSample sample;
+        sample.name = entry.first;
+        sample.busyNanos = entry.second->busyNanos.load();
+        sample.blocks = entry.second->blocks.load();
+        snapshot.threads.push_back(sample);
+    }
+
+    //aggregate the live queues by name, forget the dead ones.
+    std::map<std::string, QueueSample> queues;
+
+    for (auto it = registry.queues.begin(); it != registry.queues.end();) {
+        ThreadQueueBasePtr queue = it->second.lock();
+
+        if (!queue) {
+            it = registry.queues.erase(it);
+            continue;
+        }
+
+        QueueSample& sample = queues[it->first];
+        if (sample.name.empty()) {
+            sample.name = it->first;
+            sample.instances = sample.numItems = sample.maxNumItems = 0;
+            sample.drops = 0;
+        }
+        sample.instances++;
+        sample.numItems += queue->get_num_items();
+        sample.maxNumItems += queue->get_max_num_items();
+        sample.drops += queue->get_drop_count();
+        it++;
+    }
+
+    for (auto& entry : queues) {
+        snapshot.queues.push_back(entry.second);
+    }
+
+    for (auto& entry : registry.latencies) {
+        LatencySample sample;
+        sample.name = entry.first;
+        sample.count = entry.second->count.load();
+        sample.totalNanos = entry.second->totalNanos.load();
+        sample.maxNanos = entry.second->maxNanos.load();
+        sample.lastNanos = entry.second->lastNanos.load();
+        snapshot.latencies.push_back(sample);
+    }
+
+    return snapshot;
+}
+
+void PipelineMetrics::report(std::ostream& out, const Snapshot& current, const Snapshot *previous) {
+    int64_t since;
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard < std::mutex > lock(registry.lock);
+        since = registry.resetTime;
+    }
+
+    //counters taken as 0 at 'since' when there is no previous snapshot.
+    if (previous != nullptr) {
+        since = previous->time;
+    }
+
+    double seconds = std::max(double(current.time - since) * 1e-9, 1e-9);
+
+    out << std::fixed << std::setprecision(1);
+    out << "Over the last " << seconds << " s:" << std::endl << std::endl;
+
+    out << std::left << std::setw(32) << "Thread" << std::right << std::setw(10) << "busy %" << std::setw(12) << "blocks/s"
+        << std::setw(14) << "us/block" << std::endl;
+
+    for (const ThreadSample& sample : current.threads) {
+        int64_t busy = sample.busyNanos;
+        uint64_t blocks = sample.blocks;
+
+        if (previous != nullptr) {
+            for (const ThreadSample& prev : previous->threads) {
+                //unless reset in between:
+                if (prev.name == sample.name && sample.blocks >= prev.blocks) {
+                    busy -= prev.busyNanos;
+                    blocks -= prev.blocks;
+                    break;
+                }
+            }
+        }
+
+        out << std::left << std::setw(32) << sample.name << std::right
+            << std::setw(10) << (double(busy) * 1e-9 * 100.0 / seconds)
+            << std::setw(12) << (double(blocks) / seconds)
+            << std::setw(14) << ((blocks > 0) ? (double(busy) * 1e-3 / double(blocks)) : 0.0) << std::endl;
+    }
+
+    out << std::endl << std::left << std::setw(32) << "Queue" << std::right << std::setw(10) << "count" << std::setw(12) << "items"
+        << std::setw(14) << "max items" << std::setw(10) << "drops" << std::setw(12) << "drops/s" << std::endl;
+
+    for (const QueueSample& sample : current.queues) {
+        uint64_t drops = sample.drops;
+
+        if (previous != nullptr) {
+            for (const QueueSample& prev : previous->queues) {
+                if (prev.name == sample.name) {
+                    drops = (sample.drops >= prev.drops) ? (sample.drops - prev.drops) : sample.drops;
+                    break;
+                }
+            }
+        }
+
+        out << std::left << std::setw(32) << sample.name << std::right
+            << std::setw(10) << sample.instances
+            << std::setw(12) << sample.numItems
+            << std::setw(14) << sample.maxNumItems
+            << std::setw(10) << sample.drops
+            << std::setw(12) << (double(drops) / seconds) << std::endl;
+    }
+
+    out << std::endl << std::left << std::setw(32) << "Latency since capture" << std::right << std::setw(10) << "last ms"
+        << std::setw(12) << "avg ms" << std::setw(14) << "max ms" << std::setw(10) << "blocks" << std::endl;
+
+    for (const LatencySample& sample : current.latencies) {
+        out << std::left << std::setw(32) << sample.name << std::right
+            << std::setw(10) << (double(sample.lastNanos) * 1e-6)
+            << std::setw(12) << ((sample.count > 0) ? (double(sample.totalNanos) * 1e-6 / double(sample.count)) : 0.0)
+            << std::setw(14) << (double(sample.maxNanos) * 1e-6)
+            << std::setw(10) << sample.count << std::endl;
+    }
+}
+
+bool PipelineMetrics::dumpToFile(const std::string& fileName) {
+    std::ofstream out(fileName.c_str());
+
+    if (!out) {
+        std::cout << "PipelineMetrics: cannot write '" << fileName << "'" << std::endl;
+        return false;
+    }
+
+    report(out, getSnapshot(), nullptr);
+
+    return out.good();
+}
+
+void PipelineMetrics::reset() {
+    Registry& registry = getRegistry();
+    std::lock_guard < std::mutex > lock(registry.lock);
+
+    for (auto& entry : registry.threads) {
+        entry.second->busyNanos.store(0);
+        entry.second->blocks.store(0);
+    }
+
+    for (auto& entry : registry.latencies) {
+        entry.second->count.store(0);
+        entry.second->totalNanos.store(0);
+        entry.second->maxNanos.store(0);
+        entry.second->lastNanos.store(0);
+    }
+
+    for (auto& entry : registry.queues) {
+        ThreadQueueBasePtr queue = entry.second.lock();
+        if (queue) {
+            queue->reset_drop_count();
+        }
+    }
+
+    registry.resetTime = now();
+}
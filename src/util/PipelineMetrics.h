@@ -0,0 +1,104 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include "ThreadBlockingQueue.h"
+
+//Registry of the pipeline counters, from SDRThread to the audio output and the visual processors:
+//- busy time of each processing thread (stage), summed over the instances of a stage,
+//- depth and drop count of each registered queue, summed over the queues of the same name,
+//- latency of the sample blocks at each stage since they were read from the device,
+//  using the captureTime the blocks carry along.
+//Stats are created on their first use by name and never destroyed, so the threads can keep
+//a pointer on them, and only update them with relaxed atomics.
+class PipelineMetrics {
+public:
+    //steady clock time, in nanoseconds, time base of the captureTime carried by the blocks.
+    static int64_t now();
+
+    class ThreadStats {
+    public:
+        ThreadStats(const std::string& name);
+
+        void addBusy(int64_t nanos);
+
+        std::string name;
+        std::atomic<int64_t> busyNanos;
+        std::atomic<uint64_t> blocks;
+    };
+
+    class LatencyStats {
+    public:
+        LatencyStats(const std::string& name);
+
+        //record the latency of a block read from the device at captureTime, ignored if 0 (unknown).
+        void record(int64_t captureTime);
+
+        std::string name;
+        std::atomic<uint64_t> count;
+        std::atomic<int64_t> totalNanos, maxNanos, lastNanos;
+    };
+
+    //Counts the time from construction to destruction as one busy block of stats.
+    class BusyScope {
+    public:
+        BusyScope(ThreadStats *stats) : stats(stats), start(now()) {
+        }
+
+        ~BusyScope() {
+            stats->addBusy(now() - start);
+        }
+
+    private:
+        ThreadStats *stats;
+        int64_t start;
+    };
+
+    static ThreadStats *getThreadStats(const std::string& name);
+    static LatencyStats *getLatencyStats(const std::string& name);
+
+    //The registry only holds a weak reference on the queue, it is forgotten once destroyed.
+    static void registerQueue(const std::string& name, ThreadQueueBasePtr queue);
+
+    struct ThreadSample {
+        std::string name;
+        int64_t busyNanos;
+        uint64_t blocks;
+    };
+
+    struct QueueSample {
+        std::string name;
+        size_t instances, numItems, maxNumItems;
+        uint64_t drops;
+    };
+
+    struct LatencySample {
+        std::string name;
+        uint64_t count;
+        int64_t totalNanos, maxNanos, lastNanos;
+    };
+
+    struct Snapshot {
+        int64_t time;
+        std::vector<ThreadSample> threads;
+        std::vector<QueueSample> queues;
+        std::vector<LatencySample> latencies;
+    };
+
+    static Snapshot getSnapshot();
+
+    //Write a readable report of current, with the rates computed since previous if not nullptr, else since the last reset.
+    static void report(std::ostream& out, const Snapshot& current, const Snapshot *previous);
+
+    //report() since the last reset into fileName, false if it cannot be written.
+    static bool dumpToFile(const std::string& fileName);
+
+    //Restart all the counters, queue depths excepted.
+    static void reset();
+};
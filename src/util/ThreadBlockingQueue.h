@@ -9,6 +9,7 @@
 #include <cstdint>
 #include <stddef.h>
 #include <condition_variable>
+#include <atomic>
 #include <typeinfo>
 #include <iostream>
 #include "SpinMutex.h"
@@ -24,19 +25,74 @@
 #define BLOCKING_INFINITE_TIMEOUT (0)
 
 class ThreadQueueBase {
+public:
+    ThreadQueueBase() {
+        m_drop_count.store(0);
+    }
+
+    virtual ~ThreadQueueBase() {
+    }
+
+    /** Current and max number of items, for monitoring. */
+    virtual size_t get_num_items() const = 0;
+    virtual size_t get_max_num_items() const = 0;
+
+    /** Number of items refused because the queue was full, by try_push(), a timed out push(),
+     * or by the producer itself via add_drop() when it skips a push knowing the queue is full. */
+    uint64_t get_drop_count() const {
+        return m_drop_count.load(std::memory_order_relaxed);
+    }
+
+    void add_drop() {
+        m_drop_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset_drop_count() {
+        m_drop_count.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> m_drop_count;
 };
 
 typedef std::shared_ptr<ThreadQueueBase> ThreadQueueBasePtr;
 
-/** A thread-safe asynchronous blocking queue */
+/** The operations of a thread-safe queue of T, for the pipes which may be either a ThreadBlockingQueue
+ * or a ThreadSPSCQueue. See ThreadBlockingQueue for their description. */
 template<typename T>
-class ThreadBlockingQueue : public ThreadQueueBase {
+class ThreadQueue : public ThreadQueueBase {
 
-    typedef typename std::deque<T>::value_type value_type;
-    typedef typename std::deque<T>::size_type size_type;
+public:
+
+    typedef T value_type;
+    typedef size_t size_type;
+
+    virtual void set_max_num_items(unsigned int max_num_items) = 0;
+
+    virtual bool push(const value_type& item, std::uint64_t timeout = BLOCKING_INFINITE_TIMEOUT, const char* errorMessage = nullptr) = 0;
+    virtual bool try_push(const value_type& item) = 0;
+
+    virtual bool pop(value_type& item, std::uint64_t timeout = BLOCKING_INFINITE_TIMEOUT, const char* errorMessage = nullptr) = 0;
+    virtual bool try_pop(value_type& item) = 0;
+
+    virtual size_type size() const = 0;
+    virtual bool empty() const = 0;
+    virtual bool full() const = 0;
+
+    virtual void flush() = 0;
+};
+
+/** A thread-safe asynchronous blocking queue.
+ * It is final, so that the calls through a ThreadBlockingQueue are resolved statically,
+ * only the ones through a ThreadQueue being virtual. */
+template<typename T>
+class ThreadBlockingQueue final : public ThreadQueue<T> {
 
 public:
 
+    typedef typename std::deque<T>::value_type value_type;
+    typedef typename std::deque<T>::size_type size_type;
+
     /*! Create safe blocking queue. */
     ThreadBlockingQueue() {
         //at least 1 (== Java SynchronizedQueue)
@@ -89,11 +145,14 @@ public:
             });
         } else if (timeout <= NON_BLOCKING_TIMEOUT && m_queue.size() >= m_max_num_items) {
             // if the value is below a threshold, consider it is a try_push()
+            this->add_drop();
             return false;
         }
         else if (false == m_cond_not_full.wait_for(lock, std::chrono::microseconds(timeout),
             [this]() { return m_queue.size() < m_max_num_items; })) {
 
+            this->add_drop();
+
             if (errorMessage != nullptr) {
                 std::thread::id currentThreadId = std::this_thread::get_id();
                 std::cout << "WARNING: Thread 0x" << std::hex << currentThreadId << std::dec <<
@@ -117,6 +176,7 @@ public:
         std::lock_guard < SpinMutex > lock(m_mutex);
 
         if (m_queue.size() >= m_max_num_items) {
+            this->add_drop();
             return false;
         }
 
@@ -207,6 +267,15 @@ public:
         return (m_queue.size() >= m_max_num_items);
     }
 
+    size_t get_num_items() const {
+        return size();
+    }
+
+    size_t get_max_num_items() const {
+        std::lock_guard < SpinMutex > lock(m_mutex);
+        return m_max_num_items;
+    }
+
     /**
      *  Remove any items in the queue.
      */
@@ -0,0 +1,360 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include "ThreadBlockingQueue.h"
+
+/** A bounded Single-Producer / Single-Consumer queue, implemented as a lock-free ring buffer.
+ * It can replace ThreadBlockingQueue, behind a ThreadQueue, on pipes having exactly one pushing thread
+ * and one popping thread, like the IQ data pipes going from SDRThread to SDRPostThread,
+ * and from SDRPostThread to each demodulator or visual processor.
+ *
+ * - push() / try_push() must only be called by the producer thread,
+ * - pop() / try_pop() must only be called by the consumer thread,
+ * - flush(), size(), empty(), full() can be called from any thread.
+ *
+ * Producer and consumer never take a lock to move items: a lock is only taken by a side
+ * that has to sleep (blocking push() on a full queue, blocking pop() on an empty one),
+ * and by the opposite side only when it knows someone is sleeping, to wake it up.
+ * flush() excludes the consumer without a lock on its side: the consumer flags itself as busy
+ * and backs off when a flush is in progress, flush() waiting for it to be out of the ring.
+ */
+template<typename T>
+class ThreadSPSCQueue final : public ThreadQueue<T> {
+
+public:
+
+    typedef typename ThreadQueue<T>::value_type value_type;
+    typedef typename ThreadQueue<T>::size_type size_type;
+
+    /*! Create SPSC queue. */
+    ThreadSPSCQueue() : m_ring(MIN_ITEM_NB), m_mask(0), m_max_num_items(MIN_ITEM_NB) {
+        m_head.store(0);
+        m_tail.store(0);
+        m_consumer_busy.store(false);
+        m_flushing.store(false);
+        m_consumer_waiting.store(false);
+        m_producer_waiting.store(false);
+    }
+
+    //Forbid copy construction and assignment.
+    ThreadSPSCQueue(const ThreadSPSCQueue& sq) = delete;
+    ThreadSPSCQueue& operator=(const ThreadSPSCQueue& sq) = delete;
+
+    /**
+     * Sets the maximum number of items in the queue. As for ThreadBlockingQueue
+     * the value can only be raised. The ring storage is re-allocated if needed, so this
+     * must be called before the queue is shared between its producer and consumer threads.
+     * \param[in] nb max of items
+     */
+    void set_max_num_items(unsigned int max_num_items) {
+        ConsumerExclusion exclusion(*this);
+
+        if (max_num_items <= m_max_num_items) {
+            return;
+        }
+
+        size_t ringSize = 1;
+        while (ringSize < max_num_items) {
+            ringSize <<= 1;
+        }
+
+        if (ringSize > m_ring.size()) {
+            //re-pack the pending items at the begining of the new ring:
+            std::vector<T> newRing(ringSize);
+            size_t head = m_head.load();
+            size_t tail = m_tail.load();
+            size_t count = 0;
+
+            for (size_t pos = head; pos != tail; pos++, count++) {
+                newRing[count] = m_ring[pos & m_mask];
+            }
+
+            m_ring.swap(newRing);
+            m_mask = ringSize - 1;
+            m_head.store(0);
+            m_tail.store(count);
+        }
+
+        m_max_num_items = max_num_items;
+        notify_producer();
+    }
+
+    /**
+     * Pushes the item into the queue. If the queue is full, waits until room
+     * is available, for at most timeout microseconds. Producer thread only.
+     * \param[in] item An item.
+     * \param[in] timeout a max waiting timeout in microseconds for an item to be pushed.
+     * by default, = 0 means indefinite wait.
+     * \param[in] errorMessage if != nullptr (is nullptr by default) an error message written on std::cout in case of the timeout wait
+     * \return true if an item was pushed into the queue, else a timeout has occured.
+     */
+    bool push(const value_type& item, std::uint64_t timeout = BLOCKING_INFINITE_TIMEOUT, const char* errorMessage = nullptr) {
+
+        if (try_enqueue(item)) {
+            return true;
+        }
+
+        if (timeout != BLOCKING_INFINITE_TIMEOUT && timeout <= NON_BLOCKING_TIMEOUT) {
+            // if the value is below a threshold, consider it is a try_push()
+            this->add_drop();
+            return false;
+        }
+
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout);
+
+        while (!try_enqueue(item)) {
+
+            std::unique_lock < std::mutex > lock(m_producer_wait_mutex);
+            m_producer_waiting.store(true);
+
+            if (timeout == BLOCKING_INFINITE_TIMEOUT) {
+                m_cond_not_full.wait(lock, [this]() { return !full(); });
+            } else if (false == m_cond_not_full.wait_until(lock, deadline, [this]() { return !full(); })) {
+
+                m_producer_waiting.store(false);
+                this->add_drop();
+
+                if (errorMessage != nullptr) {
+                    std::thread::id currentThreadId = std::this_thread::get_id();
+                    std::cout << "WARNING: Thread 0x" << std::hex << currentThreadId << std::dec <<
+                        " (" << currentThreadId << ") executing {" << typeid(*this).name() << "}.push() has failed with timeout > " <<
+                        (timeout * 0.001) << " ms, message: '" << errorMessage << "'" << std::endl << std::flush;
+                }
+                return false;
+            }
+            m_producer_waiting.store(false);
+        }
+        return true;
+    }
+
+    /**
+    * Try to pushes the item into the queue, immediatly, without waiting. If the queue is full, the item
+    * is not inserted and the function returns false. Producer thread only.
+    * \param[in] item An item.
+    */
+    bool try_push(const value_type& item) {
+        if (try_enqueue(item)) {
+            return true;
+        }
+        this->add_drop();
+        return false;
+    }
+
+    /**
+     * Pops item from the queue. If the queue is empty, blocks for timeout microseconds, or until item becomes available.
+     * Consumer thread only.
+     * \param[in] timeout The number of microseconds to wait. O (default) means indefinite wait.
+     * \param[in] errorMessage if != nullptr (is nullptr by default) an error message written on std::cout in case of the timeout wait
+     * \return true if get an item from the queue, false if no item is received before the timeout.
+     */
+    bool pop(value_type& item, std::uint64_t timeout = BLOCKING_INFINITE_TIMEOUT, const char* errorMessage = nullptr) {
+
+        if (try_dequeue(item)) {
+            return true;
+        }
+
+        if (timeout != BLOCKING_INFINITE_TIMEOUT && timeout <= NON_BLOCKING_TIMEOUT) {
+            // if the value is below a threshold, consider it is try_pop()
+            return false;
+        }
+
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout);
+
+        //loop because a concurrent flush() may steal the item we have been woken up for.
+        while (!try_dequeue(item)) {
+
+            std::unique_lock < std::mutex > lock(m_consumer_wait_mutex);
+            m_consumer_waiting.store(true);
+
+            if (timeout == BLOCKING_INFINITE_TIMEOUT) {
+                m_cond_not_empty.wait(lock, [this]() { return !empty(); });
+            } else if (false == m_cond_not_empty.wait_until(lock, deadline, [this]() { return !empty(); })) {
+
+                m_consumer_waiting.store(false);
+
+                if (errorMessage != nullptr) {
+                    std::thread::id currentThreadId = std::this_thread::get_id();
+                    std::cout << "WARNING: Thread 0x" << std::hex << currentThreadId << std::dec <<
+                        " (" << currentThreadId << ") executing {" << typeid(*this).name() << "}.pop() has failed with timeout > " <<
+                        (timeout * 0.001) << " ms, message: '" << errorMessage << "'" << std::endl << std::flush;
+                }
+                return false;
+            }
+            m_consumer_waiting.store(false);
+        }
+        return true;
+    }
+
+    /**
+     *  Tries to pop item from the queue. Consumer thread only.
+     * \param[out] item The item.
+     * \return False is returned if no item is available.
+     */
+    bool try_pop(value_type& item) {
+        return try_dequeue(item);
+    }
+
+    /**
+     *  Gets the number of items in the queue.
+     * \return Number of items in the queue.
+     */
+    size_type size() const {
+        size_t head = m_head.load();
+        size_t tail = m_tail.load();
+        return (size_type)(tail - head);
+    }
+
+    /**
+     *  Check if the queue is empty.
+     * \return true if queue is empty.
+     */
+    bool empty() const {
+        return m_head.load() == m_tail.load();
+    }
+
+    /**
+     *  Check if the queue is full.
+     * \return true if queue is full.
+     */
+    bool full() const {
+        return size() >= m_max_num_items;
+    }
+
+    size_t get_max_num_items() const {
+        return m_max_num_items;
+    }
+
+    size_t get_num_items() const {
+        return size();
+    }
+
+    /**
+     *  Remove any items in the queue.
+     */
+    void flush() {
+        {
+            ConsumerExclusion exclusion(*this);
+
+            size_t head = m_head.load(std::memory_order_relaxed);
+            size_t tail = m_tail.load();
+
+            for (; head != tail; head++) {
+                //release the references now, not when the slot gets overwritten.
+                m_ring[head & m_mask] = value_type();
+            }
+            m_head.store(head);
+        }
+        notify_producer();
+    }
+
+private:
+
+    //Keeps the consumer out of the ring for its lifetime, from any thread.
+    class ConsumerExclusion {
+    public:
+        ConsumerExclusion(ThreadSPSCQueue& queue) : queue(queue), lock(queue.m_flush_mutex) {
+            //seq_cst store then load, mirrored in try_dequeue(): either the consumer sees
+            //m_flushing and backs off, or we see it busy and wait for it to leave.
+            queue.m_flushing.store(true);
+
+            while (queue.m_consumer_busy.load()) {
+                std::this_thread::yield();
+            }
+        }
+
+        ~ConsumerExclusion() {
+            queue.m_flushing.store(false);
+        }
+
+    private:
+        ThreadSPSCQueue& queue;
+        std::lock_guard < std::mutex > lock;
+    };
+
+    bool try_enqueue(const value_type& item) {
+
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail - m_head.load() >= m_max_num_items) {
+            return false;
+        }
+
+        m_ring[tail & m_mask] = item;
+
+        //seq_cst store, paired with the seq_cst load of m_consumer_waiting below,
+        //so that either the consumer sees the new item, or we see it waiting.
+        m_tail.store(tail + 1);
+
+        if (m_consumer_waiting.load()) {
+            std::lock_guard < std::mutex > lock(m_consumer_wait_mutex);
+            m_cond_not_empty.notify_all();
+        }
+        return true;
+    }
+
+    bool try_dequeue(value_type& item) {
+        m_consumer_busy.store(true);
+
+        //a flush is emptying the ring: there is nothing to take anyway.
+        if (m_flushing.load()) {
+            m_consumer_busy.store(false, std::memory_order_release);
+            return false;
+        }
+
+        size_t head = m_head.load(std::memory_order_relaxed);
+
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            m_consumer_busy.store(false, std::memory_order_release);
+            return false;
+        }
+
+        //move out and leave an empty slot, so that shared_ptr
+        //items are not kept alive by the ring (ReBuffer relies on use_count()).
+        value_type& slot = m_ring[head & m_mask];
+        item = std::move(slot);
+        slot = value_type();
+
+        m_head.store(head + 1);
+        m_consumer_busy.store(false, std::memory_order_release);
+
+        notify_producer();
+        return true;
+    }
+
+    void notify_producer() {
+        if (m_producer_waiting.load()) {
+            std::lock_guard < std::mutex > lock(m_producer_wait_mutex);
+            m_cond_not_full.notify_all();
+        }
+    }
+
+    std::vector<T> m_ring;
+    size_t m_mask;
+    size_t m_max_num_items;
+
+    //producer and consumer indices, on separate cache lines so that each side
+    //only bounces the line of the other when it actually reads it.
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+
+    //the consumer is in try_dequeue(), a flush() or set_max_num_items() is in progress.
+    std::atomic_bool m_consumer_busy;
+    std::atomic_bool m_flushing;
+    //serializes the flush() and set_max_num_items() calls.
+    std::mutex m_flush_mutex;
+
+    std::atomic_bool m_consumer_waiting;
+    std::atomic_bool m_producer_waiting;
+    std::mutex m_consumer_wait_mutex;
+    std::mutex m_producer_wait_mutex;
+    std::condition_variable m_cond_not_empty;
+    std::condition_variable m_cond_not_full;
+};
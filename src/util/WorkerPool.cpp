@@ -0,0 +1,171 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+
+//50 ms
+#define HEARTBEAT_CHECK_PERIOD_MICROS (50 * 1000)
+
+WorkerPool::WorkerPool(const std::string& name, size_t numThreads) : name(name) {
+    pendingTasks.store(0);
+    nextQueue.store(0);
+    stopping.store(false);
+
+    for (size_t i = 0; i < numThreads + 1; i++) {
+        queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+    }
+
+    for (size_t i = 0; i < numThreads; i++) {
+        threads.push_back(std::thread(&WorkerPool::workerMain, this, i));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard < std::mutex > lock(wakeMutex);
+        stopping.store(true);
+    }
+    wakeCond.notify_all();
+
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+size_t WorkerPool::getDefaultNumThreads(size_t maxThreads) {
+    size_t numCores = std::thread::hardware_concurrency();
+
+    //keep one core for the calling thread.
+    size_t numThreads = (numCores > 1) ? (numCores - 1) : 0;
+
+    return std::min(numThreads, maxThreads);
+}
+
+size_t WorkerPool::getNumThreads() {
+    return threads.size();
+}
+
+void WorkerPool::enqueue(size_t queueIndex, Task task) {
+    std::lock_guard < SpinMutex > lock(queues[queueIndex]->lock);
+
+    //counted under the queue lock, before the task can be taken, so that takeTask() never decrements first.
+    pendingTasks++;
+    queues[queueIndex]->tasks.push_back(std::move(task));
+}
+
+bool WorkerPool::takeTask(size_t first, Task& task) {
+    size_t numQueues = queues.size();
+
+    for (size_t k = 0; k < numQueues; k++) {
+        TaskQueue& queue = *queues[(first + k) % numQueues];
+
+        std::lock_guard < SpinMutex > lock(queue.lock);
+
+        if (queue.tasks.empty()) {
+            continue;
+        }
+
+        //own tasks are taken from the front, stolen ones from the back.
+        if (k == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        pendingTasks--;
+        return true;
+    }
+    return false;
+}
+
+void WorkerPool::workerMain(size_t workerIndex) {
+    while (!stopping.load()) {
+        Task task;
+
+        if (takeTask(workerIndex, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock < std::mutex > lock(wakeMutex);
+        wakeCond.wait_for(lock, std::chrono::microseconds(HEARTBEAT_CHECK_PERIOD_MICROS), [this]() {
+            return stopping.load() || pendingTasks.load() > 0;
+        });
+    }
+}
+
+void WorkerPool::submit(Task task) {
+    if (threads.empty()) {
+        task();
+        return;
+    }
+
+    //leave the callers queue to parallelFor(): a worker would have to steal the task from it.
+    enqueue(nextQueue++ % threads.size(), std::move(task));
+
+    {
+        std::lock_guard < std::mutex > lock(wakeMutex);
+    }
+    wakeCond.notify_one();
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+
+    //nothing to share: do not pay for the queues.
+    if (threads.empty() || count == 1) {
+        for (size_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    //shared with the tasks, which may still be signaling completion when the caller returns.
+    struct Batch {
+        std::atomic_size_t remaining;
+        std::mutex doneMutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->remaining.store(count);
+
+    //spread the tasks round-robin over all the queues, starting at a different one each time.
+    size_t numQueues = queues.size();
+    size_t start = nextQueue++;
+
+    for (size_t i = 0; i < count; i++) {
+        enqueue((start + i) % numQueues, [batch, &task, i]() {
+            task(i);
+
+            if (--batch->remaining == 0) {
+                std::lock_guard < std::mutex > lock(batch->doneMutex);
+                batch->done.notify_all();
+            }
+        });
+    }
+
+    {
+        std::lock_guard < std::mutex > lock(wakeMutex);
+    }
+    wakeCond.notify_all();
+
+    //help until no task is left to take, then wait for the ones still running.
+    size_t callerQueue = numQueues - 1;
+
+    while (batch->remaining.load() > 0) {
+        Task t;
+
+        if (takeTask(callerQueue, t)) {
+            t();
+            continue;
+        }
+
+        std::unique_lock < std::mutex > lock(batch->doneMutex);
+        batch->done.wait(lock, [&batch]() { return batch->remaining.load() == 0; });
+    }
+}
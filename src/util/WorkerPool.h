@@ -0,0 +1,74 @@
+// Copyright (c) Charles J. Cliffe
+// SPDX-License-Identifier: GPL-2.0+
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SpinMutex.h"
+
+/** A small pool of worker threads with work-stealing, to fan out DSP work
+ * (channels, sub-blocks...) from a single processing thread to the idle cores,
+ * or to run independent tasks submitted by any thread.
+ *
+ * Each worker owns a task deque: tasks are spread round-robin over the deques,
+ * a worker pops from the front of its own deque, and when it is empty steals
+ * from the back of the others.
+ * The thread calling parallelFor() takes part in the work too, so a pool
+ * created with 0 threads simply runs everything in the caller.
+ */
+class WorkerPool {
+public:
+    typedef std::function<void()> Task;
+
+    /// numThreads == 0 means no worker thread: everything is run by the caller.
+    WorkerPool(const std::string& name, size_t numThreads);
+    ~WorkerPool();
+
+    /// Number of threads to use for a pool sharing the CPU with the rest of the application:
+    /// one less than the number of cores, at most maxThreads.
+    static size_t getDefaultNumThreads(size_t maxThreads);
+
+    size_t getNumThreads();
+
+    /// Run task(i) for each i in [0, count), spread over the workers and the calling thread.
+    /// Returns when all of them have completed.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    /// Queue task to be run by a worker, and return without waiting for it.
+    /// Run by the caller right away if the pool has no worker thread.
+    void submit(Task task);
+
+private:
+    struct TaskQueue {
+        SpinMutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void workerMain(size_t workerIndex);
+
+    void enqueue(size_t queueIndex, Task task);
+
+    //pop a task from queue 'first', else steal one from any other.
+    bool takeTask(size_t first, Task& task);
+
+    std::string name;
+
+    //one queue per worker thread, plus one for the threads calling parallelFor().
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::atomic_size_t pendingTasks;
+    std::atomic_size_t nextQueue;
+    std::atomic_bool stopping;
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeCond;
+};
@@ -523,9 +523,13 @@ void PrimaryGLContext::BeginDraw(float r, float g, float b) {
 
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
+
+    GLFont::beginBatch(this);
 }
 
 void PrimaryGLContext::EndDraw() {
+    GLFont::flushBatch();
+
 //    glFlush();
 
 //    CheckGLError();
@@ -59,6 +59,7 @@ void SpectrumCanvas::OnPaint(wxPaintEvent& WXUNUSED(event)) {
             
         if (vData) {
             spectrumPanel.setPoints(vData->spectrum_points);
+            spectrumPanel.setPyramid(SpectrumPyramidPtr(vData, &vData->spectrum_pyramid));
             spectrumPanel.setPeakPoints(vData->spectrum_hold_points);
             spectrumPanel.setFloorValue(vData->fft_floor);
             spectrumPanel.setCeilValue(vData->fft_ceiling);
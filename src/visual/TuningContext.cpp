@@ -39,6 +39,8 @@ void TuningContext::DrawBegin() {
     glLoadIdentity();
 
     glDisable(GL_TEXTURE_2D);
+
+    GLFont::beginBatch(this);
 }
 
 void TuningContext::Draw(float r, float g, float b, float a, float p1, float p2) {
@@ -62,6 +64,8 @@ void TuningContext::Draw(float r, float g, float b, float a, float p1, float p2)
 }
 
 void TuningContext::DrawEnd() {
+    GLFont::flushBatch();
+
 //    glFlush();
 
 //    CheckGLError();
@@ -103,7 +107,7 @@ void TuningContext::DrawTuner(long long freq, int count, float displayPos, float
 
     for (int i = ofs; i < count; i++) {
         float xpos = displayPos + (displayWidth / (float) count) * (float) i + ((displayWidth / 2.0) / (float) count);
-        refDrawingFont.drawString(freqStr.str().substr(i - ofs, 1), xpos, 0, GLFont::GLFONT_ALIGN_CENTER, GLFont::GLFONT_ALIGN_CENTER);
+        refDrawingFont.drawString(freqStr.str().substr(i - ofs, 1), xpos, 0, GLFont::GLFONT_ALIGN_CENTER, GLFont::GLFONT_ALIGN_CENTER, 0, 0, true);
     }
 
     glColor4f(0.65f, 0.65f, 0.65f, 0.25f);
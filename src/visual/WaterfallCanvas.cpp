@@ -51,6 +51,10 @@ WaterfallCanvas::WaterfallCanvas(wxWindow *parent, const wxGLAttributes& dispAtt
     scaleMove = 0;
     minBandwidth = 30000;
     fft_size_changed.store(false);
+    historyAge = 0;
+    historyRowsPerLine = 1;
+    historyView = false;
+    historyChanged = false;
 }
 
 WaterfallCanvas::~WaterfallCanvas() {
@@ -105,11 +109,21 @@ void WaterfallCanvas::processInputQueue() {
                     
                     if (vData) {
                         if (vData->spectrum_points.size() == fft_size * 2) {
-                            waterfallPanel.setPoints(vData->spectrum_points);
+                            if (history.isOpen()) {
+                                history.append(&vData->spectrum_points[1], fft_size, 2, vData->centerFreq, vData->bandwidth, WaterfallHistory::now());
+                                //keep the history on screen where it is.
+                                if (historyView) {
+                                    historyAge++;
+                                }
+                            }
+                            if (!historyView) {
+                                waterfallPanel.setPoints(vData->spectrum_points);
+                            }
+                        }
+                        if (!historyView) {
+                            waterfallPanel.step();
+                            updated = true;
                         }
-                        waterfallPanel.step();
-                      
-                        updated = true;
                     }
                     lpsIndex-=targetVis;
                 } else {
@@ -118,6 +132,11 @@ void WaterfallCanvas::processInputQueue() {
             }
         }
     }
+    if (historyChanged) {
+        loadHistoryLines();
+        historyChanged = false;
+        updated = true;
+    }
     if (updated) {
         wxClientDC(this);
         glContext->SetCurrent(*this);
@@ -448,6 +467,58 @@ void WaterfallCanvas::OnKeyDown(wxKeyEvent& event) {
     case 'E': //E is for 'Edit the label' of the active demodulator. 
         wxGetApp().showLabelInput();
         break;
+    case WXK_PAGEUP:
+    case WXK_NUMPAD_PAGEUP:
+    case WXK_PAGEDOWN:
+    case WXK_NUMPAD_PAGEDOWN:
+    case WXK_END:
+    case WXK_NUMPAD_END:
+        {
+            std::lock_guard < std::mutex > lock(tex_update);
+
+            if (!history.isOpen() || !waterfall_lines) {
+                break;
+            }
+
+            size_t historyRows = history.getNumRows();
+            size_t lines = (size_t)waterfall_lines;
+            int keyCode = event.GetKeyCode();
+
+            if (keyCode == WXK_END || keyCode == WXK_NUMPAD_END) {
+                historyView = false;
+            } else if (shiftDown) {
+                //zoom out / in around the top line.
+                if (keyCode == WXK_PAGEUP || keyCode == WXK_NUMPAD_PAGEUP) {
+                    if (historyRowsPerLine * lines < historyRows) {
+                        historyRowsPerLine *= 2;
+                    }
+                } else if (historyRowsPerLine > 1) {
+                    historyRowsPerLine /= 2;
+                }
+                historyView = true;
+            } else {
+                size_t scroll = std::max((size_t)1, lines / 2) * historyRowsPerLine;
+
+                if (keyCode == WXK_PAGEUP || keyCode == WXK_NUMPAD_PAGEUP) {
+                    if (historyAge + scroll < historyRows) {
+                        historyAge += scroll;
+                    }
+                    historyView = true;
+                } else {
+                    historyAge = (historyAge > scroll) ? (historyAge - scroll) : 0;
+                }
+            }
+
+            if (historyView && historyAge == 0 && historyRowsPerLine == 1) {
+                historyView = false;
+            }
+            if (!historyView) {
+                historyAge = 0;
+                historyRowsPerLine = 1;
+            }
+            historyChanged = true;
+        }
+        break;
     case 'C':
         if (wxGetApp().getDemodMgr().getActiveContextModem()) {
             wxGetApp().setFrequency(wxGetApp().getDemodMgr().getActiveContextModem()->getFrequency());
@@ -912,6 +983,68 @@ void WaterfallCanvas::updateCenterFrequency(long long freq) {
 
 }
 
+void WaterfallCanvas::enableHistory(const std::string& path, size_t capacity) {
+    std::lock_guard < std::mutex > lock(tex_update);
+
+    historyView = false;
+    historyAge = 0;
+    historyRowsPerLine = 1;
+
+    history.open(path, capacity);
+}
+
+void WaterfallCanvas::disableHistory() {
+    std::lock_guard < std::mutex > lock(tex_update);
+
+    if (historyView) {
+        historyView = false;
+        historyAge = 0;
+        historyRowsPerLine = 1;
+        historyChanged = true;
+    }
+    history.close();
+}
+
+bool WaterfallCanvas::isHistoryEnabled() {
+    std::lock_guard < std::mutex > lock(tex_update);
+
+    return history.isOpen();
+}
+
+bool WaterfallCanvas::exportHistory(const std::string& path) {
+    std::lock_guard < std::mutex > lock(tex_update);
+
+    if (!history.isOpen()) {
+        return false;
+    }
+
+    return history.exportImage(path, historyAge, (size_t)waterfall_lines * historyRowsPerLine);
+}
+
+void WaterfallCanvas::loadHistoryLines() {
+    if (!history.isOpen() || !waterfall_lines) {
+        return;
+    }
+
+    historyLines.resize((size_t)waterfall_lines * WATERFALL_HISTORY_ROW_WIDTH);
+    history.readLines(historyAge, historyRowsPerLine, waterfall_lines, &historyLines[0]);
+    waterfallPanel.setLines(&historyLines[0], waterfall_lines, WATERFALL_HISTORY_ROW_WIDTH);
+
+    if (!historyView) {
+        setStatusText("Waterfall history: live");
+        return;
+    }
+
+    WaterfallHistory::Row row;
+    if (history.getRow(historyAge, row)) {
+        wxDateTime rowTime(wxLongLong(row.timestamp / 1000));
+        std::string timeText = rowTime.Format("%Y-%m-%d %H:%M:%S").ToStdString();
+
+        setStatusText("Waterfall history at " + timeText + ", " + std::to_string(historyRowsPerLine)
+                      + " row(s) per line. Page Up / Page Down to scroll, Shift to zoom, End to go back live.");
+    }
+}
+
 void WaterfallCanvas::setLinesPerSecond(int lps) {
     std::lock_guard < std::mutex > lock(tex_update);
     
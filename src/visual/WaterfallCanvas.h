@@ -13,6 +13,7 @@
 #include "MouseTracker.h"
 #include "SpectrumCanvas.h"
 #include "WaterfallPanel.h"
+#include "WaterfallHistory.h"
 #include "Timer.h"
 
 class WaterfallCanvas: public InteractiveCanvas {
@@ -36,6 +37,15 @@ public:
     void setLinesPerSecond(int lps);
     void setMinBandwidth(int min);
 
+    //Keep every line in a history ring file of capacity rows, to scroll back to
+    //with Page Up / Page Down, Shift to zoom out / in and End to go back live.
+    //The file is opened in the background, see WaterfallHistory::open().
+    void enableHistory(const std::string& path, size_t capacity);
+    void disableHistory();
+    bool isHistoryEnabled();
+    //Export the history lines on screen, or the latest ones when live.
+    bool exportHistory(const std::string& path);
+
     //This is public because it is indeed forwarded from
     //AppFrame::OnGlobalKeyDown, because global key handler intercepts 
     //calls in all windows.
@@ -66,6 +76,9 @@ private:
     void OnMouseLeftWindow(wxMouseEvent& event);
 
     void updateCenterFrequency(long long freq);
+
+    //show the history from historyAge with historyRowsPerLine rows per line, or the latest lines when live.
+    void loadHistoryLines();
     
     std::vector<float> spectrum_points;
 
@@ -96,6 +109,11 @@ private:
     std::mutex tex_update;
     int minBandwidth;
     std::atomic_bool fft_size_changed;
+
+    WaterfallHistory history;
+    std::vector<unsigned char> historyLines;
+    size_t historyAge, historyRowsPerLine;
+    bool historyView, historyChanged;
     // event table
 wxDECLARE_EVENT_TABLE();
 };